@@ -42,6 +42,8 @@
 #include <limits.h>
 #include <lua.h>
 #include <lauxlib.h>
+#include <TH.h>
+#include <luaT.h>
 
 #include "strbuf.h"
 #include "fpconv.h"
@@ -124,6 +126,7 @@ typedef struct {
     int encode_invalid_numbers;     /* 2 => Encode as "null" */
     int encode_number_precision;
     int encode_keep_buffer;
+    int encode_last_length;         /* Initial size of private buffers */
 
     int decode_invalid_numbers;
     int decode_max_depth;
@@ -390,6 +393,7 @@ static void json_create_config(lua_State *l)
     cfg->decode_invalid_numbers = DEFAULT_DECODE_INVALID_NUMBERS;
     cfg->encode_keep_buffer = DEFAULT_ENCODE_KEEP_BUFFER;
     cfg->encode_number_precision = DEFAULT_ENCODE_NUMBER_PRECISION;
+    cfg->encode_last_length = 0;
 
 #if DEFAULT_ENCODE_KEEP_BUFFER > 0
     strbuf_init(&cfg->encode_buf, 0);
@@ -583,10 +587,10 @@ static void json_append_array(lua_State *l, json_config_t *cfg, int current_dept
     strbuf_append_char(json, ']');
 }
 
-static void json_append_number(lua_State *l, json_config_t *cfg,
-                               strbuf_t *json, int lindex)
+/* lindex is only used to report errors */
+static void json_append_double(lua_State *l, json_config_t *cfg,
+                               strbuf_t *json, int lindex, double num)
 {
-    double num = lua_tonumber(l, lindex);
     int len;
 
     if (cfg->encode_invalid_numbers == 0) {
@@ -621,6 +625,45 @@ static void json_append_number(lua_State *l, json_config_t *cfg,
     strbuf_extend_length(json, len);
 }
 
+static void json_append_number(lua_State *l, json_config_t *cfg,
+                               strbuf_t *json, int lindex)
+{
+    json_append_double(l, cfg, json, lindex, lua_tonumber(l, lindex));
+}
+
+/* Tensors are serialised as nested arrays (one per dimension), straight
+ * from their storage. No Lua value is created per element. */
+#define JSON_APPEND_TENSOR(Type, real)                                   \
+static void json_append_##Type##Tensor(lua_State *l, json_config_t *cfg,   \
+                                       strbuf_t *json,                     \
+                                       TH##Type##Tensor *tensor,           \
+                                       real *data, int dim)                \
+{                                                                           \
+    long size = tensor->size[dim];                                          \
+    long stride = tensor->stride[dim];                                      \
+    long i;                                                                 \
+                                                                            \
+    strbuf_append_char(json, '[');                                          \
+    for (i = 0; i < size; i++) {                                            \
+        if (i > 0)                                                          \
+            strbuf_append_char(json, ',');                                  \
+        if (dim == tensor->nDimension - 1)                                  \
+            json_append_double(l, cfg, json, -1, (double)data[i*stride]);   \
+        else                                                                \
+            json_append_##Type##Tensor(l, cfg, json, tensor,                \
+                                       data + i*stride, dim + 1);           \
+    }                                                                       \
+    strbuf_append_char(json, ']');                                          \
+}
+
+JSON_APPEND_TENSOR(Double, double)
+JSON_APPEND_TENSOR(Float, float)
+JSON_APPEND_TENSOR(Long, long)
+JSON_APPEND_TENSOR(Int, int)
+JSON_APPEND_TENSOR(Short, short)
+JSON_APPEND_TENSOR(Char, char)
+JSON_APPEND_TENSOR(Byte, unsigned char)
+
 static void json_append_object(lua_State *l, json_config_t *cfg,
                                int current_depth, strbuf_t *json)
 {
@@ -662,6 +705,38 @@ static void json_append_object(lua_State *l, json_config_t *cfg,
     strbuf_append_char(json, '}');
 }
 
+#define JSON_TENSOR_CASE(Type)                                              \
+    if ((tensor = luaT_toudata(l, -1, "torch." #Type "Tensor"))) {          \
+        TH##Type##Tensor *t = tensor;                                       \
+        json_check_encode_depth(l, cfg, current_depth + t->nDimension, json); \
+        if (t->nDimension == 0)                                             \
+            strbuf_append_mem(json, "[]", 2);                               \
+        else                                                                \
+            json_append_##Type##Tensor(l, cfg, json, t,                     \
+                    TH##Type##Tensor_data(t), 0);  \
+        return 1;                                                           \
+    }
+
+/* Returns 0 if the value on the top of the stack is not a tensor */
+static int json_append_tensor(lua_State *l, json_config_t *cfg,
+                              int current_depth, strbuf_t *json)
+{
+    void *tensor;
+
+    if (lua_type(l, -1) != LUA_TUSERDATA)
+        return 0;
+
+    JSON_TENSOR_CASE(Double)
+    JSON_TENSOR_CASE(Float)
+    JSON_TENSOR_CASE(Long)
+    JSON_TENSOR_CASE(Int)
+    JSON_TENSOR_CASE(Short)
+    JSON_TENSOR_CASE(Char)
+    JSON_TENSOR_CASE(Byte)
+
+    return 0;
+}
+
 /* Serialise Lua data into JSON string. */
 static void json_append_data(lua_State *l, json_config_t *cfg,
                              int current_depth, strbuf_t *json)
@@ -698,9 +773,13 @@ static void json_append_data(lua_State *l, json_config_t *cfg,
             strbuf_append_mem(json, "null", 4);
             break;
         }
+    case LUA_TUSERDATA:
+        if (json_append_tensor(l, cfg, current_depth, json))
+            break;
     default:
-        /* Remaining types (LUA_TFUNCTION, LUA_TUSERDATA, LUA_TTHREAD,
-         * and LUA_TLIGHTUSERDATA) cannot be serialised */
+        /* Remaining types (LUA_TFUNCTION, LUA_TTHREAD, LUA_TLIGHTUSERDATA
+         * and LUA_TUSERDATA other than torch tensors) cannot be
+         * serialised */
         json_encode_exception(l, cfg, json, -1, "type not supported");
         /* never returns */
     }
@@ -719,7 +798,7 @@ static int json_encode(lua_State *l)
     if (!cfg->encode_keep_buffer) {
         /* Use private buffer */
         encode_buf = &local_encode_buf;
-        strbuf_init(encode_buf, 0);
+        strbuf_init(encode_buf, cfg->encode_last_length);
     } else {
         /* Reuse existing buffer */
         encode_buf = &cfg->encode_buf;
@@ -731,6 +810,9 @@ static int json_encode(lua_State *l)
 
     lua_pushlstring(l, json, len);
 
+    /* Similar values are usually encoded over and over */
+    cfg->encode_last_length = len;
+
     if (!cfg->encode_keep_buffer)
         strbuf_free(encode_buf);
 
@@ -1188,6 +1270,40 @@ static void json_parse_object_context(lua_State *l, json_parse_t *json)
     }
 }
 
+/* Largest array preallocated at once; longer arrays grow as they are
+ * filled */
+#define JSON_MAX_PREALLOC (1 << 20)
+
+/* Called after the first number of an array.
+ * Returns the number of elements of an array holding only numbers (at
+ * most JSON_MAX_PREALLOC), or 0 if something else is found. Invalid
+ * numbers, and empty elements such as "[1,,2]", are reported later. */
+static int json_numeric_array_length(json_parse_t *json)
+{
+    const char *p;
+    int n = 1;
+
+    for (p = json->ptr; *p; p++) {
+        switch (*p) {
+        case ',':
+            if (++n == JSON_MAX_PREALLOC)
+                return n;
+            break;
+        case ']':
+            return n;
+        case '"':
+        case '[':
+        case '{':
+        case 't':
+        case 'f':
+        case 'n':
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
 /* Handle the array context */
 static void json_parse_array_context(lua_State *l, json_parse_t *json)
 {
@@ -1198,10 +1314,14 @@ static void json_parse_array_context(lua_State *l, json_parse_t *json)
      * .., table, value */
     json_decode_descend(l, json, 2);
 
-    lua_newtable(l);
-
     json_next_token(json, &token);
 
+    /* Homogeneous numeric arrays are allocated at once */
+    if (token.type == T_NUMBER)
+        lua_createtable(l, json_numeric_array_length(json), 0);
+    else
+        lua_newtable(l);
+
     /* Handle empty arrays */
     if (token.type == T_ARR_END) {
         json_decode_ascend(json);
@@ -1296,6 +1416,666 @@ static int json_decode(lua_State *l)
     return 1;
 }
 
+/* Fill a preallocated tensor from nested arrays. The array nesting and
+ * lengths must match the tensor dimensions and sizes. */
+#define JSON_PARSE_TENSOR(Type, real)                                       \
+static void json_parse_##Type##Tensor(lua_State *l, json_parse_t *json,    \
+                                      json_token_t *token,                 \
+                                      TH##Type##Tensor *tensor,            \
+                                      real *data, int dim)                 \
+{                                                                           \
+    long size = tensor->size[dim];                                          \
+    long stride = tensor->stride[dim];                                      \
+    long i;                                                                 \
+                                                                            \
+    if (token->type != T_ARR_BEGIN)                                         \
+        json_throw_parse_error(l, json, "array", token);                    \
+                                                                            \
+    json_decode_descend(l, json, 1);                                        \
+                                                                            \
+    for (i = 0; ; i++) {                                                    \
+        json_next_token(json, token);                                       \
+        if (dim == tensor->nDimension - 1) {                                \
+            if (token->type != T_NUMBER)                                    \
+                json_throw_parse_error(l, json, "number", token);           \
+            data[i*stride] = (real)token->value.number;                     \
+        } else {                                                            \
+            json_parse_##Type##Tensor(l, json, token, tensor,               \
+                                      data + i*stride, dim + 1);            \
+        }                                                                   \
+                                                                            \
+        json_next_token(json, token);                                       \
+        if (i == size - 1) {                                                \
+            if (token->type != T_ARR_END)                                   \
+                json_throw_parse_error(l, json, "array end", token);        \
+            break;                                                          \
+        }                                                                   \
+        if (token->type != T_COMMA)                                         \
+            json_throw_parse_error(l, json, "comma", token);                \
+    }                                                                       \
+                                                                            \
+    json_decode_ascend(json);                                               \
+}
+
+JSON_PARSE_TENSOR(Double, double)
+JSON_PARSE_TENSOR(Float, float)
+
+static int json_decode_tensor(lua_State *l)
+{
+    json_parse_t json;
+    json_token_t token;
+    size_t json_len;
+    THDoubleTensor *dtensor;
+    THFloatTensor *ftensor;
+
+    luaL_argcheck(l, lua_gettop(l) == 2, 2, "expected 2 arguments");
+
+    json.cfg = json_fetch_config(l);
+    json.data = luaL_checklstring(l, 1, &json_len);
+    json.current_depth = 0;
+    json.ptr = json.data;
+
+    dtensor = luaT_toudata(l, 2, "torch.DoubleTensor");
+    ftensor = luaT_toudata(l, 2, "torch.FloatTensor");
+    luaL_argcheck(l, dtensor || ftensor, 2,
+                  "torch.DoubleTensor or torch.FloatTensor expected");
+    luaL_argcheck(l, (dtensor ? dtensor->nDimension : ftensor->nDimension) > 0,
+                  2, "tensor must be allocated");
+
+    if (json_len >= 2 && (!json.data[0] || !json.data[1]))
+        luaL_error(l, "JSON parser does not support UTF-16 or UTF-32");
+
+    /* Strings are rejected, but the tokenizer still decodes them first */
+    json.tmp = strbuf_new(json_len);
+
+    json_next_token(&json, &token);
+    if (dtensor)
+        json_parse_DoubleTensor(l, &json, &token, dtensor,
+                                THDoubleTensor_data(dtensor), 0);
+    else
+        json_parse_FloatTensor(l, &json, &token, ftensor,
+                               THFloatTensor_data(ftensor), 0);
+
+    /* Ensure there is no more input left */
+    json_next_token(&json, &token);
+
+    if (token.type != T_END)
+        json_throw_parse_error(l, &json, "the end", &token);
+
+    strbuf_free(json.tmp);
+
+    lua_settop(l, 2);
+    return 1;
+}
+
+/* ===== STREAMING DECODER ===== */
+
+/* cjson.decoder() decodes documents (or streams of concatenated
+ * documents) fed by chunks, without holding the whole input. Tokens split
+ * between two chunks are kept until the next feed.
+ *
+ * Values nested at "depth" (0: top level values) are decoded as a whole
+ * and passed to handler.value(value, key), or queued for decoder:next()
+ * when there is no such handler. Containers above that depth are never
+ * built: they are reported through handler.object_begin(key),
+ * handler.array_begin(key), handler.object_end() and handler.array_end().
+ * Scalars above that depth are passed to handler.value() too. */
+
+typedef enum {
+    S_ARR_FIRST,
+    S_ARR_VALUE,
+    S_ARR_NEXT,
+    S_OBJ_FIRST,
+    S_OBJ_KEY,
+    S_OBJ_COLON,
+    S_OBJ_VALUE,
+    S_OBJ_NEXT
+} json_stream_state_t;
+
+static const char *json_stream_expected[] = {
+    "value or array end",
+    "value",
+    "comma or array end",
+    "object key string or object end",
+    "object key string",
+    "colon",
+    "value",
+    "comma or object end"
+};
+
+typedef struct {
+    json_stream_state_t state;
+    int is_object;
+    int index;          /* Last array index */
+} json_stream_level_t;
+
+typedef struct {
+    json_config_t *cfg;
+    strbuf_t input;     /* Unconsumed input starts at pos */
+    strbuf_t tmp;       /* Temporary storage for strings */
+    json_stream_level_t *levels;
+    int nlevels;
+    int maxlevels;
+    int depth;
+    int pos;
+    long consumed;      /* Input dropped before input.buf */
+    int qhead;
+    int qtail;
+    int finished;
+    int error;
+} json_stream_t;
+
+/* Decoder environment table slots */
+#define STREAM_HANDLER  1
+#define STREAM_CONFIG   2
+#define STREAM_BUILD    3   /* Table being built, per level */
+#define STREAM_KEYS     4   /* Key of each level in its parent */
+#define STREAM_PENDING  5   /* Last key read, per object level */
+#define STREAM_QUEUE    6
+#define STREAM_QKEYS    7
+
+/* Longest token which can be reported as invalid only because it has
+ * been split: "-Infinity", or a surrogate pair escape */
+#define STREAM_LOOKAHEAD 12
+
+static void json_stream_error(lua_State *l, json_stream_t *s,
+                              json_token_t *token)
+{
+    const char *exp, *found;
+
+    s->error = 1;
+
+    if (s->nlevels > 0)
+        exp = json_stream_expected[s->levels[s->nlevels - 1].state];
+    else
+        exp = "value";
+
+    if (token->type == T_ERROR)
+        found = token->value.string;
+    else
+        found = json_token_type_name[token->type];
+
+    luaL_error(l, "Expected %s but found %s at character %d",
+               exp, found, (int)(s->consumed + token->index + 1));
+}
+
+static int json_is_number_char(char ch)
+{
+    return ('0' <= ch && ch <= '9') || ('a' <= (ch | 0x20) && (ch | 0x20) <= 'z') ||
+           ch == '.' || ch == '+' || ch == '-';
+}
+
+/* Returns 0 when more input is required to read the next token */
+static int json_stream_next_token(json_stream_t *s, json_parse_t *json,
+                                  json_token_t *token, const char *end)
+{
+    const char *start;
+
+    while (json->ptr < end &&
+           s->cfg->ch2token[(unsigned char)*json->ptr] == T_WHITESPACE)
+        json->ptr++;
+
+    if (json->ptr == end) {
+        token->type = T_END;
+        token->index = json->ptr - json->data;
+        return s->finished;
+    }
+
+    if (!*json->ptr) {
+        json_set_token_error(token, json, "invalid token");
+        return 1;
+    }
+
+    start = json->ptr;
+    json_next_token(json, token);
+
+    if (s->finished)
+        return 1;
+
+    if (token->type == T_ERROR &&
+        end - (json->data + token->index) < STREAM_LOOKAHEAD) {
+        json->ptr = start;
+        return 0;
+    }
+
+    if (token->type == T_NUMBER) {
+        const char *p = json->ptr;
+
+        while (p < end && json_is_number_char(*p))
+            p++;
+        if (p == end) {
+            json->ptr = start;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Calls handler[name] with the nargs values on the top of the stack.
+ * Arguments are popped in any case. */
+static void json_stream_callback(lua_State *l, int env, const char *name,
+                                 int nargs)
+{
+    lua_rawgeti(l, env, STREAM_HANDLER);
+    if (lua_istable(l, -1)) {
+        lua_getfield(l, -1, name);
+        lua_remove(l, -2);
+        if (lua_isfunction(l, -1)) {
+            lua_insert(l, -(nargs + 1));
+            lua_call(l, nargs, 0);
+            return;
+        }
+    }
+    lua_pop(l, nargs + 1);
+}
+
+/* .., key, value => .. */
+static void json_stream_emit(lua_State *l, json_stream_t *s, int env)
+{
+    lua_insert(l, -2);
+
+    lua_rawgeti(l, env, STREAM_HANDLER);
+    if (lua_istable(l, -1)) {
+        lua_getfield(l, -1, "value");
+        lua_remove(l, -2);
+        if (lua_isfunction(l, -1)) {
+            lua_insert(l, -3);
+            lua_call(l, 2, 0);
+            return;
+        }
+    }
+    lua_pop(l, 1);
+
+    /* No value handler: queue for decoder:next() */
+    s->qtail++;
+    lua_rawgeti(l, env, STREAM_QKEYS);
+    lua_insert(l, -2);
+    lua_rawseti(l, -2, s->qtail);
+    lua_pop(l, 1);
+    lua_rawgeti(l, env, STREAM_QUEUE);
+    lua_insert(l, -2);
+    lua_rawseti(l, -2, s->qtail);
+    lua_pop(l, 1);
+}
+
+/* .., key, value => ..
+ * Stores the value in the table being built, or emits it */
+static void json_stream_add_value(lua_State *l, json_stream_t *s, int env)
+{
+    if (s->nlevels > s->depth) {
+        lua_rawgeti(l, env, STREAM_BUILD);
+        lua_rawgeti(l, -1, s->nlevels);
+        lua_remove(l, -2);
+        lua_insert(l, -3);
+        lua_rawset(l, -3);
+        lua_pop(l, 1);
+    } else {
+        json_stream_emit(l, s, env);
+    }
+}
+
+/* .., key => .. */
+static void json_stream_open(lua_State *l, json_stream_t *s, int env,
+                             json_token_t *token)
+{
+    json_stream_level_t *level;
+    int is_object = (token->type == T_OBJ_BEGIN);
+
+    if (s->nlevels >= s->cfg->decode_max_depth || !lua_checkstack(l, 6)) {
+        s->error = 1;
+        luaL_error(l, "Found too many nested data structures (%d) at character %d",
+                   s->nlevels + 1, (int)(s->consumed + token->index + 1));
+    }
+
+    if (s->nlevels == s->maxlevels) {
+        s->maxlevels = s->maxlevels ? 2 * s->maxlevels : 16;
+        s->levels = realloc(s->levels, s->maxlevels * sizeof(*s->levels));
+        if (!s->levels)
+            luaL_error(l, "Out of memory");
+    }
+
+    level = &s->levels[s->nlevels++];
+    level->state = (is_object ? S_OBJ_FIRST : S_ARR_FIRST);
+    level->is_object = is_object;
+    level->index = 0;
+
+    if (s->nlevels > s->depth) {
+        lua_rawgeti(l, env, STREAM_KEYS);
+        lua_insert(l, -2);
+        lua_rawseti(l, -2, s->nlevels);
+        lua_rawgeti(l, env, STREAM_BUILD);
+        lua_newtable(l);
+        lua_rawseti(l, -2, s->nlevels);
+        lua_pop(l, 2);
+    } else {
+        json_stream_callback(l, env, is_object ? "object_begin" : "array_begin", 1);
+    }
+}
+
+static void json_stream_close(lua_State *l, json_stream_t *s, int env)
+{
+    int is_object = s->levels[s->nlevels - 1].is_object;
+
+    if (is_object) {
+        lua_rawgeti(l, env, STREAM_PENDING);
+        lua_pushnil(l);
+        lua_rawseti(l, -2, s->nlevels);
+        lua_pop(l, 1);
+    }
+
+    if (s->nlevels > s->depth) {
+        lua_rawgeti(l, env, STREAM_KEYS);
+        lua_rawgeti(l, -1, s->nlevels);
+        lua_pushnil(l);
+        lua_rawseti(l, -3, s->nlevels);
+        lua_remove(l, -2);
+        lua_rawgeti(l, env, STREAM_BUILD);
+        lua_rawgeti(l, -1, s->nlevels);
+        lua_pushnil(l);
+        lua_rawseti(l, -3, s->nlevels);
+        lua_remove(l, -2);
+        s->nlevels--;
+        json_stream_add_value(l, s, env);
+    } else {
+        s->nlevels--;
+        json_stream_callback(l, env, is_object ? "object_end" : "array_end", 0);
+    }
+}
+
+static void json_stream_value(lua_State *l, json_stream_t *s, int env,
+                              json_token_t *token)
+{
+    /* Push the key of the value in its container */
+    if (s->nlevels > 0) {
+        json_stream_level_t *level = &s->levels[s->nlevels - 1];
+
+        if (level->is_object) {
+            level->state = S_OBJ_NEXT;
+            lua_rawgeti(l, env, STREAM_PENDING);
+            lua_rawgeti(l, -1, s->nlevels);
+            lua_remove(l, -2);
+        } else {
+            level->state = S_ARR_NEXT;
+            lua_pushinteger(l, ++level->index);
+        }
+    } else {
+        lua_pushnil(l);
+    }
+
+    switch (token->type) {
+    case T_OBJ_BEGIN:
+    case T_ARR_BEGIN:
+        json_stream_open(l, s, env, token);
+        return;
+    case T_STRING:
+        lua_pushlstring(l, token->value.string, token->string_len);
+        break;
+    case T_NUMBER:
+        lua_pushnumber(l, token->value.number);
+        break;
+    case T_BOOLEAN:
+        lua_pushboolean(l, token->value.boolean);
+        break;
+    case T_NULL:
+        lua_pushlightuserdata(l, NULL);
+        break;
+    default:
+        lua_pop(l, 1);
+        if (s->nlevels > 0) {
+            /* Report the state before the value */
+            json_stream_level_t *level = &s->levels[s->nlevels - 1];
+            level->state = (level->is_object ? S_OBJ_VALUE : S_ARR_VALUE);
+        }
+        json_stream_error(l, s, token);
+    }
+
+    json_stream_add_value(l, s, env);
+}
+
+static void json_stream_process(lua_State *l, json_stream_t *s, int env,
+                                json_token_t *token)
+{
+    json_stream_level_t *level;
+
+    if (s->nlevels == 0) {
+        json_stream_value(l, s, env, token);
+        return;
+    }
+
+    level = &s->levels[s->nlevels - 1];
+    switch (level->state) {
+    case S_ARR_FIRST:
+        if (token->type == T_ARR_END) {
+            json_stream_close(l, s, env);
+            return;
+        }
+        /* Fall through */
+    case S_ARR_VALUE:
+    case S_OBJ_VALUE:
+        json_stream_value(l, s, env, token);
+        return;
+    case S_ARR_NEXT:
+        if (token->type == T_COMMA)
+            level->state = S_ARR_VALUE;
+        else if (token->type == T_ARR_END)
+            json_stream_close(l, s, env);
+        else
+            json_stream_error(l, s, token);
+        return;
+    case S_OBJ_FIRST:
+        if (token->type == T_OBJ_END) {
+            json_stream_close(l, s, env);
+            return;
+        }
+        /* Fall through */
+    case S_OBJ_KEY:
+        if (token->type != T_STRING)
+            json_stream_error(l, s, token);
+        lua_rawgeti(l, env, STREAM_PENDING);
+        lua_pushlstring(l, token->value.string, token->string_len);
+        lua_rawseti(l, -2, s->nlevels);
+        lua_pop(l, 1);
+        level->state = S_OBJ_COLON;
+        return;
+    case S_OBJ_COLON:
+        if (token->type != T_COLON)
+            json_stream_error(l, s, token);
+        level->state = S_OBJ_VALUE;
+        return;
+    case S_OBJ_NEXT:
+        if (token->type == T_COMMA)
+            level->state = S_OBJ_KEY;
+        else if (token->type == T_OBJ_END)
+            json_stream_close(l, s, env);
+        else
+            json_stream_error(l, s, token);
+        return;
+    }
+}
+
+/* Process all complete tokens of the input */
+static void json_stream_parse(lua_State *l, json_stream_t *s, int env)
+{
+    json_parse_t json;
+    json_token_t token;
+    const char *end;
+
+    strbuf_ensure_null(&s->input);
+    json.cfg = s->cfg;
+    json.data = s->input.buf;
+    json.ptr = json.data + s->pos;
+    json.tmp = &s->tmp;
+    json.current_depth = 0;
+    end = json.data + strbuf_length(&s->input);
+
+    /* Strings can not be longer than the input left */
+    strbuf_reset(&s->tmp);
+    strbuf_ensure_empty_length(&s->tmp, end - json.ptr);
+
+    while (json_stream_next_token(s, &json, &token, end)) {
+        if (token.type == T_END)
+            break;
+
+        /* Skip the token even if a handler throws an error */
+        s->pos = json.ptr - json.data;
+        json_stream_process(l, s, env, &token);
+    }
+    s->pos = json.ptr - json.data;
+}
+
+static json_stream_t *json_stream_check(lua_State *l)
+{
+    json_stream_t *s = luaL_checkudata(l, 1, "cjson.decoder");
+
+    if (s->error)
+        luaL_error(l, "JSON decoder is in an error state");
+    if (s->finished)
+        luaL_error(l, "JSON decoder input is already finished");
+
+    return s;
+}
+
+/* decoder:feed(chunk) */
+static int json_stream_feed(lua_State *l)
+{
+    json_stream_t *s = json_stream_check(l);
+    const char *chunk;
+    size_t len;
+
+    chunk = luaL_checklstring(l, 2, &len);
+    lua_settop(l, 2);
+    lua_getfenv(l, 1);
+
+    /* Drop consumed input */
+    if (s->pos > 0) {
+        s->input.length -= s->pos;
+        memmove(s->input.buf, s->input.buf + s->pos, s->input.length);
+        s->consumed += s->pos;
+        s->pos = 0;
+    }
+
+    strbuf_append_mem(&s->input, chunk, len);
+    json_stream_parse(l, s, 3);
+
+    lua_settop(l, 1);
+    return 1;
+}
+
+/* decoder:finish() */
+static int json_stream_finish(lua_State *l)
+{
+    json_stream_t *s = json_stream_check(l);
+    json_token_t token;
+
+    lua_settop(l, 1);
+    lua_getfenv(l, 1);
+
+    s->finished = 1;
+    json_stream_parse(l, s, 2);
+
+    if (s->nlevels > 0) {
+        token.type = T_END;
+        token.index = s->pos;
+        json_stream_error(l, s, &token);
+    }
+
+    lua_settop(l, 1);
+    return 1;
+}
+
+/* value, key = decoder:next() */
+static int json_stream_next(lua_State *l)
+{
+    json_stream_t *s = luaL_checkudata(l, 1, "cjson.decoder");
+
+    if (s->qhead == s->qtail) {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    lua_settop(l, 1);
+    lua_getfenv(l, 1);
+    s->qhead++;
+
+    lua_rawgeti(l, 2, STREAM_QUEUE);
+    lua_rawgeti(l, -1, s->qhead);
+    lua_pushnil(l);
+    lua_rawseti(l, -3, s->qhead);
+    lua_rawgeti(l, 2, STREAM_QKEYS);
+    lua_rawgeti(l, -1, s->qhead);
+    lua_pushnil(l);
+    lua_rawseti(l, -3, s->qhead);
+    lua_remove(l, -2);
+
+    if (s->qhead == s->qtail)
+        s->qhead = s->qtail = 0;
+
+    return 2;
+}
+
+static int json_stream_gc(lua_State *l)
+{
+    json_stream_t *s = lua_touserdata(l, 1);
+
+    strbuf_free(&s->input);
+    strbuf_free(&s->tmp);
+    free(s->levels);
+    s->levels = NULL;
+
+    return 0;
+}
+
+/* decoder = cjson.decoder([handler [, depth]]) */
+static int json_stream_new(lua_State *l)
+{
+    static const luaL_Reg methods[] = {
+        { "feed", json_stream_feed },
+        { "finish", json_stream_finish },
+        { "next", json_stream_next },
+        { NULL, NULL }
+    };
+    json_config_t *cfg = json_fetch_config(l);
+    json_stream_t *s;
+    int depth, i;
+
+    luaL_argcheck(l, lua_isnoneornil(l, 1) || lua_istable(l, 1), 1,
+                  "handler table expected");
+    depth = luaL_optinteger(l, 2, 0);
+    luaL_argcheck(l, depth >= 0, 2, "depth must be positive");
+    lua_settop(l, 2);
+
+    s = lua_newuserdata(l, sizeof(*s));
+    memset(s, 0, sizeof(*s));
+    s->cfg = cfg;
+    s->depth = depth;
+    strbuf_init(&s->input, 0);
+    strbuf_init(&s->tmp, 0);
+
+    if (luaL_newmetatable(l, "cjson.decoder")) {
+        lua_pushcfunction(l, json_stream_gc);
+        lua_setfield(l, -2, "__gc");
+        lua_newtable(l);
+        luaL_register(l, NULL, methods);
+        lua_setfield(l, -2, "__index");
+    }
+    lua_setmetatable(l, -2);
+
+    lua_createtable(l, STREAM_QKEYS, 0);
+    lua_pushvalue(l, 1);
+    lua_rawseti(l, -2, STREAM_HANDLER);
+    /* Keep the configuration alive */
+    lua_pushvalue(l, lua_upvalueindex(1));
+    lua_rawseti(l, -2, STREAM_CONFIG);
+    for (i = STREAM_BUILD; i <= STREAM_QKEYS; i++) {
+        lua_newtable(l);
+        lua_rawseti(l, -2, i);
+    }
+    lua_setfenv(l, -2);
+
+    return 1;
+}
+
 /* ===== INITIALISATION ===== */
 
 #if !defined(LUA_VERSION_NUM) || LUA_VERSION_NUM < 502
@@ -1352,6 +2132,8 @@ static int lua_cjson_new(lua_State *l)
     luaL_Reg reg[] = {
         { "encode", json_encode },
         { "decode", json_decode },
+        { "decode_tensor", json_decode_tensor },
+        { "decoder", json_stream_new },
         { "encode_sparse_array", json_cfg_encode_sparse_array },
         { "encode_max_depth", json_cfg_encode_max_depth },
         { "decode_max_depth", json_cfg_decode_max_depth },
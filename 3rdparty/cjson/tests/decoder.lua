@@ -0,0 +1,204 @@
+-- incremental decoding in Lua CJSON: cjson.decoder
+-- typical usage: lua decoder.lua
+
+require 'torch'
+local cjson = require 'cjson'
+
+local mytester = torch.Tester()
+
+local decodertest = {}
+
+local doc = '{"a": [1, -2.5e3, true, null, "h\\u00e9llo \\ud834\\udd1e"], "b": {"c": false}} ' ..
+            '[3, -Infinity] "x\\n" 12'
+local values = {'{"a": [1, -2.5e3, true, null, "h\\u00e9llo \\ud834\\udd1e"], "b": {"c": false}}',
+                '[3, -Infinity]', '"x\\n"', '12'}
+
+-- values and keys queued by a decoder without handler
+local function drain(decoder)
+   local results = {}
+   while true do
+      local value, key = decoder:next()
+      if value == nil then
+         return results
+      end
+      table.insert(results, {value, key})
+   end
+end
+
+local function equal(x, y)
+   if type(x) ~= 'table' or type(y) ~= 'table' then
+      return x == y
+   end
+   for k,v in pairs(x) do
+      if not equal(v, y[k]) then
+         return false
+      end
+   end
+   for k in pairs(y) do
+      if x[k] == nil then
+         return false
+      end
+   end
+   return true
+end
+
+local function checkValues(results, msg)
+   mytester:asserteq(#results, #values, msg .. ': number of values')
+   for i,value in ipairs(values) do
+      local result = results[i] and results[i][1]
+      mytester:assert(equal(result, cjson.decode(value)), msg .. ': value ' .. i)
+      mytester:asserteq(results[i] and results[i][2], nil, msg .. ': top level key ' .. i)
+   end
+end
+
+function decodertest.chunks()
+   -- every split point, in the middle of numbers, strings, escapes and literals
+   for i=0,#doc do
+      local decoder = cjson.decoder()
+      decoder:feed(doc:sub(1, i))
+      decoder:feed(doc:sub(i+1))
+      decoder:finish()
+      checkValues(drain(decoder), 'split at ' .. i)
+   end
+   -- one byte at a time, reading the values as they come
+   local decoder = cjson.decoder()
+   local results = {}
+   for i=1,#doc do
+      decoder:feed(doc:sub(i, i))
+      for _,result in ipairs(drain(decoder)) do
+         table.insert(results, result)
+      end
+   end
+   -- the last number may go on in the next chunk
+   mytester:asserteq(#results, #values-1, 'number pending before finish')
+   decoder:finish()
+   for _,result in ipairs(drain(decoder)) do
+      table.insert(results, result)
+   end
+   checkValues(results, 'byte by byte')
+   mytester:asserteq(decoder:next(), nil, 'empty queue')
+end
+
+function decodertest.handler()
+   local events = {}
+   local function record(name)
+      return function(...)
+         table.insert(events, {name, ...})
+      end
+   end
+   local handler = {value=record('value'), object_begin=record('object_begin'),
+                    array_begin=record('array_begin'), object_end=record('object_end'),
+                    array_end=record('array_end')}
+
+   -- depth 1: the entries of the top level container are built
+   local decoder = cjson.decoder(handler, 1)
+   decoder:feed('[{"a": 1}, [2], 3]{"x": [4, 5], "y": null}')
+   decoder:finish()
+   mytester:asserteq(drain(decoder)[1], nil, 'values passed to the handler are not queued')
+   local expected = {{'array_begin'}, {'value', '{"a":1}', 1}, {'value', '[2]', 2}, {'value', '3', 3},
+                     {'array_end'}, {'object_begin'}, {'value', '[4,5]', 'x'}, {'value', 'null', 'y'},
+                     {'object_end'}}
+   mytester:asserteq(#events, #expected, 'depth 1: number of events')
+   for i,event in ipairs(expected) do
+      local got = events[i] or {}
+      mytester:asserteq(got[1], event[1], 'depth 1: event ' .. i)
+      if event[1] == 'value' then
+         mytester:asserteq(cjson.encode(got[2]), event[2], 'depth 1: value ' .. i)
+         mytester:asserteq(got[3], event[3], 'depth 1: key ' .. i)
+      end
+   end
+
+   -- depth 2: the containers of the first two levels are reported with their key
+   events = {}
+   decoder = cjson.decoder(handler, 2)
+   decoder:feed('{"x": {"y": [1], "z": 2}, "w": []}')
+   decoder:finish()
+   expected = {{'object_begin', nil}, {'object_begin', 'x'}, {'value', '[1]', 'y'}, {'value', '2', 'z'},
+               {'object_end'}, {'array_begin', 'w'}, {'array_end'}, {'object_end'}}
+   mytester:asserteq(#events, #expected, 'depth 2: number of events')
+   for i,event in ipairs(expected) do
+      local got = events[i] or {}
+      mytester:asserteq(got[1], event[1], 'depth 2: event ' .. i)
+      if event[1] == 'value' then
+         mytester:asserteq(cjson.encode(got[2]), event[2], 'depth 2: value ' .. i)
+         mytester:asserteq(got[3], event[3], 'depth 2: key ' .. i)
+      elseif event[1]:match('begin') then
+         mytester:asserteq(got[2], event[2], 'depth 2: key ' .. i)
+      end
+   end
+
+   -- without a value handler, the values are queued
+   decoder = cjson.decoder({array_begin=function() end}, 1)
+   decoder:feed('[7, 8]')
+   decoder:finish()
+   local results = drain(decoder)
+   mytester:asserteq(#results, 2, 'queued values')
+   mytester:asserteq(results[2][1], 8, 'queued value')
+   mytester:asserteq(results[2][2], 2, 'queued key')
+
+   -- an error thrown by the handler skips the value, but not the decoder
+   local calls = 0
+   decoder = cjson.decoder({value=function(v)
+      calls = calls + 1
+      if v == 1 then error('handler') end
+   end})
+   mytester:assertError(function() decoder:feed('1 ') end, 'handler error')
+   decoder:feed('2 3')
+   decoder:finish()
+   mytester:asserteq(calls, 3, 'decoding goes on after a handler error')
+
+   mytester:assertError(function() cjson.decoder(1) end, 'handler type')
+   mytester:assertError(function() cjson.decoder(nil, -1) end, 'negative depth')
+end
+
+function decodertest.errors()
+   local function message(f)
+      local ok, err = pcall(f)
+      return not ok and tostring(err) or ''
+   end
+
+   -- truncated input is reported at finish
+   for _,input in ipairs{'[1, 2', '{"a": ', '{"a"', '"abc', '[1, {"b": [true'} do
+      local decoder = cjson.decoder()
+      decoder:feed(input)
+      mytester:assertError(function() decoder:finish() end, 'truncated ' .. input)
+      mytester:assert(message(function() decoder:feed('1') end):find('error state') ~= nil,
+                      'feed after a truncation error ' .. input)
+   end
+
+   -- the character positions count the input of the previous chunks
+   local decoder = cjson.decoder()
+   decoder:feed('[1, 2')
+   decoder:feed('] [1')
+   local err = message(function() decoder:feed(' 2]') end)
+   mytester:assert(err:find('Expected comma or array end but found T_NUMBER at character 11', 1, true) ~= nil,
+                   'position of the error: ' .. err)
+   mytester:assert(message(function() decoder:feed('1') end):find('error state') ~= nil, 'feed after an error')
+   mytester:assert(message(function() decoder:finish() end):find('error state') ~= nil, 'finish after an error')
+
+   for _,input in ipairs{'[1,,2]', '{1: 2}', '{"a" 1}', '{"a": 1,}', ']', '[1}', 'nul ', '"\\x"'} do
+      decoder = cjson.decoder()
+      mytester:assertError(function() decoder:feed(input) decoder:finish() end, 'invalid ' .. input)
+   end
+
+   -- cjson.decode preallocates numeric arrays: malformed ones are still errors,
+   -- and long ones are read whole
+   mytester:assertError(function() cjson.decode('[1' .. string.rep(',', 3e6) .. ']') end, 'empty elements')
+   local long = cjson.decode('[' .. string.rep('1,', 2^20 + 10) .. '2]')
+   mytester:asserteq(#long, 2^20 + 11, 'long numeric array')
+   mytester:asserteq(long[#long], 2, 'long numeric array end')
+
+   -- nesting is bounded by cjson.decode_max_depth
+   decoder = cjson.decoder()
+   mytester:assertError(function() decoder:feed(string.rep('[', 1001)) end, 'too deep')
+
+   decoder = cjson.decoder()
+   decoder:feed('1')
+   decoder:finish()
+   mytester:asserteq(decoder:next(), 1, 'value')
+   mytester:assert(message(function() decoder:feed('2') end):find('already finished') ~= nil, 'feed after finish')
+   mytester:assert(message(function() decoder:finish() end):find('already finished') ~= nil, 'finish twice')
+end
+
+mytester:add(decodertest)
+mytester:run()
@@ -0,0 +1,72 @@
+-- torch tensors in Lua CJSON: cjson.encode and cjson.decode_tensor
+-- typical usage: lua tensor.lua
+
+require 'torch'
+local cjson = require 'cjson'
+
+local mytester = torch.Tester()
+
+local tensortest = {}
+
+local types = {'Byte', 'Char', 'Short', 'Int', 'Long', 'Float', 'Double'}
+
+-- numbers are encoded with 14 significant digits
+-- (cjson.encode_number_precision)
+local function relerr(x, y)
+   x, y = x:double(), y:double()
+   return (x - y):abs():cdiv(x:clone():abs():add(1e-300)):max()
+end
+
+local function roundtrip(x, y)
+   cjson.decode_tensor(cjson.encode(x), y)
+   return y
+end
+
+function tensortest.encode()
+   mytester:asserteq(cjson.encode(torch.DoubleTensor{1, 2.5, -3}), '[1,2.5,-3]', '1D')
+   mytester:asserteq(cjson.encode(torch.IntTensor{{1, 2}, {3, 4}}), '[[1,2],[3,4]]', '2D')
+   mytester:asserteq(cjson.encode(torch.DoubleTensor()), '[]', 'empty')
+   mytester:asserteq(cjson.encode({w=torch.ByteTensor{7}}), '{"w":[7]}', 'in a table')
+   -- views are encoded from their own elements
+   local x = torch.LongTensor{{1, 2, 3}, {4, 5, 6}}
+   mytester:asserteq(cjson.encode(x:t()), '[[1,4],[2,5],[3,6]]', 'transposed')
+   mytester:asserteq(cjson.encode(x:select(2, 2)), '[2,5]', 'select')
+   for _,type in ipairs(types) do
+      local t = torch[type .. 'Tensor'](2, 3):fill(3)
+      mytester:asserteq(cjson.encode(t), '[[3,3,3],[3,3,3]]', type)
+   end
+end
+
+function tensortest.roundtrip()
+   for _,type in ipairs{'Float', 'Double'} do
+      for _,size in ipairs{{7}, {3, 4}, {2, 3, 4}, {2, 1, 2, 3}} do
+         local x = torch[type .. 'Tensor'](torch.LongStorage(size)):uniform(-1e3, 1e3)
+         local y = roundtrip(x, torch[type .. 'Tensor'](torch.LongStorage(size)))
+         mytester:assertlt(relerr(x, y), 1e-13, type .. ' ' .. table.concat(size, 'x'))
+      end
+      -- integers of the other types, and a non contiguous destination
+      local x = torch.IntTensor(4, 5):random(-100, 100)
+      local y = torch[type .. 'Tensor'](5, 4):t()
+      roundtrip(x, y)
+      mytester:asserteq((x:double() - y:double()):abs():max(), 0, type .. ' from Int, transposed')
+   end
+   -- tiny and large magnitudes survive the text form
+   local x = torch.DoubleTensor{1e-300, -1e300, 1/3, 0.1}
+   mytester:assertlt(relerr(x, roundtrip(x, torch.DoubleTensor(4))), 1e-13, 'magnitudes')
+   -- decode also reads what cjson.decode reads
+   local t = cjson.decode(cjson.encode(torch.DoubleTensor{{1, 2}, {3, 4}}))
+   mytester:asserteq(t[2][1], 3, 'decode to tables')
+end
+
+function tensortest.decodeErrors()
+   local x = torch.DoubleTensor(2, 2)
+   mytester:assertError(function() cjson.decode_tensor('[[1, 2], [3]]', x) end, 'short row')
+   mytester:assertError(function() cjson.decode_tensor('[[1, 2], [3, 4, 5]]', x) end, 'long row')
+   mytester:assertError(function() cjson.decode_tensor('[1, 2, 3, 4]', x) end, 'nesting')
+   mytester:assertError(function() cjson.decode_tensor('[[1, 2], [3, "a"]]', x) end, 'not a number')
+   mytester:assertError(function() cjson.decode_tensor('[[1, 2], [3, 4]]', torch.IntTensor(2, 2)) end,
+                        'destination type')
+end
+
+mytester:add(tensortest)
+mytester:run()
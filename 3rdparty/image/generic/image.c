@@ -47,131 +47,132 @@ static long image_(Main_op_depth)( THTensor *T){
   return 1; /* greyscale */
 }
 
-static void image_(Main_scale_rowcol)(THTensor *Tsrc,
-                                      THTensor *Tdst,
-                                      long src_start,
-                                      long dst_start,
-                                      long src_stride,
-                                      long dst_stride,
-                                      long src_len,
-                                      long dst_len ) {
-
-  real *src= THTensor_(data)(Tsrc);
-  real *dst= THTensor_(data)(Tdst);
-
-  if ( dst_len > src_len ){
-    long di;
-    float si_f;
-    long si_i;
-    float scale = (float)(src_len - 1) / (dst_len - 1);
-
-    for( di = 0; di < dst_len - 1; di++ ) {
-      long dst_pos = dst_start + di*dst_stride;
-      si_f = di * scale; si_i = (long)si_f; si_f -= si_i;
-
-      dst[dst_pos] = (1 - si_f) * src[ src_start + si_i * src_stride ] +
-        si_f * src[ src_start + (si_i + 1) * src_stride ];
-    }
+#undef image_acc
+#undef image_store
+#if defined(TH_REAL_IS_DOUBLE)
+#define image_acc double
+#else
+#define image_acc float
+#endif
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+#define image_store(x) ((real)(x))
+#elif defined(TH_REAL_IS_BYTE)
+#define image_store(x) ((x) <= 0 ? 0 : ((x) >= 255 ? 255 : (real)((x) + 0.5f)))
+#else
+#define image_store(x) ((real)floor((x) + 0.5))
+#endif
 
-    dst[ dst_start + (dst_len - 1) * dst_stride ] =
-      src[ src_start + (src_len - 1) * src_stride ];
-  }
-  else if ( dst_len < src_len ) {
-    long di;
-    long si0_i = 0; float si0_f = 0;
-    long si1_i; float si1_f;
-    long si;
-    float scale = (float)src_len / dst_len;
-    float acc, n;
-
-    for( di = 0; di < dst_len; di++ )
-      {
-        si1_f = (di + 1) * scale; si1_i = (long)si1_f; si1_f -= si1_i;
-        acc = (1 - si0_f) * src[ src_start + si0_i * src_stride ];
-        n = 1 - si0_f;
-        for( si = si0_i + 1; si < si1_i; si++ )
-          {
-            acc += src[ src_start + si * src_stride ];
-            n += 1;
-          }
-        if( si1_i < src_len )
-          {
-            acc += si1_f * src[ src_start + si1_i*src_stride ];
-            n += si1_f;
-          }
-        dst[ dst_start + di*dst_stride ] = acc / n;
-        si0_i = si1_i; si0_f = si1_f;
+/* two passes: rows of src are resampled horizontally into a dense
+   depth x src_height x dst_width buffer, whose rows are then combined
+   vertically into dst. Both passes run over independent rows. */
+static void image_(Main_resample)(lua_State *L, image_Resampler *r, THTensor *Tsrc, THTensor *Tdst)
+{
+  image_ResampleAxis *ax = &r->x;
+  image_ResampleAxis *ay = &r->y;
+  real *src, *dst;
+  image_acc *tmp;
+  long src_stride0, src_stride1, src_stride2;
+  long dst_stride0, dst_stride1, dst_stride2;
+  long depth, ndims, kj;
+
+  image_(Main_op_validate)(L, Tsrc, Tdst);
+  ndims = Tdst->nDimension;
+  if(Tsrc->size[ndims-1] != ax->src_len || Tsrc->size[ndims-2] != ay->src_len ||
+     Tdst->size[ndims-1] != ax->dst_len || Tdst->size[ndims-2] != ay->dst_len)
+    luaL_error(L, "image.scale: src and dst sizes do not match the resampler (%dx%d -> %dx%d)",
+               (int)ax->src_len, (int)ay->src_len, (int)ax->dst_len, (int)ay->dst_len);
+
+  src = THTensor_(data)(Tsrc);
+  dst = THTensor_(data)(Tdst);
+  depth = image_(Main_op_depth)(Tsrc);
+  src_stride0 = image_(Main_op_stride)(Tsrc,0);
+  src_stride1 = image_(Main_op_stride)(Tsrc,1);
+  src_stride2 = image_(Main_op_stride)(Tsrc,2);
+  dst_stride0 = image_(Main_op_stride)(Tdst,0);
+  dst_stride1 = image_(Main_op_stride)(Tdst,1);
+  dst_stride2 = image_(Main_op_stride)(Tdst,2);
+
+  tmp = image_Resampler_buffer(r, sizeof(image_acc)*depth*ay->src_len*ax->dst_len);
+
+  /* horizontal pass */
+#pragma omp parallel for private(kj)
+  for(kj = 0; kj < depth*ay->src_len; kj++) {
+    long k = kj / ay->src_len, j = kj % ay->src_len;
+    real *srow = src + k*src_stride0 + j*src_stride1;
+    image_acc *trow = tmp + kj*ax->dst_len;
+    long ntaps = ax->ntaps, i, t;
+    for(i = 0; i < ax->dst_len; i++) {
+      const float *w = ax->weights + i*ntaps;
+      image_acc acc = 0;
+      if(src_stride2 == 1) {
+        real *s = srow + ax->start[i];
+        for(t = 0; t < ntaps; t++)
+          acc += w[t] * s[t];
+      } else {
+        real *s = srow + ax->start[i]*src_stride2;
+        for(t = 0; t < ntaps; t++)
+          acc += w[t] * s[t*src_stride2];
       }
+      trow[i] = acc;
+    }
   }
-  else {
-    long i;
-    for( i = 0; i < dst_len; i++ )
-      dst[ dst_start + i*dst_stride ] = src[ src_start + i*src_stride ];
+
+  /* vertical pass: each dst row is a weighted sum of whole buffer rows,
+     so the inner loops run over contiguous memory */
+#pragma omp parallel for private(kj)
+  for(kj = 0; kj < depth*ay->dst_len; kj++) {
+    long k = kj / ay->dst_len, j = kj % ay->dst_len;
+    real *drow = dst + k*dst_stride0 + j*dst_stride1;
+    image_acc *tplane = tmp + (k*ay->src_len + ay->start[j])*ax->dst_len;
+    const float *w = ay->weights + j*ay->ntaps;
+    long width = ax->dst_len, ntaps = ay->ntaps, i, t;
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+    if(dst_stride2 == 1) {
+      for(i = 0; i < width; i++)
+        drow[i] = w[0] * tplane[i];
+      for(t = 1; t < ntaps; t++) {
+        image_acc *trow = tplane + t*width;
+        real wt = w[t];
+        if(wt == 0) continue;
+        for(i = 0; i < width; i++)
+          drow[i] += wt * trow[i];
+      }
+      continue;
+    }
+#endif
+    for(i = 0; i < width; i++) {
+      image_acc acc = 0;
+      for(t = 0; t < ntaps; t++)
+        acc += w[t] * tplane[t*width + i];
+      drow[i*dst_stride2] = image_store(acc);
+    }
   }
 }
 
-static int image_(Main_scaleBilinear)(lua_State *L) {
-
+static int image_(Main_scaleWith)(lua_State *L, int mode)
+{
   THTensor *Tsrc = luaT_checkudata(L, 1, torch_Tensor);
   THTensor *Tdst = luaT_checkudata(L, 2, torch_Tensor);
-  THTensor *Ttmp;
-  long dst_stride0, dst_stride1, dst_stride2, dst_width, dst_height;
-  long src_stride0, src_stride1, src_stride2, src_width, src_height;
-  long tmp_stride0, tmp_stride1, tmp_stride2, tmp_width, tmp_height;
-  long i, j, k;
-
-  image_(Main_op_validate)(L, Tsrc,Tdst);
-
-  int ndims;
-  if (Tdst->nDimension == 3) ndims = 3;
-  else ndims = 2;
-
-  Ttmp = THTensor_(newWithSize2d)(Tsrc->size[ndims-2], Tdst->size[ndims-1]);
-
-  dst_stride0= image_(Main_op_stride)(Tdst,0);
-  dst_stride1= image_(Main_op_stride)(Tdst,1);
-  dst_stride2= image_(Main_op_stride)(Tdst,2);
-  src_stride0= image_(Main_op_stride)(Tsrc,0);
-  src_stride1= image_(Main_op_stride)(Tsrc,1);
-  src_stride2= image_(Main_op_stride)(Tsrc,2);
-  tmp_stride0= image_(Main_op_stride)(Ttmp,0);
-  tmp_stride1= image_(Main_op_stride)(Ttmp,1);
-  tmp_stride2= image_(Main_op_stride)(Ttmp,2);
-  dst_width=   Tdst->size[ndims-1];
-  dst_height=  Tdst->size[ndims-2];
-  src_width=   Tsrc->size[ndims-1];
-  src_height=  Tsrc->size[ndims-2];
-  tmp_width=   Ttmp->size[1];
-  tmp_height=  Ttmp->size[0];
-
-  for(k=0;k<image_(Main_op_depth)(Tsrc);k++) {
-    /* compress/expand rows first */
-    for(j = 0; j < src_height; j++) {
-      image_(Main_scale_rowcol)(Tsrc,
-				Ttmp,
-				0*src_stride2+j*src_stride1+k*src_stride0,
-				0*tmp_stride2+j*tmp_stride1+k*tmp_stride0,
-				src_stride2,
-				tmp_stride2,
-				src_width,
-				tmp_width );
+  image_Resampler r;
+  long ndims;
+
+  image_(Main_op_validate)(L, Tsrc, Tdst);
+  ndims = Tdst->nDimension;
+  image_Resampler_init(&r, Tsrc->size[ndims-1], Tsrc->size[ndims-2],
+                       Tdst->size[ndims-1], Tdst->size[ndims-2], mode);
+  image_(Main_resample)(L, &r, Tsrc, Tdst);
+  image_Resampler_free(&r);
+  return 0;
+}
 
-    }
+static int image_(Main_scaleBilinear)(lua_State *L)
+{
+  return image_(Main_scaleWith)(L, IMAGE_RESAMPLE_BILINEAR);
+}
 
-    /* then columns */
-    for(i = 0; i < dst_width; i++) {
-      image_(Main_scale_rowcol)(Ttmp,
-				Tdst,
-				i*tmp_stride2+0*tmp_stride1+k*tmp_stride0,
-				i*dst_stride2+0*dst_stride1+k*dst_stride0,
-				tmp_stride1,
-				dst_stride1,
-				tmp_height,
-				dst_height );
-    }
-  }
-  THTensor_(free)(Ttmp);
-  return 0;
+static int image_(Main_scaleBicubic)(lua_State *L)
+{
+  return image_(Main_scaleWith)(L, IMAGE_RESAMPLE_BICUBIC);
 }
 
 static int image_(Main_scaleSimple)(lua_State *L)
@@ -957,9 +958,178 @@ int image_(Main_gaussian)(lua_State *L) {
   return 0;
 }
 
+/* convolution with a separable kernel kv x kh, as one horizontal and one
+   vertical 1D pass. The output is a window of the zero-padded 'full'
+   convolution, starting at row oy and column ox of it. */
+static void image_(Main_convolveSeparablePlane)(real *dst, real *src, real *tmp,
+                                                long h, long w, long oh, long ow,
+                                                long oy, long ox,
+                                                real *kv, long nv, real *kh, long nh)
+{
+  long y;
+
+#pragma omp parallel for private(y)
+  for(y = 0; y < h; y++) {
+    real *s = src + y*w;
+    real *d = tmp + y*ow;
+    long x, t;
+    for(x = 0; x < ow; x++) {
+      long xf = x + ox;
+      long t0 = MAX(0, xf - w + 1), t1 = MIN(nh, xf + 1);
+      real acc = 0;
+      for(t = t0; t < t1; t++)
+        acc += kh[t] * s[xf - t];
+      d[x] = acc;
+    }
+  }
+
+#pragma omp parallel for private(y)
+  for(y = 0; y < oh; y++) {
+    long yf = y + oy;
+    long t0 = MAX(0, yf - h + 1), t1 = MIN(nv, yf + 1);
+    real *d = dst + y*ow;
+    long x, t;
+    for(x = 0; x < ow; x++)
+      d[x] = 0;
+    for(t = t0; t < t1; t++) {
+      real *s = tmp + (yf - t)*ow;
+      real k = kv[t];
+      for(x = 0; x < ow; x++)
+        d[x] += k * s[x];
+    }
+  }
+}
+
+static int image_(Main_convolveSeparable)(lua_State *L)
+{
+  THTensor *Tdst = luaT_checkudata(L, 1, torch_Tensor);
+  THTensor *Tsrc = luaT_checkudata(L, 2, torch_Tensor);
+  THTensor *Tkv = luaT_checkudata(L, 3, torch_Tensor);
+  THTensor *Tkh = luaT_checkudata(L, 4, torch_Tensor);
+  long oy = luaL_checklong(L, 5);
+  long ox = luaL_checklong(L, 6);
+  long depth, h, w, oh, ow, k;
+  THTensor *dst, *tmp;
+  real *src_data, *dst_data, *tmp_data, *kv, *kh;
+
+  luaL_argcheck(L, Tsrc->nDimension == 2 || Tsrc->nDimension == 3, 2, "2D or 3D tensor expected");
+  luaL_argcheck(L, Tdst->nDimension == Tsrc->nDimension, 1, "src and dst must have the same dimension");
+  luaL_argcheck(L, Tkv->nDimension == 1, 3, "1D kernel expected");
+  luaL_argcheck(L, Tkh->nDimension == 1, 4, "1D kernel expected");
+
+  Tsrc = THTensor_(newContiguous)(Tsrc);
+  Tkv = THTensor_(newContiguous)(Tkv);
+  Tkh = THTensor_(newContiguous)(Tkh);
+  depth = image_(Main_op_depth)(Tsrc);
+  h = Tsrc->size[Tsrc->nDimension-2];
+  w = Tsrc->size[Tsrc->nDimension-1];
+  oh = Tdst->size[Tdst->nDimension-2];
+  ow = Tdst->size[Tdst->nDimension-1];
+  luaL_argcheck(L, depth == image_(Main_op_depth)(Tdst), 1, "src and dst depths do not match");
+
+  dst = THTensor_(newContiguous)(Tdst);
+  tmp = THTensor_(newWithSize2d)(h, ow);
+  src_data = THTensor_(data)(Tsrc);
+  dst_data = THTensor_(data)(dst);
+  tmp_data = THTensor_(data)(tmp);
+  kv = THTensor_(data)(Tkv);
+  kh = THTensor_(data)(Tkh);
+
+  for(k = 0; k < depth; k++)
+    image_(Main_convolveSeparablePlane)(dst_data + k*oh*ow, src_data + k*h*w, tmp_data,
+                                        h, w, oh, ow, oy, ox,
+                                        kv, Tkv->size[0], kh, Tkh->size[0]);
+
+  THTensor_(free)(tmp);
+  THTensor_(free)(Tsrc);
+  THTensor_(free)(Tkv);
+  THTensor_(free)(Tkh);
+  THTensor_(freeCopyTo)(dst, Tdst);
+  return 0;
+}
+
+/* local contrast normalization over the 'valid' region: local mean and
+   second moment come out of the same two 1D passes, and the division by
+   the local standard deviation is applied as they are produced */
+static int image_(Main_lcn)(lua_State *L)
+{
+  THTensor *Tdst = luaT_checkudata(L, 1, torch_Tensor);
+  THTensor *Tsrc = luaT_checkudata(L, 2, torch_Tensor);
+  THTensor *Tkv = luaT_checkudata(L, 3, torch_Tensor);
+  THTensor *Tkh = luaT_checkudata(L, 4, torch_Tensor);
+  long h, w, oh, ow, nv, nh, y;
+  THTensor *tmp;
+  real *src, *dst, *tmp1, *tmp2, *kv, *kh;
+
+  luaL_argcheck(L, Tsrc->nDimension == 2, 2, "2D tensor expected");
+  luaL_argcheck(L, Tkv->nDimension == 1, 3, "1D kernel expected");
+  luaL_argcheck(L, Tkh->nDimension == 1, 4, "1D kernel expected");
+
+  Tsrc = THTensor_(newContiguous)(Tsrc);
+  Tkv = THTensor_(newContiguous)(Tkv);
+  Tkh = THTensor_(newContiguous)(Tkh);
+  h = Tsrc->size[0];
+  w = Tsrc->size[1];
+  nv = Tkv->size[0];
+  nh = Tkh->size[0];
+  luaL_argcheck(L, nv <= h && nh <= w, 3, "kernel larger than the image");
+  oh = h - nv + 1;
+  ow = w - nh + 1;
+
+  THTensor_(resize2d)(Tdst, oh, ow);
+  tmp = THTensor_(newWithSize3d)(2, h, ow);
+  src = THTensor_(data)(Tsrc);
+  dst = THTensor_(data)(Tdst);
+  tmp1 = THTensor_(data)(tmp);
+  tmp2 = tmp1 + h*ow;
+  kv = THTensor_(data)(Tkv);
+  kh = THTensor_(data)(Tkh);
+
+#pragma omp parallel for private(y)
+  for(y = 0; y < h; y++) {
+    real *s = src + y*w;
+    long x, t;
+    for(x = 0; x < ow; x++) {
+      real m = 0, m2 = 0;
+      for(t = 0; t < nh; t++) {
+        real v = s[x + nh - 1 - t];
+        m += kh[t] * v;
+        m2 += kh[t] * v * v;
+      }
+      tmp1[y*ow + x] = m;
+      tmp2[y*ow + x] = m2;
+    }
+  }
+
+#pragma omp parallel for private(y)
+  for(y = 0; y < oh; y++) {
+    long x, t;
+    long dst_stride0 = Tdst->stride[0], dst_stride1 = Tdst->stride[1];
+    for(x = 0; x < ow; x++) {
+      real m = 0, m2 = 0, sd;
+      for(t = 0; t < nv; t++) {
+        m += kv[t] * tmp1[(y + nv - 1 - t)*ow + x];
+        m2 += kv[t] * tmp2[(y + nv - 1 - t)*ow + x];
+      }
+      sd = m2 - m*m;
+      sd = (sd > 0 ? sqrt(sd) : 0);
+      if(sd < 1)
+        sd = 1;
+      dst[y*dst_stride0 + x*dst_stride1] = (src[(y + nv/2)*w + x + nh/2] - m) / sd;
+    }
+  }
+
+  THTensor_(free)(tmp);
+  THTensor_(free)(Tsrc);
+  THTensor_(free)(Tkv);
+  THTensor_(free)(Tkh);
+  return 0;
+}
+
 static const struct luaL_Reg image_(Main__) [] = {
   {"scaleSimple", image_(Main_scaleSimple)},
   {"scaleBilinear", image_(Main_scaleBilinear)},
+  {"scaleBicubic", image_(Main_scaleBicubic)},
   {"rotate", image_(Main_rotate)},
   {"translate", image_(Main_translate)},
   {"cropNoScale", image_(Main_cropNoScale)},
@@ -970,6 +1140,8 @@ static const struct luaL_Reg image_(Main__) [] = {
   {"hsv2rgb", image_(Main_hsv2rgb)},
   {"hsl2rgb", image_(Main_hsl2rgb)},
   {"gaussian", image_(Main_gaussian)},
+  {"convolveSeparable", image_(Main_convolveSeparable)},
+  {"lcn", image_(Main_lcn)},
   {NULL, NULL}
 };
 
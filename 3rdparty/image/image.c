@@ -16,11 +16,295 @@
 #endif
 #define min( a, b ) ( ((a) < (b)) ? (a) : (b) )
 
+/* separable resampling: each axis is described by a filter table giving,
+   for every output sample, the first source sample it reads and ntaps
+   weights. Tables are built once per (src size, dst size, mode) and can be
+   kept in an image.Resampler to be reused across calls. */
+#define IMAGE_RESAMPLE_BILINEAR 0
+#define IMAGE_RESAMPLE_BICUBIC  1
+
+typedef struct image_ResampleAxis
+{
+  long src_len;
+  long dst_len;
+  long ntaps;
+  long *start;
+  float *weights;
+} image_ResampleAxis;
+
+typedef struct image_Resampler
+{
+  int mode;
+  image_ResampleAxis x;
+  image_ResampleAxis y;
+  void *buffer;
+  long buffer_size;
+} image_Resampler;
+
+static float image_cubic(float x)
+{
+  /* Keys kernel, a = -0.5 */
+  x = fabsf(x);
+  if(x < 1)
+    return (1.5f*x - 2.5f)*x*x + 1;
+  if(x < 2)
+    return ((-0.5f*x + 2.5f)*x - 4)*x + 2;
+  return 0;
+}
+
+/* taps are first collected as (index, weight) pairs with indices clamped to
+   the source, then folded into a window of ntaps contiguous samples */
+static void image_resampleAxis_fold(image_ResampleAxis *axis, long di, long *idx, float *w, long n)
+{
+  long lo = idx[0], t;
+  float *dw = axis->weights + di*axis->ntaps;
+
+  for(t = 1; t < n; t++)
+    lo = min(lo, idx[t]);
+  if(lo + axis->ntaps > axis->src_len)
+    lo = axis->src_len - axis->ntaps;
+
+  axis->start[di] = lo;
+  for(t = 0; t < axis->ntaps; t++)
+    dw[t] = 0;
+  for(t = 0; t < n; t++)
+    dw[idx[t]-lo] += w[t];
+}
+
+static void image_resampleAxis_init(image_ResampleAxis *axis, long src_len, long dst_len, int mode)
+{
+  long di, t, n, maxtaps;
+  long *idx;
+  float *w;
+
+  axis->src_len = src_len;
+  axis->dst_len = dst_len;
+
+  /* upper bound on the number of taps of a single output sample, before
+     the indices are clamped to the source and folded */
+  if(dst_len >= src_len)
+    maxtaps = (mode == IMAGE_RESAMPLE_BICUBIC ? 4 : 2);
+  else if(mode == IMAGE_RESAMPLE_BICUBIC)
+    maxtaps = 4*(src_len/dst_len + 1) + 1;
+  else
+    maxtaps = src_len/dst_len + 2;
+  /* folded, the taps of a sample never span more than the source */
+  axis->ntaps = min(maxtaps, src_len);
+
+  axis->start = THAlloc(sizeof(long)*dst_len);
+  axis->weights = THAlloc(sizeof(float)*dst_len*axis->ntaps);
+  idx = THAlloc(sizeof(long)*(maxtaps+2));
+  w = THAlloc(sizeof(float)*(maxtaps+2));
+
+  if(dst_len == src_len)
+  {
+    for(di = 0; di < dst_len; di++)
+    {
+      idx[0] = di; w[0] = 1;
+      image_resampleAxis_fold(axis, di, idx, w, 1);
+    }
+  }
+  else if(mode == IMAGE_RESAMPLE_BICUBIC && dst_len > src_len)
+  {
+    /* interpolate, with the corners of src and dst aligned */
+    float scale = (dst_len > 1 ? (float)(src_len - 1) / (dst_len - 1) : 0);
+    for(di = 0; di < dst_len; di++)
+    {
+      float si_f = di * scale;
+      long si_i = (long)si_f;
+      for(t = 0; t < 4; t++)
+      {
+        long si = si_i - 1 + t;
+        w[t] = image_cubic(si_f - si);
+        idx[t] = max(0, min(si, src_len-1));
+      }
+      image_resampleAxis_fold(axis, di, idx, w, 4);
+    }
+  }
+  else if(mode == IMAGE_RESAMPLE_BICUBIC)
+  {
+    /* shrink: stretch the kernel over the source footprint of each output
+       sample, which low-passes the image however large the ratio */
+    float scale = (float)src_len / dst_len;
+    for(di = 0; di < dst_len; di++)
+    {
+      float center = (di + 0.5f) * scale - 0.5f;
+      long first = (long)ceilf(center - 2*scale);
+      long last = (long)floorf(center + 2*scale);
+      float sum = 0;
+      n = 0;
+      for(t = first; t <= last && n < maxtaps; t++)
+      {
+        w[n] = image_cubic((t - center) / scale);
+        idx[n] = max(0, min(t, src_len-1));
+        sum += w[n++];
+      }
+      for(t = 0; t < n; t++)
+        w[t] /= sum;
+      image_resampleAxis_fold(axis, di, idx, w, n);
+    }
+  }
+  else if(dst_len > src_len)
+  {
+    /* linear interpolation, corners aligned */
+    float scale = (float)(src_len - 1) / (dst_len - 1);
+    for(di = 0; di < dst_len - 1; di++)
+    {
+      float si_f = di * scale;
+      long si_i = (long)si_f;
+      si_f -= si_i;
+      idx[0] = si_i; w[0] = 1 - si_f;
+      idx[1] = min(si_i + 1, src_len - 1); w[1] = si_f;
+      image_resampleAxis_fold(axis, di, idx, w, 2);
+    }
+    idx[0] = src_len - 1; w[0] = 1;
+    image_resampleAxis_fold(axis, dst_len - 1, idx, w, 1);
+  }
+  else
+  {
+    /* area averaging: each output sample is the mean of the source samples
+       it covers, partially covered ones weighted by their coverage */
+    long si0_i = 0, si1_i;
+    float si0_f = 0, si1_f, norm;
+    float scale = (float)src_len / dst_len;
+    for(di = 0; di < dst_len; di++)
+    {
+      si1_f = (di + 1) * scale; si1_i = (long)si1_f; si1_f -= si1_i;
+      n = 0;
+      idx[n] = si0_i; w[n++] = 1 - si0_f;
+      for(t = si0_i + 1; t < si1_i && n < maxtaps; t++)
+      {
+        idx[n] = t; w[n++] = 1;
+      }
+      if(si1_i < src_len && si1_f > 0 && n < maxtaps)
+      {
+        idx[n] = si1_i; w[n++] = si1_f;
+      }
+      norm = 0;
+      for(t = 0; t < n; t++)
+        norm += w[t];
+      for(t = 0; t < n; t++)
+        w[t] /= norm;
+      image_resampleAxis_fold(axis, di, idx, w, n);
+      si0_i = si1_i; si0_f = si1_f;
+    }
+  }
+
+  THFree(idx);
+  THFree(w);
+}
+
+static void image_resampleAxis_free(image_ResampleAxis *axis)
+{
+  THFree(axis->start);
+  THFree(axis->weights);
+}
+
+static void image_Resampler_init(image_Resampler *r, long src_width, long src_height,
+                                 long dst_width, long dst_height, int mode)
+{
+  r->mode = mode;
+  image_resampleAxis_init(&r->x, src_width, dst_width, mode);
+  image_resampleAxis_init(&r->y, src_height, dst_height, mode);
+  r->buffer = NULL;
+  r->buffer_size = 0;
+}
+
+static void image_Resampler_free(image_Resampler *r)
+{
+  image_resampleAxis_free(&r->x);
+  image_resampleAxis_free(&r->y);
+  THFree(r->buffer);
+}
+
+static void *image_Resampler_buffer(image_Resampler *r, long size)
+{
+  if(size > r->buffer_size)
+  {
+    r->buffer = THRealloc(r->buffer, size);
+    r->buffer_size = size;
+  }
+  return r->buffer;
+}
+
+static int image_resampleMode(lua_State *L, int idx)
+{
+  static const char *modes[] = {"bilinear", "bicubic", NULL};
+  return luaL_checkoption(L, idx, "bilinear", modes);
+}
+
 #include "generic/image.c"
 #include "THGenerateAllTypes.h"
 
+/* image.Resampler: filter tables and scratch for repeated resizes between
+   the same two geometries */
+static int image_Resampler_new(lua_State *L)
+{
+  long src_width = luaL_checklong(L, 1);
+  long src_height = luaL_checklong(L, 2);
+  long dst_width = luaL_checklong(L, 3);
+  long dst_height = luaL_checklong(L, 4);
+  int mode = image_resampleMode(L, 5);
+  image_Resampler *r;
+
+  luaL_argcheck(L, src_width > 0, 1, "width must be positive");
+  luaL_argcheck(L, src_height > 0, 2, "height must be positive");
+  luaL_argcheck(L, dst_width > 0, 3, "width must be positive");
+  luaL_argcheck(L, dst_height > 0, 4, "height must be positive");
+
+  r = lua_newuserdata(L, sizeof(image_Resampler));
+  image_Resampler_init(r, src_width, src_height, dst_width, dst_height, mode);
+  luaL_getmetatable(L, "image.Resampler");
+  lua_setmetatable(L, -2);
+  return 1;
+}
+
+static int image_Resampler_scale(lua_State *L)
+{
+  image_Resampler *r = luaL_checkudata(L, 1, "image.Resampler");
+  void *src, *dst;
+
+  if((src = luaT_toudata(L, 2, "torch.FloatTensor")) && (dst = luaT_toudata(L, 3, "torch.FloatTensor")))
+    image_FloatMain_resample(L, r, src, dst);
+  else if((src = luaT_toudata(L, 2, "torch.DoubleTensor")) && (dst = luaT_toudata(L, 3, "torch.DoubleTensor")))
+    image_DoubleMain_resample(L, r, src, dst);
+  else if((src = luaT_toudata(L, 2, "torch.ByteTensor")) && (dst = luaT_toudata(L, 3, "torch.ByteTensor")))
+    image_ByteMain_resample(L, r, src, dst);
+  else
+    luaL_error(L, "image.Resampler: src and dst must be Float, Double or Byte tensors of the same type");
+
+  lua_settop(L, 3);
+  return 1;
+}
+
+static int image_Resampler_gc(lua_State *L)
+{
+  image_Resampler *r = luaL_checkudata(L, 1, "image.Resampler");
+  image_Resampler_free(r);
+  return 0;
+}
+
+static const struct luaL_Reg image_Resampler__ [] = {
+  {"scale", image_Resampler_scale},
+  {"__gc", image_Resampler_gc},
+  {NULL, NULL}
+};
+
+static const struct luaL_Reg image__ [] = {
+  {"resampler", image_Resampler_new},
+  {NULL, NULL}
+};
+
 DLL_EXPORT int luaopen_libimage(lua_State *L)
 {
+  luaL_newmetatable(L, "image.Resampler");
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  luaL_register(L, NULL, image_Resampler__);
+  lua_pop(L, 1);
+  luaL_register(L, "image", image__);
+  lua_pop(L, 1);
+
   image_FloatMain_init(L);
   image_DoubleMain_init(L);
   image_ByteMain_init(L);
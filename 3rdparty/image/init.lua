@@ -366,6 +366,23 @@ rawset(image, 'translate', translate)
 ----------------------------------------------------------------------
 -- scale
 --
+-- image.resampler(srcw,srch,dstw,dsth,mode) precomputes the filter
+-- tables of a resize; scale() keeps the last one used for each mode, so
+-- that resizing a stream of same-size frames doesn't rebuild them.
+--
+local resamplers = {}
+local function resampler(src, dst, mode)
+   local sw,sh,dw,dh = src:size(src:nDimension()),src:size(src:nDimension()-1),
+                       dst:size(dst:nDimension()),dst:size(dst:nDimension()-1)
+   local key = sw..'x'..sh..'>'..dw..'x'..dh
+   local cached = resamplers[mode]
+   if not cached or cached.key ~= key then
+      cached = {key=key, r=image.resampler(sw,sh,dw,dh,mode)}
+      resamplers[mode] = cached
+   end
+   return cached.r
+end
+
 local function scale(...)
    local dst,src,width,height,mode,size
    local args = {...}
@@ -404,15 +421,15 @@ local function scale(...)
                        {type='torch.Tensor', help='input image', req=true},
                        {type='number', help='destination width', req=true},
                        {type='number', help='destination height', req=true},
-                       {type='string', help='mode: bilinear | simple', default='bilinear'},
+                       {type='string', help='mode: bilinear | bicubic | simple', default='bilinear'},
                        '',
                        {type='torch.Tensor', help='input image', req=true},
                        {type='string | number', help='destination size: "WxH" or "MAX" or "^MIN" or MAX', req=true},
-                       {type='string', help='mode: bilinear | simple', default='bilinear'},
+                       {type='string', help='mode: bilinear | bicubic | simple', default='bilinear'},
                        '',
                        {type='torch.Tensor', help='destination image', req=true},
                        {type='torch.Tensor', help='input image', req=true},
-                       {type='string', help='mode: bilinear | simple', default='bilinear'}))
+                       {type='string', help='mode: bilinear | bicubic | simple', default='bilinear'}))
       dok.error('incorrect arguments', 'image.scale')
    end
    if size then
@@ -450,12 +467,13 @@ local function scale(...)
       end
    end
    mode = mode or 'bilinear'
-   if mode=='bilinear' then
-      src.image.scaleBilinear(src,dst)
+   if mode=='bilinear' or mode=='bicubic' then
+      local r = resampler(src, dst, mode)
+      r:scale(src,dst)
    elseif mode=='simple' then
       src.image.scaleSimple(src,dst)
    else
-      dok.error('mode must be one of: simple | bilinear', 'image.scale')
+      dok.error('mode must be one of: simple | bilinear | bicubic', 'image.scale')
    end
    return dst
 end
@@ -640,6 +658,46 @@ local function vflip(...)
 end
 rawset(image, 'vflip', vflip)
 
+----------------------------------------------------------------------
+-- separable kernels
+--
+-- a rank-one 2D kernel is the outer product of a vertical and a
+-- horizontal 1D kernel (see torch.separate), and is applied as two 1D
+-- passes
+--
+local function sameSize(a, b)
+   if a:nDimension() ~= b:nDimension() then
+      return false
+   end
+   for i = 1,a:nDimension() do
+      if a:size(i) ~= b:size(i) then
+         return false
+      end
+   end
+   return true
+end
+
+local function convolveSeparable(dst, src, kv, kh, mode)
+   local nv, nh = kv:size(1), kh:size(1)
+   local h, w = src:size(src:nDimension()-1), src:size(src:nDimension())
+   local oh, ow, oy, ox
+   if mode == 'full' then
+      oh, ow, oy, ox = h + nv - 1, w + nh - 1, 0, 0
+   elseif mode == 'same' then
+      oh, ow, oy, ox = h, w, math.ceil(nv/2) - 1, math.ceil(nh/2) - 1
+   else
+      oh, ow, oy, ox = h - nv + 1, w - nh + 1, nv - 1, nh - 1
+   end
+   dst = dst or src.new()
+   if src:nDimension() == 3 then
+      dst:resize(src:size(1), oh, ow)
+   else
+      dst:resize(oh, ow)
+   end
+   src.image.convolveSeparable(dst, src, kv, kh, oy, ox)
+   return dst
+end
+
 ----------------------------------------------------------------------
 -- convolve(dst,src,ker,type)
 -- convolve(dst,src,ker)
@@ -683,6 +741,21 @@ local function convolve(...)
    if mode and mode ~= 'valid' and mode ~= 'full' and mode ~= 'same' then
       dok.error('mode has to be one of: full | valid', 'image.convolve')
    end
+   -- the separable passes are only implemented for Float and Double; in
+   -- 'same' mode, a given dst keeps the layout of the conv2 path (full
+   -- result, narrowed) unless it already has the size of src
+   local sdim = src:nDimension()
+   local stype = torch.typename(src)
+   if kernel:nDimension() == 2 and (sdim == 2 or sdim == 3)
+      and (stype == 'torch.FloatTensor' or stype == 'torch.DoubleTensor')
+      and (mode ~= 'same' or not dst or sameSize(dst, src))
+      and (mode ~= nil and mode ~= 'valid' or (kernel:size(1) <= src:size(sdim-1)
+                                               and kernel:size(2) <= src:size(sdim))) then
+      local kv,kh = torch.separate(src.new(kernel:size()):copy(kernel))
+      if kv then
+         return convolveSeparable(dst, src, kv, kh, mode or 'valid')
+      end
+   end
    local md = (((mode == 'full') or (mode == 'same')) and 'F') or 'V'
    if kernel:nDimension() == 2 and src:nDimension() == 3 then
       local k3d = torch.Tensor(src:size(1), kernel:size(1), kernel:size(2))
@@ -1119,9 +1192,11 @@ function image.rgb2yuv(...)
    local outputV = output[3]
    
    -- convert
-   outputY:zero():add(0.299, inputRed):add(0.587, inputGreen):add(0.114, inputBlue)
-   outputU:zero():add(-0.14713, inputRed):add(-0.28886, inputGreen):add(0.436, inputBlue)
-   outputV:zero():add(0.615, inputRed):add(-0.51499, inputGreen):add(-0.10001, inputBlue)
+   -- (lazy expressions: one pass per channel)
+   local red = torch.lazy(inputRed)
+   red:mul(0.299):add(0.587, inputGreen):add(0.114, inputBlue):eval(outputY)
+   red:mul(-0.14713):add(-0.28886, inputGreen):add(0.436, inputBlue):eval(outputU)
+   red:mul(0.615):add(-0.51499, inputGreen):add(-0.10001, inputBlue):eval(outputV)
 
    -- return YUV image
    return output
@@ -1166,9 +1241,9 @@ function image.yuv2rgb(...)
    local outputBlue = output[3]
    
    -- convert
-   outputRed:copy(inputY):add(1.13983, inputV)
-   outputGreen:copy(inputY):add(-0.39465, inputU):add(-0.58060, inputV)      
-   outputBlue:copy(inputY):add(2.03211, inputU)
+   torch.add(outputRed, inputY, 1.13983, inputV)
+   torch.lazy(inputY):add(-0.39465, inputU):add(-0.58060, inputV):eval(outputGreen)
+   torch.add(outputBlue, inputY, 2.03211, inputU)
    
    -- return RGB image
    return output
@@ -1211,7 +1286,7 @@ function image.rgb2y(...)
    local outputY = output[1]
    
    -- convert
-   outputY:zero():add(0.299, inputRed):add(0.587, inputGreen):add(0.114, inputBlue)
+   torch.lazy(inputRed):mul(0.299):add(0.587, inputGreen):add(0.114, inputBlue):eval(outputY)
    
    -- return YUV image
    return output
@@ -1389,10 +1464,7 @@ function image.rgb2nrgb(...)
    
    -- compute sum and normalize
    sum:copy(input[1]):add(input[2]):add(input[3]):add(1e-6)
-   output:copy(input)
-   output[1]:cdiv(sum)
-   output[2]:cdiv(sum)
-   output[3]:cdiv(sum)
+   torch.cdiv(output, input, sum)
    
    -- return HSV image
    return output
@@ -1634,6 +1706,12 @@ function image.lcn(im,ker)
    im:div(sd)
 
    -- 2. calculate local mean and std and normalize each pixel
+   local kv,kh = separate(ker)
+   if kv then
+      local dim = im.new()
+      im.image.lcn(dim, im, kv:typeAs(im), kh:typeAs(im))
+      return dim
+   end
 
    -- mean
    local lmn = torch.conv2(im, ker)
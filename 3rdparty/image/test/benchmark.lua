@@ -0,0 +1,60 @@
+-- image benchmarks: decoding, scaling, color spaces and filtering
+-- typical usage: lua benchmark.lua [-run pattern] [-save file] [-baseline file]
+
+require 'torch'
+require 'image'
+
+local bench = torch.Benchmark()
+local elementsize = ({['torch.FloatTensor']=4, ['torch.DoubleTensor']=8})[torch.getdefaulttensortype()]
+
+torch.manualSeed(1234)
+
+-- a VGA frame
+local height, width = 480, 640
+local src = torch.rand(3, height, width)
+local bytes = src:nElement()*elementsize
+
+-- decoding, with the bindings which are built
+local dir = debug.getinfo(1, 'S').source:match('^@(.*)/test/[^/]*$') or '.'
+local decoders = {
+   {'libjpeg', 'decode jpg (lena)', function() image.loadJPG(dir .. '/lena.jpg') end},
+   {'libpng', 'decode png (lena)', function() image.loadPNG(dir .. '/lena.png') end},
+}
+for _,decoder in ipairs(decoders) do
+   if pcall(require, decoder[1]) then
+      bench:add(decoder[2], decoder[3])
+   else
+      print(string.format('skipping %s: %s not available', decoder[2], decoder[1]))
+   end
+end
+
+-- scaling
+for _,mode in ipairs{'simple', 'bilinear', 'bicubic'} do
+   local down = torch.Tensor(3, height/2, width/2)
+   local up = torch.Tensor(3, height*2, width*2)
+   bench:add(string.format('scale %dx%d -> %dx%d %s', width, height, width/2, height/2, mode),
+             function() image.scale(down, src, mode) end, 0, bytes*5/4)
+   bench:add(string.format('scale %dx%d -> %dx%d %s', width, height, width*2, height*2, mode),
+             function() image.scale(up, src, mode) end, 0, bytes*5)
+end
+
+-- color spaces
+local dst = torch.Tensor(3, height, width)
+local y = torch.Tensor(1, height, width)
+bench:add('rgb2yuv', function() image.rgb2yuv(dst, src) end, 0, 2*bytes)
+bench:add('yuv2rgb', function() image.yuv2rgb(dst, src) end, 0, 2*bytes)
+bench:add('rgb2y', function() image.rgb2y(y, src) end, 0, bytes*4/3)
+bench:add('rgb2hsl', function() image.rgb2hsl(dst, src) end, 0, 2*bytes)
+bench:add('rgb2hsv', function() image.rgb2hsv(dst, src) end, 0, 2*bytes)
+bench:add('rgb2lab', function() image.rgb2lab(dst, src) end, 0, 2*bytes)
+
+-- geometry and filtering
+bench:add('hflip', function() image.hflip(dst, src) end, 0, 2*bytes)
+bench:add('vflip', function() image.vflip(dst, src) end, 0, 2*bytes)
+bench:add('rotate 0.3', function() image.rotate(dst, src, 0.3) end, 0, 2*bytes)
+bench:add('crop 320x240', function() image.crop(src, 160, 120, 480, 360) end, 0, bytes/2)
+local gaussian = image.gaussian(5)
+bench:add('convolve gaussian 5x5 same', function() image.convolve(dst, src, gaussian, 'same') end,
+          2*25*src:nElement(), 2*bytes)
+
+bench:main(arg)
@@ -0,0 +1,195 @@
+require 'torch'
+
+local mytester = torch.Tester()
+
+local precision = 1e-4
+
+local imagetest = {}
+
+-- reference filters of the resampler, one dst x src weight matrix per axis
+local function cubic(x)
+   x = math.abs(x)
+   if x < 1 then
+      return (1.5*x - 2.5)*x*x + 1
+   elseif x < 2 then
+      return ((-0.5*x + 2.5)*x - 4)*x + 2
+   end
+   return 0
+end
+
+local function clamp(i, n)
+   return math.max(1, math.min(i, n))
+end
+
+local function axisWeights(srclen, dstlen, mode)
+   local W = torch.zeros(dstlen, srclen)
+   if srclen == dstlen then
+      W:copy(torch.eye(srclen))
+   elseif mode == 'bicubic' and dstlen > srclen then
+      local scale = (srclen - 1)/(dstlen - 1)
+      for di=0,dstlen-1 do
+         local si_f = di*scale
+         local si_i = math.floor(si_f)
+         for si=si_i-1,si_i+2 do
+            W[di+1][clamp(si+1, srclen)] = W[di+1][clamp(si+1, srclen)] + cubic(si_f - si)
+         end
+      end
+   elseif mode == 'bicubic' then
+      local scale = srclen/dstlen
+      for di=0,dstlen-1 do
+         local center = (di + 0.5)*scale - 0.5
+         for t=math.ceil(center - 2*scale),math.floor(center + 2*scale) do
+            W[di+1][clamp(t+1, srclen)] = W[di+1][clamp(t+1, srclen)] + cubic((t - center)/scale)
+         end
+         W[di+1]:div(W[di+1]:sum())
+      end
+   elseif dstlen > srclen then
+      local scale = (srclen - 1)/(dstlen - 1)
+      for di=0,dstlen-1 do
+         local si_f = di*scale
+         local si_i = math.min(math.floor(si_f), srclen - 1)
+         W[di+1][si_i+1] = 1 - (si_f - si_i)
+         if si_i + 1 < srclen then
+            W[di+1][si_i+2] = si_f - si_i
+         end
+      end
+   else
+      -- area averaging
+      local scale = srclen/dstlen
+      for di=0,dstlen-1 do
+         local a, b = di*scale, (di + 1)*scale
+         for t=math.floor(a),math.min(math.ceil(b), srclen)-1 do
+            W[di+1][t+1] = math.max(0, math.min(b, t+1) - math.max(a, t))/scale
+         end
+      end
+   end
+   return W
+end
+
+local function referenceScale(src, dstw, dsth, mode)
+   local Wx = axisWeights(src:size(3), dstw, mode)
+   local Wy = axisWeights(src:size(2), dsth, mode)
+   local dst = torch.Tensor(src:size(1), dsth, dstw)
+   for k=1,src:size(1) do
+      dst[k]:copy(Wy * src[k] * Wx:t())
+   end
+   return dst
+end
+
+local sizes = {
+   {5, 2}, {7, 3}, {16, 5}, {9, 1}, {64, 7},  -- shrink
+   {3, 8}, {2, 9}, {6, 16},                   -- enlarge
+   {10, 10},
+}
+
+function imagetest.scaleBicubic()
+   for _,sx in ipairs(sizes) do
+      for _,sy in ipairs(sizes) do
+         local src = torch.rand(2, sy[1], sx[1])
+         local dst = image.scale(src, sx[2], sy[2], 'bicubic')
+         local ref = referenceScale(src, sx[2], sy[2], 'bicubic')
+         mytester:assertlt((dst - ref):abs():max(), precision,
+                           string.format('bicubic %dx%d -> %dx%d', sx[1], sy[1], sx[2], sy[2]))
+      end
+   end
+end
+
+function imagetest.scaleBilinear()
+   for _,sx in ipairs(sizes) do
+      for _,sy in ipairs(sizes) do
+         local src = torch.rand(2, sy[1], sx[1])
+         local dst = image.scale(src, sx[2], sy[2], 'bilinear')
+         local ref = referenceScale(src, sx[2], sy[2], 'bilinear')
+         mytester:assertlt((dst - ref):abs():max(), precision,
+                           string.format('bilinear %dx%d -> %dx%d', sx[1], sy[1], sx[2], sy[2]))
+      end
+   end
+end
+
+function imagetest.scaleSimple()
+   -- ratios exact in floating point, so that the nearest sample is exact
+   for _,size in ipairs{{12, 8}, {6, 16}, {8, 8}, {16, 1}} do
+      local src = torch.rand(3, size[1], size[1])
+      local dst = image.scale(src, size[2], size[2], 'simple')
+      local scale = size[1]/size[2]
+      local ref = torch.Tensor(3, size[2], size[2])
+      for j=1,size[2] do
+         for i=1,size[2] do
+            local sj = math.min(math.floor((j-1)*scale), size[1]-1) + 1
+            local si = math.min(math.floor((i-1)*scale), size[1]-1) + 1
+            ref[{{}, j, i}]:copy(src[{{}, sj, si}])
+         end
+      end
+      mytester:asserteq((dst - ref):abs():max(), 0, string.format('simple %d -> %d', size[1], size[2]))
+   end
+end
+
+function imagetest.Resampler()
+   local src = torch.rand(3, 17, 23)
+   for _,mode in ipairs{'bilinear', 'bicubic'} do
+      local r = image.resampler(23, 17, 9, 40, mode)
+      local dst = torch.Tensor(3, 40, 9)
+      for i=1,2 do
+         r:scale(src, dst)
+         mytester:assertlt((dst - referenceScale(src, 9, 40, mode)):abs():max(), precision,
+                           mode .. ' resampler')
+      end
+      -- 2D and non contiguous tensors
+      local dst2 = torch.Tensor(40, 9):t()
+      local r2 = image.resampler(17, 23, 40, 9, mode)
+      r2:scale(src[2]:t(), dst2)
+      mytester:assertlt((dst2 - dst[2]:t()):abs():max(), precision, mode .. ' transposed')
+      mytester:assertError(function() r:scale(src, torch.Tensor(3, 40, 10)) end,
+                           mode .. ' size mismatch')
+   end
+   -- bytes are rounded
+   local bsrc = torch.ByteTensor(1, 5, 5):fill(200)
+   local bdst = torch.ByteTensor(1, 2, 2)
+   image.resampler(5, 5, 2, 2, 'bicubic'):scale(bsrc, bdst)
+   mytester:asserteq(bdst:min(), 200, 'byte resampler')
+end
+
+function imagetest.convolve()
+   local kernel = torch.ger(torch.Tensor{1, 2, 3}, torch.Tensor{1, -1, 2, 1})
+   for _,mode in ipairs{'valid', 'full', 'same'} do
+      for _,dim in ipairs{2, 3} do
+         local src = dim == 2 and torch.rand(9, 11) or torch.rand(2, 9, 11)
+         local k3d = torch.Tensor(2, 3, 4)
+         k3d[1]:copy(kernel)
+         k3d[2]:copy(kernel)
+         local ref = torch.conv2(src, dim == 2 and kernel or k3d, 'F')
+         if mode == 'valid' then
+            ref = ref:narrow(dim-1, 3, 7):narrow(dim, 4, 8)
+         elseif mode == 'same' then
+            ref = ref:narrow(dim-1, 2, 9):narrow(dim, 2, 11)
+         end
+         local dst = image.convolve(src, kernel, mode)
+         mytester:assertlt((dst - ref):abs():max(), precision, 'separable ' .. mode)
+         dst = image.convolve(torch.Tensor(), src, kernel, mode)
+         mytester:assertlt((dst - ref):abs():max(), precision, 'separable with dst ' .. mode)
+      end
+   end
+
+   -- 'same' into a dst of the size of src is done in place
+   local src = torch.rand(9, 11)
+   local dst = torch.Tensor(9, 11)
+   local result = image.convolve(dst, src, kernel, 'same')
+   mytester:asserteq(torch.pointer(result:storage()), torch.pointer(dst:storage()), 'same in place')
+   mytester:assertlt((dst - image.convolve(src, kernel, 'same')):abs():max(), precision, 'same in place')
+
+   -- integer tensors take the conv2 path
+   for _,type in ipairs{'Byte', 'Char', 'Short', 'Int', 'Long'} do
+      local isrc = torch[type .. 'Tensor'](8, 8):fill(2)
+      local ikernel = torch[type .. 'Tensor'](3, 3):fill(1)
+      local idst = image.convolve(isrc, ikernel)
+      mytester:asserteq(idst:size(1), 6, type .. ' convolve size')
+      mytester:asserteq(idst:min(), 18, type .. ' convolve')
+   end
+end
+
+mytester:add(imagetest)
+
+function image.test(tests)
+   math.randomseed(os.time())
+   mytester:run(tests)
+end
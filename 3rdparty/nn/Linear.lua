@@ -40,7 +40,7 @@ function Linear:updateOutput(input)
       local nunit = self.bias:size(1)
 
       self.output:resize(nframe, nunit)
-      self.output:zero():addr(1, input.new(nframe):fill(1), self.bias)
+      self.output:zero():add(self.bias)
       self.output:addmm(1, input, self.weight:t())
    else
       error('input must be vector or matrix')
@@ -74,11 +74,8 @@ function Linear:accGradParameters(input, gradOutput, scale)
       self.gradWeight:addr(scale, gradOutput, input)
       self.gradBias:add(scale, gradOutput)      
    elseif input:dim() == 2 then
-      local nframe = input:size(1)
-      local nunit = self.bias:size(1)
-
       self.gradWeight:addmm(scale, gradOutput:t(), input)
-      self.gradBias:addmv(scale, gradOutput:t(), input.new(nframe):fill(1))
+      self.gradBias:add(scale, gradOutput:sum(1))
    end
 
 end
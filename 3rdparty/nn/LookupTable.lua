@@ -1,6 +1,6 @@
 local LookupTable, parent = torch.class('nn.LookupTable', 'nn.Module')
 
-LookupTable.__version = 2
+LookupTable.__version = 3
 
 function LookupTable:__init(nIndex, ...)
    parent.__init(self)
@@ -22,7 +22,10 @@ function LookupTable:__init(nIndex, ...)
    self.size[1] = nIndex
    self.weight = torch.Tensor(self.size)
    self.gradWeight = torch.Tensor(self.size):zero()
-   self.inputs = {}
+   -- rows of gradWeight referenced since the last zeroGradParameters
+   self.inputs = torch.LongTensor()
+   self.touched = torch.ByteTensor(nIndex):zero()
+   self.indexBuffer = torch.LongTensor()
 
    self:reset()
 end
@@ -38,42 +41,68 @@ function LookupTable:reset(stdv)
    end
 end
 
-function LookupTable:updateOutput(input)
-   local nIndex = input:size(1)
-   self.size[1] = nIndex
-   self.output:resize(self.size)
-
-   for i=1,nIndex do
-      self.output:select(1, i):copy(self.weight:select(1, input[i]))
+-- indices are handled as a LongTensor; other types go through a buffer
+local function indices(self, input)
+   if torch.typename(input) == 'torch.LongTensor' then
+      return input
    end
+   self.indexBuffer = self.indexBuffer or torch.LongTensor()
+   self.indexBuffer:resize(input:size()):copy(input)
+   return self.indexBuffer
+end
 
+function LookupTable:updateOutput(input)
+   self.weight.nn.LookupTable_updateOutput(self, indices(self, input))
    return self.output
 end
 
 function LookupTable:zeroGradParameters()
-   for k,_ in pairs(self.inputs) do
-      self.gradWeight:select(1, k):zero()
-   end
-   self.inputs = {}
+   self.weight.nn.LookupTable_zeroGradParameters(self)
 end
 
 function LookupTable:accGradParameters(input, gradOutput, scale)
-   for i=1,input:size(1) do
-      local k = input[i]
-      self.inputs[k] = true
-      self.gradWeight:select(1, k):add(scale, gradOutput:select(1, i))
-   end
+   self.weight.nn.LookupTable_accGradParameters(self, indices(self, input), gradOutput, scale or 1)
 end
 
 function LookupTable:accUpdateGradParameters(input, gradOutput, lr)
-   for i=1,input:size(1) do
-      self.weight:select(1, input[i]):add(-lr, gradOutput:select(1, i))
-   end
+   self.weight.nn.LookupTable_accUpdateGradParameters(self, indices(self, input), gradOutput, lr)
 end
 
 function LookupTable:updateParameters(learningRate)
-   for k,_ in pairs(self.inputs) do
-      self.weight:select(1, k):add(-learningRate, self.gradWeight:select(1, k))
+   self.weight.nn.LookupTable_updateParameters(self, learningRate)
+end
+
+-- index bookkeeping keeps its integer types
+function LookupTable:type(type)
+   local inputs, touched, indexBuffer = self.inputs, self.touched, self.indexBuffer
+   self.inputs, self.touched, self.indexBuffer = nil, nil, nil
+   parent.type(self, type)
+   self.inputs, self.touched, self.indexBuffer = inputs, touched, indexBuffer
+   return self
+end
+
+function LookupTable:read(file, version)
+   local var = file:readObject()
+   for k,v in pairs(var) do
+      self[k] = v
+   end
+   -- modules saved with a Lua set of referenced rows
+   if version < 3 then
+      local rows = {}
+      for k,_ in pairs(self.inputs or {}) do
+         table.insert(rows, k)
+      end
+      table.sort(rows)
+      self.touched = torch.ByteTensor(self.weight:size(1)):zero()
+      self.inputs = torch.LongTensor()
+      if #rows > 0 then
+         self.inputs:resize(#rows)
+      end
+      for i,k in ipairs(rows) do
+         self.inputs[i] = k
+         self.touched[k] = 1
+      end
+      self.indexBuffer = torch.LongTensor()
    end
 end
 
@@ -26,6 +26,9 @@ function Module:forward(input)
 end
 
 function Module:backward(input, gradOutput, scale)
+   if self.forwardOnly then
+      error('backward() of a module in inference mode: call training() first')
+   end
    scale = scale or 1
    self:updateGradInput(input, gradOutput)
    self:accGradParameters(input, gradOutput, scale)
@@ -33,6 +36,9 @@ function Module:backward(input, gradOutput, scale)
 end
 
 function Module:backwardUpdate(input, gradOutput, lr)
+   if self.forwardOnly then
+      error('backwardUpdate() of a module in inference mode: call training() first')
+   end
    self:updateGradInput(input, gradOutput)
    self:accUpdateGradParameters(input, gradOutput, lr)
    return self.gradInput
@@ -136,6 +142,68 @@ end
 function Module:reset()
 end
 
+-- forward only mode: frees the gradients w.r.t. the input and the
+-- parameters (the parameters themselves are kept). The gradient tensors
+-- and their storages are emptied, not replaced, so that the views of
+-- getParameters() and the gradients shared between modules are still
+-- linked after training(); those views must not be used in between.
+function Module:inference()
+   self.forwardOnly = true
+   if torch.typename(self.gradInput) then
+      -- gradInput may be another module's tensor (e.g. gradOutput)
+      self.gradInput = self.gradInput.new()
+   elseif type(self.gradInput) == 'table' then
+      self.gradInput = {}
+   end
+   if self.modules then
+      for _,module in ipairs(self.modules) do
+         module:inference()
+      end
+   else
+      local _,gradParams = self:parameters()
+      self.gradParamViews = self.gradParamViews or {}
+      for i,gradParam in ipairs(gradParams or {}) do
+         local storage = gradParam:storage()
+         if storage and gradParam:nElement() > 0 then
+            self.gradParamViews[i] = {offset=gradParam:storageOffset(),
+                                      size=gradParam:size(), stride=gradParam:stride(),
+                                      storageSize=storage:size()}
+            gradParam:resize(0)
+            storage:resize(0)
+         end
+      end
+   end
+   return self
+end
+
+-- back to the default mode, where backward() is possible
+function Module:training()
+   self.forwardOnly = nil
+   if self.modules then
+      for _,module in ipairs(self.modules) do
+         module:training()
+      end
+   else
+      local _,gradParams = self:parameters()
+      for i,view in pairs(self.gradParamViews or {}) do
+         local gradParam = gradParams[i]
+         local storage = gradParam:storage()
+         -- a storage shared with a module restored before is already grown
+         local extent = view.offset
+         for d=1,view.size:size() do
+            extent = extent + (view.size[d]-1)*view.stride[d]
+         end
+         local size = math.max(view.storageSize, extent)
+         if storage:size() < size then
+            storage:resize(size):fill(0)
+         end
+         gradParam:set(storage, view.offset, view.size, view.stride):zero()
+      end
+      self.gradParamViews = nil
+   end
+   return self
+end
+
 function Module:getParameters()
    -- get parameters
    local parameters,gradParameters = self:parameters()
@@ -47,13 +47,10 @@ function PairwiseDistance:updateGradInput(input, gradOutput)
    if input[1]:dim() == 1 then
       self.gradInput[1]:mul(gradOutput[1])
    elseif input[1]:dim() == 2 then
+      -- gradOutput as a column, broadcast over the features
       self.grad = self.grad or gradOutput.new()
-      self.ones = self.ones or gradOutput.new()
-
-      self.grad:resizeAs(input[1]):zero()
-      self.ones:resize(input[1]:size(2)):fill(1)
-
-      self.grad:addr(gradOutput, self.ones)
+      self.grad:set(gradOutput:storage(), gradOutput:storageOffset(),
+                    gradOutput:size(1), gradOutput:stride(1), 1, 1)
       self.gradInput[1]:cmul(self.grad)
    else
       error('input must be vector or matrix')
@@ -0,0 +1,208 @@
+local Profiler = torch.class('nn.Profiler')
+
+-- methods which are timed
+Profiler.methods = {'updateOutput', 'updateGradInput', 'accGradParameters', 'accUpdateGradParameters'}
+
+-- FLOPs estimates of one updateOutput call, from its input and output (by
+-- default, one operation per output element).
+Profiler.flops = {}
+
+local function batch(input, dim)
+   return input:dim() > dim and input:size(1) or 1
+end
+
+Profiler.flops['nn.Linear'] = function(module, input, output)
+   return 2 * module.weight:nElement() * batch(input, 1)
+end
+
+local function spatialconv(module, input, output)
+   local kernel = module.weight:nElement() / module.nOutputPlane
+   return 2 * kernel * output:nElement()
+end
+Profiler.flops['nn.SpatialConvolution'] = spatialconv
+Profiler.flops['nn.SpatialConvolutionMM'] = spatialconv
+
+Profiler.flops['nn.SpatialConvolutionMap'] = function(module, input, output)
+   local kernel = module.kW * module.kH * module.connTable:size(1) / module.nOutputPlane
+   return 2 * kernel * output:nElement()
+end
+
+Profiler.flops['nn.TemporalConvolution'] = function(module, input, output)
+   return 2 * module.weight:size(2) * output:nElement()
+end
+
+function Profiler:__init(module)
+   self.module = module
+   self.timer = torch.Timer()
+   self.stats = {}
+   self.events = {}
+   self.stack = {}
+   self.saved = {}
+   self:attach()
+end
+
+local function shape(x)
+   if torch.typename(x) and x.size then
+      local size = x:size():totable()
+      return #size > 0 and table.concat(size, 'x') or 'empty'
+   elseif type(x) == 'table' then
+      local shapes = {}
+      for i,v in ipairs(x) do
+         shapes[i] = shape(v)
+      end
+      return '{' .. table.concat(shapes, ',') .. '}'
+   end
+   return '-'
+end
+
+local elementsize = {['torch.ByteTensor']=1, ['torch.CharTensor']=1, ['torch.ShortTensor']=2,
+                     ['torch.IntTensor']=4, ['torch.LongTensor']=8, ['torch.FloatTensor']=4,
+                     ['torch.DoubleTensor']=8}
+
+-- bytes of the tensors held by the module itself
+local function tensorbytes(module)
+   local bytes = 0
+   for _,v in pairs(module) do
+      local size = elementsize[torch.typename(v)]
+      if size and v:storage() then
+         bytes = bytes + v:storage():size() * size
+      end
+   end
+   return bytes
+end
+
+local function flops(profiler, module, input, output)
+   local estimate = profiler.flops[torch.typename(module)]
+   if estimate then
+      return estimate(module, input, output)
+   elseif torch.typename(output) and output.nElement then
+      return output:nElement()
+   end
+   return 0
+end
+
+function Profiler:wrap(module, name)
+   local profiler = self
+   local method = module[name]
+   local stats = self.stats[module][name]
+   table.insert(self.saved, {module, name, rawget(module, name)})
+   module[name] = function(self, input, ...)
+      local stack = profiler.stack
+      local bytes = tensorbytes(self)
+      local start = profiler.timer:time().real
+      table.insert(stack, 0)
+      local result = method(self, input, ...)
+      local time = profiler.timer:time().real - start
+      local children = table.remove(stack)
+      if #stack > 0 then
+         stack[#stack] = stack[#stack] + time
+      end
+      if name == 'updateOutput' then
+         stats.flops = flops(profiler, self, input, result)
+      end
+      stats.calls = stats.calls + 1
+      stats.time = stats.time + time
+      stats.self = stats.self + time - children
+      stats.bytes = stats.bytes + tensorbytes(self) - bytes
+      stats.shape = shape(result)
+      table.insert(profiler.events, {stats.module, name, start, time, stats.shape})
+      return result
+   end
+end
+
+-- wraps the methods of the module and of its submodules
+function Profiler:attach(module, path)
+   module = module or self.module
+   path = path or ''
+   if not self.stats[module] then
+      local name = (path == '' and '' or path .. ' ') .. torch.typename(module)
+      self.stats[module] = {}
+      for _,method in ipairs(self.methods) do
+         if module[method] then
+            self.stats[module][method] = {module=name, calls=0, time=0, self=0, bytes=0, flops=0}
+            self:wrap(module, method)
+         end
+      end
+      table.insert(self.stats, module)
+   end
+   for i,submodule in ipairs(module.modules or {}) do
+      self:attach(submodule, (path == '' and '' or path .. '.') .. i)
+   end
+end
+
+-- restores the methods of all modules: the network runs (and can be saved) as before
+function Profiler:detach()
+   for i=#self.saved,1,-1 do
+      local module, name, method = unpack(self.saved[i])
+      module[name] = method
+   end
+   self.saved = {}
+end
+
+function Profiler:reset()
+   self.events = {}
+   for _,module in ipairs(self.stats) do
+      for _,stats in pairs(self.stats[module]) do
+         stats.calls, stats.time, stats.self, stats.bytes = 0, 0, 0, 0
+      end
+   end
+   self.timer:reset()
+end
+
+-- aggregated statistics, one row per module and method, sorted by self time
+function Profiler:report()
+   local rows = {}
+   for _,module in ipairs(self.stats) do
+      for _,method in ipairs(self.methods) do
+         local stats = self.stats[module][method]
+         if stats and stats.calls > 0 then
+            -- backward methods count as much as the forward
+            local forward = self.stats[module].updateOutput
+            local flops = forward and forward.flops or 0
+            if method ~= 'updateOutput' and method ~= 'updateGradInput' and not module.weight then
+               flops = 0
+            end
+            table.insert(rows, {module=stats.module, method=method, calls=stats.calls,
+                                time=stats.time, self=stats.self, bytes=stats.bytes,
+                                flops=flops * stats.calls, shape=stats.shape})
+         end
+      end
+   end
+   table.sort(rows, function(a, b) return a.self > b.self end)
+   return rows
+end
+
+function Profiler:__tostring__()
+   local lines = {string.format('%-40s %-24s %7s %10s %10s %9s %12s  %s',
+                                'module', 'method', 'calls', 'time(ms)', 'self(ms)',
+                                'GFLOP/s', 'bytes', 'shape')}
+   for _,row in ipairs(self:report()) do
+      table.insert(lines, string.format('%-40s %-24s %7d %10.3f %10.3f %9.3f %12d  %s',
+                                        row.module, row.method, row.calls, row.time*1e3,
+                                        row.self*1e3, row.self > 0 and row.flops/row.self*1e-9 or 0,
+                                        row.bytes, row.shape))
+   end
+   return table.concat(lines, '\n')
+end
+
+-- JSON string literal (%q gives Lua escapes, which are not JSON)
+local jsonEscapes = {['"']='\\"', ['\\']='\\\\', ['\n']='\\n', ['\r']='\\r', ['\t']='\\t'}
+local function jsonString(s)
+   s = tostring(s):gsub('[%c"\\]', function(c)
+      return jsonEscapes[c] or string.format('\\u%04x', c:byte())
+   end)
+   return '"' .. s .. '"'
+end
+
+-- Chrome trace-event file (chrome://tracing) of all the recorded calls
+function Profiler:trace(filename)
+   local f = assert(io.open(filename, 'w'))
+   f:write('{"traceEvents":[\n')
+   for i,event in ipairs(self.events) do
+      f:write(string.format('{"name":%s,"cat":%s,"ph":"X","ts":%.3f,"dur":%.3f,"pid":1,"tid":1,"args":{"shape":%s}}%s\n',
+                            jsonString(event[1]), jsonString(event[2]), event[3]*1e6, event[4]*1e6,
+                            jsonString(event[5]), i < #self.events and ',' or ''))
+   end
+   f:write(']}\n')
+   f:close()
+end
@@ -21,12 +21,46 @@ function Sequential:get(index)
    return self.modules[index]
 end
 
+-- storages (pointers) of a tensor or of a table of tensors
+local function storages(x, set)
+   set = set or {}
+   if torch.typename(x) and x.storage then
+      if x:storage() then
+         set[torch.pointer(x:storage())] = true
+      end
+   elseif type(x) == 'table' then
+      for _,v in pairs(x) do
+         storages(v, set)
+      end
+   end
+   return set
+end
+
 function Sequential:updateOutput(input)
+   if self.forwardOnly and not self.outputPlan and self.plannedInput then
+      -- the storages of the outputs of the previous call tell which modules
+      -- return views
+      self:planOutputs(self.plannedInput)
+   end
+   self.plannedInput = nil
+   local plan = self.forwardOnly and self.outputPlan
    local currentOutput = input
    for i=1,#self.modules do 
       currentOutput = self.modules[i]:updateOutput(currentOutput)
+      if plan and plan[i] and not (torch.typename(currentOutput) and currentOutput:storage()
+                                   and torch.pointer(currentOutput:storage()) == plan[i]) then
+         -- the module did not write into its buffer (e.g. it allocates a
+         -- new output at each call): the liveness of the buffers may be
+         -- wrong, so they are not shared anymore, and never planned again
+         self:unplanOutputs(currentOutput)
+         self.unplannable = true
+         plan = nil
+      end
    end 
    self.output = currentOutput
+   if self.forwardOnly and not self.outputPlan and not self.unplannable then
+      self.plannedInput = storages(input)
+   end
    return currentOutput
 end
 
@@ -71,6 +105,112 @@ function Sequential:accUpdateGradParameters(input, gradOutput, lr)
    currentModule:accUpdateGradParameters(input, currentGradOutput, lr)
 end
 
+-- In inference mode, the modules which return a new tensor write it into
+-- a few shared buffers: an output is live until the last module which
+-- reads it (directly, or through a view returned by the next modules), and
+-- its buffer is then reused. A chain of such modules ping-pongs between two
+-- buffers. The forward scratch of the convolutions (finput) is shared too.
+-- The plan is made from the outputs of an unplanned call, whose input
+-- storages are given. Returns true if some storages are shared.
+function Sequential:planOutputs(inputStorages)
+   local n = #self.modules
+   local values = {}
+   local seen = {}
+   for p in pairs(inputStorages) do
+      seen[p] = true
+   end
+   for i=1,n do
+      local module = self.modules[i]
+      local output = module.output
+      if not module.modules and torch.typename(output) and output.storage and output:storage() then
+         local p = torch.pointer(output:storage())
+         if not seen[p] then
+            values[i] = {pointer=p, last=i}
+         end
+      end
+      storages(output, seen)
+   end
+
+   -- module k reads the output of module k-1 (k = n+1: the sequence output)
+   for k=2,n+1 do
+      local read = storages(self.modules[k-1].output)
+      for i,value in pairs(values) do
+         if read[value.pointer] then
+            value.last = k
+         end
+      end
+   end
+
+   local plan, buffers, scratch = {}, {}, {}
+   for i=1,n do
+      local module = self.modules[i]
+      local value = values[i]
+      if value then
+         local output = module.output
+         local buffer
+         for _,b in ipairs(buffers) do
+            if b.last < i and b.type == torch.typename(output) then
+               buffer = b
+               break
+            end
+         end
+         if not buffer then
+            buffer = {storage=output.new(1):storage(), type=torch.typename(output)}
+            table.insert(buffers, buffer)
+         end
+         buffer.last = value.last
+         if buffer.storage:size() < output:nElement() then
+            buffer.storage:resize(output:nElement())
+         end
+         output:set(buffer.storage)
+         plan[i] = torch.pointer(buffer.storage)
+      end
+      if torch.typename(module.finput) then
+         local finput = module.finput
+         local storage = scratch[torch.typename(finput)] or finput.new(1):storage()
+         if storage:size() < finput:nElement() then
+            storage:resize(finput:nElement())
+         end
+         finput:set(storage)
+         scratch[torch.typename(finput)] = storage
+      end
+   end
+   self.outputPlan = plan
+   self.outputBuffers = #buffers
+   return #buffers > 0 or next(scratch) ~= nil
+end
+
+-- each module gets its own output and scratch again (but current, which is
+-- still used, is left as is)
+function Sequential:unplanOutputs(current)
+   if self.outputPlan then
+      for i,module in ipairs(self.modules) do
+         if self.outputPlan[i] and not (current and torch.pointer(module.output) == torch.pointer(current)) then
+            module.output:set()
+         end
+         if torch.typename(module.finput) then
+            module.finput:set()
+         end
+      end
+   end
+   self.outputPlan = nil
+   self.outputBuffers = nil
+   self.plannedInput = nil
+end
+
+function Sequential:inference()
+   parent.inference(self)
+   self:unplanOutputs()
+   self.unplannable = nil
+   return self
+end
+
+function Sequential:training()
+   self:unplanOutputs()
+   self.unplannable = nil
+   return parent.training(self)
+end
+
 function Sequential:zeroGradParameters()
   for i=1,#self.modules do
      self.modules[i]:zeroGradParameters()
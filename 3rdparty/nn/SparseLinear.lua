@@ -6,9 +6,11 @@ function SparseLinear:__init(inputSize, outputSize)
    self.weightDecay = 0
    self.weight = torch.Tensor(outputSize, inputSize)
    self.bias = torch.Tensor(outputSize)
-   self.gradWeight = torch.Tensor(outputSize, inputSize)
-   self.gradBias = torch.Tensor(outputSize)
-   self.lastInput = torch.Tensor()
+   self.gradWeight = torch.Tensor(outputSize, inputSize):zero()
+   self.gradBias = torch.Tensor(outputSize):zero()
+   -- columns of gradWeight referenced since the last zeroGradParameters
+   self.touched = torch.ByteTensor(inputSize):zero()
+   self.activeColumns = torch.LongTensor()
    -- state
    self.gradInput:resize(inputSize)
    self.output:resize(outputSize)
@@ -35,10 +37,43 @@ function SparseLinear:reset(stdv)
    end
 end
 
+-- input is a SparseTensor with one row per sample, or a single sample
+-- given as a 2 x nnz tensor of (index, value) pairs
 function SparseLinear:updateOutput(input)
-   return input.nn.SparseLinear_updateOutput(self, input)
+   return self.weight.nn.SparseLinear_updateOutput(self, input)
 end
 
 function SparseLinear:accGradParameters(input, gradOutput, scale)
-   return input.nn.SparseLinear_accGradParameters(self, input, gradOutput, scale)
+   return self.weight.nn.SparseLinear_accGradParameters(self, input, gradOutput, scale)
+end
+
+function SparseLinear:updateParameters(learningRate)
+   self.weight.nn.SparseLinear_updateParameters(self, learningRate)
+end
+
+function SparseLinear:zeroGradParameters()
+   self.weight.nn.SparseLinear_zeroGradParameters(self)
+end
+
+-- column bookkeeping keeps its integer types
+function SparseLinear:type(type)
+   local touched, activeColumns = self.touched, self.activeColumns
+   self.touched, self.activeColumns = nil, nil
+   parent.type(self, type)
+   self.touched, self.activeColumns = touched, activeColumns
+   return self
+end
+
+function SparseLinear:read(file)
+   local var = file:readObject()
+   for k,v in pairs(var) do
+      self[k] = v
+   end
+   -- modules saved before the column bookkeeping: gradWeight is dense
+   if not self.touched then
+      self.lastInput = nil
+      self.gradWeight:zero()
+      self.touched = torch.ByteTensor(self.weight:size(2)):zero()
+      self.activeColumns = torch.LongTensor()
+   end
 end
@@ -35,6 +35,18 @@ function SpatialContrastiveNormalization:updateGradInput(input, gradOutput)
    return self.gradInput
 end
 
+function SpatialContrastiveNormalization:inference()
+   parent.inference(self)
+   self.normalizer:inference()
+   return self
+end
+
+function SpatialContrastiveNormalization:training()
+   parent.training(self)
+   self.normalizer:training()
+   return self
+end
+
 function SpatialContrastiveNormalization:type(type)
    parent.type(self,type)
    self.normalizer:type(type)
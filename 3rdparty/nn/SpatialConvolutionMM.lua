@@ -51,3 +51,9 @@ end
 function SpatialConvolutionMM:accGradParameters(input, gradOutput, scale)
    return input.nn.SpatialConvolutionMM_accGradParameters(self, input, gradOutput, scale)
 end
+
+function SpatialConvolutionMM:inference()
+   parent.inference(self)
+   self.fgradInput:set()
+   return self
+end
@@ -79,9 +79,18 @@ function SpatialDivisiveNormalization:__init(nInputPlane, kernel, threshold, thr
 
    -- coefficient array, to adjust side effects
    self.coef = torch.Tensor(1,1,1)
+
+   -- fused forward pass for separable kernels, in inference mode
+   self.kernelv, self.kernelh = nn.SpatialSubtractiveNormalization.separate(self.kernel)
+   if self.kernelv then
+      self.coefv = torch.Tensor()
+      self.coefh = torch.Tensor()
+      self.localmean = torch.Tensor()
+      self.blurbuffer = torch.Tensor()
+   end
 end
 
-function SpatialDivisiveNormalization:updateOutput(input)
+local function updateOutputModules(self, input)
    -- compute side coefficients
    if (input:size(3) ~= self.coef:size(3)) or (input:size(2) ~= self.coef:size(2)) then
       local ones = input.new():resizeAs(input):fill(1)
@@ -93,7 +102,17 @@ function SpatialDivisiveNormalization:updateOutput(input)
    self.localstds = self.stdestimator:updateOutput(input)
    self.adjustedstds = self.divider:updateOutput{self.localstds, self.coef}
    self.thresholdedstds = self.thresholder:updateOutput(self.adjustedstds)
-   self.output = self.normalizer:updateOutput{input, self.thresholdedstds}
+   return self.normalizer:updateOutput{input, self.thresholdedstds}
+end
+
+-- the fused forward pass keeps no intermediate state for the backward
+-- pass: it is only used in inference mode
+function SpatialDivisiveNormalization:updateOutput(input)
+   if self.kernelv and self.forwardOnly then
+      input.nn.SpatialDivisiveNormalization_updateOutput(self, input)
+   else
+      self.output = updateOutputModules(self, input)
+   end
 
    -- done
    return self.output
@@ -11,7 +11,8 @@ function SpatialMaxPooling:__init(kW, kH, dW, dH)
    self.dW = dW
    self.dH = dH
 
-   self.indices = torch.Tensor()
+   -- offset of the max inside its window; set to nil for forward-only use
+   self.indices = (kW*kH <= 256) and torch.ByteTensor() or torch.IntTensor()
 end
 
 function SpatialMaxPooling:updateOutput(input)
@@ -29,6 +30,29 @@ function SpatialMaxPooling:empty()
    self.gradInput:storage():resize(0)
    self.output:resize()
    self.output:storage():resize(0)
-   self.indices:resize()
-   self.indices:storage():resize(0)
+   if self.indices then
+      self.indices:resize()
+      self.indices:storage():resize(0)
+   end
+end
+
+-- indices keep their integer type
+function SpatialMaxPooling:type(type)
+   local indices = self.indices
+   self.indices = nil
+   parent.type(self, type)
+   self.indices = indices
+   return self
+end
+
+function SpatialMaxPooling:read(file)
+   local var = file:readObject()
+   for k,v in pairs(var) do
+      self[k] = v
+   end
+   -- modules saved with one real-typed index plane per dimension
+   local t = torch.typename(self.indices)
+   if t and t ~= 'torch.ByteTensor' and t ~= 'torch.IntTensor' then
+      self.indices = (self.kW*self.kH <= 256) and torch.ByteTensor() or torch.IntTensor()
+   end
 end
@@ -58,9 +58,34 @@ function SpatialSubtractiveNormalization:__init(nInputPlane, kernel)
 
    -- coefficient array, to adjust side effects
    self.coef = torch.Tensor(1,1,1)
+
+   -- separable kernels get a fused forward pass in inference mode: one 1D
+   -- pass per axis, border coefficients cached per frame size
+   self.kernelv, self.kernelh = SpatialSubtractiveNormalization.separate(self.kernel)
+   if self.kernelv then
+      self.coefv = torch.Tensor()
+      self.coefh = torch.Tensor()
+      self.localmean = torch.Tensor()
+      self.blurbuffer = torch.Tensor()
+   end
 end
 
-function SpatialSubtractiveNormalization:updateOutput(input)
+-- splits a kernel into vertical and horizontal factors, each scaled to
+-- sum to one; returns nil if a 2D kernel is not of rank one
+function SpatialSubtractiveNormalization.separate(kernel)
+   local kv, kh
+   if kernel:nDimension() == 1 then
+      kv, kh = kernel:clone(), kernel:clone()
+   else
+      kv, kh = torch.separate(kernel)
+      if not kv then return end
+   end
+   local sv, sh = kv:sum(), kh:sum()
+   if sv == 0 or sh == 0 then return end
+   return kv:div(sv), kh:div(sh)
+end
+
+local function updateOutputModules(self, input)
    -- compute side coefficients
    if (input:size(3) ~= self.coef:size(3)) or (input:size(2) ~= self.coef:size(2)) then
       local ones = input.new():resizeAs(input):fill(1)
@@ -71,7 +96,17 @@ function SpatialSubtractiveNormalization:updateOutput(input)
    -- compute mean
    self.localsums = self.meanestimator:updateOutput(input)
    self.adjustedsums = self.divider:updateOutput{self.localsums, self.coef}
-   self.output = self.subtractor:updateOutput{input, self.adjustedsums}
+   return self.subtractor:updateOutput{input, self.adjustedsums}
+end
+
+-- the fused forward pass keeps no intermediate state for the backward
+-- pass: it is only used in inference mode
+function SpatialSubtractiveNormalization:updateOutput(input)
+   if self.kernelv and self.forwardOnly then
+      input.nn.SpatialSubtractiveNormalization_updateOutput(self, input)
+   else
+      self.output = updateOutputModules(self, input)
+   end
 
    -- done
    return self.output
@@ -8,7 +8,8 @@ function TemporalMaxPooling:__init(kW, dW)
    self.kW = kW
    self.dW = dW
 
-   self.indices = torch.Tensor()
+   -- offset of the max inside its window; set to nil for forward-only use
+   self.indices = (kW <= 256) and torch.ByteTensor() or torch.IntTensor()
 end
 
 function TemporalMaxPooling:updateOutput(input)
@@ -26,6 +27,29 @@ function TemporalMaxPooling:empty()
    self.gradInput:storage():resize(0)
    self.output:resize()
    self.output:storage():resize(0)
-   self.indices:resize()
-   self.indices:storage():resize(0)
+   if self.indices then
+      self.indices:resize()
+      self.indices:storage():resize(0)
+   end
+end
+
+-- indices keep their integer type
+function TemporalMaxPooling:type(type)
+   local indices = self.indices
+   self.indices = nil
+   parent.type(self, type)
+   self.indices = indices
+   return self
+end
+
+function TemporalMaxPooling:read(file)
+   local var = file:readObject()
+   for k,v in pairs(var) do
+      self[k] = v
+   end
+   -- modules saved with one real-typed index plane per dimension
+   local t = torch.typename(self.indices)
+   if t and t ~= 'torch.ByteTensor' and t ~= 'torch.IntTensor' then
+      self.indices = (self.kW <= 256) and torch.ByteTensor() or torch.IntTensor()
+   end
 end
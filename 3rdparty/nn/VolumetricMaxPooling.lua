@@ -14,7 +14,8 @@ function VolumetricMaxPooling:__init(kT, kW, kH, dT, dW, dH)
    self.dW = dW
    self.dH = dH
 
-   self.indices = torch.Tensor()
+   -- offset of the max inside its window; set to nil for forward-only use
+   self.indices = (kT*kW*kH <= 256) and torch.ByteTensor() or torch.IntTensor()
 end
 
 function VolumetricMaxPooling:updateOutput(input)
@@ -32,6 +33,29 @@ function VolumetricMaxPooling:empty()
    self.gradInput:storage():resize(0)
    self.output:resize()
    self.output:storage():resize(0)
-   self.indices:resize()
-   self.indices:storage():resize(0)
+   if self.indices then
+      self.indices:resize()
+      self.indices:storage():resize(0)
+   end
+end
+
+-- indices keep their integer type
+function VolumetricMaxPooling:type(type)
+   local indices = self.indices
+   self.indices = nil
+   parent.type(self, type)
+   self.indices = indices
+   return self
+end
+
+function VolumetricMaxPooling:read(file)
+   local var = file:readObject()
+   for k,v in pairs(var) do
+      self[k] = v
+   end
+   -- modules saved with one real-typed index plane per dimension
+   local t = torch.typename(self.indices)
+   if t and t ~= 'torch.ByteTensor' and t ~= 'torch.IntTensor' then
+      self.indices = (self.kT*self.kW*self.kH <= 256) and torch.ByteTensor() or torch.IntTensor()
+   end
 end
@@ -0,0 +1,257 @@
+#ifndef TH_GENERIC_FILE
+#define TH_GENERIC_FILE "generic/LookupTable.c"
+#else
+
+/* indices (1D, or 2D batch x sequence) as a contiguous LongTensor, checked
+   against the number of rows */
+static THLongTensor *nn_(LookupTable_checkInput)(lua_State *L, int idx, long nIndex)
+{
+  THLongTensor *input = luaT_checkudata(L, idx, "torch.LongTensor");
+  long *input_data;
+  long i, n;
+
+  luaL_argcheck(L, input->nDimension == 1 || input->nDimension == 2, idx, "1D or 2D tensor of indices expected");
+  input = THLongTensor_newContiguous(input);
+  input_data = THLongTensor_data(input);
+  n = THLongTensor_nElement(input);
+  for(i = 0; i < n; i++)
+  {
+    if(input_data[i] < 1 || input_data[i] > nIndex)
+    {
+      long index = input_data[i];
+      THLongTensor_free(input);
+      luaL_error(L, "index %d out of range [1, %d]", (int)index, (int)nIndex);
+    }
+  }
+  return input;
+}
+
+static int nn_(LookupTable_updateOutput)(lua_State *L)
+{
+  THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
+  THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
+  THLongTensor *input = nn_(LookupTable_checkInput)(L, 2, weight->size[0]);
+  THLongStorage *size;
+  long *input_data;
+  real *weight_data, *output_data;
+  long i, n, rowsize;
+  int d;
+
+  weight = THTensor_(newContiguous)(weight);
+  rowsize = THTensor_(nElement)(weight) / weight->size[0];
+
+  /* index dimensions followed by the row dimensions */
+  size = THLongStorage_newWithSize(input->nDimension + weight->nDimension - 1);
+  for(d = 0; d < input->nDimension; d++)
+    size->data[d] = input->size[d];
+  for(d = 1; d < weight->nDimension; d++)
+    size->data[input->nDimension + d - 1] = weight->size[d];
+  THTensor_(resize)(output, size, NULL);
+  THLongStorage_free(size);
+
+  output = THTensor_(newContiguous)(output);
+  input_data = THLongTensor_data(input);
+  weight_data = THTensor_(data)(weight);
+  output_data = THTensor_(data)(output);
+  n = THLongTensor_nElement(input);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < n; i++)
+    memcpy(output_data + i*rowsize, weight_data + (input_data[i]-1)*rowsize, sizeof(real)*rowsize);
+
+  THLongTensor_free(input);
+  THTensor_(free)(weight);
+  THTensor_(freeCopyTo)(output, luaT_getfieldcheckudata(L, 1, "output", torch_Tensor));
+  return 1;
+}
+
+/* arguments of a scatter into dst, checked before the contiguous copy of
+   the indices is made, as the errors would leak it */
+static void nn_(LookupTable_checkScatter)(lua_State *L, THTensor *dst, THTensor *gradOutput)
+{
+  THLongTensor *input = luaT_checkudata(L, 2, "torch.LongTensor");
+  long rowsize = THTensor_(nElement)(dst) / dst->size[0];
+
+  luaL_argcheck(L, THTensor_(isContiguous)(dst), 1, "parameters must be contiguous");
+  luaL_argcheck(L, THTensor_(nElement)(gradOutput) == THLongTensor_nElement(input)*rowsize, 3,
+                "gradOutput does not match input");
+}
+
+/* dst[index] += scale * gradOutput[i] for each position i; positions sharing
+   an index are summed by the same thread. The rows written for the first
+   time are flagged in touched and appended to rows (when given). */
+static void nn_(LookupTable_scatter)(THTensor *dst, THLongTensor *input, THTensor *gradOutput,
+                                     real scale, THByteTensor *touched, THLongTensor *rows)
+{
+  long n = THLongTensor_nElement(input);
+  long rowsize = THTensor_(nElement)(dst) / dst->size[0];
+  nn_LookupTableEntry *entries;
+  long *start, *input_data;
+  real *dst_data, *gradOutput_data;
+  long g, ngroup;
+
+  gradOutput = THTensor_(newContiguous)(gradOutput);
+  input_data = THLongTensor_data(input);
+  dst_data = THTensor_(data)(dst);
+  gradOutput_data = THTensor_(data)(gradOutput);
+
+  entries = THAlloc(sizeof(nn_LookupTableEntry)*THMax(n, 1));
+  start = THAlloc(sizeof(long)*(n+1));
+  ngroup = nn_LookupTable_coalesce(input_data, n, entries, start);
+
+#pragma omp parallel for private(g)
+  for(g = 0; g < ngroup; g++)
+  {
+    real *row = dst_data + (entries[start[g]].index-1)*rowsize;
+    long e;
+    for(e = start[g]; e < start[g+1]; e++)
+      THVector_(add)(row, gradOutput_data + entries[e].pos*rowsize, scale, rowsize);
+  }
+
+  if(touched)
+  {
+    unsigned char *touched_data = THByteTensor_data(touched);
+    long nrows = THLongTensor_nElement(rows);
+    long nnew = 0;
+    for(g = 0; g < ngroup; g++)
+      nnew += !touched_data[entries[start[g]].index-1];
+    if(nnew > 0)
+    {
+      long *rows_data;
+      /* grow geometrically: this is called once per batch */
+      if(!rows->storage || rows->storage->size < nrows+nnew)
+        THLongTensor_resize1d(rows, 2*(nrows+nnew));
+      THLongTensor_resize1d(rows, nrows+nnew);
+      rows_data = THLongTensor_data(rows);
+      for(g = 0; g < ngroup; g++)
+      {
+        long index = entries[start[g]].index;
+        if(!touched_data[index-1])
+        {
+          touched_data[index-1] = 1;
+          rows_data[nrows++] = index;
+        }
+      }
+    }
+  }
+
+  THFree(entries);
+  THFree(start);
+  THTensor_(free)(gradOutput);
+}
+
+/* rows referenced since the last zeroGradParameters */
+static void nn_(LookupTable_checkRows)(lua_State *L, THTensor *weight, THByteTensor **touched, THLongTensor **rows)
+{
+  *touched = luaT_getfieldcheckudata(L, 1, "touched", "torch.ByteTensor");
+  *rows = luaT_getfieldcheckudata(L, 1, "inputs", "torch.LongTensor");
+  luaL_argcheck(L, THByteTensor_isContiguous(*touched) && THByteTensor_nElement(*touched) == weight->size[0], 1,
+                "touched does not match weight");
+  luaL_argcheck(L, THLongTensor_isContiguous(*rows) && (*rows)->nDimension <= 1, 1, "inputs must be a 1D LongTensor");
+}
+
+static int nn_(LookupTable_accGradParameters)(lua_State *L)
+{
+  THTensor *gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
+  THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  real scale = luaL_optnumber(L, 4, 1);
+  THByteTensor *touched;
+  THLongTensor *rows, *input;
+
+  nn_(LookupTable_checkRows)(L, gradWeight, &touched, &rows);
+  nn_(LookupTable_checkScatter)(L, gradWeight, gradOutput);
+  input = nn_(LookupTable_checkInput)(L, 2, gradWeight->size[0]);
+  nn_(LookupTable_scatter)(gradWeight, input, gradOutput, scale, touched, rows);
+  THLongTensor_free(input);
+  return 0;
+}
+
+static int nn_(LookupTable_accUpdateGradParameters)(lua_State *L)
+{
+  THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
+  THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  real lr = luaL_checknumber(L, 4);
+  THLongTensor *input;
+
+  nn_(LookupTable_checkScatter)(L, weight, gradOutput);
+  input = nn_(LookupTable_checkInput)(L, 2, weight->size[0]);
+  nn_(LookupTable_scatter)(weight, input, gradOutput, -lr, NULL, NULL);
+  THLongTensor_free(input);
+  return 0;
+}
+
+static int nn_(LookupTable_zeroGradParameters)(lua_State *L)
+{
+  THTensor *gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
+  THByteTensor *touched;
+  THLongTensor *rows;
+  long *rows_data;
+  unsigned char *touched_data;
+  real *gradWeight_data;
+  long i, nrows, rowsize;
+
+  nn_(LookupTable_checkRows)(L, gradWeight, &touched, &rows);
+  luaL_argcheck(L, THTensor_(isContiguous)(gradWeight), 1, "gradWeight must be contiguous");
+  rowsize = THTensor_(nElement)(gradWeight) / gradWeight->size[0];
+  nrows = THLongTensor_nElement(rows);
+  rows_data = (nrows > 0) ? THLongTensor_data(rows) : NULL;
+  touched_data = THByteTensor_data(touched);
+  gradWeight_data = THTensor_(data)(gradWeight);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < nrows; i++)
+  {
+    real *row = gradWeight_data + (rows_data[i]-1)*rowsize;
+    long j;
+    for(j = 0; j < rowsize; j++)
+      row[j] = 0;
+    touched_data[rows_data[i]-1] = 0;
+  }
+  THLongTensor_resize1d(rows, 0);
+  return 0;
+}
+
+static int nn_(LookupTable_updateParameters)(lua_State *L)
+{
+  THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
+  THTensor *gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
+  real lr = luaL_checknumber(L, 2);
+  THByteTensor *touched;
+  THLongTensor *rows;
+  long *rows_data;
+  real *weight_data, *gradWeight_data;
+  long i, nrows, rowsize;
+
+  nn_(LookupTable_checkRows)(L, gradWeight, &touched, &rows);
+  luaL_argcheck(L, THTensor_(isContiguous)(weight) && THTensor_(isContiguous)(gradWeight), 1,
+                "parameters must be contiguous");
+  rowsize = THTensor_(nElement)(weight) / weight->size[0];
+  nrows = THLongTensor_nElement(rows);
+  rows_data = (nrows > 0) ? THLongTensor_data(rows) : NULL;
+  weight_data = THTensor_(data)(weight);
+  gradWeight_data = THTensor_(data)(gradWeight);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < nrows; i++)
+    THVector_(add)(weight_data + (rows_data[i]-1)*rowsize, gradWeight_data + (rows_data[i]-1)*rowsize,
+                   -lr, rowsize);
+  return 0;
+}
+
+static const struct luaL_Reg nn_(LookupTable__) [] = {
+  {"LookupTable_updateOutput", nn_(LookupTable_updateOutput)},
+  {"LookupTable_accGradParameters", nn_(LookupTable_accGradParameters)},
+  {"LookupTable_accUpdateGradParameters", nn_(LookupTable_accUpdateGradParameters)},
+  {"LookupTable_zeroGradParameters", nn_(LookupTable_zeroGradParameters)},
+  {"LookupTable_updateParameters", nn_(LookupTable_updateParameters)},
+  {NULL, NULL}
+};
+
+static void nn_(LookupTable_init)(lua_State *L)
+{
+  luaT_pushmetatable(L, torch_Tensor);
+  luaT_registeratname(L, nn_(LookupTable__), "nn");
+  lua_pop(L,1);
+}
+
+#endif
@@ -2,119 +2,287 @@
 #define TH_GENERIC_FILE "generic/SparseLinear.c"
 #else
 
+/* the input as a sparse matrix with one row per sample: either a
+   SparseTensor (batch), or a single sample given as a 2 x nnz tensor of
+   (index, value) pairs. The products convert their sparse operand to CSR:
+   a COO input is copied, so that the caller's tensor keeps its layout. */
+static THSparseTensor *nn_(SparseLinear_checkInput)(lua_State *L, int idx, long inputSize, int *batch)
+{
+  THSparseTensor *sparse = luaT_toudata(L, idx, torch_SparseTensor);
+
+  if(sparse)
+  {
+    luaL_argcheck(L, sparse->nCol == inputSize, idx, "input size mismatch");
+    if(sparse->format == TH_SPARSE_CSR)
+      THSparseTensor_(retain)(sparse);
+    else
+    {
+      THSparseTensor *copy = THSparseTensor_(new)();
+      THSparseTensor_(resize)(copy, sparse->nRow, sparse->nCol, sparse->nnz);
+      if(sparse->nnz > 0)
+      {
+        memcpy(copy->rows->data, sparse->rows->data, sizeof(long)*sparse->nnz);
+        memcpy(copy->cols->data, sparse->cols->data, sizeof(long)*sparse->nnz);
+        memcpy(copy->values->data, sparse->values->data, sizeof(real)*sparse->nnz);
+      }
+      copy->coalesced = sparse->coalesced;
+      sparse = copy;
+    }
+    *batch = 1;
+  }
+  else
+  {
+    THTensor *input = luaT_checkudata(L, idx, torch_Tensor);
+    long i, nnz;
+
+    luaL_argcheck(L, input->nDimension == 2 && input->size[0] == 2, idx, "sparse tensor or 2 x nnz tensor expected");
+    nnz = input->size[1];
+    for(i = 0; i < nnz; i++)
+    {
+      long offset = (long)(THTensor_(get2d)(input, 0, i))-1;
+      if(offset < 0 || offset >= inputSize) /* make sure indices are in bounds.. */
+        luaL_error(L, "index out of bound");
+    }
+
+    sparse = THSparseTensor_(new)();
+    THSparseTensor_(resize)(sparse, 1, inputSize, nnz);
+    for(i = 0; i < nnz; i++)
+    {
+      sparse->rows->data[i] = 0;
+      sparse->cols->data[i] = (long)(THTensor_(get2d)(input, 0, i))-1;
+      sparse->values->data[i] = THTensor_(get2d)(input, 1, i);
+    }
+    *batch = 0;
+  }
+  return sparse;
+}
+
+/* a 1D tensor as a 1 x n matrix */
+static THTensor *nn_(SparseLinear_asRow)(THTensor *t)
+{
+  return THTensor_(newWithStorage2d)(t->storage, t->storageOffset, 1, t->size[0]*t->stride[0], t->size[0], t->stride[0]);
+}
+
 static int nn_(SparseLinear_updateOutput)(lua_State *L)
 {
-  long i;
-  THTensor * input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor * weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor * bias = luaT_getfieldcheckudata(L, 1, "bias", torch_Tensor);
   THTensor * output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
-  long dim = weight->size[0]; /* number of weights.. */
+  long outputSize = weight->size[0];
+  int batch;
+  THSparseTensor *input = nn_(SparseLinear_checkInput)(L, 2, weight->size[1], &batch);
+  THTensor *output2d, *weightT, *row;
+  long i;
 
-  THTensor_(copy)(output, bias);
-  for(i = 0; i < input->size[1]; i++)
+  if(batch)
   {
-    long offset = (long)(THTensor_(get2d)(input, 0, i))-1;
-    
-    if(offset >= 0 && offset < dim) /* make sure indices are in bounds.. */
-    {
-      real val = THTensor_(get2d)(input, 1, i);
-      THBlas_(axpy)(output->size[0], 
-                    val, 
-                    THTensor_(data)(weight)+offset*weight->stride[0],
-                    weight->stride[1], 
-                    THTensor_(data)(output), 
-                    output->stride[0]);
-    }
-    else
-      luaL_error(L, "index out of bound");
+    THTensor_(resize2d)(output, input->nRow, outputSize);
+    output2d = output;
+    THTensor_(retain)(output);
+  }
+  else
+  {
+    THTensor_(resize1d)(output, outputSize);
+    output2d = nn_(SparseLinear_asRow)(output);
   }
+
+  row = THTensor_(new)();
+  for(i = 0; i < input->nRow; i++)
+  {
+    THTensor_(select)(row, output2d, 0, i);
+    THTensor_(copy)(row, bias);
+  }
+
+  /* output = bias + input * weight^T; only the weight columns of the
+     nonzero inputs are read */
+  weightT = THTensor_(newTranspose)(weight, 0, 1);
+  THSparseTensor_(addmm)(output2d, 1, output2d, 1, input, weightT);
+
+  THTensor_(free)(row);
+  THTensor_(free)(weightT);
+  THTensor_(free)(output2d);
+  THSparseTensor_(free)(input);
   return 1;
 }
 
+/* columns of gradWeight written since the last zeroGradParameters */
+static void nn_(SparseLinear_checkColumns)(lua_State *L, long inputSize, unsigned char **touched, THLongTensor **columns)
+{
+  THByteTensor *mask = luaT_getfieldcheckudata(L, 1, "touched", "torch.ByteTensor");
+  *columns = luaT_getfieldcheckudata(L, 1, "activeColumns", "torch.LongTensor");
+  luaL_argcheck(L, THByteTensor_isContiguous(mask) && THByteTensor_nElement(mask) == inputSize, 1,
+                "touched does not match weight");
+  luaL_argcheck(L, THLongTensor_isContiguous(*columns) && (*columns)->nDimension <= 1, 1,
+                "activeColumns must be a 1D LongTensor");
+  *touched = THByteTensor_data(mask);
+}
+
 static int nn_(SparseLinear_accGradParameters)(lua_State *L)
 {
-  long i;
-  THTensor * input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor * gradOutput = luaT_checkudata(L, 3, torch_Tensor);
   real scale = luaL_optnumber(L, 4, 1);
   THTensor * weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor * gradBias = luaT_getfieldcheckudata(L, 1, "gradBias", torch_Tensor);
   THTensor * gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
-  THTensor * lastInput = luaT_getfieldcheckudata(L, 1, "lastInput", torch_Tensor);
   real weightDecay = luaT_getfieldchecknumber(L, 1, "weightDecay");
-  long dim = gradWeight->size[0]; /* number of weights.. */
+  long outputSize = gradWeight->size[0];
+  long inputSize = gradWeight->size[1];
+  unsigned char *touched;
+  THLongTensor *columns;
+  THSparseTensor *input;
+  THTensor *gradOutput2d, *gradOutputT, *row;
+  long *cols, *columns_data;
+  long i, e, ncolumns, nnew = 0;
+  int batch;
+
+  nn_(SparseLinear_checkColumns)(L, inputSize, &touched, &columns);
+  input = nn_(SparseLinear_checkInput)(L, 2, inputSize, &batch);
 
-  for(i = 0; i < input->size[1]; i++)
+  if(batch)
   {
-    long offset = (long)(THTensor_(get2d)(input, 0, i))-1;
+    luaL_argcheck(L, gradOutput->nDimension == 2 && gradOutput->size[0] == input->nRow && gradOutput->size[1] == outputSize,
+                  3, "gradOutput does not match input");
+    gradOutput2d = gradOutput;
+    THTensor_(retain)(gradOutput);
+  }
+  else
+  {
+    luaL_argcheck(L, gradOutput->nDimension == 1 && gradOutput->size[0] == outputSize, 3, "gradOutput does not match input");
+    gradOutput2d = nn_(SparseLinear_asRow)(gradOutput);
+  }
+
+  row = THTensor_(new)();
+  for(i = 0; i < input->nRow; i++)
+  {
+    THTensor_(select)(row, gradOutput2d, 0, i);
+    THTensor_(cadd)(gradBias, gradBias, scale, row);
+  }
+
+  /* gradWeight += scale * gradOutput^T * input, over the active columns */
+  gradOutputT = THTensor_(newTranspose)(gradOutput2d, 0, 1);
+  THSparseTensor_(addDenseMM)(gradWeight, scale, gradOutputT, input);
 
-    if(offset >= 0 && offset < dim) /* make sure indices are in bounds.. */
+  /* bit 2 marks the columns of this input, so that each one is decayed
+     once and new ones (flag 0) are appended once to activeColumns */
+  cols = input->cols->data;
+  for(e = 0; e < input->nnz; e++)
+  {
+    long c = cols[e];
+    if(touched[c] & 2)
+      continue;
+    nnew += (touched[c] == 0);
+    touched[c] |= 2;
+    if(weightDecay != 0)
     {
-      real val = scale*THTensor_(get2d)(input, 1, i);
-      THBlas_(scal)(gradOutput->size[0],
-                    0, 
-                    THTensor_(data)(gradWeight)+offset*gradWeight->stride[0],
-                    gradWeight->stride[1]); /* zero */
-
-      THBlas_(axpy)(gradOutput->size[0], 
-                    val, 
-                    THTensor_(data)(gradOutput), 
-                    gradOutput->stride[0], 
-                    THTensor_(data)(gradWeight)+offset*gradWeight->stride[0], 
-                    gradWeight->stride[1]);
+      for(i = 0; i < outputSize; i++)
+        THTensor_fastSet2d(gradWeight, i, c, THTensor_fastGet2d(gradWeight, i, c) + weightDecay*THTensor_fastGet2d(weight, i, c));
     }
-    else
-      luaL_error(L, "index out of bound");
   }
-  
-  THTensor_(cadd)(gradBias, gradBias, 1, gradOutput); 
-  
-  if(weightDecay != 0)
-    THTensor_(cadd)(gradWeight, gradWeight, weightDecay, weight);
-  
-  THTensor_(resizeAs)(lastInput, input);
-  THTensor_(copy)(lastInput, input);
-  
+
+  ncolumns = THLongTensor_nElement(columns);
+  if(nnew > 0)
+  {
+    /* grow geometrically: this is called once per batch */
+    if(!columns->storage || columns->storage->size < ncolumns+nnew)
+      THLongTensor_resize1d(columns, 2*(ncolumns+nnew));
+    THLongTensor_resize1d(columns, ncolumns+nnew);
+  }
+  columns_data = (ncolumns+nnew > 0) ? THLongTensor_data(columns) : NULL;
+  for(e = 0; e < input->nnz; e++)
+  {
+    long c = cols[e];
+    if(touched[c] == 2)
+      columns_data[ncolumns++] = c+1;
+    touched[c] = 1;
+  }
+
+  THTensor_(free)(row);
+  THTensor_(free)(gradOutputT);
+  THTensor_(free)(gradOutput2d);
+  THSparseTensor_(free)(input);
   return 0;
 }
 
 int nn_(SparseLinear_updateParameters)(lua_State *L)
 {
-  long i;
   real learningRate = luaL_checknumber(L, 2);
   THTensor * weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor * bias = luaT_getfieldcheckudata(L, 1, "bias", torch_Tensor);
   THTensor * gradBias = luaT_getfieldcheckudata(L, 1, "gradBias", torch_Tensor);
   THTensor * gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
-  THTensor * lastInput = luaT_getfieldcheckudata(L, 1, "lastInput", torch_Tensor);
-  
-  long dim = weight->size[0]; /* number of weights.. */
+  long outputSize = weight->size[0];
+  unsigned char *touched;
+  THLongTensor *columns;
+  long *columns_data;
+  real *weight_data, *gradWeight_data;
+  long i, ncolumns;
+
+  nn_(SparseLinear_checkColumns)(L, weight->size[1], &touched, &columns);
   THTensor_(cadd)(bias, bias, -learningRate, gradBias);
-  
-  for(i = 0; i < lastInput->size[1]; i++) 
+
+  ncolumns = THLongTensor_nElement(columns);
+  columns_data = (ncolumns > 0) ? THLongTensor_data(columns) : NULL;
+  weight_data = THTensor_(data)(weight);
+  gradWeight_data = THTensor_(data)(gradWeight);
+
+  /* sweep each row of weight through the sorted columns, rather than
+     each column through the rows: successive accesses share pages */
+  qsort(columns_data, ncolumns, sizeof(long), nn_SparseLinear_compareLong);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < outputSize; i++)
   {
-    long offset = (long)(THTensor_(get2d)(lastInput, 0, i))-1;
-    
-    if(offset >= 0 && offset < dim) /* make sure indices are in bounds.. */
+    real *w = weight_data + i*weight->stride[0];
+    real *gw = gradWeight_data + i*gradWeight->stride[0];
+    long k;
+    for(k = 0; k < ncolumns; k++)
     {
-      THBlas_(axpy)(bias->size[0], 
-                    -learningRate, 
-                    THTensor_(data)(gradWeight)+offset*gradWeight->stride[0], 
-                    gradWeight->stride[1], 
-                    THTensor_(data)(weight)+offset*weight->stride[0], 
-                    weight->stride[1]);
+      long c = columns_data[k]-1;
+      w[c*weight->stride[1]] -= learningRate*gw[c*gradWeight->stride[1]];
     }
-    else
-      luaL_error(L, "index out of bound");
   }
   return 0;
 }
 
+static int nn_(SparseLinear_zeroGradParameters)(lua_State *L)
+{
+  THTensor * gradBias = luaT_getfieldcheckudata(L, 1, "gradBias", torch_Tensor);
+  THTensor * gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
+  long outputSize = gradWeight->size[0];
+  unsigned char *touched;
+  THLongTensor *columns;
+  long *columns_data;
+  real *gradWeight_data;
+  long i, ncolumns;
+
+  nn_(SparseLinear_checkColumns)(L, gradWeight->size[1], &touched, &columns);
+  THTensor_(zero)(gradBias);
+
+  ncolumns = THLongTensor_nElement(columns);
+  columns_data = (ncolumns > 0) ? THLongTensor_data(columns) : NULL;
+  gradWeight_data = THTensor_(data)(gradWeight);
+
+  qsort(columns_data, ncolumns, sizeof(long), nn_SparseLinear_compareLong);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < outputSize; i++)
+  {
+    real *gw = gradWeight_data + i*gradWeight->stride[0];
+    long k;
+    for(k = 0; k < ncolumns; k++)
+      gw[(columns_data[k]-1)*gradWeight->stride[1]] = 0;
+  }
+  for(i = 0; i < ncolumns; i++)
+    touched[columns_data[i]-1] = 0;
+  THLongTensor_resize1d(columns, 0);
+  return 0;
+}
+
 static const struct luaL_Reg nn_(SparseLinear__) [] = {
   {"SparseLinear_updateOutput", nn_(SparseLinear_updateOutput)},
   {"SparseLinear_accGradParameters", nn_(SparseLinear_accGradParameters)},
   {"SparseLinear_updateParameters", nn_(SparseLinear_updateParameters)},
+  {"SparseLinear_zeroGradParameters", nn_(SparseLinear_zeroGradParameters)},
   {NULL, NULL}
 };
 
@@ -2,9 +2,295 @@
 #define TH_GENERIC_FILE "generic/SpatialConvolutionMap.c"
 #else
 
+/*
+ * Connection-table engine, shared with SpatialFullConvolutionMap. Each X
+ * plane is unfolded once into a (kH*kW) x npixels matrix, and all the
+ * kernels connected to it are applied with a single gemm. X planes are
+ * processed in parallel, and the per-connection results are then summed
+ * into their Y planes, in parallel over Y planes.
+ */
+
+static void nn_(ConvMapTable_init)(lua_State *L, nn_ConvMapTable *t, THTensor *connTable, int xcol,
+                                   long nx, long ny, long xh, long xw, long yh, long yw,
+                                   int kH, int kW, int dH, int dW)
+{
+  long k, nconn;
+
+  luaL_argcheck(L, connTable->nDimension == 2 && connTable->size[1] == 2, 1, "invalid connection table");
+  luaL_argcheck(L, yh > 0 && yw > 0 && xh >= (yh-1)*dH+kH && xw >= (yw-1)*dW+kW, 2,
+                "input and output sizes do not match");
+  nconn = connTable->size[0];
+  for(k = 0; k < nconn; k++)
+  {
+    long x = (long)THTensor_(get2d)(connTable, k, xcol)-1;
+    long y = (long)THTensor_(get2d)(connTable, k, 1-xcol)-1;
+    if(x < 0 || x >= nx || y < 0 || y >= ny)
+      luaL_error(L, "connection %d out of range", (int)(k+1));
+  }
+
+  t->nconn = nconn;
+  t->nx = nx;
+  t->ny = ny;
+  t->xh = xh;
+  t->xw = xw;
+  t->yh = yh;
+  t->yw = yw;
+  t->kH = kH;
+  t->kW = kW;
+  t->dH = dH;
+  t->dW = dW;
+  t->xstart = THAlloc(sizeof(long)*(nx+1));
+  t->ystart = THAlloc(sizeof(long)*(ny+1));
+  t->xconn = THAlloc(sizeof(long)*THMax(nconn, 1));
+  t->yconn = THAlloc(sizeof(long)*THMax(nconn, 1));
+  t->rank = THAlloc(sizeof(long)*THMax(nconn, 1));
+  t->yplane = THAlloc(sizeof(long)*THMax(nconn, 1));
+
+  /* counting sort of the connections, by X plane and by Y plane */
+  for(k = 0; k <= nx; k++)
+    t->xstart[k] = 0;
+  for(k = 0; k <= ny; k++)
+    t->ystart[k] = 0;
+  for(k = 0; k < nconn; k++)
+  {
+    t->yplane[k] = (long)THTensor_(get2d)(connTable, k, 1-xcol)-1;
+    t->xstart[(long)THTensor_(get2d)(connTable, k, xcol)]++;
+    t->ystart[t->yplane[k]+1]++;
+  }
+  for(k = 0; k < nx; k++)
+    t->xstart[k+1] += t->xstart[k];
+  for(k = 0; k < ny; k++)
+    t->ystart[k+1] += t->ystart[k];
+  for(k = 0; k < nconn; k++)
+  {
+    long x = (long)THTensor_(get2d)(connTable, k, xcol)-1;
+    t->rank[k] = t->xstart[x]++;
+    t->xconn[t->rank[k]] = k;
+    t->yconn[t->ystart[t->yplane[k]]++] = k;
+  }
+  for(k = nx; k > 0; k--)
+    t->xstart[k] = t->xstart[k-1];
+  t->xstart[0] = 0;
+  for(k = ny; k > 0; k--)
+    t->ystart[k] = t->ystart[k-1];
+  t->ystart[0] = 0;
+}
+
+/* kernels in xconn order: nconn x (kH*kW) */
+static real *nn_(ConvMapTable_packWeight)(nn_ConvMapTable *t, real *weight)
+{
+  long kk = t->kH*t->kW;
+  real *packed = THAlloc(sizeof(real)*THMax(t->nconn*kk, 1));
+  long c;
+  for(c = 0; c < t->nconn; c++)
+    memcpy(packed + c*kk, weight + t->xconn[c]*kk, sizeof(real)*kk);
+  return packed;
+}
+
+/* u[ky*kW+kx][(y-y0)*yw+x] = X[y*dH+ky][x*dW+kx], for the Y rows [y0,y0+n) */
+static void nn_(ConvMapTable_unfold)(nn_ConvMapTable *t, real *u, real *x_data, long y0, long n)
+{
+  long npix = n*t->yw;
+  long ky, kx, y, x;
+  for(ky = 0; ky < t->kH; ky++)
+  {
+    for(kx = 0; kx < t->kW; kx++)
+    {
+      for(y = 0; y < n; y++)
+      {
+        real *src = x_data + ((y0+y)*t->dH+ky)*t->xw + kx;
+        real *dst = u + (ky*t->kW+kx)*npix + y*t->yw;
+        if(t->dW == 1)
+          memcpy(dst, src, sizeof(real)*t->yw);
+        else
+          for(x = 0; x < t->yw; x++)
+            dst[x] = src[x*t->dW];
+      }
+    }
+  }
+}
+
+/* adjoint of unfold: accumulates the columns back into the X plane */
+static void nn_(ConvMapTable_fold)(nn_ConvMapTable *t, real *x_data, real *u, long y0, long n)
+{
+  long npix = n*t->yw;
+  long ky, kx, y, x;
+  for(ky = 0; ky < t->kH; ky++)
+  {
+    for(kx = 0; kx < t->kW; kx++)
+    {
+      for(y = 0; y < n; y++)
+      {
+        real *dst = x_data + ((y0+y)*t->dH+ky)*t->xw + kx;
+        real *src = u + (ky*t->kW+kx)*npix + y*t->yw;
+        if(t->dW == 1)
+          THVector_(add)(dst, src, 1, t->yw);
+        else
+          for(x = 0; x < t->yw; x++)
+            dst[x*t->dW] += src[x];
+      }
+    }
+  }
+}
+
+/* rows [y0,y0+n) of the Y planes connected to X plane p, in xconn order */
+static void nn_(ConvMapTable_gather)(nn_ConvMapTable *t, real *g, real *y_data, long p, long y0, long n)
+{
+  long npix = n*t->yw;
+  long c;
+  for(c = t->xstart[p]; c < t->xstart[p+1]; c++)
+    memcpy(g + (c-t->xstart[p])*npix,
+           y_data + t->yplane[t->xconn[c]]*t->yh*t->yw + y0*t->yw, sizeof(real)*npix);
+}
+
+/* Y[q] += validXCorr(X[p], kernel), for every connection p -> q */
+static void nn_(ConvMapTable_xcorr)(nn_ConvMapTable *t, real *y_data, real *x_data, real *weight)
+{
+  long kk = t->kH*t->kW;
+  long band = nn_ConvMapTable_band(t, (t->nconn+kk)*t->yw);
+  real *packed = nn_(ConvMapTable_packWeight)(t, weight);
+  real *cols = THAlloc(sizeof(real)*THMax(t->nconn*band*t->yw, 1));
+  long y0, p, q;
+
+  for(y0 = 0; y0 < t->yh; y0 += band)
+  {
+    long n = THMin(band, t->yh-y0);
+    long npix = n*t->yw;
+
+#pragma omp parallel for private(p)
+    for(p = 0; p < t->nx; p++)
+    {
+      long cnt = t->xstart[p+1]-t->xstart[p];
+      real *u;
+      if(cnt == 0)
+        continue;
+      if(cnt == 1 && nn_ConvMapTable_fits(t))
+      {
+        /* nothing to share: direct correlation */
+        real *dst = cols + t->xstart[p]*npix;
+        long j;
+        for(j = 0; j < npix; j++)
+          dst[j] = 0;
+        THTensor_(validXCorr2Dptr)(dst, 1,
+                                   x_data + p*t->xh*t->xw + y0*t->dH*t->xw, (n-1)*t->dH+t->kH, t->xw,
+                                   packed + t->xstart[p]*kk, t->kH, t->kW, t->dH, t->dW);
+        continue;
+      }
+      u = THAlloc(sizeof(real)*kk*npix);
+      nn_(ConvMapTable_unfold)(t, u, x_data + p*t->xh*t->xw, y0, n);
+      THBlas_(gemm)('n', 'n', npix, cnt, kk, 1, u, npix, packed + t->xstart[p]*kk, kk,
+                    0, cols + t->xstart[p]*npix, npix);
+      THFree(u);
+    }
+
+#pragma omp parallel for private(q)
+    for(q = 0; q < t->ny; q++)
+    {
+      real *dst = y_data + q*t->yh*t->yw + y0*t->yw;
+      long c;
+      for(c = t->ystart[q]; c < t->ystart[q+1]; c++)
+        THVector_(add)(dst, cols + t->rank[t->yconn[c]]*npix, 1, npix);
+    }
+  }
+
+  THFree(cols);
+  THFree(packed);
+}
+
+/* X[p] += fullConv(Y[q], kernel), for every connection p -> q */
+static void nn_(ConvMapTable_fullConv)(nn_ConvMapTable *t, real *x_data, real *y_data, real *weight)
+{
+  long kk = t->kH*t->kW;
+  long band = nn_ConvMapTable_band(t, (nn_ConvMapTable_fanout(t)+kk)*t->yw);
+  real *packed = nn_(ConvMapTable_packWeight)(t, weight);
+  long y0, p;
+
+  for(y0 = 0; y0 < t->yh; y0 += band)
+  {
+    long n = THMin(band, t->yh-y0);
+    long npix = n*t->yw;
+
+#pragma omp parallel for private(p)
+    for(p = 0; p < t->nx; p++)
+    {
+      long cnt = t->xstart[p+1]-t->xstart[p];
+      real *g, *u;
+      if(cnt == 0)
+        continue;
+      if(cnt == 1 && nn_ConvMapTable_fits(t))
+      {
+        /* nothing to share: direct full convolution */
+        THTensor_(fullConv2Dptr)(x_data + p*t->xh*t->xw + y0*t->dH*t->xw, 1,
+                                 y_data + t->yplane[t->xconn[t->xstart[p]]]*t->yh*t->yw + y0*t->yw, n, t->yw,
+                                 packed + t->xstart[p]*kk, t->kH, t->kW, t->dH, t->dW);
+        continue;
+      }
+      g = THAlloc(sizeof(real)*cnt*npix);
+      u = THAlloc(sizeof(real)*kk*npix);
+      nn_(ConvMapTable_gather)(t, g, y_data, p, y0, n);
+      THBlas_(gemm)('n', 't', npix, kk, cnt, 1, g, npix, packed + t->xstart[p]*kk, kk,
+                    0, u, npix);
+      nn_(ConvMapTable_fold)(t, x_data + p*t->xh*t->xw, u, y0, n);
+      THFree(g);
+      THFree(u);
+    }
+  }
+
+  THFree(packed);
+}
+
+/* gradWeight[k] += scale * validXCorr(X[p], Y[q]), for every connection p -> q */
+static void nn_(ConvMapTable_accGradWeight)(nn_ConvMapTable *t, real *gradWeight, real scale,
+                                            real *x_data, real *y_data)
+{
+  long kk = t->kH*t->kW;
+  long band = nn_ConvMapTable_band(t, (nn_ConvMapTable_fanout(t)+kk)*t->yw);
+  real *packed = THAlloc(sizeof(real)*THMax(t->nconn*kk, 1));
+  long y0, p, k;
+
+  for(k = 0; k < t->nconn*kk; k++)
+    packed[k] = 0;
+
+  for(y0 = 0; y0 < t->yh; y0 += band)
+  {
+    long n = THMin(band, t->yh-y0);
+    long npix = n*t->yw;
+
+#pragma omp parallel for private(p)
+    for(p = 0; p < t->nx; p++)
+    {
+      long cnt = t->xstart[p+1]-t->xstart[p];
+      real *g, *u;
+      if(cnt == 0)
+        continue;
+      if(cnt == 1 && nn_ConvMapTable_fits(t))
+      {
+        /* nothing to share: direct correlation */
+        THTensor_(validXCorr2DRevptr)(packed + t->xstart[p]*kk, 1,
+                                      x_data + p*t->xh*t->xw + y0*t->dH*t->xw, (n-1)*t->dH+t->kH, t->xw,
+                                      y_data + t->yplane[t->xconn[t->xstart[p]]]*t->yh*t->yw + y0*t->yw, n, t->yw,
+                                      t->dH, t->dW);
+        continue;
+      }
+      g = THAlloc(sizeof(real)*cnt*npix);
+      u = THAlloc(sizeof(real)*kk*npix);
+      nn_(ConvMapTable_unfold)(t, u, x_data + p*t->xh*t->xw, y0, n);
+      nn_(ConvMapTable_gather)(t, g, y_data, p, y0, n);
+      THBlas_(gemm)('t', 'n', kk, cnt, npix, 1, u, npix, g, npix,
+                    1, packed + t->xstart[p]*kk, kk);
+      THFree(g);
+      THFree(u);
+    }
+  }
+
+  for(k = 0; k < t->nconn; k++)
+    THVector_(add)(gradWeight + k*kk, packed + t->rank[k]*kk, scale, kk);
+  THFree(packed);
+}
+
 static int nn_(SpatialConvolutionMap_updateOutput)(lua_State *L)
 {
- THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
+  THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   int kW = luaT_getfieldcheckint(L, 1, "kW");
   int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
@@ -21,76 +307,58 @@ static int nn_(SpatialConvolutionMap_updateOutput)(lua_State *L)
   real *output_data;
   real *weight_data;
   real *bias_data;
-  real *connTable_data;
 
   long input_h;
   long input_w;
   long output_h;
   long output_w;
-  long weight_h;
-  long weight_w;
 
   long p;
-  int nweight;
-
-
+  nn_ConvMapTable table;
 
   luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
   luaL_argcheck(L, input->size[0] >= nInputPlane, 2, "invalid number of input planes");
   luaL_argcheck(L, input->size[2] >= kW && input->size[1] >= kH, 2, "input image smaller than kernel size");
 
-  THTensor_(resize3d)(output, nOutputPlane,
-                      (input->size[1] - kH) / dH + 1,
-                      (input->size[2] - kW) / dW + 1);
+  /* and dims */
+  input_h = input->size[1];
+  input_w = input->size[2];
+  output_h = (input_h - kH) / dH + 1;
+  output_w = (input_w - kW) / dW + 1;
+
+  nn_(ConvMapTable_init)(L, &table, connTable, 0, nInputPlane, nOutputPlane,
+                         input_h, input_w, output_h, output_w, kH, kW, dH, dW);
+
+  THTensor_(resize3d)(output, nOutputPlane, output_h, output_w);
 
   /* contiguous */
   input = THTensor_(newContiguous)(input);
   output = THTensor_(newContiguous)(output);
+  weight = THTensor_(newContiguous)(weight);
 
   /* get raw pointers */
   input_data = THTensor_(data)(input);
   output_data = THTensor_(data)(output);
   weight_data = THTensor_(data)(weight);
   bias_data = THTensor_(data)(bias);
-  connTable_data = THTensor_(data)(connTable);
-
-  /* and dims */
-  input_h = input->size[1];
-  input_w = input->size[2];
-  output_h = output->size[1];
-  output_w = output->size[2];
-  weight_h = weight->size[1];
-  weight_w = weight->size[2];
 
+  /* add bias */
 #pragma omp parallel for private(p)
   for (p = 0; p < nOutputPlane; p++) {
-    /* add bias */
     real *ptr_output = output_data + p*output_w*output_h;
-    long j,k;
+    long j;
     for(j = 0; j < output_h*output_w; j++)
       ptr_output[j] = bias_data[p];
-
-    /* convolve all maps */
-    nweight = connTable->size[0];
-    for (k = 0; k < nweight; k++) {
-      /* get offsets for input/output */
-      int o = (int)connTable_data[k*2+1]-1;
-      int i = (int)connTable_data[k*2+0]-1;
-
-      if (o == p)
-        {
-          THTensor_(validXCorr2Dptr)(output_data + o*output_w*output_h,
-                                  1.0,
-                                  input_data + i*input_w*input_h, input_h, input_w,
-                                  weight_data + k*weight_w*weight_h, weight_h, weight_w,
-                                  dH, dW);
-        }
-    }
   }
 
+  /* convolve all maps */
+  nn_(ConvMapTable_xcorr)(&table, output_data, input_data, weight_data);
+
   /* clean up */
+  nn_ConvMapTable_free(&table);
   THTensor_(free)(input);
   THTensor_(free)(output);
+  THTensor_(free)(weight);
 
   return 1;
 }
@@ -99,75 +367,45 @@ static int nn_(SpatialConvolutionMap_updateGradInput)(lua_State *L)
 {
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  int kW = luaT_getfieldcheckint(L, 1, "kW");
+  int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
   int nInputPlane = luaT_getfieldcheckint(L, 1, "nInputPlane");
+  int nOutputPlane = luaT_getfieldcheckint(L, 1, "nOutputPlane");
 
   THTensor *connTable = luaT_getfieldcheckudata(L, 1, "connTable", torch_Tensor);
   THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor *gradInput = luaT_getfieldcheckudata(L, 1, "gradInput", torch_Tensor);
 
-  real *gradInput_data;
-  real *gradOutput_data;
-  real *weight_data;
-  real *connTable_data;
+  nn_ConvMapTable table;
 
-  long input_h;
-  long input_w;
-  long output_h;
-  long output_w;
-  long weight_h;
-  long weight_w;
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, gradOutput->nDimension == 3 && gradOutput->size[0] >= nOutputPlane, 3,
+                "invalid gradOutput");
 
-  long p;
+  nn_(ConvMapTable_init)(L, &table, connTable, 0, nInputPlane, nOutputPlane,
+                         input->size[1], input->size[2], gradOutput->size[1], gradOutput->size[2],
+                         kH, kW, dH, dW);
+
+  /* Resize/Zero */
+  THTensor_(resizeAs)(gradInput, input);
 
   /* contiguous */
   gradInput = THTensor_(newContiguous)(gradInput);
   gradOutput = THTensor_(newContiguous)(gradOutput);
-
-  /* Resize/Zero */
-  THTensor_(resizeAs)(gradInput, input);
+  weight = THTensor_(newContiguous)(weight);
   THTensor_(zero)(gradInput);
 
-  /* get raw pointers */
-  gradInput_data = THTensor_(data)(gradInput);
-  gradOutput_data = THTensor_(data)(gradOutput);
-  weight_data = THTensor_(data)(weight);
-  connTable_data = THTensor_(data)(connTable);
-
-  /* and dims */
-  input_h = input->size[1];
-  input_w = input->size[2];
-  output_h = gradOutput->size[1];
-  output_w = gradOutput->size[2];
-  weight_h = weight->size[1];
-  weight_w = weight->size[2];
-
-#pragma omp parallel for private(p)
-  for(p = 0; p < nInputPlane; p++)
-    {
-      long k;
-      /* backward all */
-      int nkernel = connTable->size[0];
-      for(k = 0; k < nkernel; k++)
-        {
-          int o = (int)connTable_data[k*2+1]-1;
-          int i = (int)connTable_data[k*2+0]-1;
-          if (i == p)
-            {
-              /* gradient to input */
-              THTensor_(fullConv2Dptr)(gradInput_data + i*input_w*input_h,
-                                    1.0,
-                                    gradOutput_data + o*output_w*output_h,  output_h,  output_w,
-                                    weight_data + k*weight_w*weight_h, weight_h, weight_w,
-                                    dH, dW);
-            }
-        }
-    }
+  /* gradient to input */
+  nn_(ConvMapTable_fullConv)(&table, THTensor_(data)(gradInput), THTensor_(data)(gradOutput),
+                             THTensor_(data)(weight));
 
   /* clean up */
+  nn_ConvMapTable_free(&table);
   THTensor_(free)(gradInput);
   THTensor_(free)(gradOutput);
+  THTensor_(free)(weight);
 
   return 1;
 }
@@ -176,49 +414,46 @@ static int nn_(SpatialConvolutionMap_accGradParameters)(lua_State *L)
 {
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  int kW = luaT_getfieldcheckint(L, 1, "kW");
+  int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
+  int nInputPlane = luaT_getfieldcheckint(L, 1, "nInputPlane");
   int nOutputPlane = luaT_getfieldcheckint(L, 1, "nOutputPlane");
   real scale = luaL_optnumber(L, 4, 1);
 
   THTensor *connTable = luaT_getfieldcheckudata(L, 1, "connTable", torch_Tensor);
-  THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor *gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
   THTensor *gradBias = luaT_getfieldcheckudata(L, 1, "gradBias", torch_Tensor);
 
-  real *input_data;
   real *gradOutput_data;
-  real *gradWeight_data;
   real *gradBias_data;
 
   /* and dims */
-  long input_h;
-  long input_w;
   long output_h;
   long output_w;
-  long weight_h;
-  long weight_w;
 
   long k;
-  int nkernel;
+  nn_ConvMapTable table;
+
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, gradOutput->nDimension == 3 && gradOutput->size[0] >= nOutputPlane, 3,
+                "invalid gradOutput");
+  luaL_argcheck(L, THTensor_(isContiguous)(gradWeight), 1, "gradWeight must be contiguous");
+
+  nn_(ConvMapTable_init)(L, &table, connTable, 0, nInputPlane, nOutputPlane,
+                         input->size[1], input->size[2], gradOutput->size[1], gradOutput->size[2],
+                         kH, kW, dH, dW);
 
   /* contiguous */
   input = THTensor_(newContiguous)(input);
   gradOutput = THTensor_(newContiguous)(gradOutput);
 
   /* get raw pointers */
-  input_data = THTensor_(data)(input);
   gradOutput_data = THTensor_(data)(gradOutput);
-  gradWeight_data = THTensor_(data)(gradWeight);
   gradBias_data = THTensor_(data)(gradBias);
-
-  /* and dims */
-  input_h = input->size[1];
-  input_w = input->size[2];
   output_h = gradOutput->size[1];
   output_w = gradOutput->size[2];
-  weight_h = weight->size[1];
-  weight_w = weight->size[2];
 
   /* gradients wrt bias */
 #pragma omp parallel for private(k)
@@ -230,22 +465,11 @@ static int nn_(SpatialConvolutionMap_accGradParameters)(lua_State *L)
   }
 
   /* gradients wrt weight */
-  nkernel = connTable->size[0];
-#pragma omp parallel for private(k)
-  for(k = 0; k < nkernel; k++)
-    {
-      int o = (int)THTensor_(get2d)(connTable,k,1)-1;
-      int i = (int)THTensor_(get2d)(connTable,k,0)-1;
-
-      /* gradient to kernel */
-      THTensor_(validXCorr2DRevptr)(gradWeight_data + k*weight_w*weight_h,
-                                 scale,
-                                 input_data + i*input_w*input_h, input_h, input_w,
-                                 gradOutput_data + o*output_w*output_h, output_h, output_w,
-                                 dH, dW);
-    }
+  nn_(ConvMapTable_accGradWeight)(&table, THTensor_(data)(gradWeight), scale,
+                                  THTensor_(data)(input), gradOutput_data);
 
   /* clean up */
+  nn_ConvMapTable_free(&table);
   THTensor_(free)(input);
   THTensor_(free)(gradOutput);
   return 0;
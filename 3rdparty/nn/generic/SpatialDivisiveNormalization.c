@@ -0,0 +1,64 @@
+#ifndef TH_GENERIC_FILE
+#define TH_GENERIC_FILE "generic/SpatialDivisiveNormalization.c"
+#else
+
+static int nn_(SpatialDivisiveNormalization_updateOutput)(lua_State *L)
+{
+  THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
+  real threshold = luaT_getfieldchecknumber(L, 1, "threshold");
+  real thresval = luaT_getfieldchecknumber(L, 1, "thresval");
+  THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
+  THTensor *out;
+  real *input_data, *output_data, *std, *cv, *ch;
+  long nplanes, h, w, i, y;
+
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+
+  input = THTensor_(newContiguous)(input);
+  nplanes = input->size[0];
+  h = input->size[1];
+  w = input->size[2];
+
+  THTensor_(resizeAs)(output, input);
+  out = THTensor_(newContiguous)(output);
+  input_data = THTensor_(data)(input);
+  output_data = THTensor_(data)(out);
+
+  nn_(SpatialNormalization_coefficients)(L, h, w, &cv, &ch);
+  std = nn_(SpatialNormalization_localMean)(L, input_data, nplanes, h, w, 1);
+
+  /* same order of operations as the module graph: the border correction
+     applies to the standard deviation, then the threshold */
+#pragma omp parallel for private(y)
+  for(y = 0; y < h; y++)
+  {
+    long x;
+    for(x = 0; x < w; x++)
+    {
+      real s = sqrt(std[y*w+x]) / (cv[y]*ch[x]);
+      std[y*w+x] = (s > threshold) ? s : thresval;
+    }
+  }
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < nplanes*h*w; i++)
+    output_data[i] = input_data[i] / std[i % (h*w)];
+
+  THTensor_(free)(input);
+  THTensor_(freeCopyTo)(out, output);
+  return 1;
+}
+
+static const struct luaL_Reg nn_(SpatialDivisiveNormalization__) [] = {
+  {"SpatialDivisiveNormalization_updateOutput", nn_(SpatialDivisiveNormalization_updateOutput)},
+  {NULL, NULL}
+};
+
+static void nn_(SpatialDivisiveNormalization_init)(lua_State *L)
+{
+  luaT_pushmetatable(L, torch_Tensor);
+  luaT_registeratname(L, nn_(SpatialDivisiveNormalization__), "nn");
+  lua_pop(L,1);
+}
+
+#endif
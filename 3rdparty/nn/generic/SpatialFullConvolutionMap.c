@@ -12,7 +12,6 @@ static int nn_(SpatialFullConvolutionMap_updateOutput)(lua_State *L)
   int nInputPlane = luaT_getfieldcheckint(L, 1, "nInputPlane");
   int nOutputPlane = luaT_getfieldcheckint(L, 1, "nOutputPlane");
 
-
   THTensor *connTable = luaT_getfieldcheckudata(L, 1, "connTable", torch_Tensor);
   THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor *bias = luaT_getfieldcheckudata(L, 1, "bias", torch_Tensor);
@@ -20,78 +19,58 @@ static int nn_(SpatialFullConvolutionMap_updateOutput)(lua_State *L)
 
   real *input_data;
   real *output_data;
-  real *weight_data;
   real *bias_data;
-  real *connTable_data;
 
   long input_h;
   long input_w;
   long output_h;
   long output_w;
-  long weight_h;
-  long weight_w;
 
   long p;
+  nn_ConvMapTable table;
 
   luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
   luaL_argcheck(L, input->size[0] >= nInputPlane, 2, "invalid number of input planes");
 
+  /* and dims */
+  input_h = input->size[1];
+  input_w = input->size[2];
+  output_h = (input_h - 1) * dH + kH;
+  output_w = (input_w - 1) * dW + kW;
 
-  THTensor_(resize3d)(output, nOutputPlane,
-                      (input->size[1] - 1) * dH + kH,
-                      (input->size[2] - 1) * dW + kW);
+  /* the output is the large map of the table */
+  nn_(ConvMapTable_init)(L, &table, connTable, 1, nOutputPlane, nInputPlane,
+                         output_h, output_w, input_h, input_w, kH, kW, dH, dW);
+
+  THTensor_(resize3d)(output, nOutputPlane, output_h, output_w);
 
   /* contiguous */
   input = THTensor_(newContiguous)(input);
   output = THTensor_(newContiguous)(output);
+  weight = THTensor_(newContiguous)(weight);
 
   /* get raw pointers */
   input_data = THTensor_(data)(input);
   output_data = THTensor_(data)(output);
-  weight_data = THTensor_(data)(weight);
   bias_data = THTensor_(data)(bias);
-  connTable_data = THTensor_(data)(connTable);
-
-  /* and dims */
-  input_h = input->size[1];
-  input_w = input->size[2];
-  output_h = output->size[1];
-  output_w = output->size[2];
-  weight_h = weight->size[1];
-  weight_w = weight->size[2];
 
+  /* add bias */
 #pragma omp parallel for private(p)
   for (p = 0; p < nOutputPlane; p++) {
-    /* add bias */
     real *ptr_output = output_data + p*output_w*output_h;
     long j;
-    int nweight;
-    long k;
-
     for(j = 0; j < output_h*output_w; j++)
       ptr_output[j] = bias_data[p];
-
-    /* convolve all maps */
-    nweight = connTable->size[0];
-    for (k = 0; k < nweight; k++) {
-      /* get offsets for input/output */
-      int o = (int)connTable_data[k*2+1]-1;
-      int i = (int)connTable_data[k*2+0]-1;
-
-      if (o == p)
-        {
-          THTensor_(fullConv2Dptr)(output_data + o*output_w*output_h,
-				   1.0,
-				   input_data + i*input_w*input_h, input_h, input_w,
-				   weight_data + k*weight_w*weight_h, weight_h, weight_w,
-				   dH, dW);
-        }
-    }
   }
 
+  /* convolve all maps */
+  nn_(ConvMapTable_fullConv)(&table, output_data, input_data, THTensor_(data)(weight));
+
   /* clean up */
+  nn_ConvMapTable_free(&table);
   THTensor_(free)(input);
   THTensor_(free)(output);
+  THTensor_(free)(weight);
 
   return 1;
 }
@@ -100,75 +79,45 @@ static int nn_(SpatialFullConvolutionMap_updateGradInput)(lua_State *L)
 {
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  int kW = luaT_getfieldcheckint(L, 1, "kW");
+  int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
   int nInputPlane = luaT_getfieldcheckint(L, 1, "nInputPlane");
+  int nOutputPlane = luaT_getfieldcheckint(L, 1, "nOutputPlane");
 
   THTensor *connTable = luaT_getfieldcheckudata(L, 1, "connTable", torch_Tensor);
   THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor *gradInput = luaT_getfieldcheckudata(L, 1, "gradInput", torch_Tensor);
 
-  real *gradInput_data;
-  real *gradOutput_data;
-  real *weight_data;
-  real *connTable_data;
+  nn_ConvMapTable table;
 
-  long input_h;
-  long input_w;
-  long output_h;
-  long output_w;
-  long weight_h;
-  long weight_w;
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, gradOutput->nDimension == 3 && gradOutput->size[0] >= nOutputPlane, 3,
+                "invalid gradOutput");
 
-  long p;
+  nn_(ConvMapTable_init)(L, &table, connTable, 1, nOutputPlane, nInputPlane,
+                         gradOutput->size[1], gradOutput->size[2], input->size[1], input->size[2],
+                         kH, kW, dH, dW);
+
+  /* Resize/Zero */
+  THTensor_(resizeAs)(gradInput, input);
 
   /* contiguous */
   gradInput = THTensor_(newContiguous)(gradInput);
   gradOutput = THTensor_(newContiguous)(gradOutput);
-
-  /* Resize/Zero */
-  THTensor_(resizeAs)(gradInput, input);
+  weight = THTensor_(newContiguous)(weight);
   THTensor_(zero)(gradInput);
 
-  /* get raw pointers */
-  gradInput_data = THTensor_(data)(gradInput);
-  gradOutput_data = THTensor_(data)(gradOutput);
-  weight_data = THTensor_(data)(weight);
-  connTable_data = THTensor_(data)(connTable);
-
-  /* and dims */
-  input_h = input->size[1];
-  input_w = input->size[2];
-  output_h = gradOutput->size[1];
-  output_w = gradOutput->size[2];
-  weight_h = weight->size[1];
-  weight_w = weight->size[2];
-
-#pragma omp parallel for private(p)
-  for(p = 0; p < nInputPlane; p++)
-    {
-      long k;
-      /* backward all */
-      int nkernel = connTable->size[0];
-      for(k = 0; k < nkernel; k++)
-        {
-          int o = (int)connTable_data[k*2+1]-1;
-          int i = (int)connTable_data[k*2+0]-1;
-          if (i == p)
-            {
-              /* gradient to input */
-              THTensor_(validXCorr2Dptr)(gradInput_data + i*input_w*input_h,
-					 1.0,
-					 gradOutput_data + o*output_w*output_h,  output_h,  output_w,
-					 weight_data + k*weight_w*weight_h, weight_h, weight_w,
-					 dH, dW);
-            }
-        }
-    }
+  /* gradient to input */
+  nn_(ConvMapTable_xcorr)(&table, THTensor_(data)(gradInput), THTensor_(data)(gradOutput),
+                          THTensor_(data)(weight));
 
   /* clean up */
+  nn_ConvMapTable_free(&table);
   THTensor_(free)(gradInput);
   THTensor_(free)(gradOutput);
+  THTensor_(free)(weight);
 
   return 1;
 }
@@ -177,48 +126,46 @@ static int nn_(SpatialFullConvolutionMap_accGradParameters)(lua_State *L)
 {
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  int kW = luaT_getfieldcheckint(L, 1, "kW");
+  int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
+  int nInputPlane = luaT_getfieldcheckint(L, 1, "nInputPlane");
   int nOutputPlane = luaT_getfieldcheckint(L, 1, "nOutputPlane");
   real scale = luaL_optnumber(L, 4, 1);
 
   THTensor *connTable = luaT_getfieldcheckudata(L, 1, "connTable", torch_Tensor);
-  THTensor *weight = luaT_getfieldcheckudata(L, 1, "weight", torch_Tensor);
   THTensor *gradWeight = luaT_getfieldcheckudata(L, 1, "gradWeight", torch_Tensor);
   THTensor *gradBias = luaT_getfieldcheckudata(L, 1, "gradBias", torch_Tensor);
 
-  real *input_data;
   real *gradOutput_data;
-  real *gradWeight_data;
   real *gradBias_data;
 
-  long input_h;
-  long input_w;
+  /* and dims */
   long output_h;
   long output_w;
-  long weight_h;
-  long weight_w;
 
   long k;
-  int nkernel;
+  nn_ConvMapTable table;
+
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, gradOutput->nDimension == 3 && gradOutput->size[0] >= nOutputPlane, 3,
+                "invalid gradOutput");
+  luaL_argcheck(L, THTensor_(isContiguous)(gradWeight), 1, "gradWeight must be contiguous");
+
+  nn_(ConvMapTable_init)(L, &table, connTable, 1, nOutputPlane, nInputPlane,
+                         gradOutput->size[1], gradOutput->size[2], input->size[1], input->size[2],
+                         kH, kW, dH, dW);
 
   /* contiguous */
   input = THTensor_(newContiguous)(input);
   gradOutput = THTensor_(newContiguous)(gradOutput);
 
   /* get raw pointers */
-  input_data = THTensor_(data)(input);
   gradOutput_data = THTensor_(data)(gradOutput);
-  gradWeight_data = THTensor_(data)(gradWeight);
   gradBias_data = THTensor_(data)(gradBias);
-
-  /* and dims */
-  input_h = input->size[1];
-  input_w = input->size[2];
   output_h = gradOutput->size[1];
   output_w = gradOutput->size[2];
-  weight_h = weight->size[1];
-  weight_w = weight->size[2];
 
   /* gradients wrt bias */
 #pragma omp parallel for private(k)
@@ -230,22 +177,11 @@ static int nn_(SpatialFullConvolutionMap_accGradParameters)(lua_State *L)
   }
 
   /* gradients wrt weight */
-  nkernel = connTable->size[0];
-#pragma omp parallel for private(k)
-  for(k = 0; k < nkernel; k++)
-    {
-      int o = (int)THTensor_(get2d)(connTable,k,1)-1;
-      int i = (int)THTensor_(get2d)(connTable,k,0)-1;
-
-      /* gradient to kernel */
-      THTensor_(validXCorr2DRevptr)(gradWeight_data + k*weight_w*weight_h,
-                                 scale,
-                                 gradOutput_data + o*output_w*output_h, output_h, output_w,
-                                 input_data + i*input_w*input_h, input_h, input_w,
-                                 dH, dW);
-    }
+  nn_(ConvMapTable_accGradWeight)(&table, THTensor_(data)(gradWeight), scale,
+                                  gradOutput_data, THTensor_(data)(input));
 
   /* clean up */
+  nn_ConvMapTable_free(&table);
   THTensor_(free)(input);
   THTensor_(free)(gradOutput);
   return 0;
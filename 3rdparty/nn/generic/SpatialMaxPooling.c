@@ -3,55 +3,98 @@
 #else
 
 static void nn_(SpatialMaxPooling_updateOutput_frame)(real *input_p, real *output_p,
-                                                      real *indx_p, real *indy_p,
+                                                      unsigned char *ind8_p, int *ind32_p,
                                                       long nslices,
                                                       long iwidth, long iheight,
                                                       long owidth, long oheight,
                                                       int kW, int kH, int dW, int dH)
 {
+  int argmax = (ind8_p || ind32_p);
   long k;
 #pragma omp parallel for private(k)
   for (k = 0; k < nslices; k++)
   {
-    /* loop over output */
-    long i, j;
+    /* without argmax, each output row is done in two steps: a max over the
+       kH input rows, column by column, which runs over contiguous memory,
+       then a max over the kW columns of each window */
+    real *colmax = (argmax ? NULL : THAlloc(sizeof(real)*iwidth));
+    long i, j, x;
+    int y;
+
     for(i = 0; i < oheight; i++)
     {
-      for(j = 0; j < owidth; j++)
+      real *ip = input_p + k*iwidth*iheight + i*dH*iwidth;
+      real *op = output_p + k*owidth*oheight + i*owidth;
+      long o = k*owidth*oheight + i*owidth;
+
+      if(argmax && kW == 2 && kH == 2)
       {
-        /* local pointers */
-        real *ip = input_p   + k*iwidth*iheight + i*iwidth*dH + j*dW;
-        real *op = output_p  + k*owidth*oheight + i*owidth + j;
-        real *indyp = indy_p + k*owidth*oheight + i*owidth + j;
-        real *indxp = indx_p + k*owidth*oheight + i*owidth + j;
-
-        /* compute local max: */
-        long maxindex = -1;
-        real maxval = -THInf;
-        long tcntr = 0;
-        int x,y;
-        for(y = 0; y < kH; y++)
+        for(j = 0; j < owidth; j++)
         {
-          for(x = 0; x < kW; x++)
+          real *w = ip + j*dW;
+          real m0 = w[0], m1 = w[iwidth];
+          int i0 = 0, i1 = 2;
+          if(w[1] > m0) { m0 = w[1]; i0 = 1; }
+          if(w[iwidth+1] > m1) { m1 = w[iwidth+1]; i1 = 3; }
+          if(m1 > m0) { m0 = m1; i0 = i1; }
+          op[j] = m0;
+          nn_poolingSetIndex(ind8_p, ind32_p, o+j, i0);
+        }
+      }
+      else if(argmax)
+      {
+        for(j = 0; j < owidth; j++)
+        {
+          /* first max in row-major window order */
+          real maxval = -THInf;
+          long maxindex = 0, index = 0;
+          for(y = 0; y < kH; y++)
           {
-            real val = *(ip + y*iwidth + x);
-            if (val > maxval)
+            real *row = ip + y*iwidth + j*dW;
+            for(x = 0; x < kW; x++, index++)
             {
-              maxval = val;
-              maxindex = tcntr;
+              if(row[x] > maxval)
+              {
+                maxval = row[x];
+                maxindex = index;
+              }
             }
-            tcntr++;
           }
+          op[j] = maxval;
+          nn_poolingSetIndex(ind8_p, ind32_p, o+j, maxindex);
+        }
+      }
+      else
+      {
+        for(x = 0; x < iwidth; x++)
+          colmax[x] = ip[x];
+        for(y = 1; y < kH; y++)
+        {
+          real *row = ip + y*iwidth;
+          for(x = 0; x < iwidth; x++)
+            colmax[x] = (row[x] > colmax[x]) ? row[x] : colmax[x];
         }
 
-        /* set output to local max */
-        *op = maxval;
-
-        /* store location of max (x,y) */
-        *indyp = (int)(maxindex / kW)+1;
-        *indxp = (maxindex % kW) +1;
+        if(kW == 2 && dW == 2)
+        {
+          for(j = 0; j < owidth; j++)
+            op[j] = (colmax[2*j+1] > colmax[2*j]) ? colmax[2*j+1] : colmax[2*j];
+        }
+        else
+        {
+          for(j = 0; j < owidth; j++)
+          {
+            real *c = colmax + j*dW;
+            real maxval = c[0];
+            for(x = 1; x < kW; x++)
+              maxval = (c[x] > maxval) ? c[x] : maxval;
+            op[j] = maxval;
+          }
+        }
       }
     }
+
+    THFree(colmax);
   }
 }
 
@@ -62,7 +105,6 @@ static int nn_(SpatialMaxPooling_updateOutput)(lua_State *L)
   int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
-  THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
   THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
   int dimw = 2;
   int dimh = 1;
@@ -74,8 +116,8 @@ static int nn_(SpatialMaxPooling_updateOutput)(lua_State *L)
   long owidth;
   real *input_data;
   real *output_data;
-  real *indices_data;
-
+  unsigned char *ind8_data;
+  int *ind32_data;
 
   luaL_argcheck(L, input->nDimension == 3 || input->nDimension == 4 , 2, "3D or 4D (batch mode) tensor expected");
 
@@ -101,15 +143,14 @@ static int nn_(SpatialMaxPooling_updateOutput)(lua_State *L)
   if (input->nDimension == 3)
   {
     THTensor_(resize3d)(output, nslices, oheight, owidth);
-    /* indices will contain i,j locations for each output point */
-    THTensor_(resize4d)(indices, 2, nslices, oheight, owidth);
+    /* indices will contain the window offset of each output point */
+    nn_poolingIndices(L, 3, output->size, 1, &ind8_data, &ind32_data);
 
     input_data = THTensor_(data)(input);
     output_data = THTensor_(data)(output);
-    indices_data = THTensor_(data)(indices);
 
     nn_(SpatialMaxPooling_updateOutput_frame)(input_data, output_data,
-                                              indices_data+nslices*owidth*oheight, indices_data,
+                                              ind8_data, ind32_data,
                                               nslices,
                                               iwidth, iheight,
                                               owidth, oheight,
@@ -120,18 +161,19 @@ static int nn_(SpatialMaxPooling_updateOutput)(lua_State *L)
     long p;
 
     THTensor_(resize4d)(output, nbatch, nslices, oheight, owidth);
-    /* indices will contain i,j locations for each output point */
-    THTensor_(resize5d)(indices, 2, nbatch, nslices, oheight, owidth);
+    /* indices will contain the window offset of each output point */
+    nn_poolingIndices(L, 4, output->size, 1, &ind8_data, &ind32_data);
 
     input_data = THTensor_(data)(input);
     output_data = THTensor_(data)(output);
-    indices_data = THTensor_(data)(indices);
 
 #pragma omp parallel for private(p)
     for (p = 0; p < nbatch; p++)
     {
-      nn_(SpatialMaxPooling_updateOutput_frame)(input_data+p*nslices*iwidth*iheight, output_data+p*nslices*owidth*oheight,
-                                                indices_data+(p+nbatch)*nslices*owidth*oheight, indices_data+p*nslices*owidth*oheight,
+      long off = p*nslices*owidth*oheight;
+      nn_(SpatialMaxPooling_updateOutput_frame)(input_data+p*nslices*iwidth*iheight, output_data+off,
+                                                ind8_data ? ind8_data+off : NULL,
+                                                ind32_data ? ind32_data+off : NULL,
                                                 nslices,
                                                 iwidth, iheight,
                                                 owidth, oheight,
@@ -145,11 +187,11 @@ static int nn_(SpatialMaxPooling_updateOutput)(lua_State *L)
 }
 
 static void nn_(SpatialMaxPooling_updateGradInput_frame)(real *gradInput_p, real *gradOutput_p,
-                                                         real *indx_p, real *indy_p,
+                                                         unsigned char *ind8_p, int *ind32_p,
                                                          long nslices,
                                                          long iwidth, long iheight,
                                                          long owidth, long oheight,
-                                                         int dW, int dH)
+                                                         int kW, int dW, int dH)
 {
   long k;
 #pragma omp parallel for private(k)
@@ -157,8 +199,7 @@ static void nn_(SpatialMaxPooling_updateGradInput_frame)(real *gradInput_p, real
   {
     real *gradInput_p_k = gradInput_p + k*iwidth*iheight;
     real *gradOutput_p_k = gradOutput_p + k*owidth*oheight;
-    real *indx_p_k = indx_p + k*owidth*oheight;
-    real *indy_p_k = indy_p + k*owidth*oheight;
+    long o_k = k*owidth*oheight;
 
     /* calculate max points */
     long i, j;
@@ -167,8 +208,9 @@ static void nn_(SpatialMaxPooling_updateGradInput_frame)(real *gradInput_p, real
       for(j = 0; j < owidth; j++)
       {
         /* retrieve position of max */
-        long maxi = indy_p_k[i*owidth + j] - 1 + i*dH;
-        long maxj = indx_p_k[i*owidth + j] - 1 + j*dW;
+        long maxindex = nn_poolingGetIndex(ind8_p, ind32_p, o_k + i*owidth + j);
+        long maxi = maxindex / kW + i*dH;
+        long maxj = maxindex % kW + j*dW;
 
         /* update gradient */
         gradInput_p_k[maxi*iwidth + maxj] += gradOutput_p_k[i*owidth + j];
@@ -181,9 +223,9 @@ static int nn_(SpatialMaxPooling_updateGradInput)(lua_State *L)
 {
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  int kW = luaT_getfieldcheckint(L, 1, "kW");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
-  THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
   THTensor *gradInput = luaT_getfieldcheckudata(L, 1, "gradInput", torch_Tensor);
   int dimw = 2;
   int dimh = 1;
@@ -195,7 +237,8 @@ static int nn_(SpatialMaxPooling_updateGradInput)(lua_State *L)
   int owidth;
   real *gradInput_data;
   real *gradOutput_data;
-  real *indices_data;
+  unsigned char *ind8_data;
+  int *ind32_data;
 
   /* get contiguous gradOutput */
   gradOutput = THTensor_(newContiguous)(gradOutput);
@@ -220,17 +263,17 @@ static int nn_(SpatialMaxPooling_updateGradInput)(lua_State *L)
   /* get raw pointers */
   gradInput_data = THTensor_(data)(gradInput);
   gradOutput_data = THTensor_(data)(gradOutput);
-  indices_data = THTensor_(data)(indices);
+  nn_poolingIndices(L, gradOutput->nDimension, gradOutput->size, 0, &ind8_data, &ind32_data);
 
   /* backprop */
   if (input->nDimension == 3)
   {
     nn_(SpatialMaxPooling_updateGradInput_frame)(gradInput_data, gradOutput_data,
-                                                 indices_data+nslices*owidth*oheight, indices_data,
+                                                 ind8_data, ind32_data,
                                                  nslices,
                                                  iwidth, iheight,
                                                  owidth, oheight,
-                                                 dW, dH);
+                                                 kW, dW, dH);
   }
   else
   {
@@ -238,12 +281,14 @@ static int nn_(SpatialMaxPooling_updateGradInput)(lua_State *L)
 #pragma omp parallel for private(p)
     for (p = 0; p < nbatch; p++)
     {
-      nn_(SpatialMaxPooling_updateGradInput_frame)(gradInput_data+p*nslices*iwidth*iheight, gradOutput_data+p*nslices*owidth*oheight,
-                                                   indices_data+(p+nbatch)*nslices*owidth*oheight, indices_data+p*nslices*owidth*oheight,
+      long off = p*nslices*owidth*oheight;
+      nn_(SpatialMaxPooling_updateGradInput_frame)(gradInput_data+p*nslices*iwidth*iheight, gradOutput_data+off,
+                                                   ind8_data ? ind8_data+off : NULL,
+                                                   ind32_data ? ind32_data+off : NULL,
                                                    nslices,
                                                    iwidth, iheight,
                                                    owidth, oheight,
-                                                   dW, dH);
+                                                   kW, dW, dH);
     }
   }
 
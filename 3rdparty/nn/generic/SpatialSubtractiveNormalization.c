@@ -0,0 +1,237 @@
+#ifndef TH_GENERIC_FILE
+#define TH_GENERIC_FILE "generic/SpatialSubtractiveNormalization.c"
+#else
+
+/* shared by the subtractive and divisive normalizations: kernels are
+   separable (kv vertical, kh horizontal, each summing to one) */
+
+static int nn_(SpatialNormalization_isBox)(real *k, long n)
+{
+  long i;
+  for(i = 1; i < n; i++)
+    if(k[i] != k[0])
+      return 0;
+  return 1;
+}
+
+/* sum of the kernel weights that fall inside a signal of length n, for
+   each position: the zero-padded response to a constant input */
+static void nn_(SpatialNormalization_coverage)(real *c, long n, real *k, long nk)
+{
+  long i, t, p = nk/2;
+  for(i = 0; i < n; i++)
+  {
+    accreal sum = 0;
+    for(t = THMax(0, p-i); t < THMin(nk, n+p-i); t++)
+      sum += k[t];
+    c[i] = sum;
+  }
+}
+
+/* zero-padded, same-size correlation of an h x w plane; src and dst may
+   alias, tmp is h x w. Constant kernels are applied as running sums, so
+   their cost does not depend on the kernel size. */
+static void nn_(SpatialNormalization_blur)(real *dst, real *src, real *tmp, long h, long w,
+                                           real *kv, long nv, real *kh, long nh)
+{
+  long ph = nh/2, pv = nv/2;
+  int hbox = nn_(SpatialNormalization_isBox)(kh, nh);
+  long y;
+
+#pragma omp parallel for private(y)
+  for(y = 0; y < h; y++)
+  {
+    real *s = src + y*w;
+    real *d = tmp + y*w;
+    long x, t;
+    if(hbox)
+    {
+      accreal acc = 0;
+      for(x = 0; x <= THMin(ph, w-1); x++)
+        acc += s[x];
+      for(x = 0; x < w; x++)
+      {
+        d[x] = kh[0]*acc;
+        if(x+1+ph < w)
+          acc += s[x+1+ph];
+        if(x-ph >= 0)
+          acc -= s[x-ph];
+      }
+    }
+    else
+    {
+      for(x = 0; x < w; x++)
+      {
+        accreal acc = 0;
+        for(t = THMax(0, ph-x); t < THMin(nh, w+ph-x); t++)
+          acc += kh[t]*s[x+t-ph];
+        d[x] = acc;
+      }
+    }
+  }
+
+  if(nn_(SpatialNormalization_isBox)(kv, nv))
+  {
+    accreal *acc = THAlloc(sizeof(accreal)*w);
+    long x;
+    for(x = 0; x < w; x++)
+      acc[x] = 0;
+    for(y = 0; y <= THMin(pv, h-1); y++)
+      for(x = 0; x < w; x++)
+        acc[x] += tmp[y*w+x];
+    for(y = 0; y < h; y++)
+    {
+      real *d = dst + y*w;
+      for(x = 0; x < w; x++)
+        d[x] = kv[0]*acc[x];
+      if(y+1+pv < h)
+      {
+        real *s = tmp + (y+1+pv)*w;
+        for(x = 0; x < w; x++)
+          acc[x] += s[x];
+      }
+      if(y-pv >= 0)
+      {
+        real *s = tmp + (y-pv)*w;
+        for(x = 0; x < w; x++)
+          acc[x] -= s[x];
+      }
+    }
+    THFree(acc);
+  }
+  else
+  {
+#pragma omp parallel for private(y)
+    for(y = 0; y < h; y++)
+    {
+      real *d = dst + y*w;
+      long t0 = THMax(0, pv-y), t1 = THMin(nv, h+pv-y);
+      long x, t;
+      real *s = tmp + (y+t0-pv)*w;
+      for(x = 0; x < w; x++)
+        d[x] = kv[t0]*s[x];
+      for(t = t0+1; t < t1; t++)
+      {
+        s = tmp + (y+t-pv)*w;
+        for(x = 0; x < w; x++)
+          d[x] += kv[t]*s[x];
+      }
+    }
+  }
+}
+
+/* local average over space and planes of the input (or of its square),
+   before the border correction; returns the h x w plane */
+static real *nn_(SpatialNormalization_localMean)(lua_State *L, real *input, long nplanes, long h, long w,
+                                                 int square)
+{
+  THTensor *kernelv = luaT_getfieldcheckudata(L, 1, "kernelv", torch_Tensor);
+  THTensor *kernelh = luaT_getfieldcheckudata(L, 1, "kernelh", torch_Tensor);
+  THTensor *localmean = luaT_getfieldcheckudata(L, 1, "localmean", torch_Tensor);
+  THTensor *blurbuffer = luaT_getfieldcheckudata(L, 1, "blurbuffer", torch_Tensor);
+  real *mean, *tmp;
+  long i, hw = h*w;
+
+  THTensor_(resize2d)(localmean, h, w);
+  THTensor_(resize2d)(blurbuffer, h, w);
+  mean = THTensor_(data)(localmean);
+  tmp = THTensor_(data)(blurbuffer);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < hw; i++)
+  {
+    accreal sum = 0;
+    long p;
+    if(square)
+      for(p = 0; p < nplanes; p++)
+        sum += input[p*hw+i]*input[p*hw+i];
+    else
+      for(p = 0; p < nplanes; p++)
+        sum += input[p*hw+i];
+    mean[i] = sum/nplanes;
+  }
+
+  nn_(SpatialNormalization_blur)(mean, mean, tmp, h, w,
+                                 THTensor_(data)(kernelv), kernelv->size[0],
+                                 THTensor_(data)(kernelh), kernelh->size[0]);
+  return mean;
+}
+
+/* border coefficients only depend on the frame size: they are kept in
+   coefv/coefh and recomputed when it changes */
+static void nn_(SpatialNormalization_coefficients)(lua_State *L, long h, long w, real **cv, real **ch)
+{
+  THTensor *kernelv = luaT_getfieldcheckudata(L, 1, "kernelv", torch_Tensor);
+  THTensor *kernelh = luaT_getfieldcheckudata(L, 1, "kernelh", torch_Tensor);
+  THTensor *coefv = luaT_getfieldcheckudata(L, 1, "coefv", torch_Tensor);
+  THTensor *coefh = luaT_getfieldcheckudata(L, 1, "coefh", torch_Tensor);
+
+  if(coefv->nDimension != 1 || coefv->size[0] != h)
+  {
+    THTensor_(resize1d)(coefv, h);
+    nn_(SpatialNormalization_coverage)(THTensor_(data)(coefv), h,
+                                       THTensor_(data)(kernelv), kernelv->size[0]);
+  }
+  if(coefh->nDimension != 1 || coefh->size[0] != w)
+  {
+    THTensor_(resize1d)(coefh, w);
+    nn_(SpatialNormalization_coverage)(THTensor_(data)(coefh), w,
+                                       THTensor_(data)(kernelh), kernelh->size[0]);
+  }
+  *cv = THTensor_(data)(coefv);
+  *ch = THTensor_(data)(coefh);
+}
+
+static int nn_(SpatialSubtractiveNormalization_updateOutput)(lua_State *L)
+{
+  THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
+  THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
+  THTensor *out;
+  real *input_data, *output_data, *mean, *cv, *ch;
+  long nplanes, h, w, i, y;
+
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+
+  input = THTensor_(newContiguous)(input);
+  nplanes = input->size[0];
+  h = input->size[1];
+  w = input->size[2];
+
+  THTensor_(resizeAs)(output, input);
+  out = THTensor_(newContiguous)(output);
+  input_data = THTensor_(data)(input);
+  output_data = THTensor_(data)(out);
+
+  nn_(SpatialNormalization_coefficients)(L, h, w, &cv, &ch);
+  mean = nn_(SpatialNormalization_localMean)(L, input_data, nplanes, h, w, 0);
+
+#pragma omp parallel for private(y)
+  for(y = 0; y < h; y++)
+  {
+    long x;
+    for(x = 0; x < w; x++)
+      mean[y*w+x] /= cv[y]*ch[x];
+  }
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < nplanes*h*w; i++)
+    output_data[i] = input_data[i] - mean[i % (h*w)];
+
+  THTensor_(free)(input);
+  THTensor_(freeCopyTo)(out, output);
+  return 1;
+}
+
+static const struct luaL_Reg nn_(SpatialSubtractiveNormalization__) [] = {
+  {"SpatialSubtractiveNormalization_updateOutput", nn_(SpatialSubtractiveNormalization_updateOutput)},
+  {NULL, NULL}
+};
+
+static void nn_(SpatialSubtractiveNormalization_init)(lua_State *L)
+{
+  luaT_pushmetatable(L, torch_Tensor);
+  luaT_registeratname(L, nn_(SpatialSubtractiveNormalization__), "nn");
+  lua_pop(L,1);
+}
+
+#endif
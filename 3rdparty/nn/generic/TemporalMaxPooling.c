@@ -7,7 +7,6 @@ static int nn_(TemporalMaxPooling_updateOutput)(lua_State *L)
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   int kW = luaT_getfieldcheckint(L, 1, "kW");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
-  THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
   THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
 
   long niframe;
@@ -16,9 +15,10 @@ static int nn_(TemporalMaxPooling_updateOutput)(lua_State *L)
 
   real *input_data;
   real *output_data;
-  real *indices_data;
+  unsigned char *ind8_data;
+  int *ind32_data;
 
-  long t, y;
+  long t;
 
   luaL_argcheck(L, input->nDimension == 2, 2, "2D tensor expected");
   luaL_argcheck(L, input->size[0] >= kW, 2, "input sequence smaller than kernel size");
@@ -34,39 +34,50 @@ static int nn_(TemporalMaxPooling_updateOutput)(lua_State *L)
   /* resize output */
   THTensor_(resize2d)(output, noframe, framesize);
 
-  /* indices will contain index locations for each output point */
-  THTensor_(resize2d)(indices, noframe, framesize);
+  /* indices will contain the window offset of each output point */
+  nn_poolingIndices(L, 2, output->size, 1, &ind8_data, &ind32_data);
 
   /* get raw pointers */
   input_data = THTensor_(data)(input);
   output_data = THTensor_(data)(output);
-  indices_data = THTensor_(data)(indices);
 
+  /* frames are scanned whole, so the inner loops run over contiguous
+     features */
+#pragma omp parallel for private(t)
   for(t = 0; t < noframe; t++)
   {
     real *ip = input_data + t*framesize*dW;
     real *op = output_data + t*framesize;
-    real *xp = indices_data + t*framesize;
-#pragma omp parallel for private(y)
+    long x, y;
+
     for(y = 0; y < framesize; y++)
+      op[y] = -THInf;
+
+    if(ind8_data || ind32_data)
     {
-      /* compute local max: */
-      long maxindex = -1;
-      real maxval = -THInf;
-      long x;
+      for(y = 0; y < framesize; y++)
+        nn_poolingSetIndex(ind8_data, ind32_data, t*framesize+y, 0);
       for(x = 0; x < kW; x++)
       {
-        real val = ip[x*framesize+y];
-        if (val > maxval)
+        real *frame = ip + x*framesize;
+        for(y = 0; y < framesize; y++)
         {
-          maxval = val;
-          maxindex = x;
+          if(frame[y] > op[y])
+          {
+            op[y] = frame[y];
+            nn_poolingSetIndex(ind8_data, ind32_data, t*framesize+y, x);
+          }
         }
       }
-
-      /* set output to local max */
-      op[y] = maxval;
-      xp[y] = (real)maxindex;
+    }
+    else
+    {
+      for(x = 0; x < kW; x++)
+      {
+        real *frame = ip + x*framesize;
+        for(y = 0; y < framesize; y++)
+          op[y] = (frame[y] > op[y]) ? frame[y] : op[y];
+      }
     }
   }
 
@@ -81,7 +92,6 @@ static int nn_(TemporalMaxPooling_updateGradInput)(lua_State *L)
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
   int dW = luaT_getfieldcheckint(L, 1, "dW");
-  THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
   THTensor *gradInput = luaT_getfieldcheckudata(L, 1, "gradInput", torch_Tensor);
 
   int noframe;
@@ -89,7 +99,8 @@ static int nn_(TemporalMaxPooling_updateGradInput)(lua_State *L)
 
   real *gradInput_data;
   real *gradOutput_data;
-  real *indices_data;
+  unsigned char *ind8_data;
+  int *ind32_data;
 
   long t, y;
 
@@ -107,18 +118,17 @@ static int nn_(TemporalMaxPooling_updateGradInput)(lua_State *L)
   /* get raw pointers */
   gradInput_data = THTensor_(data)(gradInput);
   gradOutput_data = THTensor_(data)(gradOutput);
-  indices_data = THTensor_(data)(indices);
+  nn_poolingIndices(L, 2, gradOutput->size, 0, &ind8_data, &ind32_data);
 
   for(t = 0; t < noframe; t++)
   {
     real *gip = gradInput_data + t*framesize*dW;
     real *gop = gradOutput_data + t*framesize;
-    real *xp = indices_data + t*framesize;
 #pragma omp parallel for private(y)
     for(y = 0; y < framesize; y++)
     {
       /* compute local max: */
-      long maxindex = (long)xp[y];
+      long maxindex = nn_poolingGetIndex(ind8_data, ind32_data, t*framesize+y);
       gip[maxindex*framesize+y] += gop[y];
     }
   }
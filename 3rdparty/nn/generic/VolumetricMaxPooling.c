@@ -3,7 +3,7 @@
 #else
 
 static void nn_(VolumetricMaxPooling_updateOutput_frame)(real *input_p, real *output_p,
-							 real *indx_p, real *indy_p, real *indz_p,
+							 unsigned char *ind8_p, int *ind32_p,
 							 long nslices,
 							 long itime, long iwidth, long iheight,
 							 long otime, long owidth, long oheight,
@@ -23,41 +23,34 @@ static void nn_(VolumetricMaxPooling_updateOutput_frame)(real *input_p, real *ou
 	{
 	  /* local pointers */
 	  real *ip = input_p   + k*itime*iwidth*iheight + ti*iwidth*iheight*dT +  i*iwidth*dH + j*dW;
-	  real *op = output_p  + k*otime*owidth*oheight + ti*owidth*oheight + i*owidth + j;
-	  real *indzp = indz_p + k*otime*owidth*oheight + ti*owidth*oheight + i*owidth + j;
-	  real *indyp = indy_p + k*otime*owidth*oheight + ti*owidth*oheight + i*owidth + j;
-	  real *indxp = indx_p + k*otime*owidth*oheight + ti*owidth*oheight + i*owidth + j;
+	  long o = k*otime*owidth*oheight + ti*owidth*oheight + i*owidth + j;
 	  
 	  /* compute local max: */
 	  real maxval = -THInf;
+	  long maxindex = 0, index = 0;
 	  int x,y,z;
 
-	  *indzp = -1;
-	  *indyp = -1;
-	  *indxp = -1;
 	  for(z=0; z < kT; z++)
 	  {
 	    for(y = 0; y < kH; y++)
 	    {
-	      for(x = 0; x < kW; x++)
+	      for(x = 0; x < kW; x++, index++)
 	      {
 		real val = *(ip + z*iwidth*iheight + y*iwidth + x);
 		if (val > maxval)
 		{
 		  maxval = val;
-		  *indzp = z+1;
-		  *indyp = y+1;
-		  *indxp = x+1;
+		  maxindex = index;
 		}
 	      }
 	    }
 	  }
 	  /* set output to local max */
-	  *op = maxval;
+	  output_p[o] = maxval;
 	  
-	  /* store location of max (x,y) */
-	  /**indyp = (int)(maxindex / kW)+1;*/
-	  /**indxp = (maxindex % kW) +1;*/
+	  /* store location of max (z,y,x) as its offset in the window */
+	  if (ind8_p || ind32_p)
+	    nn_poolingSetIndex(ind8_p, ind32_p, o, maxindex);
 	}
       }
     }
@@ -73,7 +66,6 @@ static int nn_(VolumetricMaxPooling_updateOutput)(lua_State *L)
   int dT = luaT_getfieldcheckint(L, 1, "dT");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
-  THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
   THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
   long nslices;
   long itime;
@@ -84,7 +76,8 @@ static int nn_(VolumetricMaxPooling_updateOutput)(lua_State *L)
   long owidth;
   real *input_data;
   real *output_data;
-  real *indices_data;
+  unsigned char *ind8_data;
+  int *ind32_data;
 
 
   luaL_argcheck(L, input->nDimension == 4 , 2, "4D tensor expected");
@@ -104,17 +97,14 @@ static int nn_(VolumetricMaxPooling_updateOutput)(lua_State *L)
 
   /* resize output */
   THTensor_(resize4d)(output, nslices, otime, oheight, owidth);
-  /* indices will contain ti,i,j locations for each output point */
-  THTensor_(resize5d)(indices, 3, nslices, otime, oheight, owidth);
+  /* indices will contain the window offset of each output point */
+  nn_poolingIndices(L, 4, output->size, 1, &ind8_data, &ind32_data);
   
   input_data = THTensor_(data)(input);
   output_data = THTensor_(data)(output);
-  indices_data = THTensor_(data)(indices);
   
   nn_(VolumetricMaxPooling_updateOutput_frame)(input_data, output_data,
-					       indices_data+nslices*otime*owidth*oheight*2, 
-					       indices_data+nslices*otime*owidth*oheight, 
-					       indices_data,
+					       ind8_data, ind32_data,
 					       nslices,
 					       itime, iwidth, iheight,
 					       otime, owidth, oheight,
@@ -125,11 +115,11 @@ static int nn_(VolumetricMaxPooling_updateOutput)(lua_State *L)
 }
 
 static void nn_(VolumetricMaxPooling_updateGradInput_frame)(real *gradInput_p, real *gradOutput_p,
-							    real *indx_p, real *indy_p, real *indz_p,
+							    unsigned char *ind8_p, int *ind32_p,
 							    long nslices,
 							    long itime, long iwidth, long iheight,
 							    long otime, long owidth, long oheight,
-							    int dT, int dW, int dH)
+							    int kW, int kH, int dT, int dW, int dH)
 {
   long k;
 #pragma omp parallel for private(k)
@@ -137,9 +127,7 @@ static void nn_(VolumetricMaxPooling_updateGradInput_frame)(real *gradInput_p, r
   {
     real *gradInput_p_k = gradInput_p + k*itime*iwidth*iheight;
     real *gradOutput_p_k = gradOutput_p + k*otime*owidth*oheight;
-    real *indx_p_k = indx_p + k*otime*owidth*oheight;
-    real *indy_p_k = indy_p + k*otime*owidth*oheight;
-    real *indz_p_k = indz_p + k*otime*owidth*oheight;
+    long o_k = k*otime*owidth*oheight;
 
     /* calculate max points */
     long ti, i, j;
@@ -150,12 +138,14 @@ static void nn_(VolumetricMaxPooling_updateGradInput_frame)(real *gradInput_p, r
 	for(j = 0; j < owidth; j++)
 	{
 	  /* retrieve position of max */
-	  long maxti = indz_p_k[ti*oheight*owidth + i*owidth + j] - 1 + ti*dT;
-	  long maxi  = indy_p_k[ti*oheight*owidth + i*owidth + j] - 1 + i*dH;
-	  long maxj  = indx_p_k[ti*oheight*owidth + i*owidth + j] - 1 + j*dW;
+	  long o = ti*oheight*owidth + i*owidth + j;
+	  long maxindex = nn_poolingGetIndex(ind8_p, ind32_p, o_k + o);
+	  long maxti = maxindex / (kW*kH) + ti*dT;
+	  long maxi  = (maxindex / kW) % kH + i*dH;
+	  long maxj  = maxindex % kW + j*dW;
 	  
 	  /* update gradient */
-	  gradInput_p_k[maxti*iheight*iwidth + maxi*iwidth + maxj] += gradOutput_p_k[ti*oheight*owidth + i*owidth + j];
+	  gradInput_p_k[maxti*iheight*iwidth + maxi*iwidth + maxj] += gradOutput_p_k[o];
 	}
       }
     }
@@ -166,10 +156,11 @@ static int nn_(VolumetricMaxPooling_updateGradInput)(lua_State *L)
 {
   THTensor *input = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
+  int kW = luaT_getfieldcheckint(L, 1, "kW");
+  int kH = luaT_getfieldcheckint(L, 1, "kH");
   int dT = luaT_getfieldcheckint(L, 1, "dT");
   int dW = luaT_getfieldcheckint(L, 1, "dW");
   int dH = luaT_getfieldcheckint(L, 1, "dH");
-  THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
   THTensor *gradInput = luaT_getfieldcheckudata(L, 1, "gradInput", torch_Tensor);
   int nslices;
   int itime;
@@ -180,7 +171,8 @@ static int nn_(VolumetricMaxPooling_updateGradInput)(lua_State *L)
   int owidth;
   real *gradInput_data;
   real *gradOutput_data;
-  real *indices_data;
+  unsigned char *ind8_data;
+  int *ind32_data;
 
   /* get contiguous gradOutput */
   gradOutput = THTensor_(newContiguous)(gradOutput);
@@ -201,17 +193,15 @@ static int nn_(VolumetricMaxPooling_updateGradInput)(lua_State *L)
   /* get raw pointers */
   gradInput_data = THTensor_(data)(gradInput);
   gradOutput_data = THTensor_(data)(gradOutput);
-  indices_data = THTensor_(data)(indices);
+  nn_poolingIndices(L, 4, gradOutput->size, 0, &ind8_data, &ind32_data);
 
   /* backprop */
   nn_(VolumetricMaxPooling_updateGradInput_frame)(gradInput_data, gradOutput_data,
-						  indices_data+nslices*otime*owidth*oheight*2, 
-						  indices_data+nslices*otime*owidth*oheight, 
-						  indices_data,
+						  ind8_data, ind32_data,
 						  nslices,
 						  itime, iwidth, iheight,
 						  otime, owidth, oheight,
-						  dT, dW, dH);
+						  kW, kH, dT, dW, dH);
 
   /* cleanup */
   THTensor_(free)(gradOutput);
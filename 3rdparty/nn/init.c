@@ -3,8 +3,161 @@
 
 #define torch_(NAME) TH_CONCAT_3(torch_, Real, NAME)
 #define torch_Tensor TH_CONCAT_STRING_3(torch.,Real,Tensor)
+#define torch_SparseTensor TH_CONCAT_STRING_3(torch.,Real,SparseTensor)
 #define nn_(NAME) TH_CONCAT_3(nn_, Real, NAME)
 
+/* argmax of the max-pooling modules: offset of the max inside its window,
+   in a ByteTensor for windows of up to 256 elements and in an IntTensor
+   otherwise. A nil indices field means that the module runs forward only
+   and no argmax is computed. */
+#define nn_poolingSetIndex(u8, i32, o, v) \
+  do { if(u8) (u8)[o] = (unsigned char)(v); else (i32)[o] = (int)(v); } while(0)
+#define nn_poolingGetIndex(u8, i32, o) ((u8) ? (long)(u8)[o] : (long)(i32)[o])
+
+static int nn_poolingIndices(lua_State *L, int nDimension, long *size, int resize,
+                             unsigned char **u8, int **i32)
+{
+  THLongStorage *sz;
+  THByteTensor *b;
+  THIntTensor *t = NULL;
+  long n = 1;
+  int d;
+
+  *u8 = NULL;
+  *i32 = NULL;
+  lua_getfield(L, 1, "indices");
+  if(lua_isnil(L, -1))
+  {
+    lua_pop(L, 1);
+    if(!resize)
+      luaL_error(L, "no indices: the module runs forward only");
+    return 0;
+  }
+
+  for(d = 0; d < nDimension; d++)
+    n *= size[d];
+  if((b = luaT_toudata(L, -1, "torch.ByteTensor")))
+  {
+    if(!resize && THByteTensor_nElement(b) != n)
+      luaL_error(L, "indices do not match gradOutput");
+  }
+  else
+  {
+    t = luaT_checkudata(L, -1, "torch.IntTensor");
+    if(!resize && THIntTensor_nElement(t) != n)
+      luaL_error(L, "indices do not match gradOutput");
+  }
+  if(resize)
+  {
+    sz = THLongStorage_newWithSize(nDimension);
+    for(d = 0; d < nDimension; d++)
+      sz->data[d] = size[d];
+    if(b)
+      THByteTensor_resize(b, sz, NULL);
+    else
+      THIntTensor_resize(t, sz, NULL);
+    THLongStorage_free(sz);
+  }
+  if(b)
+    *u8 = THByteTensor_data(b);
+  else
+    *i32 = THIntTensor_data(t);
+  lua_pop(L, 1);
+  return 1;
+}
+
+/* connection tables of the SpatialConvolutionMap family: a table links the
+   planes of a large map X to the planes of a small map Y, Y[y][x] seeing
+   X[y*dH+ky][x*dW+kx]. Connections are grouped by X plane (xconn, with
+   rank[k] the position of connection k in it) and by Y plane (yconn);
+   yplane[k] is the Y plane of connection k. */
+typedef struct nn_ConvMapTable_
+{
+  long nconn;
+  long nx, ny;
+  long *xstart, *xconn, *rank;
+  long *ystart, *yconn, *yplane;
+  long xh, xw, yh, yw;
+  int kH, kW, dH, dW;
+} nn_ConvMapTable;
+
+static void nn_ConvMapTable_free(nn_ConvMapTable *t)
+{
+  THFree(t->xstart);
+  THFree(t->xconn);
+  THFree(t->rank);
+  THFree(t->ystart);
+  THFree(t->yconn);
+  THFree(t->yplane);
+}
+
+/* whether the columns of X are all covered by the kernels, in which case
+   the TH 2D convolutions can be used on a band of rows directly */
+static int nn_ConvMapTable_fits(nn_ConvMapTable *t)
+{
+  return (t->yw-1)*t->dW + t->kW == t->xw;
+}
+
+/* largest number of connections of an X plane */
+static long nn_ConvMapTable_fanout(nn_ConvMapTable *t)
+{
+  long p, n = 0;
+  for(p = 0; p < t->nx; p++)
+    n = THMax(n, t->xstart[p+1]-t->xstart[p]);
+  return n;
+}
+
+/* rows of Y are processed in bands such that the buffers of a band, of
+   about perrow elements per row, stay in cache */
+#define nn_ConvMap_BAND 65536
+
+static long nn_ConvMapTable_band(nn_ConvMapTable *t, long perrow)
+{
+  long n = nn_ConvMap_BAND / THMax(perrow, 1);
+  return THMax(1, THMin(n, t->yh));
+}
+
+/* scatter-add of nn.LookupTable: the positions of a batch of indices,
+   grouped by index (in order of position within a group), so that each
+   referenced row is accumulated by a single thread */
+typedef struct nn_LookupTableEntry_
+{
+  long index;
+  long pos;
+} nn_LookupTableEntry;
+
+static int nn_LookupTable_compare(const void *a, const void *b)
+{
+  const nn_LookupTableEntry *ea = a, *eb = b;
+  if(ea->index != eb->index)
+    return (ea->index < eb->index) ? -1 : 1;
+  return (ea->pos < eb->pos) ? -1 : (ea->pos > eb->pos);
+}
+
+/* returns the number of distinct indices; group g spans
+   entries[start[g]..start[g+1]) */
+static long nn_LookupTable_coalesce(long *index, long n, nn_LookupTableEntry *entries, long *start)
+{
+  long i, ngroup = 0;
+  for(i = 0; i < n; i++)
+  {
+    entries[i].index = index[i];
+    entries[i].pos = i;
+  }
+  qsort(entries, n, sizeof(nn_LookupTableEntry), nn_LookupTable_compare);
+  for(i = 0; i < n; i++)
+    if(i == 0 || entries[i].index != entries[i-1].index)
+      start[ngroup++] = i;
+  start[ngroup] = n;
+  return ngroup;
+}
+
+static int nn_SparseLinear_compareLong(const void *a_, const void *b_)
+{
+  long a = *(const long*)a_, b = *(const long*)b_;
+  return (a > b) - (a < b);
+}
+
 #include "generic/Square.c"
 #include "THGenerateFloatTypes.h"
 
@@ -62,6 +215,9 @@
 #include "generic/SparseLinear.c"
 #include "THGenerateFloatTypes.h"
 
+#include "generic/LookupTable.c"
+#include "THGenerateFloatTypes.h"
+
 #include "generic/TemporalConvolution.c"
 #include "THGenerateFloatTypes.h"
 
@@ -77,21 +233,27 @@
 #include "generic/SpatialFullConvolution.c"
 #include "THGenerateFloatTypes.h"
 
-#include "generic/SpatialFullConvolutionMap.c"
-#include "THGenerateFloatTypes.h"
-
 #include "generic/SpatialConvolutionMM.c"
 #include "THGenerateFloatTypes.h"
 
 #include "generic/SpatialConvolutionMap.c"
 #include "THGenerateFloatTypes.h"
 
+#include "generic/SpatialFullConvolutionMap.c"
+#include "THGenerateFloatTypes.h"
+
 #include "generic/SpatialSubSampling.c"
 #include "THGenerateFloatTypes.h"
 
 #include "generic/SpatialMaxPooling.c"
 #include "THGenerateFloatTypes.h"
 
+#include "generic/SpatialSubtractiveNormalization.c"
+#include "THGenerateFloatTypes.h"
+
+#include "generic/SpatialDivisiveNormalization.c"
+#include "THGenerateFloatTypes.h"
+
 #include "generic/VolumetricConvolution.c"
 #include "THGenerateFloatTypes.h"
 
@@ -134,6 +296,7 @@ int luaopen_libnn(lua_State *L)
   nn_FloatSoftShrink_init(L);
   nn_FloatThreshold_init(L);
   nn_FloatSparseLinear_init(L);
+  nn_FloatLookupTable_init(L);
   nn_FloatTemporalConvolution_init(L);
   nn_FloatTemporalSubSampling_init(L);
   nn_FloatTemporalMaxPooling_init(L);
@@ -144,6 +307,8 @@ int luaopen_libnn(lua_State *L)
   nn_FloatSpatialConvolutionMap_init(L);
   nn_FloatSpatialSubSampling_init(L);
   nn_FloatSpatialMaxPooling_init(L);
+  nn_FloatSpatialSubtractiveNormalization_init(L);
+  nn_FloatSpatialDivisiveNormalization_init(L);
   nn_FloatVolumetricConvolution_init(L);
   nn_FloatVolumetricMaxPooling_init(L);
   nn_FloatMultiMarginCriterion_init(L);
@@ -169,6 +334,7 @@ int luaopen_libnn(lua_State *L)
   nn_DoubleSoftShrink_init(L);
   nn_DoubleThreshold_init(L);
   nn_DoubleSparseLinear_init(L);
+  nn_DoubleLookupTable_init(L);
   nn_DoubleTemporalConvolution_init(L);
   nn_DoubleTemporalSubSampling_init(L);
   nn_DoubleTemporalMaxPooling_init(L);
@@ -179,6 +345,8 @@ int luaopen_libnn(lua_State *L)
   nn_DoubleSpatialConvolutionMap_init(L);
   nn_DoubleSpatialSubSampling_init(L);
   nn_DoubleSpatialMaxPooling_init(L);
+  nn_DoubleSpatialSubtractiveNormalization_init(L);
+  nn_DoubleSpatialDivisiveNormalization_init(L);
   nn_DoubleVolumetricConvolution_init(L);
   nn_DoubleVolumetricMaxPooling_init(L);
   nn_DoubleMultiMarginCriterion_init(L);
@@ -98,6 +98,7 @@ torch.include('nn','L1Cost.lua')
 torch.include('nn','WeightedMSECriterion.lua')
 
 torch.include('nn','StochasticGradient.lua')
+torch.include('nn','Profiler.lua')
 
 torch.include('nn','Jacobian.lua')
 torch.include('nn','hessian.lua')
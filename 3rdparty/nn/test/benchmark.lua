@@ -0,0 +1,73 @@
+-- nn benchmarks: forward and backward of the spatial and temporal layers
+-- typical usage: lua benchmark.lua [-run pattern] [-save file] [-baseline file]
+
+require 'torch'
+require 'nn'
+
+local bench = torch.Benchmark()
+local elementsize = ({['torch.FloatTensor']=4, ['torch.DoubleTensor']=8})[torch.getdefaulttensortype()]
+
+torch.manualSeed(1234)
+
+local function shape(x)
+   return table.concat(x:size():totable(), 'x')
+end
+
+-- forward and backward of module on input; the flops of the forward are
+-- estimated as in nn.Profiler, the backward of a layer with weights costs
+-- twice as much (gradInput and gradWeight)
+local function layer(name, module, input)
+   local output = module:forward(input):clone()
+   local gradOutput = output:clone():uniform()
+   local estimate = nn.Profiler.flops[torch.typename(module)]
+   local flops = estimate and estimate(module, input, output) or output:nElement()
+   name = string.format('%s %s', name, shape(input))
+   bench:add(name .. ' forward', function() module:forward(input) end,
+             flops, (input:nElement() + output:nElement())*elementsize)
+   bench:add(name .. ' backward', function() module:backward(input, gradOutput) end,
+             module.weight and 2*flops or flops,
+             (2*input:nElement() + output:nElement())*elementsize)
+end
+
+-- forward of module in inference mode
+local function inference(name, module, input)
+   module:inference()
+   local output = module:forward(input)
+   name = string.format('%s %s', name, shape(input))
+   bench:add(name .. ' inference', function() module:forward(input) end,
+             output:nElement(), (input:nElement() + output:nElement())*elementsize)
+end
+
+-- convolutions: first layers of a small convnet, single and batch
+layer('SpatialConvolution 3->16 5x5', nn.SpatialConvolution(3, 16, 5, 5), torch.rand(3, 64, 64))
+layer('SpatialConvolution 16->32 5x5', nn.SpatialConvolution(16, 32, 5, 5), torch.rand(16, 30, 30))
+layer('SpatialConvolution 3->16 5x5', nn.SpatialConvolution(3, 16, 5, 5), torch.rand(16, 3, 32, 32))
+layer('SpatialConvolutionMM 3->16 5x5', nn.SpatialConvolutionMM(3, 16, 5, 5), torch.rand(3, 64, 64))
+layer('SpatialConvolutionMM 16->32 5x5', nn.SpatialConvolutionMM(16, 32, 5, 5), torch.rand(16, 30, 30))
+layer('SpatialConvolutionMM 3->16 5x5', nn.SpatialConvolutionMM(3, 16, 5, 5), torch.rand(16, 3, 32, 32))
+layer('SpatialConvolutionMap 16->32/4 5x5', nn.SpatialConvolutionMap(nn.tables.random(16, 32, 4), 5, 5),
+      torch.rand(16, 30, 30))
+layer('SpatialFullConvolution 16->8 4x4/2', nn.SpatialFullConvolution(16, 8, 4, 4, 2, 2), torch.rand(16, 16, 16))
+
+-- pooling and normalization
+layer('SpatialMaxPooling 2x2', nn.SpatialMaxPooling(2, 2, 2, 2), torch.rand(16, 64, 64))
+layer('SpatialSubSampling 2x2', nn.SpatialSubSampling(16, 2, 2, 2, 2), torch.rand(16, 64, 64))
+layer('SpatialLPPooling 2x2', nn.SpatialLPPooling(16, 2, 2, 2, 2, 2), torch.rand(16, 64, 64))
+layer('SpatialZeroPadding 2', nn.SpatialZeroPadding(2, 2, 2, 2), torch.rand(16, 64, 64))
+layer('SpatialSubtractiveNormalization 7', nn.SpatialSubtractiveNormalization(16, torch.ones(7)), torch.rand(16, 32, 32))
+layer('SpatialContrastiveNormalization 7', nn.SpatialContrastiveNormalization(16, torch.ones(7)), torch.rand(16, 32, 32))
+inference('SpatialSubtractiveNormalization 7', nn.SpatialSubtractiveNormalization(16, torch.ones(7)), torch.rand(16, 32, 32))
+inference('SpatialContrastiveNormalization 7', nn.SpatialContrastiveNormalization(16, torch.ones(7)), torch.rand(16, 32, 32))
+
+-- temporal: sequences of 256 frames
+layer('TemporalConvolution 64->128 5', nn.TemporalConvolution(64, 128, 5), torch.rand(256, 64))
+layer('TemporalMaxPooling 2', nn.TemporalMaxPooling(2, 2), torch.rand(256, 64))
+layer('TemporalSubSampling 2', nn.TemporalSubSampling(64, 2, 2), torch.rand(256, 64))
+
+-- classifier
+layer('Linear 1024->256', nn.Linear(1024, 256), torch.rand(1024))
+layer('Linear 1024->256', nn.Linear(1024, 256), torch.rand(32, 1024))
+layer('Tanh', nn.Tanh(), torch.rand(16, 64, 64))
+layer('LogSoftMax', nn.LogSoftMax(), torch.rand(32, 1000))
+
+bench:main(arg)
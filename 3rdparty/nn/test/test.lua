@@ -303,6 +303,115 @@ function nntest.Linear()
    mytester:asserteq(berr, 0, torch.typename(module) .. ' - i/o backward err ')
 end
 
+function nntest.LookupTable()
+   local nIndex = math.random(10,20)
+   local size = math.random(5,10)
+   local nframe = math.random(3,6)
+   local seqlen = math.random(20,40)
+   local module = nn.LookupTable(nIndex, size)
+   -- duplicates are guaranteed with seqlen > nIndex
+   local input = torch.LongTensor(nframe, seqlen):random(nIndex)
+   local flat = input:clone():resize(nframe*seqlen)
+
+   local output = module:forward(input)
+   mytester:asserteq(output:dim(), 3, 'wrong output dimension')
+   local oflat = output:clone():resize(nframe*seqlen, size)
+   local err = 0
+   for i=1,flat:size(1) do
+      err = math.max(err, oflat[i]:clone():add(-1, module.weight[flat[i]]):abs():max())
+   end
+   mytester:asserteq(err, 0, 'error on forward ')
+
+   -- same output for indices given as a real tensor
+   local routput = module:forward(input:double():typeAs(module.weight)):clone()
+   mytester:asserteq(routput:add(-1, output):abs():max(), 0, 'error on forward [real indices] ')
+
+   local gradOutput = torch.Tensor(nframe, seqlen, size):uniform()
+   local gradWeight = torch.Tensor(nIndex, size):zero()
+   local gflat = gradOutput:clone():resize(nframe*seqlen, size)
+   for i=1,flat:size(1) do
+      gradWeight[flat[i]]:add(0.5, gflat[i])
+   end
+   module:zeroGradParameters()
+   module:accGradParameters(input, gradOutput, 0.5)
+   mytester:assertlt(module.gradWeight:clone():add(-1, gradWeight):abs():max(), precision, 'error on gradWeight ')
+
+   local weight = module.weight:clone():add(-0.1, gradWeight)
+   module:updateParameters(0.1)
+   mytester:assertlt(module.weight:clone():add(-1, weight):abs():max(), precision, 'error on updateParameters ')
+
+   module:zeroGradParameters()
+   mytester:asserteq(module.gradWeight:abs():max(), 0, 'error on zeroGradParameters ')
+   mytester:asserteq(module.inputs:nElement(), 0, 'referenced rows not cleared ')
+
+   local weight = module.weight:clone()
+   for i=1,flat:size(1) do
+      weight[flat[i]]:add(-0.1, gflat[i])
+   end
+   module:accUpdateGradParameters(input, gradOutput, 0.1)
+   mytester:assertlt(module.weight:clone():add(-1, weight):abs():max(), precision, 'error on accUpdateGradParameters ')
+
+   -- 1D
+   local input = torch.LongTensor(seqlen):random(nIndex)
+   local output = module:forward(input)
+   mytester:asserteq(output:dim(), 2, 'wrong output dimension [1D] ')
+   mytester:asserteq(output[seqlen]:clone():add(-1, module.weight[input[seqlen]]):abs():max(), 0, 'error on forward [1D] ')
+end
+
+function nntest.SparseLinear()
+   local ini = math.random(50,100)
+   local inj = math.random(5,10)
+   local nframe = math.random(3,6)
+   local module = nn.SparseLinear(ini, inj)
+   local linear = nn.Linear(ini, inj)
+   linear.weight:copy(module.weight)
+   linear.bias:copy(module.bias)
+
+   -- batch of sparse rows, with duplicate entries
+   local nnz = math.random(20,40)
+   local indices = torch.LongTensor(2, nnz)
+   indices[1]:random(nframe)
+   indices[2]:random(ini)
+   indices[2][nnz] = indices[2][1]
+   indices[1][nnz] = indices[1][1]
+   local values = torch.Tensor(nnz):uniform()
+   local input = torch.SparseTensor(indices, values, nframe, ini)
+   local dense = input:toDense()
+
+   local output = module:forward(input)
+   local err = output:clone():add(-1, linear:forward(dense)):abs():max()
+   mytester:assertlt(err, precision, 'error on forward ')
+   err = module:forward(torch.SparseTensor(dense)):clone():add(-1, linear:forward(dense)):abs():max()
+   mytester:assertlt(err, precision, 'error on forward [csr] ')
+
+   local gradOutput = torch.Tensor(nframe, inj):uniform()
+   module:zeroGradParameters()
+   linear:zeroGradParameters()
+   module:accGradParameters(input, gradOutput, 0.5)
+   linear:accGradParameters(dense, gradOutput, 0.5)
+   mytester:assertlt(module.gradWeight:clone():add(-1, linear.gradWeight):abs():max(), precision, 'error on gradWeight ')
+   mytester:assertlt(module.gradBias:clone():add(-1, linear.gradBias):abs():max(), precision, 'error on gradBias ')
+   mytester:asserteq(input:format(), 'coo', 'input converted ')
+
+   module:updateParameters(0.1)
+   linear:updateParameters(0.1)
+   mytester:assertlt(module.weight:clone():add(-1, linear.weight):abs():max(), precision, 'error on updateParameters ')
+
+   module:zeroGradParameters()
+   mytester:asserteq(module.gradWeight:abs():max(), 0, 'error on zeroGradParameters ')
+
+   -- single sample as (index, value) pairs
+   local sample = torch.Tensor(2, 5)
+   sample[1]:copy(torch.randperm(ini):narrow(1, 1, 5))
+   sample[2]:uniform()
+   local x = torch.Tensor(ini):zero()
+   for i=1,5 do
+      x[sample[1][i]] = sample[2][i]
+   end
+   local output = module:forward(sample)
+   mytester:assertlt(output:clone():add(-1, linear:forward(x)):abs():max(), precision, 'error on forward [pairs] ')
+end
+
 function nntest.Euclidean()
    local ini = math.random(50,70)
    local inj = math.random(50,70)
@@ -604,6 +713,39 @@ function nntest.SpatialDivisiveNormalization_1dkernel()
    mytester:asserteq(berr, 0, torch.typename(module) .. ' - i/o backward err ')
 end
 
+function nntest.SpatialContrastiveNormalization_separable()
+   local inputSize = math.random(11,20)
+   local nbfeatures = math.random(1,5)
+   local gauss = torch.Tensor(7)
+   for i = 1,7 do
+      gauss[i] = math.exp(-math.pow((i-4)/2,2)/2)
+   end
+   for _,kernel in ipairs{gauss, torch.ger(gauss,gauss)} do
+      local module = nn.SpatialContrastiveNormalization(nbfeatures,kernel:clone())
+      local input = torch.rand(nbfeatures,inputSize,inputSize+3)
+      local output = module:forward(input):clone()
+      local gradInput = module:backward(input, output):clone()
+      -- the fused forward pass is used in inference mode only
+      for _,m in ipairs(module.normalizer.modules) do
+         mytester:assert(m.kernelv ~= nil, torch.typename(m) .. ' - kernel not separated ')
+         mytester:asserteq(m.coefv:nElement(), 0, torch.typename(m) .. ' - fused forward in training ')
+      end
+      module:inference()
+      for i=1,2 do
+         local err = (module:forward(input) - output):abs():max()
+         mytester:assertlt(err, precision, 'error on fused forward ')
+      end
+      for _,m in ipairs(module.normalizer.modules) do
+         mytester:assertgt(m.coefv:nElement(), 0, torch.typename(m) .. ' - fused forward not used ')
+      end
+      module:training()
+      local err = (module:forward(input) - output):abs():max()
+      mytester:assertlt(err, precision, 'error on forward after training() ')
+      err = (module:backward(input, output) - gradInput):abs():max()
+      mytester:assertlt(err, precision, 'error on backward after training() ')
+   end
+end
+
 function nntest.SpatialConvolution()
    local from = math.random(1,10)
    local to = math.random(1,10)
@@ -810,6 +952,147 @@ function nntest.SpatialConvolutionMap()
    mytester:asserteq(0, berr, torch.typename(module) .. ' - i/o backward err ')
 end
 
+function nntest.SpatialConvolutionMapCompare()
+   local from = math.random(1,6)
+   local to = math.random(1,6)
+   local tt = nn.tables.full(from, to)
+   local ki = math.random(1,6)
+   local kj = math.random(1,6)
+   local si = math.random(1,3)
+   local sj = math.random(1,3)
+   local ini = (math.random(5,15)-1)*si+ki
+   local inj = (math.random(5,15)-1)*sj+kj
+   local module1 = nn.SpatialConvolutionMap(tt, ki, kj, si, sj)
+   local module2 = nn.SpatialConvolution(from, to, ki, kj, si, sj)
+   local input = torch.rand(from, inj, ini)
+   for k=1,tt:size(1) do
+      module1.weight[k]:copy(module2.weight[tt[k][2]][tt[k][1]])
+   end
+   module1.bias:copy(module2.bias)
+
+   local o1 = module1:forward(input)
+   local o2 = module2:forward(input)
+   mytester:assertlt(o1:dist(o2), precision, 'error on output')
+
+   local go = torch.rand(o1:size())
+   local gi1 = module1:backward(input, go)
+   local gi2 = module2:backward(input, go)
+   mytester:assertlt(gi1:dist(gi2), precision, 'error on gradInput')
+
+   module1:zeroGradParameters()
+   module2:zeroGradParameters()
+   module1:accGradParameters(input, go)
+   module2:accGradParameters(input, go)
+   for k=1,tt:size(1) do
+      mytester:assertlt(module1.gradWeight[k]:dist(module2.gradWeight[tt[k][2]][tt[k][1]]), precision, 'error on gradWeight ' .. k)
+   end
+   mytester:assertlt(module1.gradBias:dist(module2.gradBias), precision, 'error on gradBias ')
+end
+
+
+-- reference of the connection table modules: one 2D convolution per
+-- connection, strides done by inserting zeros (full) or subsampling
+local function mapUpsample(x, sj, si)
+   local y = torch.zeros((x:size(1)-1)*sj+1, (x:size(2)-1)*si+1)
+   for j=1,x:size(1) do
+      for i=1,x:size(2) do
+         y[(j-1)*sj+1][(i-1)*si+1] = x[j][i]
+      end
+   end
+   return y
+end
+
+local function mapSubsample(x, sj, si, h, w)
+   local y = torch.Tensor(h, w)
+   for j=1,h do
+      for i=1,w do
+         y[j][i] = x[(j-1)*sj+1][(i-1)*si+1]
+      end
+   end
+   return y
+end
+
+local function mapReference(module, input, gradOutput, full)
+   local tt, weight = module.connTable, module.weight
+   local kH, kW, dH, dW = module.kH, module.kW, module.dH, module.dW
+   local output = torch.Tensor(gradOutput:size())
+   local gradInput = torch.zeros(input:size())
+   local gradWeight = torch.zeros(weight:size())
+   for o=1,output:size(1) do
+      output[o]:fill(module.bias[o])
+   end
+   for k=1,tt:size(1) do
+      local i, o = tt[k][1], tt[k][2]
+      if full then
+         local h, w = (input:size(2)-1)*dH+kH, (input:size(3)-1)*dW+kW
+         output[o]:add(torch.conv2(mapUpsample(input[i], dH, dW), weight[k], 'F'))
+         gradInput[i]:add(mapSubsample(torch.xcorr2(gradOutput[o], weight[k], 'V'), dH, dW,
+                                       input:size(2), input:size(3)))
+         gradWeight[k]:add(torch.xcorr2(gradOutput[o], mapUpsample(input[i], dH, dW), 'V'))
+      else
+         local oh, ow = output:size(2), output:size(3)
+         -- the part of the input covered by the kernels
+         local covered = input[i]:narrow(1, 1, (oh-1)*dH+kH):narrow(2, 1, (ow-1)*dW+kW)
+         output[o]:add(mapSubsample(torch.xcorr2(covered, weight[k], 'V'), dH, dW, oh, ow))
+         gradInput[i]:narrow(1, 1, covered:size(1)):narrow(2, 1, covered:size(2))
+            :add(torch.conv2(mapUpsample(gradOutput[o], dH, dW), weight[k], 'F'))
+         gradWeight[k]:add(torch.xcorr2(covered, mapUpsample(gradOutput[o], dH, dW), 'V'))
+      end
+   end
+   local gradBias = gradOutput:sum(2):sum(3):select(3,1):select(2,1)
+   return output, gradInput, gradWeight, gradBias
+end
+
+local function mapCompare(name, module, input, full)
+   local output = module:forward(input)
+   local gradOutput = torch.rand(output:size())
+   local refOutput, refGradInput, refGradWeight, refGradBias = mapReference(module, input, gradOutput, full)
+   mytester:assertlt((output - refOutput):abs():max(), precision, name .. ' - error on output')
+   local gradInput = module:updateGradInput(input, gradOutput)
+   mytester:assertlt((gradInput - refGradInput):abs():max(), precision, name .. ' - error on gradInput')
+   module:zeroGradParameters()
+   module:accGradParameters(input, gradOutput)
+   mytester:assertlt((module.gradWeight - refGradWeight):abs():max(), precision, name .. ' - error on gradWeight')
+   mytester:assertlt((module.gradBias - refGradBias):abs():max(), precision, name .. ' - error on gradBias')
+end
+
+-- the tables of nn.tables, with one or several connections per plane, and
+-- inputs which the strided kernels do not cover entirely
+local function mapTables()
+   local from = math.random(2,6)
+   local to = math.random(2,6)
+   return {
+      full = nn.tables.full(from, to),
+      oneToOne = nn.tables.oneToOne(from),
+      random1 = nn.tables.random(from, to, 1),
+      randomFanin = nn.tables.random(from, to, math.random(2, from)),
+   }
+end
+
+function nntest.SpatialConvolutionMapTables()
+   for name,tt in pairs(mapTables()) do
+      local ki, kj = math.random(1,5), math.random(1,5)
+      local si, sj = math.random(2,3), math.random(2,3)
+      local from = tt:select(2,1):max()
+      for _,extra in ipairs{0, 1} do
+         local ini = (math.random(3,8)-1)*si + ki + extra*math.random(1, si-1)
+         local inj = (math.random(3,8)-1)*sj + kj + extra*math.random(1, sj-1)
+         local module = nn.SpatialConvolutionMap(tt, ki, kj, si, sj)
+         mapCompare(string.format('%s %dx%d', name, inj, ini), module, torch.rand(from, inj, ini))
+      end
+   end
+end
+
+function nntest.SpatialFullConvolutionMapTables()
+   for name,tt in pairs(mapTables()) do
+      local ki, kj = math.random(1,5), math.random(1,5)
+      local si, sj = math.random(1,3), math.random(1,3)
+      local from = tt:select(2,1):max()
+      local module = nn.SpatialFullConvolutionMap(tt, ki, kj, si, sj)
+      mapCompare(name, module, torch.rand(from, math.random(3,10), math.random(3,10)), true)
+   end
+end
+
 
 function nntest.SpatialFullConvolution()
    local from = math.random(1,10)
@@ -1167,6 +1450,27 @@ function nntest.SpatialMaxPooling()
 
 end
 
+function nntest.SpatialMaxPooling_indices()
+   local from = math.random(1,5)
+   for _,k in ipairs{{2,2,2,2}, {3,3,2,2}, {17,16,3,5}} do
+      local module = nn.SpatialMaxPooling(k[1],k[2],k[3],k[4])
+      local ini = math.random(1,10)*k[3]+k[1]
+      local inj = math.random(1,10)*k[4]+k[2]
+      local input = torch.rand(from,inj,ini)
+      mytester:asserteq(torch.typename(module.indices),
+                        k[1]*k[2] <= 256 and 'torch.ByteTensor' or 'torch.IntTensor',
+                        'wrong indices type')
+
+      local err = jac.testJacobian(module, input)
+      mytester:assertlt(err, precision, 'error on state ')
+
+      local output = module:forward(input):clone()
+      module.indices = nil
+      local err = (module:forward(input) - output):abs():max()
+      mytester:asserteq(err, 0, 'error on forward without indices ')
+   end
+end
+
 function nntest.SpatialLPPooling()
    local fanin = math.random(1,4)
    local osizex = math.random(1,4)
@@ -1530,6 +1834,135 @@ function nntest.Module_getParameters_7()
    mytester:asserteq(p:nElement(), 121, 'error: incorrect number of elements in flat vector')
 end
 
+function nntest.Profiler()
+   local mlp = nn.Sequential()
+   mlp:add(nn.Linear(10,20))
+   mlp:add(nn.Tanh())
+   mlp:add(nn.Linear(20,5))
+   local input = torch.randn(10)
+   local output = mlp:forward(input):clone()
+
+   local profiler = nn.Profiler(mlp)
+   for i=1,3 do
+      mlp:forward(input)
+      mlp:backward(input, torch.randn(5))
+   end
+   mytester:asserteq((mlp.output - output):abs():max(), 0, 'profiled forward differs')
+
+   local rows = {}
+   for _,row in ipairs(profiler:report()) do
+      rows[row.module .. ':' .. row.method] = row
+   end
+   local linear = rows['1 nn.Linear:updateOutput']
+   mytester:assert(linear ~= nil, 'missing module')
+   mytester:asserteq(linear.calls, 3, 'wrong number of calls')
+   mytester:asserteq(linear.flops, 3*2*200, 'wrong flops')
+   mytester:asserteq(linear.shape, '20', 'wrong shape')
+   local seq = rows['nn.Sequential:updateOutput']
+   mytester:assertlt(seq.self, seq.time + 1e-9, 'self time larger than time')
+   mytester:asserteq(#profiler.events, 3*(4 + 4 + 4), 'wrong number of events')
+
+   -- trace strings are JSON escaped
+   local filename = os.tmpname()
+   profiler.events[#profiler.events+1] = {'a "b"\\c', 'updateOutput', 0, 1e-6, '2\n3\0014'}
+   profiler:trace(filename)
+   local f = io.open(filename)
+   local trace = f:read('*a')
+   f:close()
+   os.remove(filename)
+   mytester:assert(trace:find('"name":"a \\"b\\"\\\\c"', 1, true) ~= nil, 'trace name not escaped')
+   mytester:assert(trace:find('"shape":"2\\n3\\u00014"', 1, true) ~= nil, 'trace shape not escaped')
+   profiler.events[#profiler.events] = nil
+
+   profiler:detach()
+   for _,module in ipairs(mlp.modules) do
+      mytester:asserteq(rawget(module, 'updateOutput'), nil, 'method not restored')
+   end
+   mlp:forward(input)
+   mytester:asserteq(#profiler.events, 3*(4 + 4 + 4), 'detached module still profiled')
+end
+
+function nntest.inference()
+   local mlp = nn.Sequential()
+   mlp:add(nn.SpatialConvolutionMM(3, 8, 5, 5)):add(nn.Tanh()):add(nn.SpatialMaxPooling(2, 2, 2, 2))
+   mlp:add(nn.SpatialConvolution(8, 16, 3, 3)):add(nn.Threshold())
+   mlp:add(nn.Reshape(16*6*6)):add(nn.Linear(16*6*6, 10)):add(nn.Tanh()):add(nn.LogSoftMax())
+   local input = torch.rand(3, 20, 20)
+   local output = mlp:forward(input):clone()
+   mlp:backward(input, torch.rand(10))
+
+   mlp:inference()
+   mytester:asserteq(mlp.modules[1].gradWeight:nElement(), 0, 'gradWeight not freed')
+   mytester:asserteq(mlp.modules[1].fgradInput:nElement(), 0, 'fgradInput not freed')
+   mytester:asserteq(mlp.modules[2].gradInput:nElement(), 0, 'gradInput not freed')
+   for i=1,2 do
+      mytester:assertlt((mlp:forward(input) - output):abs():max(), precision, 'inference output')
+   end
+   -- a chain of modules only needs two buffers, even with the view of Reshape
+   mytester:asserteq(mlp.outputBuffers, 2, 'number of output buffers')
+   local storages = {}
+   for i,module in ipairs(mlp.modules) do
+      storages[torch.pointer(module.output:storage())] = true
+   end
+   local n = 0
+   for _ in pairs(storages) do n = n + 1 end
+   mytester:asserteq(n, 2, 'outputs not shared')
+   mytester:assertError(function() mlp:backward(input, torch.rand(10)) end, 'backward in inference mode')
+
+   mlp:training()
+   mytester:asserteq(mlp.modules[7].gradWeight:nElement(), mlp.modules[7].weight:nElement(), 'gradWeight not restored')
+   mytester:assertlt((mlp:forward(input) - output):abs():max(), precision, 'output after training()')
+   local gradInput = mlp:backward(input, torch.rand(10))
+   mytester:asserteq(gradInput:dim(), 3, 'backward after training()')
+
+   -- the flat gradients of getParameters() and the shared gradients stay
+   -- views of the module gradients through inference()/training()
+   local mlp = nn.Sequential()
+   mlp:add(nn.Linear(10, 10)):add(nn.Tanh())
+   mlp:add(mlp.modules[1]:clone('weight', 'bias', 'gradWeight', 'gradBias'))
+   mlp:add(nn.Identity())
+   local params, gradParams = mlp:getParameters()
+   local input, gradOutput = torch.rand(10), torch.rand(10)
+   mlp:forward(input)
+   mlp:backward(input, gradOutput)
+   mlp:inference()
+   mytester:asserteq(gradOutput:nElement(), 10, 'gradOutput of Identity freed')
+   mlp:forward(input)
+   mlp:training()
+   mlp:zeroGradParameters()
+   mlp:forward(input)
+   mlp:backward(input, gradOutput)
+   mytester:assertgt(gradParams:norm(), 0, 'flat gradients not linked')
+   mytester:asserteq(torch.pointer(gradParams:storage()), torch.pointer(mlp.modules[1].gradWeight:storage()),
+                     'flat gradients storage')
+   mytester:asserteq(torch.pointer(mlp.modules[1].gradWeight:storage()), torch.pointer(mlp.modules[3].gradWeight:storage()),
+                     'shared gradWeight')
+   mytester:assertlt((gradParams:narrow(1, 1, 100) - mlp.modules[3].gradWeight:clone():resize(100)):abs():max(), precision,
+                     'flat gradients values')
+
+   -- a module which allocates a new output at each call turns the sharing off
+   local mlp = nn.Sequential()
+   local cloning = nn.Identity()
+   function cloning:updateOutput(input)
+      self.output = input:clone()
+      return self.output
+   end
+   mlp:add(nn.Linear(10, 10)):add(cloning):add(nn.Linear(10, 3))
+   local input = torch.rand(10)
+   local output = mlp:forward(input):clone()
+   local linear, calls = mlp.modules[1], 0
+   function linear:updateOutput(input)
+      calls = calls + 1
+      return nn.Linear.updateOutput(self, input)
+   end
+   mlp:inference()
+   for i=1,3 do
+      mytester:assertlt((mlp:forward(input) - output):abs():max(), precision, 'cloning module output')
+      mytester:asserteq(calls, i, 'modules run more than once per forward')
+   end
+   mytester:asserteq(mlp.outputPlan, nil, 'outputs still shared')
+end
+
 mytester:add(nntest)
 
 if not nn then
@@ -12,24 +12,22 @@ function Dropout:__init(p)
 end
 
 function Dropout:updateOutput(input)
-   self.output:resizeAs(input):copy(input)
    if self.train then
       self.fnoise = self.fnoise:float()
       self.fnoise:resize(input:size())
       self.noise:resizeAs(input)
       self.fnoise:bernoulli(1-self.p)
       self.noise:copy(self.fnoise)
-      self.output:cmul(self.noise)
+      self.output:cmul(input, self.noise)
    else
-      self.output:mul(1-self.p)
+      self.output:mul(input, 1-self.p)
    end
    return self.output
 end
 
 function Dropout:updateGradInput(input, gradOutput)
    if self.train then
-      self.gradInput:resizeAs(gradOutput):copy(gradOutput)
-      self.gradInput:cmul(self.noise) -- simply mask the gradients with the noise vector
+      self.gradInput:cmul(gradOutput, self.noise) -- simply mask the gradients with the noise vector
    else
       error('backprop only defined while training')
    end
@@ -5,9 +5,11 @@ local help_desc =
 maps. 
 
 The input is a 3D tensor width x height x nInputPlane, the
-output is a 3D tensor width x height x 2. The first slice
-of the output contains horizontal edges, the second vertical
-edges.
+output is a 3D tensor width x height x 2 (connex == 4) or 4
+(connex == 8). The first slice of the output contains horizontal
+edges, the second vertical edges; with 8-connexity, the third
+and fourth contain the diagonal edges going down-right and
+down-left.
 
 The input features are assumed to be >= 0.
 More precisely:
@@ -30,16 +32,12 @@ function SpatialGraph:__init(...)
       {arg='connex', type='number', help='connexity', default=4}
    )
    
-   if self.connex ~= 4 then
-      xlua.error('4 is the only connexity supported, for now', 'nn.SpatialGraph',self.usage)
+   if self.connex ~= 4 and self.connex ~= 8 then
+      xlua.error('connexity must be 4 or 8', 'nn.SpatialGraph',self.usage)
    end
    self.dist = ((self.dist == 'euclid') and 0) or ((self.dist == 'cosine') and 1)
-      or xerror('euclid is the only distance supported, for now','nn.SpatialGraph',self.usage)
+      or xerror('euclid and cosine are the only distances supported, for now','nn.SpatialGraph',self.usage)
    self.normalize = (self.normalize and 1) or 0
-   if self.dist == 'cosine' and self.normalize == 1 then
-      xerror('normalized cosine is not supported for now [just because I couldnt figure out the gradient :-)]',
-             'nn.SpatialGraph', self.usage)
-   end
 end
 
 function SpatialGraph:updateOutput(input)
@@ -1,10 +1,13 @@
 local SpatialMatching, parent = torch.class('nn.SpatialMatching', 'nn.Module')
 
-function SpatialMatching:__init(maxh, maxw, full_output)
+function SpatialMatching:__init(maxh, maxw, full_output, topk)
    -- If full_output is false, output is computed on elements of the first input
    -- for which all the possible corresponding elements exist in the second input
    -- In addition, if full_output is set to false, the pixel (1,1) of the first input
    -- is supposed to correspond to the pixel (maxh/2, maxw/2) of the second one
+   -- If topk is given, only the topk smallest distances of each pixel are kept,
+   -- in increasing order, and self.indices holds their displacements, as
+   -- (dy-1)*maxw+dx (0 when fewer than topk displacements are valid)
    parent.__init(self)
    self.maxw = maxw or 11
    self.maxh = maxh or 11
@@ -12,6 +15,10 @@ function SpatialMatching:__init(maxh, maxw, full_output)
       full_output = false
    end
    self.full_output = full_output
+   self.topk = topk or 0
+   if self.topk > 0 then
+      self.indices = torch.Tensor()
+   end
    self.gradInput1 = torch.Tensor()
    self.gradInput2 = torch.Tensor()
 end
@@ -19,7 +26,11 @@ end
 function SpatialMatching:updateOutput(input)
    -- input is a table of 2 inputs, each one being KxHxW
    -- if not full_output, the 1st one is KxH1xW1 where H1 <= H-maxh+1, W1 <= W-maxw+1
-   self.output:resize(input[1]:size(2), input[1]:size(3), self.maxh, self.maxw)
+   if (self.topk or 0) > 0 then
+      self.output:resize(input[1]:size(2), input[1]:size(3), self.topk)
+   else
+      self.output:resize(input[1]:size(2), input[1]:size(3), self.maxh, self.maxw)
+   end
    input[1].nn.SpatialMatching_updateOutput(self, input[1], input[2])
    return self.output
 end
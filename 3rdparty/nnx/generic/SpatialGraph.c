@@ -7,6 +7,36 @@
 #endif
 #define square(x) ((x)*(x))
 
+#ifndef nn_SpatialGraph_EDGES
+#define nn_SpatialGraph_EDGES
+/* edge e links (y,x) to (y+dy[e],x+dx[e]) and is stored in output plane e:
+   horizontal, vertical, then for 8-connexity the two diagonals */
+static const int nn_SpatialGraph_dy[4] = {0, 1, 1, 1};
+static const int nn_SpatialGraph_dx[4] = {1, 0, 1, -1};
+
+/* columns [*lo,*hi) of row y for which edge e exists; empty on the last
+   row for the edges pointing down */
+static void nn_SpatialGraph_range(int e, long y, long h, long w, long *lo, long *hi)
+{
+  int dx = nn_SpatialGraph_dx[e];
+  if (y + nn_SpatialGraph_dy[e] >= h) {
+    *lo = *hi = 0;
+    return;
+  }
+  *lo = (dx < 0) ? -dx : 0;
+  *hi = (dx > 0) ? w - dx : w;
+  if (*hi < *lo)
+    *hi = *lo;
+}
+#endif
+
+/*
+ * Both directions walk the (contiguous) input one row at a time. For a
+ * row y, each channel is read once along x and accumulated into the
+ * output rows of all the edges that start on that row, so the inner
+ * loops are unit-stride and independent across x.
+ */
+
 static int nn_(SpatialGraph_updateOutput)(lua_State *L)
 {
   // get all params
@@ -16,97 +46,213 @@ static int nn_(SpatialGraph_updateOutput)(lua_State *L)
   int norm = luaT_getfieldcheckint(L, 1, "normalize");
   THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
 
+  luaL_argcheck(L, input->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, connex == 4 || connex == 8, 1, "connexity must be 4 or 8");
+
   // dims
-  int iwidth = input->size[2];
-  int iheight = input->size[1];
-  int ichannels = input->size[0];
-  int owidth = iwidth;
-  int oheight = iheight;
-  int ochannels = connex / 2;
+  long iwidth = input->size[2];
+  long iheight = input->size[1];
+  long ichannels = input->size[0];
+  long plane = iwidth*iheight;
+  int nedges = connex / 2;
 
   // norm ?
-  double normer = (norm == 1) ? 1/sqrt(ichannels) : 1;
+  real normer = (norm == 1) ? 1/sqrt(ichannels) : 1;
+
+  // make contiguous
+  input = THTensor_(newContiguous)(input);
+  THTensor_(resize3d)(output, nedges, iheight, iwidth);
+  THTensor *output_c = THTensor_(newContiguous)(output);
+  real *input_p = THTensor_(data)(input);
+  real *output_p = THTensor_(data)(output_c);
+
+  long y;
+#pragma omp parallel for private(y)
+  for (y = 0; y < iheight; y++) {
+    long lo[4], hi[4];
+    long x, k;
+    int e;
+    for (e = 0; e < nedges; e++) {
+      real *o = output_p + e*plane + y*iwidth;
+      nn_SpatialGraph_range(e, y, iheight, iwidth, &lo[e], &hi[e]);
+      for (x = 0; x < iwidth; x++)
+        o[x] = 0;
+    }
+
+    // Euclidean distance
+    if (dist == 0) {
+      // Sum[ (Xi - Xi+1)^2 ]
+      for (k = 0; k < ichannels; k++) {
+        real *a = input_p + k*plane + y*iwidth;
+        for (e = 0; e < nedges; e++) {
+          real *o = output_p + e*plane + y*iwidth;
+          real *b = a + nn_SpatialGraph_dy[e]*iwidth + nn_SpatialGraph_dx[e];
+          for (x = lo[e]; x < hi[e]; x++)
+            o[x] += square(a[x] - b[x]);
+        }
+      }
 
-  // zero output
-  THTensor_(zero)(output);
+      // Sqrt[ Sum[ (Xi - Xi+1)^2 ] ]
+      for (e = 0; e < nedges; e++) {
+        real *o = output_p + e*plane + y*iwidth;
+        for (x = 0; x < iwidth; x++)
+          o[x] = sqrt(o[x]) * normer;
+      }
+
+      // Cosine dissimilarity
+    } else {
+      // an epsilon is added to the input (to get rid of 0s)
+      real epsi = 1e-12;
+      real *norms = THAlloc(sizeof(real)*2*iwidth);
+      real *na = norms, *nb = norms + iwidth;
+      for (x = 0; x < 2*iwidth; x++)
+        norms[x] = 0;
+
+      // Sum[ (Xi * Xi+1) ], and the squared norms of rows y and y+1
+      for (k = 0; k < ichannels; k++) {
+        real *a = input_p + k*plane + y*iwidth;
+        for (x = 0; x < iwidth; x++)
+          na[x] += square(a[x] + epsi);
+        if (y < iheight-1)
+          for (x = 0; x < iwidth; x++)
+            nb[x] += square(a[x+iwidth] + epsi);
+        for (e = 0; e < nedges; e++) {
+          real *o = output_p + e*plane + y*iwidth;
+          real *b = a + nn_SpatialGraph_dy[e]*iwidth + nn_SpatialGraph_dx[e];
+          for (x = lo[e]; x < hi[e]; x++)
+            o[x] += (a[x] + epsi) * (b[x] + epsi);
+        }
+      }
+
+      for (e = 0; e < nedges; e++) {
+        real *o = output_p + e*plane + y*iwidth;
+        real *n2 = (nn_SpatialGraph_dy[e] ? nb : na) + nn_SpatialGraph_dx[e];
+        for (x = lo[e]; x < hi[e]; x++) {
+          if (norm)
+            o[x] = 1 - o[x] / (sqrt(na[x]) * sqrt(n2[x]));
+          else
+            o[x] = ichannels - o[x];
+        }
+      }
+      THFree(norms);
+    }
+  }
+
+  // done
+  THTensor_(free)(input);
+  THTensor_(freeCopyTo)(output_c, output);
+  return 1;
+}
+
+/* backpropagates the edges of row y into rows y and y+1 of gradInput;
+   rows of the same parity never touch the same gradInput rows */
+static void nn_(SpatialGraph_backwardRow)(real *input_p, real *output_p, real *gradOutput_p, real *gradInput_p,
+                                          long y, long iheight, long iwidth, long ichannels, int nedges,
+                                          int dist, int norm, real *buffer)
+{
+  long plane = iwidth*iheight;
+  long lo[4], hi[4];
+  long x, k;
+  int e;
+  real normer = (norm == 1) ? 1.0/ichannels : 1;
+
+  for (e = 0; e < nedges; e++)
+    nn_SpatialGraph_range(e, y, iheight, iwidth, &lo[e], &hi[e]);
 
-  // Euclidean distance
   if (dist == 0) {
-    // Sum[ (Xi - Xi+1)^2 ]
-    int x,y,k;
-    for (k=0; k<ichannels; k++) {
-      for (y=0; y<oheight; y++) {
-        for (x=0; x<owidth; x++) {
-          if (x < owidth-1) {
-            double temp = square(THTensor_(get3d)(input, k, y, x) - THTensor_(get3d)(input, k, y, x+1));
-            THTensor_(set3d)(output, 0, y, x, temp + THTensor_(get3d)(output, 0, y, x));
-          }
-          if (y < oheight-1) {
-            double temp = square(THTensor_(get3d)(input, k, y, x) - THTensor_(get3d)(input, k, y+1, x));
-            THTensor_(set3d)(output, 1, y, x, temp + THTensor_(get3d)(output, 1, y, x));
-          }
+    // d/dXi = (Xi - Xi+1) / dist * gradOutput
+    real *f = buffer;
+    for (e = 0; e < nedges; e++) {
+      real *o = output_p + e*plane + y*iwidth;
+      real *go = gradOutput_p + e*plane + y*iwidth;
+      real *fe = f + e*iwidth;
+      for (x = lo[e]; x < hi[e]; x++)
+        fe[x] = (o[x] != 0) ? go[x] * normer / o[x] : 0;
+    }
+    for (k = 0; k < ichannels; k++) {
+      real *a = input_p + k*plane + y*iwidth;
+      real *ga = gradInput_p + k*plane + y*iwidth;
+      for (e = 0; e < nedges; e++) {
+        long off = nn_SpatialGraph_dy[e]*iwidth + nn_SpatialGraph_dx[e];
+        real *b = a + off;
+        real *gb = ga + off;
+        real *fe = f + e*iwidth;
+        for (x = lo[e]; x < hi[e]; x++) {
+          real partial_d = (a[x] - b[x]) * fe[x];
+          ga[x] += partial_d;
+          gb[x] -= partial_d;
         }
       }
     }
 
-    // Sqrt[ Sum[ (Xi - Xi+1)^2 ] ]
-    for (k=0; k<ochannels; k++) {
-      for (y=0; y<oheight; y++) {
-        for (x=0; x<owidth; x++) {
-          THTensor_(set3d)(output, k, y, x, sqrt(THTensor_(get3d)(output, k, y, x)) * normer);
+    // Cosine
+  } else if (!norm) {
+    for (k = 0; k < ichannels; k++) {
+      real *a = input_p + k*plane + y*iwidth;
+      real *ga = gradInput_p + k*plane + y*iwidth;
+      for (e = 0; e < nedges; e++) {
+        long off = nn_SpatialGraph_dy[e]*iwidth + nn_SpatialGraph_dx[e];
+        real *b = a + off;
+        real *gb = ga + off;
+        real *go = gradOutput_p + e*plane + y*iwidth;
+        for (x = lo[e]; x < hi[e]; x++) {
+          ga[x] -= b[x] * go[x];
+          gb[x] -= a[x] * go[x];
         }
       }
     }
 
-    // Cosine dissimilarity
   } else {
-    // add epsilon to input (to get rid of 0s)
-    THTensor *inputb = THTensor_(newWithSize3d)(input->size[0], input->size[1], input->size[2]);
-    THTensor_(copy)(inputb, input);
-    THTensor_(add)(inputb, inputb, 1e-12);
-
-    // Sum[ (Xi * Xi+1) ]
-    int x,y,k;
-    for (y=0; y<oheight; y++) {
-      for (x=0; x<owidth; x++) {
-        double norm_A = 0;
-        double norm_B = 0;
-        double norm_C = 0;
-        for (k=0; k<ichannels; k++) {
-          norm_A += square(THTensor_(get3d)(inputb, k, y, x));
-          if (x < owidth-1) {
-            double temp = THTensor_(get3d)(inputb, k, y, x) * THTensor_(get3d)(inputb, k, y, x+1);
-            THTensor_(set3d)(output, 0, y, x, temp + THTensor_(get3d)(output, 0, y, x));
-            norm_B += square(THTensor_(get3d)(inputb, k, y, x+1));
-          }
-          if (y < oheight-1) {
-            double temp = THTensor_(get3d)(inputb, k, y, x) * THTensor_(get3d)(inputb, k, y+1, x);
-            THTensor_(set3d)(output, 1, y, x, temp + THTensor_(get3d)(output, 1, y, x));
-            norm_C += square(THTensor_(get3d)(inputb, k, y+1, x));
-          }
-        }
-        if (x < owidth-1) {
-          if (norm) {
-            THTensor_(set3d)(output, 0, y, x, 1 - THTensor_(get3d)(output, 0, y, x) / (sqrt(norm_A) * sqrt(norm_B)));
-          } else {
-            THTensor_(set3d)(output, 0, y, x, ichannels - THTensor_(get3d)(output, 0, y, x));
-          }
-        }
-        if (y < oheight-1) {
-          if (norm) {
-            THTensor_(set3d)(output, 1, y, x, 1 - THTensor_(get3d)(output, 1, y, x) / (sqrt(norm_A) * sqrt(norm_C)));
-          } else {
-            THTensor_(set3d)(output, 1, y, x, ichannels - THTensor_(get3d)(output, 1, y, x));
-          }
-        }
+    // sums of squares of rows y and y+1, and dot products along each edge
+    real epsi = 1e-12;
+    real *sa = buffer, *sb = buffer + iwidth, *dot = buffer + 2*iwidth;
+    real *t1 = buffer + (2+nedges)*iwidth;
+    real *t2 = t1 + nedges*iwidth;
+    real *t3 = t2 + nedges*iwidth;
+    for (x = 0; x < (2+nedges)*iwidth; x++)
+      buffer[x] = 0;
+    for (k = 0; k < ichannels; k++) {
+      real *a = input_p + k*plane + y*iwidth;
+      for (x = 0; x < iwidth; x++)
+        sa[x] += square(a[x]);
+      if (y < iheight-1)
+        for (x = 0; x < iwidth; x++)
+          sb[x] += square(a[x+iwidth]);
+      for (e = 0; e < nedges; e++) {
+        real *b = a + nn_SpatialGraph_dy[e]*iwidth + nn_SpatialGraph_dx[e];
+        real *de = dot + e*iwidth;
+        for (x = lo[e]; x < hi[e]; x++)
+          de[x] += a[x] * b[x];
       }
     }
 
-    // Cleanup
-    THTensor_(free)(inputb);
+    // d/dA [1 - AB/(|A||B|)] = AB/(|A|^3|B|) A - 1/(|A||B|) B
+    for (e = 0; e < nedges; e++) {
+      real *s2 = (nn_SpatialGraph_dy[e] ? sb : sa) + nn_SpatialGraph_dx[e];
+      real *de = dot + e*iwidth;
+      real *go = gradOutput_p + e*plane + y*iwidth;
+      for (x = lo[e]; x < hi[e]; x++) {
+        real nA = sqrt(sa[x]), nB = sqrt(s2[x]);
+        t1[e*iwidth+x] = go[x] / (nA*nB + epsi);
+        t2[e*iwidth+x] = go[x] * de[x] / (sa[x]*nA*nB + epsi);
+        t3[e*iwidth+x] = go[x] * de[x] / (s2[x]*nB*nA + epsi);
+      }
+    }
+    for (k = 0; k < ichannels; k++) {
+      real *a = input_p + k*plane + y*iwidth;
+      real *ga = gradInput_p + k*plane + y*iwidth;
+      for (e = 0; e < nedges; e++) {
+        long off = nn_SpatialGraph_dy[e]*iwidth + nn_SpatialGraph_dx[e];
+        real *b = a + off;
+        real *gb = ga + off;
+        real *t1e = t1 + e*iwidth, *t2e = t2 + e*iwidth, *t3e = t3 + e*iwidth;
+        for (x = lo[e]; x < hi[e]; x++) {
+          ga[x] += t2e[x]*a[x] - t1e[x]*b[x];
+          gb[x] += t3e[x]*b[x] - t1e[x]*a[x];
+        }
+      }
+    }
   }
-
-  return 1;
 }
 
 static int nn_(SpatialGraph_updateGradInput)(lua_State *L)
@@ -116,131 +262,51 @@ static int nn_(SpatialGraph_updateGradInput)(lua_State *L)
   THTensor *gradInput = luaT_getfieldcheckudata(L, 1, "gradInput", torch_Tensor);
   THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
   THTensor *gradOutput = luaT_checkudata(L, 3, torch_Tensor);
-  //int connex = luaT_getfieldcheckint(L, 1, "connex");
+  int connex = luaT_getfieldcheckint(L, 1, "connex");
   int dist = luaT_getfieldcheckint(L, 1, "dist");
   int norm = luaT_getfieldcheckint(L, 1, "normalize");
 
   // dims
-  //int iwidth = input->size[2];
-  //int iheight = input->size[1];
-  int ichannels = input->size[0];
-  int owidth = gradOutput->size[2];
-  int oheight = gradOutput->size[1];
-  //int ochannels = gradOutput->size[0];
+  long iwidth = input->size[2];
+  long iheight = input->size[1];
+  long ichannels = input->size[0];
+  int nedges = connex / 2;
 
-  // norm ?
-  double normer = (norm == 1) ? 1/sqrt(ichannels)/sqrt(ichannels) : 1;
+  luaL_argcheck(L, gradOutput->nDimension == 3 && gradOutput->size[0] == nedges
+                && gradOutput->size[1] == iheight && gradOutput->size[2] == iwidth,
+                3, "gradOutput does not match the output size");
 
-  // resize gradInput
-  THTensor_(zero)(gradInput);
+  // make contiguous
+  input = THTensor_(newContiguous)(input);
+  output = THTensor_(newContiguous)(output);
+  gradOutput = THTensor_(newContiguous)(gradOutput);
+  THTensor_(resizeAs)(gradInput, input);
+  THTensor *gradInput_c = THTensor_(newContiguous)(gradInput);
+  THTensor_(zero)(gradInput_c);
 
-  // compute derivatives, and backpropagate output error to input
-  if (dist == 0) {
-    int x,y,k;
-    for (k=0; k<ichannels; k++) {
-      for (y=0; y<oheight; y++) {
-        for (x=0; x<owidth; x++) {
-          if (x < owidth-1) {
-            double partial_d = THTensor_(get3d)(input, k, y, x) - THTensor_(get3d)(input, k, y, x+1);
-            if (partial_d != 0) partial_d /= THTensor_(get3d)(output, 0, y, x);
-            partial_d *= THTensor_(get3d)(gradOutput, 0, y, x) * normer;
-            THTensor_(set3d)(gradInput, k, y, x, partial_d + THTensor_(get3d)(gradInput, k, y, x));
-            THTensor_(set3d)(gradInput, k, y, x+1, -partial_d + THTensor_(get3d)(gradInput, k, y, x+1));
-          }
-          if (y < oheight-1) {
-            double partial_d = THTensor_(get3d)(input, k, y, x) - THTensor_(get3d)(input, k, y+1, x);
-            if (partial_d != 0) partial_d /= THTensor_(get3d)(output, 1, y, x);
-            partial_d *= THTensor_(get3d)(gradOutput, 1, y, x) * normer;
-            THTensor_(set3d)(gradInput, k, y, x, partial_d + THTensor_(get3d)(gradInput, k, y, x));
-            THTensor_(set3d)(gradInput, k, y+1, x, -partial_d + THTensor_(get3d)(gradInput, k, y+1, x));
-          }
-        }
-      }
-    }
+  real *input_p = THTensor_(data)(input);
+  real *output_p = THTensor_(data)(output);
+  real *gradOutput_p = THTensor_(data)(gradOutput);
+  real *gradInput_p = THTensor_(data)(gradInput_c);
 
-    // Cosine
-  } else {
-    int x,y,k;
-    for (y=0; y<oheight; y++) {
-      for (x=0; x<owidth; x++) {
-        double sum_A = 0;
-        double sum_B = 0;
-        double sum_C = 0;
-        double sum_AB = 0;
-        double sum_AC = 0;
-
-        if (norm) {
-          for (k=0; k<ichannels; k++) {
-            sum_A += square(THTensor_(get3d)(input, k, y, x));
-            if (x < owidth-1) {
-              sum_B += square(THTensor_(get3d)(input, k, y, x+1));
-              sum_AB += THTensor_(get3d)(input, k, y, x) * THTensor_(get3d)(input, k, y, x+1);
-            }
-            if (y < oheight-1) {
-              sum_C += square(THTensor_(get3d)(input, k, y+1, x));
-              sum_AC += THTensor_(get3d)(input, k, y, x) * THTensor_(get3d)(input, k, y+1, x);
-            }
-          }
-        }
-
-        double term1, term2, term3, partial_d;
-        double epsi = 1e-12;
-        if (x < owidth-1) {
-          if (norm) {
-            term1 = 1 / ( pow(sum_A, 1/2) * pow(sum_B, 1/2) + epsi );
-            term2 = sum_AB / ( pow(sum_A, 3/2) * pow(sum_B, 1/2) + epsi );
-            term3 = sum_AB / ( pow(sum_B, 3/2) * pow(sum_A, 1/2) + epsi );
-          }
-          for (k=0; k<ichannels; k++) {
-            if (norm) {
-              partial_d = term2 * THTensor_(get3d)(input, k, y, x)
-                - term1 * THTensor_(get3d)(input, k, y, x+1);
-            } else {
-              partial_d = -THTensor_(get3d)(input, k, y, x+1);
-            }
-            partial_d *= THTensor_(get3d)(gradOutput, 0, y, x);
-            THTensor_(set3d)(gradInput, k, y, x, partial_d + THTensor_(get3d)(gradInput, k, y, x));
-
-            if (norm) {
-              partial_d = term3 * THTensor_(get3d)(input, k, y, x+1)
-                - term1 * THTensor_(get3d)(input, k, y, x);
-            } else {
-              partial_d = -THTensor_(get3d)(input, k, y, x);
-            }
-            partial_d *= THTensor_(get3d)(gradOutput, 0, y, x);
-            THTensor_(set3d)(gradInput, k, y, x+1, partial_d + THTensor_(get3d)(gradInput, k, y, x+1));
-          }
-        }
-        if (y < oheight-1) {
-          if (norm) {
-            term1 = 1 / ( pow(sum_A, 1/2) * pow(sum_C, 1/2) + epsi );
-            term2 = sum_AC / ( pow(sum_A, 3/2) * pow(sum_C, 1/2) + epsi );
-            term3 = sum_AC / ( pow(sum_C, 3/2) * pow(sum_A, 1/2) + epsi );
-          }
-          for (k=0; k<ichannels; k++) {
-            if (norm) {
-              partial_d = term2 * THTensor_(get3d)(input, k, y, x)
-                - term1 * THTensor_(get3d)(input, k, y+1, x);
-            } else {
-              partial_d = -THTensor_(get3d)(input, k, y+1, x);
-            }
-            partial_d *= THTensor_(get3d)(gradOutput, 1, y, x);
-            THTensor_(set3d)(gradInput, k, y, x, partial_d + THTensor_(get3d)(gradInput, k, y, x));
-
-            if (norm) {
-              partial_d = term3 * THTensor_(get3d)(input, k, y+1, x)
-                - term1 * THTensor_(get3d)(input, k, y, x);
-            } else {
-              partial_d = -THTensor_(get3d)(input, k, y, x);
-            }
-            partial_d *= THTensor_(get3d)(gradOutput, 1, y, x);
-            THTensor_(set3d)(gradInput, k, y+1, x, partial_d + THTensor_(get3d)(gradInput, k, y+1, x));
-          }
-        }
-      }
+  // compute derivatives, and backpropagate output error to input:
+  // even rows first, then odd rows
+  long y, parity;
+  for (parity = 0; parity < 2; parity++) {
+#pragma omp parallel for private(y)
+    for (y = parity; y < iheight; y += 2) {
+      real *buffer = THAlloc(sizeof(real)*(2+4*nedges)*iwidth);
+      nn_(SpatialGraph_backwardRow)(input_p, output_p, gradOutput_p, gradInput_p,
+                                    y, iheight, iwidth, ichannels, nedges, dist, norm, buffer);
+      THFree(buffer);
     }
   }
 
+  // done
+  THTensor_(free)(input);
+  THTensor_(free)(output);
+  THTensor_(free)(gradOutput);
+  THTensor_(freeCopyTo)(gradInput_c, gradInput);
   return 1;
 }
 
@@ -6,6 +6,43 @@
 #define max(x,y) (((x)>(y)) ? (x) : (y))
 #define min(x,y) (((x)>(y)) ? (y) : (x))
 
+/* columns of a row processed together: the cost block (maxw x tile) and
+   the input rows it reads stay in cache across channels and displacements */
+#define SpatialMatching_TILE 256
+
+/* value of the displacements that fall outside of input2 */
+#define SpatialMatching_INVALID 1e30
+
+/*
+ * Costs of row y1 of input1, columns [x0,x0+n), against row y2 of input2,
+ * for all horizontal displacements: cost[dx*n+x] is the squared distance
+ * between input1(y1,x0+x) and input2(y2,x0+x+dx+offx). Only [lo[dx],hi[dx])
+ * is computed, the rest falls outside of input2. The rows are loaded once
+ * per channel and reused for every dx; the inner loop runs along x.
+ */
+static void nn_(SpatialMatching_costRow)(real *cost, real *r1, real *r2, long nchannels,
+                                         long plane1, long plane2, long n, long offx,
+                                         int maxw, long *lo, long *hi)
+{
+  long k, dx, x;
+  for (dx = 0; dx < maxw; dx++)
+    for (x = 0; x < n; x++)
+      cost[dx*n+x] = 0;
+
+  for (k = 0; k < nchannels; k++) {
+    real *a = r1 + k*plane1;
+    real *b = r2 + k*plane2;
+    for (dx = 0; dx < maxw; dx++) {
+      real *c = cost + dx*n;
+      long s = dx + offx;
+      for (x = lo[dx]; x < hi[dx]; x++) {
+        real d = a[x] - b[x+s];
+        c[x] += d*d;
+      }
+    }
+  }
+}
+
 static int nn_(SpatialMatching_updateOutput)(lua_State *L)
 {
   // get all params
@@ -14,99 +51,147 @@ static int nn_(SpatialMatching_updateOutput)(lua_State *L)
   int maxw = luaT_getfieldcheckint(L, 1, "maxw");
   int maxh = luaT_getfieldcheckint(L, 1, "maxh");
   int full_output = luaT_getfieldcheckboolean(L, 1, "full_output");
+  int topk = 0;
   THTensor *output = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
+  THTensor *indices = NULL;
+  THTensor *output_c, *indices_c = NULL;
 
-  // dims
-  int iwidth = input1->size[2];
-  int iheight = input1->size[1];
-  int ichannels = input1->size[0];
+  // keep the k best displacements only (winner-take-all)
+  lua_getfield(L, 1, "topk");
+  if (!lua_isnil(L, -1))
+    topk = luaL_checkint(L, -1);
+  lua_pop(L, 1);
+  luaL_argcheck(L, topk >= 0 && topk <= maxh*maxw, 1, "topk must be between 0 and maxh*maxw");
 
-  // make contiguous
-  //input1 = THTensor_(newContiguous)(input1);
-  //input2 = THTensor_(newContiguous)(input2);
-  //output = THTensor_(newContiguous)(output);
+  luaL_argcheck(L, input1->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, input2->nDimension == 3 && input2->size[0] == input1->size[0], 3,
+                "3D tensor with as many channels as input1 expected");
 
-  // zero output
-  THTensor_(fill)(output, 1e30);
+  // dims
+  long iwidth = input1->size[2];
+  long iheight = input1->size[1];
+  long ichannels = input1->size[0];
+  long i2width = input2->size[2];
 
-  // get strides
-  long *i1s = input1->stride;
-  long *i2s = input2->stride;
-  long *os  = output->stride;
+  // displacement (dy,dx) compares (y1,x1) with (y1+dy+offy,x1+dx+offx);
+  // in full mode, displacements are centered and bounded by the size of input1
+  long offy = 0, offx = 0, ylim, xlim;
+  if (full_output) {
+    offy = -(ceil((real)maxh/2)-1);
+    offx = -(ceil((real)maxw/2)-1);
+    ylim = iheight;
+    xlim = iwidth;
+    luaL_argcheck(L, input2->size[1] >= iheight && i2width >= iwidth, 3,
+                  "input2 must be at least as large as input1");
+  } else {
+    ylim = iheight + maxh - 1;
+    xlim = iwidth + maxw - 1;
+    luaL_argcheck(L, input2->size[1] >= ylim && i2width >= xlim, 3,
+                  "input2 must be larger than input1 by (maxh-1,maxw-1)");
+  }
+
+  // make contiguous
+  input1 = THTensor_(newContiguous)(input1);
+  input2 = THTensor_(newContiguous)(input2);
+  output_c = THTensor_(newContiguous)(output);
+  if (topk > 0) {
+    indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
+    THTensor_(resize3d)(indices, iheight, iwidth, topk);
+    indices_c = THTensor_(newContiguous)(indices);
+  }
 
   // get pointers
   real *input1_p = THTensor_(data)(input1);
   real *input2_p = THTensor_(data)(input2);
-  real *output_p = THTensor_(data)(output);
+  real *output_p = THTensor_(data)(output_c);
+  real *indices_p = indices_c ? THTensor_(data)(indices_c) : NULL;
+  long plane1 = iheight*iwidth;
+  long plane2 = input2->size[1]*i2width;
+  long tile = min(iwidth, SpatialMatching_TILE);
 
-  // compute output
-  int x1,y1,x2,y2,k;
-  real dist;
-  if (full_output) {
-    // get halves of window size
-    int halfh1 = ceil((real)maxh/2)-1;
-    int halfh2 = floor((real)maxh/2)+1;
-    int halfw1 = ceil((real)maxw/2)-1;
-    int halfw2 = floor((real)maxw/2)+1;
+  // compute output, one row of input1 at a time
+  long y1;
+#pragma omp parallel for private(y1)
+  for (y1 = 0; y1 < iheight; y1++) {
+    real *cost = THAlloc(sizeof(real)*maxw*tile);
+    long *lo = THAlloc(sizeof(long)*maxw);
+    long *hi = THAlloc(sizeof(long)*maxw);
+    real *bestv = NULL, *besti = NULL;
+    long x0, x, dx, dy, j;
+    if (topk > 0) {
+      bestv = THAlloc(sizeof(real)*tile*topk);
+      besti = THAlloc(sizeof(real)*tile*topk);
+    }
 
-    long dy, dx;
-    
-    #pragma omp parallel for private(x1,x2,y2,k,dist,dy,dx)
-    for (y1 = 0; y1 < iheight; y1++) {
-      for (x1 = 0; x1 < iwidth; x1++) {
-	for (y2 = max(0,y1-halfh1); y2 < min(iheight,y1+halfh2); y2++) {
-	  for (x2 = max(0,(x1-halfw1)); x2 < min(iwidth,x1+halfw2); x2++) {
-	    dist = 0;
-	    for (k = 0; k < ichannels; k++) {
-	      dist += square(input1_p[k*i1s[0] + y1*i1s[1] + x1*i1s[2]] - input2_p[k*i2s[0] + y2*i2s[1] + x2*i2s[2]]);
-	    }
-	    dy = y2-y1 + halfh1;
-	    dx = x2-x1 + halfw1;
-	    output_p[dy*os[2] + dx*os[3] + y1*os[0] + x1*os[1]] = dist;
-	  }
-	}
+    for (x0 = 0; x0 < iwidth; x0 += tile) {
+      long n = min(tile, iwidth-x0);
+      for (dx = 0; dx < maxw; dx++) {
+        lo[dx] = min(n, max(0, -(x0+dx+offx)));
+        hi[dx] = max(lo[dx], min(n, xlim-(x0+dx+offx)));
       }
-    }
-    /*
-    real *input1_p_it_start = input1_p, *input1_p_it_end = input1_p+ichannels*i1s[0];
-    real *input1_p_it, *input2_p_it;
-    for (y1 = 0; y1 < iheight; y1++) {
-      for (x1 = 0; x1 < iwidth; x1++, ++input1_p_it_start, ++input1_p_it_end) {
-	for (y2 = max(0,y1-halfh1); y2 < min(iheight,y1+halfh2); y2++) {
-	  for (x2 = max(0,(x1-halfw1)); x2 < min(iwidth,x1+halfw2); x2++) {
-	    dist = 0;
-	    for (input1_p_it = input1_p_it_start, input2_p_it=input2_p+y2*i2s[1]+x2*i2s[2];
-		 input1_p_it != input1_p_it_end;
-		 input1_p_it += i1s[0], input2_p_it += i2s[0]) {
-	      dist += square(*input1_p_it - *input2_p_it);
-	    }
-	    dy = y2-y1 + halfh1;
-	    dx = x2-x1 + halfw1;
-	    output_p[dy*os[0] + dx*os[1] + y1*os[2] + x1*os[3]] = dist;
-	  }
-	}
+      if (topk > 0) {
+        for (j = 0; j < n*topk; j++) {
+          bestv[j] = SpatialMatching_INVALID;
+          besti[j] = 0;
+        }
       }
-    }
-    */
-  } else {
-#pragma omp parallel for private(y1,x1,x2,y2,k,dist)
-    for (y1 = 0; y1 < iheight; y1++) {
-      for (x1 = 0; x1 < iwidth; x1++) {
-	for (y2 = y1; y2 < y1+maxh; y2++) {
-	  for (x2 = x1; x2 < x1+maxw; x2++) {
-	    dist = 0;
-	    for (k = 0; k < ichannels; k++) {
-	      dist += square(input1_p[k*i1s[0] + y1*i1s[1] + x1*i1s[2]] - input2_p[k*i2s[0] + y2*i2s[1] + x2*i2s[2]]);
-	    }
-	    output_p[(y2-y1)*os[2] + (x2-x1)*os[3] + y1*os[0] + x1*os[1]] = dist;
-	  }
-	}
+
+      for (dy = 0; dy < maxh; dy++) {
+        long y2 = y1+dy+offy;
+        int valid = (y2 >= 0 && y2 < ylim);
+        if (valid)
+          nn_(SpatialMatching_costRow)(cost, input1_p + y1*iwidth + x0,
+                                       input2_p + y2*i2width + x0,
+                                       ichannels, plane1, plane2, n, offx, maxw, lo, hi);
+
+        if (topk == 0) {
+          // dense volume: output(y1,x,dy,dx)
+          real *o = output_p + ((y1*iwidth + x0)*maxh + dy)*maxw;
+          for (x = 0; x < n; x++, o += maxh*maxw)
+            for (dx = 0; dx < maxw; dx++)
+              o[dx] = (valid && x >= lo[dx] && x < hi[dx]) ? cost[dx*n+x] : SpatialMatching_INVALID;
+        } else if (valid) {
+          // winner-take-all: insert into the sorted k best of each pixel
+          for (dx = 0; dx < maxw; dx++) {
+            real *c = cost + dx*n;
+            real idx = dy*maxw + dx + 1;
+            for (x = lo[dx]; x < hi[dx]; x++) {
+              real *bv = bestv + x*topk;
+              real *bi = besti + x*topk;
+              if (c[x] < bv[topk-1]) {
+                for (j = topk-1; j > 0 && bv[j-1] > c[x]; j--) {
+                  bv[j] = bv[j-1];
+                  bi[j] = bi[j-1];
+                }
+                bv[j] = c[x];
+                bi[j] = idx;
+              }
+            }
+          }
+        }
+      }
+
+      if (topk > 0) {
+        memcpy(output_p + (y1*iwidth + x0)*topk, bestv, sizeof(real)*n*topk);
+        memcpy(indices_p + (y1*iwidth + x0)*topk, besti, sizeof(real)*n*topk);
       }
     }
+
+    THFree(cost);
+    THFree(lo);
+    THFree(hi);
+    if (topk > 0) {
+      THFree(bestv);
+      THFree(besti);
+    }
   }
-    
 
   // done
+  THTensor_(free)(input1);
+  THTensor_(free)(input2);
+  THTensor_(freeCopyTo)(output_c, output);
+  if (indices_c)
+    THTensor_(freeCopyTo)(indices_c, indices);
   return 1;
 }
 
@@ -144,7 +229,38 @@ static int nn_(SpatialMatching_updateGradInput)(lua_State *L)
   // compute gradients
   int x1, y1, x2, y2, k;
   real partial_d;
-  if (full_output) {
+  int topk = 0;
+  lua_getfield(L, 1, "topk");
+  if (!lua_isnil(L, -1))
+    topk = luaL_checkint(L, -1);
+  lua_pop(L, 1);
+  if (topk > 0) {
+    // only the selected displacements received a gradient
+    THTensor *indices = luaT_getfieldcheckudata(L, 1, "indices", torch_Tensor);
+    long *is = indices->stride;
+    real *indices_p = THTensor_(data)(indices);
+    int offy = full_output ? -(ceil((real)maxh/2)-1) : 0;
+    int offx = full_output ? -(ceil((real)maxw/2)-1) : 0;
+    int j;
+    long idx;
+    for (y1 = 0; y1 < iheight; y1++) {
+      for (x1 = 0; x1 < iwidth; x1++) {
+	for (j = 0; j < topk; j++) {
+	  idx = (long)indices_p[y1*is[0] + x1*is[1] + j*is[2]] - 1;
+	  if (idx < 0)
+	    continue;
+	  y2 = y1 + idx/maxw + offy;
+	  x2 = x1 + idx%maxw + offx;
+	  for (k = 0; k < ichannels; k++) {
+	    partial_d = 2*(input1_p[k*i1s[0] + y1*i1s[1] + x1*i1s[2]] - input2_p[k*i2s[0] + y2*i2s[1] + x2*i2s[2]]);
+	    partial_d *= gradOutput_p[y1*gos[0] + x1*gos[1] + j*gos[2]];
+	    gradInput1_p[k*gi1s[0] + y1*gi1s[1] + x1*gi1s[2]] += partial_d;
+	    gradInput2_p[k*gi2s[0] + y2*gi2s[1] + x2*gi2s[2]] -= partial_d;
+	  }
+	}
+      }
+    }
+  } else if (full_output) {
     // get halves of window size
     int halfh1 = ceil((real)maxh/2)-1;
     int halfh2 = floor((real)maxh/2)+1;
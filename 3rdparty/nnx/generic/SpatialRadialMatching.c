@@ -11,47 +11,64 @@ static int nn_(SpatialRadialMatching_updateOutput)(lua_State *L)
   // get all params
   THTensor *input1  = luaT_checkudata(L, 2, torch_Tensor);
   THTensor *input2  = luaT_checkudata(L, 3, torch_Tensor);
-  //THLongTensor *mask= luaT_checkudata(L, 4, luaT_checktypename2id(L, "torch.LongTensor"));
   int maxh          = luaT_getfieldcheckint(L, 1, "maxh");
   THTensor *output  = luaT_getfieldcheckudata(L, 1, "output", torch_Tensor);
+  THTensor *output_c;
+
+  luaL_argcheck(L, input1->nDimension == 3, 2, "3D tensor expected");
+  luaL_argcheck(L, input2->nDimension == 3 && input2->size[0] == input1->size[0], 3,
+                "3D tensor with as many channels as input1 expected");
 
   // dims
-  int iwidth = input1->size[2];
-  int iheight = input1->size[1];
-  int ichannels = input1->size[0];
+  long iwidth = input1->size[2];
+  long iheight = input1->size[1];
+  long ichannels = input1->size[0];
+  long i2width = input2->size[2];
+  luaL_argcheck(L, input2->size[1] >= iheight+maxh-1 && i2width >= iwidth, 3,
+                "input2 must be taller than input1 by maxh-1");
 
-  // get strides
-  long *i1s = input1->stride;
-  long *i2s = input2->stride;
-  //long *ms  = mask  ->stride;
-  long *os  = output->stride;
+  // make contiguous
+  input1 = THTensor_(newContiguous)(input1);
+  input2 = THTensor_(newContiguous)(input2);
+  output_c = THTensor_(newContiguous)(output);
 
   // get pointers
   real *input1_p = THTensor_(data)(input1);
   real *input2_p = THTensor_(data)(input2);
-  //long *mask_p   = THLongTensor_data(mask);
-  real *output_p = THTensor_(data)(output);
+  real *output_p = THTensor_(data)(output_c);
+  long plane1 = iheight*iwidth;
+  long plane2 = input2->size[1]*i2width;
 
-  // compute output
-  int x1,y1,y2,k;
-  real dist;
-#pragma omp parallel for private(y1,x1,y2,k,dist)
+  // compute output: for each row and vertical displacement, the rows of
+  // both inputs are walked once per channel, along x
+  long y1;
+#pragma omp parallel for private(y1)
   for (y1 = 0; y1 < iheight; y1++) {
-    for (x1 = 0; x1 < iwidth; x1++) {
-      //if (mask_p[y1*ms[0] + x1*ms[1]]) {
-	for (y2 = y1; y2 < y1+maxh; y2++) {
-	  dist = 0.0f;
-	  for (k = 0; k < ichannels; k++)
-	    dist += square(  input1_p[k*i1s[0] + y1*i1s[1] + x1*i1s[2]]
-			     - input2_p[k*i2s[0] + y2*i2s[1] + x1*i2s[2]]);
-	  output_p[(y2-y1)*os[2] + y1*os[0] + x1*os[1]] = dist;
-	}
-	//}
+    real *cost = THAlloc(sizeof(real)*iwidth);
+    long x, y2, k;
+    for (y2 = y1; y2 < y1+maxh; y2++) {
+      real *o = output_p + y1*iwidth*maxh + (y2-y1);
+      for (x = 0; x < iwidth; x++)
+        cost[x] = 0;
+      for (k = 0; k < ichannels; k++) {
+        real *a = input1_p + k*plane1 + y1*iwidth;
+        real *b = input2_p + k*plane2 + y2*i2width;
+        for (x = 0; x < iwidth; x++) {
+          real d = a[x] - b[x];
+          cost[x] += d*d;
+        }
+      }
+      for (x = 0; x < iwidth; x++)
+        o[x*maxh] = cost[x];
     }
+    THFree(cost);
   }
-  
+
   // done
-  return 0;
+  THTensor_(free)(input1);
+  THTensor_(free)(input2);
+  THTensor_(freeCopyTo)(output_c, output);
+  return 1;
 }
 
 static int nn_(SpatialRadialMatching_updateGradInput)(lua_State *L)
@@ -365,8 +365,8 @@ end
 function nnxtest.SpatialPyramid_focused() template_SpatialPyramid(5,3) end
 function nnxtest.SpatialPyramid_unfocused() template_SpatialPyramid() end
 
-local function template_SpatialGraph(channels, iwidth, iheight, dist, norm)
-   local module = nn.SpatialGraph{normalize=norm, dist=dist}
+local function template_SpatialGraph(channels, iwidth, iheight, dist, norm, connex)
+   local module = nn.SpatialGraph{normalize=norm, dist=dist, connex=connex}
    local input = torch.rand(iwidth, iheight, channels)
    local err = nn.Jacobian.testJacobian(module, input, 0.1, 1)
    mytester:assertlt(err, precision, 'error on state ')
@@ -380,6 +380,9 @@ function nnxtest.SpatialGraph_2() template_SpatialGraph(16, 4, 4, 'euclid', true
 function nnxtest.SpatialGraph_3() template_SpatialGraph(256, 2, 2, 'euclid', false) end
 function nnxtest.SpatialGraph_4() template_SpatialGraph(2, 16, 16, 'cosine', false) end
 function nnxtest.SpatialGraph_5() template_SpatialGraph(64, 3, 3, 'cosine', false) end
+function nnxtest.SpatialGraph_6() template_SpatialGraph(8, 12, 10, 'cosine', true) end
+function nnxtest.SpatialGraph_7() template_SpatialGraph(3, 16, 16, 'euclid', true, 8) end
+function nnxtest.SpatialGraph_8() template_SpatialGraph(4, 9, 13, 'cosine', true, 8) end
 
 local function template_SpatialMatching(channels, iwidth, iheight, maxw, maxh, full_output)
    local module = nn.Sequential()
@@ -407,6 +410,37 @@ function nnxtest.SpatialMatching_4() template_SpatialMatching(3, 20, 20, 4, 4, f
 function nnxtest.SpatialMatching_5() template_SpatialMatching(3, 12, 16, 5, 7, true) end
 --function nnxtest.SpatialMatching_6() template_SpatialMatching(4, 16, 32, 9, 5, false) end
 
+function nnxtest.SpatialMatching_topk()
+   local maxh, maxw, k = 5, 7, 4
+   for _,full_output in ipairs{true, false} do
+      local input1 = torch.rand(3, 10, 12)
+      local input2 = torch.rand(3, 10+maxh-1, 12+maxw-1)
+      local dense = nn.SpatialMatching(maxh, maxw, full_output)
+      local wta = nn.SpatialMatching(maxh, maxw, full_output, k)
+      local input = {input1, input2}
+
+      local volume = dense:forward(input):clone():resize(10, 12, maxh*maxw)
+      local sorted, order = torch.sort(volume, 3)
+      local best = wta:forward(input)
+      mytester:assertlt(best:dist(sorted:narrow(3, 1, k)), precision, 'error on top k distances ')
+      mytester:assertlt(wta.indices:dist(order:narrow(3, 1, k):typeAs(wta.indices)), precision, 'error on top k indices ')
+
+      local gradOutput = torch.rand(10, 12, k)
+      local gradVolume = torch.zeros(10, 12, maxh*maxw)
+      for y = 1,10 do
+         for x = 1,12 do
+            for j = 1,k do
+               gradVolume[y][x][wta.indices[y][x][j]] = gradOutput[y][x][j]
+            end
+         end
+      end
+      local gradInput = dense:backward(input, gradVolume:resize(10, 12, maxh, maxw))
+      local gradInputk = wta:backward(input, gradOutput)
+      mytester:assertlt(gradInputk[1]:dist(gradInput[1]), precision, 'error on top k gradInput1 ')
+      mytester:assertlt(gradInputk[2]:dist(gradInput[2]), precision, 'error on top k gradInput2 ')
+   end
+end
+
 function nnx.test()
    xlua.require('image',true)
    mytester = torch.Tester()
@@ -17,3 +17,47 @@ MACRO(ADD_TORCH_LUA2EXE lua_exe lua_file)
   TARGET_LINK_LIBRARIES("${lua_exe}" liblua-shared)
 
 ENDMACRO(ADD_TORCH_LUA2EXE lua_exe lua_file)
+
+# Bundles the Lua files of a package (if it has an init.lua) into
+# ${package}.lua, in the current binary directory. Tests are left out.
+# Bytecode must be produced by the Lua which will load it: when cross
+# compiling (or if the target Lua cannot run on the build machine), the
+# bundle keeps the Lua sources (it is then produced by the host luajit, as
+# for wrappers).
+OPTION(WITH_LUA_BUNDLE_BYTECODE "Precompile Lua package bundles with the Lua being built" ON)
+
+MACRO(ADD_TORCH_LUA_BUNDLE package luasrc)
+
+  SET(_bundle_files_)
+  SET(_bundle_init_ FALSE)
+  FOREACH(_file_ ${luasrc})
+    IF(NOT IS_ABSOLUTE "${_file_}")
+      SET(_file_ "${CMAKE_CURRENT_SOURCE_DIR}/${_file_}")
+    ENDIF(NOT IS_ABSOLUTE "${_file_}")
+    IF("${_file_}" MATCHES "\\.lua$" AND NOT "${_file_}" MATCHES "/test/")
+      LIST(APPEND _bundle_files_ "${_file_}")
+      IF("${_file_}" STREQUAL "${CMAKE_CURRENT_SOURCE_DIR}/init.lua")
+        SET(_bundle_init_ TRUE)
+      ENDIF("${_file_}" STREQUAL "${CMAKE_CURRENT_SOURCE_DIR}/init.lua")
+    ENDIF("${_file_}" MATCHES "\\.lua$" AND NOT "${_file_}" MATCHES "/test/")
+  ENDFOREACH(_file_)
+
+  IF(_bundle_init_)
+    IF(CMAKE_CROSSCOMPILING OR NOT WITH_LUA_BUNDLE_BYTECODE)
+      SET(_bundle_lua_ luajit)
+      SET(_bundle_flags_)
+      SET(_bundle_deps_)
+    ELSE(CMAKE_CROSSCOMPILING OR NOT WITH_LUA_BUNDLE_BYTECODE)
+      SET(_bundle_lua_ "${Torch_SOURCE_LUA}")
+      SET(_bundle_flags_ "-b")
+      SET(_bundle_deps_ "${Torch_SOURCE_LUA}")
+    ENDIF(CMAKE_CROSSCOMPILING OR NOT WITH_LUA_BUNDLE_BYTECODE)
+    ADD_CUSTOM_COMMAND(
+      OUTPUT "${CMAKE_CURRENT_BINARY_DIR}/${package}.lua"
+      COMMAND ${_bundle_lua_}
+      ARGS "${Torch_SOURCE_CMAKE}/lua2exe/lua2bundle.lua" ${_bundle_flags_} "${package}" "${CMAKE_CURRENT_SOURCE_DIR}" "${CMAKE_CURRENT_BINARY_DIR}/${package}.lua" ${_bundle_files_}
+      DEPENDS ${_bundle_files_} ${_bundle_deps_} "${Torch_SOURCE_CMAKE}/lua2exe/lua2bundle.lua")
+    ADD_CUSTOM_TARGET(${package}-bundle ALL DEPENDS "${CMAKE_CURRENT_BINARY_DIR}/${package}.lua")
+  ENDIF(_bundle_init_)
+
+ENDMACRO(ADD_TORCH_LUA_BUNDLE)
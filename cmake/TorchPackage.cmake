@@ -1,5 +1,7 @@
 # -*- cmake -*-
 
+INCLUDE(TorchLua2exe)
+
 MACRO(ADD_TORCH_PACKAGE package src luasrc)
 
   INCLUDE_DIRECTORIES(${CMAKE_CURRENT_SOURCE_DIR} ${Torch_SOURCE_INCLUDES})
@@ -16,5 +18,10 @@ MACRO(ADD_TORCH_PACKAGE package src luasrc)
       INSTALL_NAME_DIR "@executable_path/${Torch_INSTALL_BIN2CPATH}")
         
   ENDIF(src)
+
+  ### Lua sources
+  IF(luasrc)
+    ADD_TORCH_LUA_BUNDLE(${package} "${luasrc}")
+  ENDIF(luasrc)
       
 ENDMACRO(ADD_TORCH_PACKAGE)
@@ -0,0 +1,132 @@
+-- Bundles the Lua files of a package into a single file.
+--
+-- usage: lua2bundle.lua [-b] package srcdir bundle file1.lua [file2.lua...]
+--
+-- The bundle registers every file in package.preload, under the name
+-- torch.include() and require() use for it (package.subdir.file), and then
+-- runs the package init.lua. Files are kept in the bundle as strings, compiled
+-- only when they are first required. With -b, the whole bundle is instead
+-- precompiled to (stripped, if the Lua running this script supports it)
+-- bytecode, which then must be loaded by the same Lua as the one running
+-- this script.
+--
+-- Files which only define a class, i.e. whose top-level statements are the
+-- torch.class() call and local or method definitions, are declared to
+-- torch.autoload(): they are loaded on first access to their class only.
+
+local bytecode = false
+if arg[1] == '-b' then
+   bytecode = true
+   table.remove(arg, 1)
+end
+
+local package, srcdir, bundlefile = arg[1], arg[2], arg[3]
+assert(package and srcdir and bundlefile and arg[4],
+       'usage: lua2bundle.lua [-b] package srcdir bundle file1.lua [file2.lua...]')
+srcdir = srcdir:gsub('/$', '') .. '/'
+
+local function readfile(filename)
+   local f = io.open(filename)
+   if not f then
+      error('could not open Lua file ' .. filename .. ' (read mode)')
+   end
+   local str = f:read('*all')
+   f:close()
+   return str
+end
+
+-- the class defined by a file, if it does nothing else
+local function classof(src)
+   local classlocal, tname, parenttname
+   src = src:gsub('%[(=*)%[.-%]%1%]', '""') -- long strings and comments
+   for line in src:gmatch('[^\n]*') do
+      local l, t, p = line:match("^local%s+([%w_]+)%s*,?%s*[%w_]*%s*=%s*torch%.class%(%s*['\"]([%w_.]+)['\"]%s*,?%s*['\"]?([%w_.]*)['\"]?%s*%)")
+      if l then
+         if classlocal then
+            return -- more than one class
+         end
+         classlocal, tname, parenttname = l, t, p
+      elseif line:match('^[%a_]') then
+         local name = line:match('^function%s+([%w_]+)[.:]')
+         if not (line:match('^local%s') or line:match('^end') or line:match('^return%s') or line:match('^%-%-')
+                 or (name and name == classlocal)) then
+            return
+         end
+      end
+   end
+   if tname and tname:match('%.') then
+      return tname, (parenttname ~= '' and parenttname or nil)
+   end
+end
+
+local modules = {}
+local classes = {}
+for i=4,#arg do
+   local filename = arg[i]
+   local relname = filename
+   if relname:sub(1, #srcdir) == srcdir then
+      relname = relname:sub(#srcdir+1)
+   end
+   local req = package .. '.' .. relname:gsub('%.lua$', '')
+   if relname == 'init.lua' then
+      req = package
+   end
+   local src = readfile(filename)
+   assert(loadstring(src, '@' .. filename))
+   if bytecode then
+      table.insert(modules, string.format('[%q] = function(...)\n%s\nend,', req, src))
+   else
+      table.insert(modules, string.format('[%q] = %q,', req, src))
+   end
+   local tname, parenttname = classof(src)
+   if tname and req ~= package then
+      table.insert(classes, string.format('{%q, %q, %s},', req, tname, parenttname and string.format('%q', parenttname) or 'nil'))
+   end
+end
+assert(#modules == #arg-3)
+
+local bundle = {
+   '-- ' .. package .. ' package bundle, generated by lua2bundle.lua',
+   'local modules = {',
+   table.concat(modules, '\n'),
+   '}',
+   'local classes = {',
+   table.concat(classes, '\n'),
+   '}',
+   ([[
+local function loader(name)
+   return function(...)
+             local chunk = modules[name]
+             modules[name] = nil
+             if type(chunk) == 'string' then
+                chunk = assert(loadstring(chunk, '@' .. name:gsub('%.', '/') .. '.lua'))
+             end
+             return chunk(...)
+          end
+end
+for name in pairs(modules) do
+   if name ~= PACKAGE then
+      package.preload[name] = loader(name)
+   end
+end
+if torch and torch.autoload then
+   for _,class in ipairs(classes) do
+      torch.autoload(class[1], class[2], class[3])
+   end
+end
+return loader(PACKAGE)(...)
+]]):gsub('PACKAGE', string.format('%q', package)),
+   ''
+}
+
+bundle = table.concat(bundle, '\n')
+if bytecode then
+   bundle = string.dump(assert(loadstring(bundle, '=' .. package)), true)
+end
+
+local f = io.open(bundlefile, 'wb')
+if not f then
+   error('could not open bundle file (write mode)')
+end
+f:write(bundle)
+f:close()
@@ -0,0 +1,49 @@
+-- Cold start benchmark: time to load the Torch packages, the way
+-- framework/Torch.m does, and to run a first forward of a small network.
+--
+-- usage: startup.lua luadir [bundle]
+--
+-- luadir holds the Lua packages (<package>/init.lua), or with "bundle" the
+-- package bundles (<package>.lua) produced by lua2bundle.lua. Run it in a
+-- fresh process each time: it measures one cold start only.
+
+local luadir, mode = arg[1], arg[2] or 'source'
+assert(luadir and (mode == 'source' or mode == 'bundle'),
+       'usage: startup.lua luadir [bundle]')
+
+package.path = luadir .. '/?.lua;' .. luadir .. '/?/init.lua;' .. package.path
+
+local clock = os.clock
+local t0 = clock()
+local times = {}
+
+local function load(package)
+   local t = clock()
+   require('lib' .. package)
+   if mode == 'bundle' then
+      dofile(luadir .. '/' .. package .. '.lua')
+   else
+      dofile(luadir .. '/' .. package .. '/init.lua')
+   end
+   table.insert(times, string.format('%-8s %8.2f ms', package, (clock()-t)*1000))
+end
+
+load('torch')
+load('nn')
+load('nnx')
+load('image')
+local tload = clock()
+
+local net = nn.Sequential()
+net:add(nn.SpatialConvolution(3, 8, 5, 5))
+net:add(nn.Tanh())
+net:add(nn.SpatialMaxPooling(2, 2, 2, 2))
+net:add(nn.Reshape(8*14*14))
+net:add(nn.Linear(8*14*14, 10))
+net:add(nn.LogSoftMax())
+net:forward(torch.rand(3, 32, 32))
+local tforward = clock()
+
+print(table.concat(times, '\n'))
+print(string.format('%-8s %8.2f ms', 'load', (tload-t0)*1000))
+print(string.format('%-8s %8.2f ms', 'forward', (tforward-t0)*1000))
@@ -938,6 +938,20 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       }
       break;
     }
+    case LUA_GCSLICE: {
+      res = luaC_slice(L, cast(lu_mem, data));
+      break;
+    }
+    case LUA_GCPAUSES: {
+      g->gctimesteps = 1;  /* steps are only timed from now on */
+      if (data >= 0 && data < LUA_GCPAUSEBUCKETS)
+        res = cast_int(g->gcpauses[data]);
+      else {  /* reset */
+        int i;
+        for (i = 0; i < LUA_GCPAUSEBUCKETS; i++) g->gcpauses[i] = 0;
+      }
+      break;
+    }
     case LUA_GCSETPAUSE: {
       res = g->gcpause;
       g->gcpause = data;
@@ -192,19 +192,31 @@ static int luaB_gcinfo (lua_State *L) {
 
 static int luaB_collectgarbage (lua_State *L) {
   static const char *const opts[] = {"stop", "restart", "collect",
-    "count", "step", "setpause", "setstepmul", NULL};
+    "count", "step", "setpause", "setstepmul", "slice", "pauses", NULL};
   static const int optsnum[] = {LUA_GCSTOP, LUA_GCRESTART, LUA_GCCOLLECT,
-    LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL};
+    LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL,
+    LUA_GCSLICE, LUA_GCPAUSES};
   int o = luaL_checkoption(L, 1, "collect", opts);
   int ex = luaL_optint(L, 2, 0);
-  int res = lua_gc(L, optsnum[o], ex);
+  int res;
+  if (optsnum[o] == LUA_GCPAUSES) {  /* histogram, reset if `ex' */
+    int k;
+    lua_createtable(L, LUA_GCPAUSEBUCKETS, 0);
+    for (k = 0; k < LUA_GCPAUSEBUCKETS; k++) {
+      lua_pushinteger(L, lua_gc(L, LUA_GCPAUSES, k));
+      lua_rawseti(L, -2, k+1);
+    }
+    if (ex) lua_gc(L, LUA_GCPAUSES, -1);
+    return 1;
+  }
+  res = lua_gc(L, optsnum[o], ex);
   switch (optsnum[o]) {
     case LUA_GCCOUNT: {
       int b = lua_gc(L, LUA_GCCOUNTB, 0);
       lua_pushnumber(L, res + ((lua_Number)b/1024));
       return 1;
     }
-    case LUA_GCSTEP: {
+    case LUA_GCSTEP: case LUA_GCSLICE: {
       lua_pushboolean(L, res);
       return 1;
     }
@@ -5,6 +5,12 @@
 */
 
 #include <string.h>
+#include <time.h>
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#elif !defined(_WIN32)
+#include <sys/time.h>
+#endif
 
 #define lgc_c
 #define LUA_CORE
@@ -607,7 +613,27 @@ static l_mem singlestep (lua_State *L) {
 }
 
 
-void luaC_step (lua_State *L) {
+/*
+** time in microseconds, for the slices and the step times histogram
+** (clock_gettime is missing on older iOS and OS X)
+*/
+static double gcclock (void) {
+#if defined(__APPLE__)
+  static mach_timebase_info_data_t tb;
+  if (tb.denom == 0)
+    mach_timebase_info(&tb);
+  return (double)mach_absolute_time()*tb.numer/tb.denom*1e-3;
+#elif !defined(_WIN32)
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec*1e6 + (double)tv.tv_usec;
+#else
+  return (double)clock()*(1e6/CLOCKS_PER_SEC);
+#endif
+}
+
+
+static void gcstep (lua_State *L) {
   global_State *g = G(L);
   l_mem lim = (GCSTEPSIZE/100) * g->gcstepmul;
   if (lim == 0)
@@ -633,6 +659,46 @@ void luaC_step (lua_State *L) {
 }
 
 
+void luaC_step (lua_State *L) {
+  global_State *g = G(L);
+  double t;
+  int k = 0;
+  if (!g->gctimesteps) {  /* histogram never requested? */
+    gcstep(L);
+    return;
+  }
+  t = gcclock();
+  gcstep(L);
+  t = gcclock() - t;
+  while (t >= 1 && k < LUA_GCPAUSEBUCKETS-1) {
+    t /= 2;
+    k++;
+  }
+  g->gcpauses[k]++;
+}
+
+
+/*
+** Runs the collector for about `usec' microseconds (the atomic phase is
+** not interruptible), or until the end of the current cycle, which starts
+** a new one if there is none. Does not change the automatic schedule,
+** unless the collector is stopped: then only slices collect. Returns 1 at
+** the end of a cycle.
+*/
+int luaC_slice (lua_State *L, lu_mem usec) {
+  global_State *g = G(L);
+  double end = gcclock() + (double)usec;
+  do {
+    singlestep(L);
+  } while (g->gcstate != GCSpause && gcclock() < end);
+  if (g->gcstate != GCSpause)
+    return 0;
+  if (g->GCthreshold != MAX_LUMEM)  /* not stopped? */
+    setthreshold(g);
+  return 1;
+}
+
+
 void luaC_fullgc (lua_State *L) {
   global_State *g = G(L);
   if (g->gcstate <= GCSpropagate) {
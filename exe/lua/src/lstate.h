@@ -85,6 +85,8 @@ typedef struct global_State {
   lu_mem gcdept;  /* how much GC is `behind schedule' */
   int gcpause;  /* size of pause between successive GCs */
   int gcstepmul;  /* GC `granularity' */
+  lu_int32 gcpauses[LUA_GCPAUSEBUCKETS];  /* histogram of the GC step times */
+  lu_byte gctimesteps;  /* true once the histogram has been requested */
   lua_CFunction panic;  /* to be called in unprotected errors */
   TValue l_registry;
   struct lua_State *mainthread;
@@ -226,6 +226,12 @@ LUA_API int  (lua_status) (lua_State *L);
 #define LUA_GCSTEP		5
 #define LUA_GCSETPAUSE		6
 #define LUA_GCSETSTEPMUL	7
+#define LUA_GCSLICE		8
+#define LUA_GCPAUSES		9
+
+/* GC step times histogram: bucket k counts steps of [2^(k-1), 2^k[ us;
+   the steps are only timed after a first LUA_GCPAUSES request */
+#define LUA_GCPAUSEBUCKETS	24
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
@@ -0,0 +1,60 @@
+-- garbage collector pauses in a request loop: automatic vs scheduled slices
+-- typical usage: lua gcpauses.lua [requests] [slice budget in us]
+-- (with torch loaded, requests also create tensor views)
+
+local nrequests = tonumber(arg and arg[1]) or 2000
+local budget = tonumber(arg and arg[2]) or 2000
+local clock = os.clock
+
+-- a long lived heap, traced by every cycle
+local heap = {}
+for i=1,2e5 do heap[i] = {i} end
+
+local x = torch and torch.Tensor(100, 100):zero()
+
+local function request()
+  local t = {}
+  for i=1,2000 do
+    t[i] = {value=i, f=function() return i end}
+  end
+  if x then
+    for i=1,100 do
+      t[i].view = x:narrow(1, i, 1):select(1, 1)
+    end
+  end
+  return #t
+end
+
+local function percentile(times, p)
+  return times[math.max(1, math.ceil(#times*p))]*1e3
+end
+
+local function run(name, sliced)
+  collectgarbage()
+  collectgarbage("pauses", 1)
+  if sliced then collectgarbage("stop") end
+  local times, peak = {}, 0
+  for r=1,nrequests do
+    local t = clock()
+    request()
+    times[r] = clock()-t
+    peak = math.max(peak, collectgarbage("count"))
+    if sliced then collectgarbage("slice", budget) end
+  end
+  collectgarbage("restart")
+  table.sort(times)
+  print(string.format("%-8s p50 %7.3f ms  p99 %7.3f ms  max %7.3f ms  peak %6.0f KB",
+                      name, percentile(times, 0.5), percentile(times, 0.99),
+                      times[#times]*1e3, peak))
+  local pauses = collectgarbage("pauses", 1)
+  local line = {}
+  for k=1,#pauses do
+    if pauses[k] > 0 then
+      table.insert(line, string.format("<%dus:%d", 2^(k-1), pauses[k]))
+    end
+  end
+  print("         GC steps " .. table.concat(line, " "))
+end
+
+run("auto")
+run("sliced", true)
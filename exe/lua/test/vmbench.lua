@@ -0,0 +1,77 @@
+-- interpreter benchmarks: the dispatch-bound patterns of module code
+-- typical usage: lua vmbench.lua [scale]
+-- (with torch and nn loaded, also times a small network training loop)
+
+local scale = tonumber(arg and arg[1]) or 1
+local clock = os.clock
+
+local function bench(name, n, f)
+  n = math.floor(n*scale)
+  f(math.floor(n/10)) -- warm up
+  local best = math.huge
+  for run=1,3 do
+    local t = clock()
+    f(n)
+    best = math.min(best, clock()-t)
+  end
+  print(string.format("%-12s %8.3f s", name, best))
+end
+
+-- numeric for loops
+bench("forloop", 2e7, function(n)
+  local s = 0
+  for i=1,n do s = s + i*0.5 end
+  return s
+end)
+
+-- array reads and writes
+bench("array", 2e2, function(n)
+  local t = {}
+  for i=1,1e5 do t[i] = i end
+  for k=1,n do
+    for i=1,#t do t[i] = t[i] + 1 end
+  end
+end)
+
+-- field accesses, as self.output or self.gradInput
+bench("fields", 1e7, function(n)
+  local obj = {output=1, gradInput=2, train=true}
+  local s = 0
+  for i=1,n do
+    if obj.train then s = s + obj.output + obj.gradInput end
+    obj.output = s
+  end
+end)
+
+-- method calls through a class metatable, as module:forward()
+local Class = {}
+Class.__index = Class
+function Class:get(x) return self.value + x end
+bench("methods", 1e7, function(n)
+  local obj = setmetatable({value=1}, Class)
+  local s = 0
+  for i=1,n do s = obj:get(s) end
+end)
+
+-- recursive calls
+local function fib(n) if n < 2 then return n end return fib(n-1) + fib(n-2) end
+bench("fib", 300, function(n)
+  for i=1,n do fib(20) end
+end)
+
+-- module graph driver loop
+if nn then
+  local mlp = nn.Sequential()
+  mlp:add(nn.Linear(4,8)):add(nn.Tanh()):add(nn.Linear(8,2))
+  local criterion = nn.MSECriterion()
+  local input, target = torch.rand(4), torch.rand(2)
+  bench("nn", 2e4, function(n)
+    for i=1,n do
+      local output = mlp:forward(input)
+      criterion:forward(output, target)
+      mlp:zeroGradParameters()
+      mlp:backward(input, criterion:backward(output, target))
+      mlp:updateParameters(0.01)
+    end
+  end)
+end
@@ -57,7 +57,11 @@
 
 - (void)requireFrameworkPackage:(NSString *)package frameworkResourcesPath:(NSString *)resourcesPath
 {
-  NSString *path = [[resourcesPath stringByAppendingPathComponent:package] stringByAppendingPathComponent:@"init.lua"];
+  // Prefer the package bundle (see cmake/lua2exe/lua2bundle.lua) if any
+  NSString *path = [resourcesPath stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.lua", package]];
+  if (![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    path = [[resourcesPath stringByAppendingPathComponent:package] stringByAppendingPathComponent:@"init.lua"];
+  }
   int ret = luaL_dofile(L, [path UTF8String]);
   if (ret == 1) {
     NSLog(@"could not load invalid lua resource: %@\n", package);
@@ -88,8 +92,8 @@
   luaopen_libtorch(L);
   [self requireFrameworkPackage:@"torch" frameworkResourcesPath:frameworkResourcesPath];
 
-  // load dok
-  [self requireFrameworkPackage:@"dok" frameworkResourcesPath:frameworkResourcesPath];
+  // dok is documentation only: load it on first use
+  luaL_dostring(L, "dok = setmetatable({}, {__index = function(self, key) dok = nil; require 'dok'; return dok[key] end})");
     
   // load nn
   luaopen_libnn(L);
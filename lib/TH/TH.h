@@ -11,8 +11,10 @@
 #include "THVector.h"
 #include "THLogAdd.h"
 #include "THRandom.h"
+#include "THStats.h"
 #include "THStorage.h"
 #include "THTensor.h"
+#include "THSparseTensor.h"
 #include "THTensorApply.h"
 #include "THTensorDimApply.h"
 
@@ -1,4 +1,5 @@
 #include "THBlas.h"
+#include "THStats.h"
 
 #include "generic/THBlas.c"
 #include "THGenerateAllTypes.h"
@@ -1,6 +1,7 @@
 #include "THGeneral.h"
 #include "THDiskFile.h"
 #include "THFilePrivate.h"
+#include <ctype.h>
 
 typedef struct THDiskFile__
 {
@@ -37,6 +38,33 @@ size_t fread__(void *ptr, size_t size, size_t nitems, FILE *stream)
 #define fread__ fread
 #endif
 
+/* ascii numbers are read token by token, and written by chunks */
+#define TH_DISKFILE_ASCII_TOKEN_BSZ 512L
+#define TH_DISKFILE_ASCII_BSZ 4096L
+
+static long THDiskFile_readAsciiToken(THDiskFile *dfself, char *token)
+{
+  long n = 0L;
+  int c;
+
+  do
+  {
+    c = fgetc(dfself->handle);
+  } while(isspace(c));
+
+  while( (c != EOF) && !isspace(c) && (n < TH_DISKFILE_ASCII_TOKEN_BSZ-1) )
+  {
+    token[n++] = (char)c;
+    c = fgetc(dfself->handle);
+  }
+
+  if(c != EOF)
+    ungetc(c, dfself->handle);
+  token[n] = '\0';
+
+  return n;
+}
+
 #define READ_WRITE_METHODS(TYPE, TYPEC, ASCII_READ_ELEM, ASCII_WRITE_ELEM) \
   static long THDiskFile_read##TYPEC(THFile *self, TYPE *data, long n)  \
   {                                                                     \
@@ -106,15 +134,27 @@ size_t fread__(void *ptr, size_t size, size_t nitems, FILE *stream)
     }                                                                   \
     else                                                                \
     {                                                                   \
+      char buffer[TH_DISKFILE_ASCII_BSZ];                               \
+      long nByte = 0L;                                                  \
+      long nBuffered = 0L;                                              \
       long i;                                                           \
       for(i = 0; i < n; i++)                                            \
       {                                                                 \
-        ASCII_WRITE_ELEM;                                               \
+        ASCII_WRITE_ELEM; /* append to buffer here, or write and break */ \
         if( dfself->file.isAutoSpacing && (i < n-1) )                   \
-          fprintf(dfself->handle, " ");                                 \
+          buffer[nByte++] = ' ';                                        \
+        nBuffered++;                                                    \
+        if( (nByte > TH_DISKFILE_ASCII_BSZ-TH_FILE_ASCII_NUMBER_BSZ-1) || (i == n-1) ) \
+        {                                                               \
+          if(fwrite(buffer, 1, nByte, dfself->handle) != (size_t)nByte) \
+            break;                                                      \
+          nwrite += nBuffered;                                          \
+          nBuffered = 0L;                                               \
+          nByte = 0L;                                                   \
+        }                                                               \
       }                                                                 \
       if(dfself->file.isAutoSpacing && (n > 0))                         \
-        fprintf(dfself->handle, "\n");                                  \
+        fputc('\n', dfself->handle);                                    \
     }                                                                   \
                                                                         \
     if(nwrite != n)                                                     \
@@ -293,25 +333,36 @@ READ_WRITE_METHODS(char, Char,
                    nread = fread(data, 1, n, dfself->handle); break,
                    nwrite = fwrite(data, 1, n, dfself->handle); break)
 
+#define ASCII_READ_NUMBER(TYPE, PARSER)                                 \
+  char token[TH_DISKFILE_ASCII_TOKEN_BSZ];                              \
+  TYPE value;                                                           \
+  long nToken = THDiskFile_readAsciiToken(dfself, token);               \
+  if( (nToken == 0) || (PARSER(token, &value) != nToken) ) break;       \
+  data[i] = value;                                                      \
+  nread++
+
+#define ASCII_WRITE_NUMBER(FORMATTER, VALUE)                            \
+  nByte += FORMATTER(buffer+nByte, VALUE)
+
 READ_WRITE_METHODS(short, Short,
-                   int ret = fscanf(dfself->handle, "%hd", &data[i]); if(ret <= 0) break; else nread++,
-                   int ret = fprintf(dfself->handle, "%hd", data[i]); if(ret <= 0) break; else nwrite++)
+                   ASCII_READ_NUMBER(long, THFile_asciiParseLong),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatLong, data[i]))
 
 READ_WRITE_METHODS(int, Int,
-                   int ret = fscanf(dfself->handle, "%d", &data[i]); if(ret <= 0) break; else nread++,
-                   int ret = fprintf(dfself->handle, "%d", data[i]); if(ret <= 0) break; else nwrite++)
+                   ASCII_READ_NUMBER(long, THFile_asciiParseLong),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatLong, data[i]))
 
 READ_WRITE_METHODS(long, Long,
-                   int ret = fscanf(dfself->handle, "%ld", &data[i]); if(ret <= 0) break; else nread++,
-                   int ret = fprintf(dfself->handle, "%ld", data[i]); if(ret <= 0) break; else nwrite++)
+                   ASCII_READ_NUMBER(long, THFile_asciiParseLong),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatLong, data[i]))
 
 READ_WRITE_METHODS(float, Float,
-                   int ret = fscanf(dfself->handle, "%g", &data[i]); if(ret <= 0) break; else nread++,
-                   int ret = fprintf(dfself->handle, "%g", data[i]); if(ret <= 0) break; else nwrite++)
+                   ASCII_READ_NUMBER(float, THFile_asciiParseFloat),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatFloat, data[i]))
 
 READ_WRITE_METHODS(double, Double,
-                   int ret = fscanf(dfself->handle, "%lg", &data[i]); if(ret <= 0) break; else nread++,
-                   int ret = fprintf(dfself->handle, "%lg", data[i]); if(ret <= 0) break; else nwrite++)
+                   ASCII_READ_NUMBER(double, THFile_asciiParseDouble),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatDouble, data[i]))
 
 static long THDiskFile_readString(THFile *self, const char *format, char **str_)
 {
@@ -1,5 +1,6 @@
 #include "THFile.h"
 #include "THFilePrivate.h"
+#include <ctype.h>
 
 #define IMPLEMENT_THFILE_RW(TYPEC, TYPE)                          \
   long THFile_read##TYPEC##Raw(THFile *self, TYPE *data, long n)  \
@@ -152,3 +153,212 @@ IMPLEMENT_THFILE_STORAGE(Int, int)
 IMPLEMENT_THFILE_STORAGE(Long, long)
 IMPLEMENT_THFILE_STORAGE(Float, float)
 IMPLEMENT_THFILE_STORAGE(Double, double)
+
+/* ASCII number codec, shared by the file implementations */
+
+static const double THFile_asciiPowersOf10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+long THFile_asciiParseLong(const char *str, long *value)
+{
+  const char *p = str;
+  unsigned long acc = 0;
+  int isNegative = 0;
+  int nDigits = 0;
+
+  if(*p == '-' || *p == '+')
+    isNegative = (*p++ == '-');
+
+  while(*p >= '0' && *p <= '9')
+  {
+    acc = acc*10 + (*p++ - '0');
+    nDigits++;
+  }
+
+  /* may overflow: let the C library decide */
+  if(nDigits == 0 || nDigits > (sizeof(long) == 8 ? 18 : 9))
+  {
+    char *end;
+    *value = strtol(str, &end, 10);
+    return end-str;
+  }
+
+  *value = (isNegative ? -(long)acc : (long)acc);
+  return p-str;
+}
+
+/* Exact when the decimal mantissa fits in 15 digits and the power of ten is
+   itself exact: one correctly rounded multiplication or division. Anything
+   else (long mantissas, huge exponents, inf, nan, hex) goes through strtod. */
+long THFile_asciiParseDouble(const char *str, double *value)
+{
+  const char *p = str;
+  double mantissa = 0;
+  int isNegative = 0;
+  int nDigits = 0;
+  int nSignificant = 0;
+  long exponent = 0;
+
+  if(*p == '-' || *p == '+')
+    isNegative = (*p++ == '-');
+
+  for(; *p >= '0' && *p <= '9'; p++, nDigits++)
+  {
+    if(nSignificant || *p != '0')
+    {
+      mantissa = mantissa*10 + (*p - '0');
+      nSignificant++;
+    }
+  }
+
+  if(*p == '.')
+  {
+    for(p++; *p >= '0' && *p <= '9'; p++, nDigits++, exponent--)
+    {
+      if(nSignificant || *p != '0')
+      {
+        mantissa = mantissa*10 + (*p - '0');
+        nSignificant++;
+      }
+    }
+  }
+
+  if(nDigits > 0 && (*p == 'e' || *p == 'E'))
+  {
+    const char *q = p+1;
+    int isExpNegative = 0;
+    long exp10 = 0;
+
+    if(*q == '-' || *q == '+')
+      isExpNegative = (*q++ == '-');
+
+    if(*q >= '0' && *q <= '9')
+    {
+      for(; *q >= '0' && *q <= '9'; q++)
+      {
+        if(exp10 < 10000)
+          exp10 = exp10*10 + (*q - '0');
+      }
+      exponent += (isExpNegative ? -exp10 : exp10);
+      p = q;
+    }
+  }
+
+  if(nDigits > 0 && nSignificant <= 15 && !isalpha((unsigned char)*p))
+  {
+    if(nSignificant == 0)
+    {
+      *value = (isNegative ? -0.0 : 0.0);
+      return p-str;
+    }
+    else if(exponent >= 0 && exponent <= 22)
+    {
+      mantissa *= THFile_asciiPowersOf10[exponent];
+      *value = (isNegative ? -mantissa : mantissa);
+      return p-str;
+    }
+    else if(exponent < 0 && exponent >= -22)
+    {
+      mantissa /= THFile_asciiPowersOf10[-exponent];
+      *value = (isNegative ? -mantissa : mantissa);
+      return p-str;
+    }
+  }
+
+  {
+    char *end;
+    *value = strtod(str, &end);
+    return end-str;
+  }
+}
+
+long THFile_asciiParseFloat(const char *str, float *value)
+{
+  double d;
+  long n = THFile_asciiParseDouble(str, &d);
+  float f = (float)d;
+
+  /* d is correctly rounded, so rounding it again to float can only go wrong
+     when it lands exactly halfway between two floats */
+  if(n > 0 && (double)f != d)
+  {
+    float g = nextafterf(f, (d > f ? HUGE_VALF : -HUGE_VALF));
+    if(d == ((double)f+(double)g)/2)
+    {
+      char *end;
+      f = strtof(str, &end);
+    }
+  }
+
+  *value = f;
+  return n;
+}
+
+long THFile_asciiFormatLong(char *str, long value)
+{
+  char digits[TH_FILE_ASCII_NUMBER_BSZ];
+  unsigned long acc = (value < 0 ? 0UL-(unsigned long)value : (unsigned long)value);
+  long nDigits = 0;
+  long n = 0;
+
+  do
+  {
+    digits[nDigits++] = '0' + (char)(acc % 10);
+    acc /= 10;
+  } while(acc);
+
+  if(value < 0)
+    str[n++] = '-';
+  while(nDigits > 0)
+    str[n++] = digits[--nDigits];
+  str[n] = '\0';
+
+  return n;
+}
+
+/* Integral values are printed as such. Others get the fewest significant
+   digits (starting at DBL_DIG, which always round-trips text->number) which
+   read back to the very same number. */
+long THFile_asciiFormatDouble(char *str, double value)
+{
+  int precision;
+
+  if(value > -LONG_MAX && value < LONG_MAX && value == (double)(long)value && (value != 0 || 1/value > 0))
+    return THFile_asciiFormatLong(str, (long)value);
+
+  if(value != value || value == HUGE_VAL || value == -HUGE_VAL)
+    return snprintf(str, TH_FILE_ASCII_NUMBER_BSZ, "%g", value);
+
+  for(precision = DBL_DIG; precision < 17; precision++)
+  {
+    double readback;
+    long n = snprintf(str, TH_FILE_ASCII_NUMBER_BSZ, "%.*g", precision, value);
+    if(THFile_asciiParseDouble(str, &readback) == n && readback == value)
+      return n;
+  }
+
+  return snprintf(str, TH_FILE_ASCII_NUMBER_BSZ, "%.17g", value);
+}
+
+long THFile_asciiFormatFloat(char *str, float value)
+{
+  int precision;
+
+  if(value > -LONG_MAX && value < LONG_MAX && value == (float)(long)value && (value != 0 || 1/value > 0))
+    return THFile_asciiFormatLong(str, (long)value);
+
+  if(value != value || value == HUGE_VALF || value == -HUGE_VALF)
+    return snprintf(str, TH_FILE_ASCII_NUMBER_BSZ, "%g", value);
+
+  for(precision = FLT_DIG; precision < 9; precision++)
+  {
+    float readback;
+    long n = snprintf(str, TH_FILE_ASCII_NUMBER_BSZ, "%.*g", precision, value);
+    if(THFile_asciiParseFloat(str, &readback) == n && readback == value)
+      return n;
+  }
+
+  return snprintf(str, TH_FILE_ASCII_NUMBER_BSZ, "%.9g", value);
+}
@@ -41,3 +41,17 @@ struct THFileVTable
     void (*close)(THFile *self);
     void (*free)(THFile *self);
 };
+
+/* ascii number codec (see THFile.c) */
+/* parsers do not skip spaces and return the number of chars consumed (0 on failure) */
+/* formatters write at most TH_FILE_ASCII_NUMBER_BSZ chars (with the '\0') and return the length */
+
+#define TH_FILE_ASCII_NUMBER_BSZ 32
+
+long THFile_asciiParseLong(const char *str, long *value);
+long THFile_asciiParseFloat(const char *str, float *value);
+long THFile_asciiParseDouble(const char *str, double *value);
+
+long THFile_asciiFormatLong(char *str, long value);
+long THFile_asciiFormatFloat(char *str, float value);
+long THFile_asciiFormatDouble(char *str, double value);
@@ -1,5 +1,6 @@
 #include "THMemoryFile.h"
 #include "THFilePrivate.h"
+#include <ctype.h>
 
 typedef struct THMemoryFile__
 {
@@ -16,28 +17,18 @@ static int THMemoryFile_isOpened(THFile *self)
   return (mfself->storage != NULL);
 }
 
-static char *THMemoryFile_strnextspace(char *str_, char *c_)
+static long THMemoryFile_nspaces(const char *str_)
 {
+  const char *p = str_;
   char c;
 
-  while( (c = *str_) )
+  while( (c = *p) )
   {
-    if( (c != ' ') && (c != '\n') && (c != ':') && (c != ';') )
+    if( !isspace((unsigned char)c) && (c != ':') && (c != ';') )
       break;
-    str_++;
+    p++;
   }
-
-  while( (c = *str_) )
-  {
-    if( (c == ' ') || (c == '\n') || (c == ':') || (c == ';') )
-    {
-      *c_ = c;
-      *str_ = '\0';
-      return(str_);
-    }
-    str_++;
-  }
-  return NULL;
+  return p-str_;
 }
 
 static void THMemoryFile_grow(THMemoryFile *self, long size)
@@ -116,18 +107,8 @@ static int THMemoryFile_mode(const char *mode, int *isReadable, int *isWritable)
       for(i = 0; i < n; i++)                                            \
       {                                                                 \
         long nByteRead = 0;                                             \
-        char spaceChar = 0;                                             \
-        char *spacePtr = THMemoryFile_strnextspace(mfself->storage->data+mfself->position, &spaceChar); \
         ASCII_READ_ELEM;                                                \
-        if(ret == EOF)                                                  \
-        {                                                               \
-          while(mfself->storage->data[mfself->position])                \
-            mfself->position++;                                         \
-        }                                                               \
-        else                                                            \
-          mfself->position += nByteRead;                                \
-        if(spacePtr)                                                    \
-          *spacePtr = spaceChar;                                        \
+        mfself->position += nByteRead;                                  \
       }                                                                 \
       if(mfself->file.isAutoSpacing && (n > 0))                         \
       {                                                                 \
@@ -281,7 +262,6 @@ static void THMemoryFile_free(THFile *self)
 
 READ_WRITE_METHODS(unsigned char, Byte,
                    long ret = (mfself->position + n <= mfself->size ? n : mfself->size-mfself->position);  \
-                   if(spacePtr) *spacePtr = spaceChar; \
                    nByteRead = ret; \
                    nread = ret; \
                    i = n-1; \
@@ -296,7 +276,6 @@ READ_WRITE_METHODS(unsigned char, Byte,
 /* Note that we do a trick for char */
 READ_WRITE_METHODS(char, Char,
                    long ret = (mfself->position + n <= mfself->size ? n : mfself->size-mfself->position);  \
-                   if(spacePtr) *spacePtr = spaceChar; \
                    nByteRead = ret; \
                    nread = ret; \
                    i = n-1; \
@@ -307,29 +286,42 @@ READ_WRITE_METHODS(char, Char,
                      memmove(mfself->storage->data+mfself->position, data, nByteWritten),
                    0)
 
+#define ASCII_READ_NUMBER(TYPE, PARSER)                                 \
+  TYPE value;                                                           \
+  long nSpace = THMemoryFile_nspaces(mfself->storage->data+mfself->position); \
+  long ret = PARSER(mfself->storage->data+mfself->position+nSpace, &value); \
+  if(ret <= 0) break;                                                   \
+  data[i] = value;                                                      \
+  nByteRead = nSpace+ret;                                               \
+  nread++
+
+#define ASCII_WRITE_NUMBER(FORMATTER, VALUE)                            \
+  nByteWritten = (mfself->storage->size-mfself->position > TH_FILE_ASCII_NUMBER_BSZ ? \
+                  FORMATTER(mfself->storage->data+mfself->position, VALUE) : -1)
+
 READ_WRITE_METHODS(short, Short,
-                   int nByteRead_; int ret = sscanf(mfself->storage->data+mfself->position, "%hd%n", &data[i], &nByteRead_); nByteRead = nByteRead_; if(ret <= 0) break; else nread++,
-                   nByteWritten = snprintf(mfself->storage->data+mfself->position, mfself->storage->size-mfself->position, "%hd", data[i]),
+                   ASCII_READ_NUMBER(long, THFile_asciiParseLong),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatLong, data[i]),
                    1)
 
 READ_WRITE_METHODS(int, Int,
-                   int nByteRead_; int ret = sscanf(mfself->storage->data+mfself->position, "%d%n", &data[i], &nByteRead_); nByteRead = nByteRead_; if(ret <= 0) break; else nread++,
-                   nByteWritten = snprintf(mfself->storage->data+mfself->position, mfself->storage->size-mfself->position, "%d", data[i]),
+                   ASCII_READ_NUMBER(long, THFile_asciiParseLong),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatLong, data[i]),
                    1)
 
 READ_WRITE_METHODS(long, Long,
-                   int nByteRead_; int ret = sscanf(mfself->storage->data+mfself->position, "%ld%n", &data[i], &nByteRead_); nByteRead = nByteRead_; if(ret <= 0) break; else nread++,
-                   nByteWritten = snprintf(mfself->storage->data+mfself->position, mfself->storage->size-mfself->position, "%ld", data[i]),
+                   ASCII_READ_NUMBER(long, THFile_asciiParseLong),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatLong, data[i]),
                    1)
 
 READ_WRITE_METHODS(float, Float,
-                   int nByteRead_; int ret = sscanf(mfself->storage->data+mfself->position, "%g%n", &data[i], &nByteRead_); nByteRead = nByteRead_; if(ret <= 0) break; else nread++,
-                   nByteWritten = snprintf(mfself->storage->data+mfself->position, mfself->storage->size-mfself->position, "%g", data[i]),
+                   ASCII_READ_NUMBER(float, THFile_asciiParseFloat),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatFloat, data[i]),
                    1)
 
 READ_WRITE_METHODS(double, Double,
-                   int nByteRead_; int ret = sscanf(mfself->storage->data+mfself->position, "%lg%n", &data[i], &nByteRead_); nByteRead = nByteRead_; if(ret <= 0) break; else nread++,
-                   nByteWritten = snprintf(mfself->storage->data+mfself->position, mfself->storage->size-mfself->position, "%lg", data[i]),
+                   ASCII_READ_NUMBER(double, THFile_asciiParseDouble),
+                   ASCII_WRITE_NUMBER(THFile_asciiFormatDouble, data[i]),
                    1)
 
 static char* THMemoryFile_cloneString(const char *str, long size)
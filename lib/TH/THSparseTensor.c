@@ -0,0 +1,20 @@
+#include "THSparseTensor.h"
+#include "THVector.h"
+
+/* (key, position) pairs, sorted by key then position */
+typedef struct THSparseEntry
+{
+  long key;
+  long pos;
+} THSparseEntry;
+
+static int THSparseEntry_compare(const void *a_, const void *b_)
+{
+  const THSparseEntry *a = a_, *b = b_;
+  if(a->key != b->key)
+    return (a->key < b->key) ? -1 : 1;
+  return (a->pos < b->pos) ? -1 : (a->pos > b->pos);
+}
+
+#include "generic/THSparseTensor.c"
+#include "THGenerateFloatTypes.h"
@@ -0,0 +1,16 @@
+#ifndef TH_SPARSE_TENSOR_INC
+#define TH_SPARSE_TENSOR_INC
+
+#include "THTensor.h"
+
+#define THSparseTensor          TH_CONCAT_3(TH,Real,SparseTensor)
+#define THSparseTensor_(NAME)   TH_CONCAT_4(TH,Real,SparseTensor_,NAME)
+
+/* storage formats */
+#define TH_SPARSE_COO 0
+#define TH_SPARSE_CSR 1
+
+#include "generic/THSparseTensor.h"
+#include "THGenerateFloatTypes.h"
+
+#endif
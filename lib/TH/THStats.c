@@ -0,0 +1,251 @@
+#include "THStats.h"
+
+#ifdef TH_STATS
+
+#if !defined(__GNUC__)
+#error "TH_STATS needs a compiler with __thread and __sync builtins"
+#endif
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#elif !defined(_WIN32)
+#include <sys/time.h>
+#endif
+
+typedef struct THStatsThread
+{
+  long long calls[TH_STATS_MAXKERNELS];
+  long long ns[TH_STATS_MAXKERNELS];
+  long long bytes[TH_STATS_MAXKERNELS];
+  THStatsShape shapes[TH_STATS_MAXSHAPES];
+  struct THStatsThread *next;
+} THStatsThread;
+
+/* all the blocks ever created: pushed with a CAS, never removed (the
+   counts of a finished thread are kept) */
+static THStatsThread *THStats_threads = NULL;
+static __thread THStatsThread *THStats_self = NULL;
+
+static const char *THStats_names[TH_STATS_MAXKERNELS];
+static volatile int THStats_nkernels = 0;
+static volatile int THStats_lock = 0;
+
+static THStatsThread* THStats_thread(void)
+{
+  THStatsThread *self = THStats_self;
+  if(!self)
+  {
+    int i;
+    /* not THAlloc: no garbage collection to trigger from here */
+    self = calloc(1, sizeof(THStatsThread));
+    if(!self)
+      THError("$ Torch: not enough memory: you tried to allocate %dKB.", (int)(sizeof(THStatsThread)/1024));
+    for(i = 0; i < TH_STATS_MAXSHAPES; i++)
+      self->shapes[i].kernel = -1;
+    do
+      self->next = THStats_threads;
+    while(!__sync_bool_compare_and_swap(&THStats_threads, self->next, self));
+    THStats_self = self;
+  }
+  return self;
+}
+
+int THStats_enabled(void)
+{
+  return 1;
+}
+
+/* the clock of the Lua GC pause histogram (lgc.c, which TH does not link
+   to): clock_gettime is missing on older iOS */
+long long THStats_clock(void)
+{
+#if defined(__APPLE__)
+  static mach_timebase_info_data_t tb;
+  if(tb.denom == 0)
+    mach_timebase_info(&tb);
+  return (long long)(mach_absolute_time()*tb.numer/tb.denom);
+#elif !defined(_WIN32)
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (long long)tv.tv_sec*1000000000LL + (long long)tv.tv_usec*1000LL;
+#else
+  return (long long)clock()*(1000000000LL/CLOCKS_PER_SEC);
+#endif
+}
+
+int THStats_kernel(const char *name)
+{
+  int i;
+
+  /* registration happens once per call site: a spin lock is enough */
+  while(__sync_lock_test_and_set(&THStats_lock, 1))
+    ;
+  for(i = 0; i < THStats_nkernels; i++)
+  {
+    if(!strcmp(THStats_names[i], name))
+      break;
+  }
+  if(i == THStats_nkernels)
+  {
+    /* the last slot collects the kernels which do not fit, under its own
+       name */
+    if(i >= TH_STATS_MAXKERNELS-1)
+    {
+      i = TH_STATS_MAXKERNELS-1;
+      THStats_names[i] = "<overflow>";
+    }
+    else
+      THStats_names[i] = name;
+    THStats_nkernels = i+1;
+  }
+  __sync_lock_release(&THStats_lock);
+  return i;
+}
+
+void THStats_add(int kernel, long long ns, long long bytes, int ndim, const long *shape)
+{
+  THStatsThread *self = THStats_thread();
+
+  self->calls[kernel]++;
+  self->ns[kernel] += ns;
+  self->bytes[kernel] += bytes;
+
+  if(ndim > 0)
+  {
+    unsigned long h = (unsigned long)kernel;
+    int i, probe;
+
+    if(ndim > TH_STATS_MAXDIM)
+      ndim = TH_STATS_MAXDIM;
+    for(i = 0; i < ndim; i++)
+      h = h*31 + (unsigned long)shape[i];
+
+    /* open addressing; when the table is full around h, only the kernel
+       counters are kept */
+    for(probe = 0; probe < 16; probe++)
+    {
+      THStatsShape *entry = &self->shapes[(h+probe) % TH_STATS_MAXSHAPES];
+      if(entry->kernel == kernel && entry->ndim == ndim &&
+         !memcmp(entry->shape, shape, ndim*sizeof(long)))
+      {
+        entry->calls++;
+        entry->ns += ns;
+        break;
+      }
+      if(entry->kernel == -1)
+      {
+        entry->ndim = ndim;
+        memcpy(entry->shape, shape, ndim*sizeof(long));
+        entry->calls = 1;
+        entry->ns = ns;
+        /* readers skip free slots: the slot is taken last */
+        __sync_synchronize();
+        entry->kernel = kernel;
+        break;
+      }
+    }
+  }
+}
+
+int THStats_nKernel(void)
+{
+  return THStats_nkernels;
+}
+
+const char* THStats_name(int kernel)
+{
+  THArgCheck(kernel >= 0 && kernel < THStats_nkernels, 1, "invalid kernel id");
+  return THStats_names[kernel];
+}
+
+void THStats_get(int kernel, long long *calls, long long *ns, long long *bytes)
+{
+  THStatsThread *thread;
+
+  THArgCheck(kernel >= 0 && kernel < THStats_nkernels, 1, "invalid kernel id");
+  *calls = *ns = *bytes = 0;
+  for(thread = THStats_threads; thread; thread = thread->next)
+  {
+    *calls += thread->calls[kernel];
+    *ns += thread->ns[kernel];
+    *bytes += thread->bytes[kernel];
+  }
+}
+
+void THStats_shapes(THStatsShapeFunction f, void *data)
+{
+  THStatsThread *thread;
+  int i;
+
+  for(thread = THStats_threads; thread; thread = thread->next)
+  {
+    for(i = 0; i < TH_STATS_MAXSHAPES; i++)
+    {
+      if(thread->shapes[i].kernel >= 0)
+        f(&thread->shapes[i], data);
+    }
+  }
+}
+
+/* not synchronized with the counting threads: call it while no kernel runs */
+void THStats_reset(void)
+{
+  THStatsThread *thread;
+  int i;
+
+  for(thread = THStats_threads; thread; thread = thread->next)
+  {
+    memset(thread->calls, 0, sizeof(thread->calls));
+    memset(thread->ns, 0, sizeof(thread->ns));
+    memset(thread->bytes, 0, sizeof(thread->bytes));
+    for(i = 0; i < TH_STATS_MAXSHAPES; i++)
+      thread->shapes[i].kernel = -1;
+  }
+}
+
+#else
+
+int THStats_enabled(void)
+{
+  return 0;
+}
+
+long long THStats_clock(void)
+{
+  return 0;
+}
+
+int THStats_kernel(const char *name)
+{
+  return 0;
+}
+
+void THStats_add(int kernel, long long ns, long long bytes, int ndim, const long *shape)
+{
+}
+
+int THStats_nKernel(void)
+{
+  return 0;
+}
+
+const char* THStats_name(int kernel)
+{
+  THArgCheck(0, 1, "invalid kernel id");
+  return NULL;
+}
+
+void THStats_get(int kernel, long long *calls, long long *ns, long long *bytes)
+{
+  THArgCheck(0, 1, "invalid kernel id");
+}
+
+void THStats_shapes(THStatsShapeFunction f, void *data)
+{
+}
+
+void THStats_reset(void)
+{
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef TH_STATS_INC
+#define TH_STATS_INC
+
+#include "THGeneral.h"
+
+/* Kernel counters: calls, time and bytes touched per kernel, and a
+   histogram of the shapes of the BLAS and convolution calls.
+
+   Compiled in only when TH is configured with WITH_TH_STATS. Each thread
+   counts into its own block (no locks, no atomics on the hot path); blocks
+   are merged when the statistics are read. Otherwise the probes are empty
+   macros. */
+
+#define TH_STATS_MAXKERNELS 256
+#define TH_STATS_MAXSHAPES 1024
+#define TH_STATS_MAXDIM 8
+
+typedef struct THStatsShape
+{
+  int kernel; /* -1 when the slot is free */
+  int ndim;
+  long shape[TH_STATS_MAXDIM];
+  long long calls;
+  long long ns;
+} THStatsShape;
+
+typedef void (*THStatsShapeFunction)(const THStatsShape *shape, void *data);
+
+TH_API int THStats_enabled(void);
+TH_API long long THStats_clock(void);
+
+/* id of the kernel called name (registered on first use); past
+   TH_STATS_MAXKERNELS-1 kernels, the new ones are all counted as
+   "<overflow>" */
+TH_API int THStats_kernel(const char *name);
+TH_API void THStats_add(int kernel, long long ns, long long bytes, int ndim, const long *shape);
+
+/* merged over all threads */
+TH_API int THStats_nKernel(void);
+TH_API const char* THStats_name(int kernel);
+TH_API void THStats_get(int kernel, long long *calls, long long *ns, long long *bytes);
+/* calls f on every shape entry of every thread: entries of the same shape
+   recorded by different threads are not merged */
+TH_API void THStats_shapes(THStatsShapeFunction f, void *data);
+TH_API void THStats_reset(void);
+
+#ifdef TH_STATS
+
+/* TH_STATS_BEGIN must be placed where a declaration is allowed, and a
+   TH_STATS_END must be reached on every way out of the block. */
+#define TH_STATS_BEGIN(NAME)                                            \
+  static int THStats_kernel_ = -1;                                      \
+  long long THStats_start_ =                                            \
+    ((THStats_kernel_ < 0 ? THStats_kernel_ = THStats_kernel(NAME) : 0), THStats_clock())
+
+#define TH_STATS_END(BYTES, NDIM, SHAPE)                                \
+  THStats_add(THStats_kernel_, THStats_clock()-THStats_start_, (BYTES), (NDIM), (SHAPE))
+
+static inline long long THStats_nElement(int nDimension, const long *size)
+{
+  long long n = (nDimension ? 1 : 0);
+  int i;
+  for(i = 0; i < nDimension; i++)
+    n *= size[i];
+  return n;
+}
+
+#else
+
+#define TH_STATS_BEGIN(NAME)
+#define TH_STATS_END(BYTES, NDIM, SHAPE)
+
+#endif
+
+#endif
@@ -3,8 +3,47 @@
 #include "THBlas.h"
 #include "THLapack.h"
 #include "THRandom.h"
+#include "THStats.h"
 #include "THTensorDimApply.h"
 
+/* offset of the sliceIndex-th slice along dimension, slices being taken in
+   row-major order of the other dimensions */
+static long THTensor_sliceOffset(long sliceIndex, int nDimension, const long *size, const long *stride, int dimension)
+{
+  long offset = 0;
+  int d;
+  for(d = nDimension-1; d >= 0; d--)
+  {
+    if(d == dimension)
+      continue;
+    offset += (sliceIndex % size[d])*stride[d];
+    sliceIndex /= size[d];
+  }
+  return offset;
+}
+
+/* strict order used by sort and topk: by value, then by index. The index
+   order is reversed when the ascending result gets reversed into a
+   descending one, so that equal values always keep increasing indices. */
+#define THTensor_sortBefore(v, ix, i, j, desc)                          \
+  ((v)[i] < (v)[j] || ((v)[i] == (v)[j] && ((desc) ? (ix)[i] > (ix)[j] : (ix)[i] < (ix)[j])))
+
+/* for topk: whether element i would be dropped before element j, when
+   keeping the largest (dir) or smallest values */
+#define THTensor_topkWorse(v, ix, i, j, dir)                            \
+  (((dir) ? (v)[i] < (v)[j] : (v)[i] > (v)[j]) || ((v)[i] == (v)[j] && (ix)[i] > (ix)[j]))
+
+/* reductions: values summed per block before being combined pairwise,
+   columns per block in the outer order, elements per chunk of a full
+   reduction, and the size below which a reduction stays on one thread */
+#define TH_REDUCE_BLOCK 128
+#define TH_REDUCE_COLUMNS 256
+#define TH_REDUCE_CHUNK 65536
+#define TH_REDUCE_PARALLEL 32768
+
+/* elements per block of a fused expression */
+#define TH_FUSE_BLOCK 256
+
 #include "generic/THTensor.c"
 #include "THGenerateAllTypes.h"
 
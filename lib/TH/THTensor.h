@@ -20,6 +20,21 @@
 #include "generic/THTensorRandom.h"
 #include "THGenerateAllTypes.h"
 
+/* instructions of THTensor_(fuse): {op, dst, a, b, s}, where dst, a and b
+   are registers and s is the index of a scalar */
+enum {
+  TH_FUSE_ADD,   /* dst = a + b */
+  TH_FUSE_SUB,   /* dst = a - b */
+  TH_FUSE_MUL,   /* dst = a * b */
+  TH_FUSE_DIV,   /* dst = a / b */
+  TH_FUSE_AXPY,  /* dst = a + s * b */
+  TH_FUSE_ADDS,  /* dst = a + s */
+  TH_FUSE_MULS,  /* dst = a * s */
+  TH_FUSE_DIVS,  /* dst = a / s */
+  TH_FUSE_RDIVS, /* dst = s / a */
+  TH_FUSE_NOPS
+};
+
 /* maths */
 #include "generic/THTensorMath.h"
 #include "THGenerateAllTypes.h"
@@ -1,6 +1,8 @@
 #ifndef TH_TENSOR_APPLY_INC
 #define TH_TENSOR_APPLY_INC
 
+#include "THStats.h"
+
 #define TH_TENSOR_APPLY3(TYPE1, TENSOR1, TYPE2, TENSOR2, TYPE3, TENSOR3, CODE) \
 { \
   TYPE1 *TENSOR1##_data = NULL; \
@@ -13,6 +15,7 @@
   long *TENSOR3##_counter = NULL; \
   long TENSOR3##_stride = 0, TENSOR3##_size = 0, TENSOR3##_dim = 0, TENSOR3##_i, TENSOR3##_n; \
   int TH_TENSOR_APPLY_hasFinished = 0; \
+  TH_STATS_BEGIN(__func__); \
 \
   TENSOR1##_n = (TENSOR1->nDimension ? 1 : 0); \
   for(TENSOR1##_i = 0; TENSOR1##_i < TENSOR1->nDimension; TENSOR1##_i++) \
@@ -203,6 +206,7 @@
   THFree(TENSOR1##_counter); \
   THFree(TENSOR2##_counter); \
   THFree(TENSOR3##_counter); \
+  TH_STATS_END(TENSOR1##_n*(long long)(sizeof(TYPE1)+sizeof(TYPE2)+sizeof(TYPE3)), 0, NULL); \
 }
 
 #define TH_TENSOR_APPLY2(TYPE1, TENSOR1, TYPE2, TENSOR2, CODE) \
@@ -214,6 +218,7 @@
   long *TENSOR2##_counter = NULL; \
   long TENSOR2##_stride = 0, TENSOR2##_size = 0, TENSOR2##_dim = 0, TENSOR2##_i, TENSOR2##_n; \
   int TH_TENSOR_APPLY_hasFinished = 0; \
+  TH_STATS_BEGIN(__func__); \
 \
   TENSOR1##_n = (TENSOR1->nDimension ? 1 : 0); \
   for(TENSOR1##_i = 0; TENSOR1##_i < TENSOR1->nDimension; TENSOR1##_i++) \
@@ -346,6 +351,7 @@
   } \
   THFree(TENSOR1##_counter); \
   THFree(TENSOR2##_counter); \
+  TH_STATS_END(TENSOR1##_n*(long long)(sizeof(TYPE1)+sizeof(TYPE2)), 0, NULL); \
 }
 
 #define TH_TENSOR_APPLY(TYPE, TENSOR, CODE) \
@@ -354,6 +360,7 @@
   long *TENSOR##_counter = NULL; \
   long TENSOR##_stride = 0, TENSOR##_size = 0, TENSOR##_dim = 0, TENSOR##_i; \
   int TH_TENSOR_APPLY_hasFinished = 0; \
+  TH_STATS_BEGIN(__func__); \
 \
   if(TENSOR->nDimension == 0) \
     TH_TENSOR_APPLY_hasFinished = 1; \
@@ -423,6 +430,7 @@
     } \
   } \
   THFree(TENSOR##_counter); \
+  TH_STATS_END(THStats_nElement(TENSOR->nDimension, TENSOR->size)*(long long)sizeof(TYPE), 0, NULL); \
 }
 
 #endif
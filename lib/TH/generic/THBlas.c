@@ -157,6 +157,8 @@ real THBlas_(dot)(long n, real *x, long incx, real *y, long incy)
 
 void THBlas_(gemv)(char trans, long m, long n, real alpha, real *a, long lda, real *x, long incx, real beta, real *y, long incy)
 {
+  TH_STATS_BEGIN(__func__);
+
   if(n == 1)
     lda = m;
 
@@ -183,6 +185,7 @@ void THBlas_(gemv)(char trans, long m, long n, real alpha, real *a, long lda, re
 #else
     cblas_sgemv(CblasColMajor, cblas_trans, i_m, i_n, alpha, a, i_lda, x, i_incx, beta, y, i_incy);
 #endif
+    TH_STATS_END((m*n+m+n)*(long long)sizeof(real), 2, ((long[]){m, n}));
     return;
   }
 #endif
@@ -214,6 +217,7 @@ void THBlas_(gemv)(char trans, long m, long n, real alpha, real *a, long lda, re
       }
     }
   }
+  TH_STATS_END((m*n+m+n)*(long long)sizeof(real), 2, ((long[]){m, n}));
 }
 
 void THBlas_(ger)(long m, long n, real alpha, real *x, long incx, real *y, long incy, real *a, long lda)
@@ -256,6 +260,7 @@ void THBlas_(gemm)(char transa, char transb, long m, long n, long k, real alpha,
   int transb_ = ((transb == 't') || (transb == 'T'));
   int cblas_transa = CblasNoTrans;
   int cblas_transb = CblasNoTrans;
+  TH_STATS_BEGIN(__func__);
 
   if(n == 1)
     ldc = m;
@@ -299,6 +304,7 @@ void THBlas_(gemm)(char transa, char transb, long m, long n, long k, real alpha,
 #else
     cblas_sgemm(CblasColMajor, cblas_transa, cblas_transb, i_m, i_n, i_k, alpha, a, i_lda, b, i_ldb, beta, c, i_ldc);
 #endif
+    TH_STATS_END((m*k+k*n+2*m*n)*(long long)sizeof(real), 3, ((long[]){m, n, k}));
     return;
   }
 #endif
@@ -373,6 +379,7 @@ void THBlas_(gemm)(char transa, char transb, long m, long n, long k, real alpha,
       }
     }
   }
+  TH_STATS_END((m*k+k*n+2*m*n)*(long long)sizeof(real), 3, ((long[]){m, n, k}));
 }
 
 #endif
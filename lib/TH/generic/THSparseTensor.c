@@ -0,0 +1,439 @@
+#ifndef TH_GENERIC_FILE
+#define TH_GENERIC_FILE "generic/THSparseTensor.c"
+#else
+
+/**** creation methods ****/
+THSparseTensor *THSparseTensor_(new)(void)
+{
+  return THSparseTensor_(newWithSize)(0, 0);
+}
+
+THSparseTensor *THSparseTensor_(newWithSize)(long nRow, long nCol)
+{
+  THSparseTensor *self = THAlloc(sizeof(THSparseTensor));
+  THArgCheck(nRow >= 0 && nCol >= 0, 1, "invalid size");
+  self->nRow = nRow;
+  self->nCol = nCol;
+  self->nnz = 0;
+  self->format = TH_SPARSE_COO;
+  self->coalesced = 1;
+  self->rows = THLongStorage_new();
+  self->cols = THLongStorage_new();
+  self->values = THStorage_(new)();
+  self->refcount = 1;
+  return self;
+}
+
+void THSparseTensor_(retain)(THSparseTensor *self)
+{
+  if(self)
+    ++self->refcount;
+}
+
+void THSparseTensor_(free)(THSparseTensor *self)
+{
+  if(!self)
+    return;
+
+  if(--self->refcount == 0)
+  {
+    THLongStorage_free(self->rows);
+    THLongStorage_free(self->cols);
+    THStorage_(free)(self->values);
+    THFree(self);
+  }
+}
+
+void THSparseTensor_(resize)(THSparseTensor *self, long nRow, long nCol, long nnz)
+{
+  THArgCheck(nRow >= 0 && nCol >= 0, 2, "invalid size");
+  THArgCheck(nnz >= 0, 4, "invalid number of nonzeros");
+  self->nRow = nRow;
+  self->nCol = nCol;
+  self->nnz = nnz;
+  self->format = TH_SPARSE_COO;
+  self->coalesced = (nnz == 0);
+  THLongStorage_resize(self->rows, nnz);
+  THLongStorage_resize(self->cols, nnz);
+  THStorage_(resize)(self->values, nnz);
+}
+
+/**** conversions ****/
+
+/* COO -> CSR: bucket the entries by row, sort each row by column and sum
+   the duplicates */
+static void THSparseTensor_(compress)(THSparseTensor *self)
+{
+  long nnz = self->nnz, nRow = self->nRow;
+  long *rows = self->rows->data, *cols = self->cols->data;
+  real *values = self->values->data;
+  long *offsets, *fill, *counts;
+  THSparseEntry *entries;
+  THLongStorage *newCols;
+  THStorage *newValues;
+  long i, e;
+
+  for(e = 0; e < nnz; e++)
+    THArgCheck(rows[e] >= 0 && rows[e] < nRow && cols[e] >= 0 && cols[e] < self->nCol, 1, "index out of range");
+
+  offsets = THAlloc(sizeof(long)*(nRow+1));
+  fill = THAlloc(sizeof(long)*(nRow+1));
+  counts = THAlloc(sizeof(long)*(nRow+1));
+  entries = THAlloc(sizeof(THSparseEntry)*THMax(nnz, 1));
+
+  for(i = 0; i <= nRow; i++)
+    offsets[i] = 0;
+  for(e = 0; e < nnz; e++)
+    offsets[rows[e]+1]++;
+  for(i = 0; i < nRow; i++)
+    offsets[i+1] += offsets[i];
+  for(i = 0; i < nRow; i++)
+    fill[i] = offsets[i];
+  for(e = 0; e < nnz; e++)
+  {
+    THSparseEntry *entry = entries + fill[rows[e]]++;
+    entry->key = cols[e];
+    entry->pos = e;
+  }
+
+  /* rows are independent; ties keep the original order */
+#pragma omp parallel for private(i)
+  for(i = 0; i < nRow; i++)
+  {
+    long k, n = 0;
+    if(offsets[i+1] - offsets[i] > 1)
+      qsort(entries + offsets[i], offsets[i+1] - offsets[i], sizeof(THSparseEntry), THSparseEntry_compare);
+    for(k = offsets[i]; k < offsets[i+1]; k++)
+      n += (k == offsets[i] || entries[k].key != entries[k-1].key);
+    counts[i] = n;
+  }
+
+  fill[0] = 0;
+  for(i = 0; i < nRow; i++)
+    fill[i+1] = fill[i] + counts[i];
+
+  newCols = THLongStorage_newWithSize(fill[nRow]);
+  newValues = THStorage_(newWithSize)(fill[nRow]);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < nRow; i++)
+  {
+    long k, o = fill[i]-1;
+    for(k = offsets[i]; k < offsets[i+1]; k++)
+    {
+      if(k == offsets[i] || entries[k].key != entries[k-1].key)
+      {
+        o++;
+        newCols->data[o] = entries[k].key;
+        newValues->data[o] = values[entries[k].pos];
+      }
+      else
+        newValues->data[o] += values[entries[k].pos];
+    }
+  }
+
+  THLongStorage_resize(self->rows, nRow+1);
+  memcpy(self->rows->data, fill, sizeof(long)*(nRow+1));
+  THLongStorage_free(self->cols);
+  THStorage_(free)(self->values);
+  self->cols = newCols;
+  self->values = newValues;
+  self->nnz = fill[nRow];
+  self->format = TH_SPARSE_CSR;
+  self->coalesced = 1;
+
+  THFree(offsets);
+  THFree(fill);
+  THFree(counts);
+  THFree(entries);
+}
+
+/* CSR -> COO, keeping the order */
+static void THSparseTensor_(expand)(THSparseTensor *self)
+{
+  THLongStorage *rows = THLongStorage_newWithSize(self->nnz);
+  long i;
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < self->nRow; i++)
+  {
+    long k;
+    for(k = self->rows->data[i]; k < self->rows->data[i+1]; k++)
+      rows->data[k] = i;
+  }
+  THLongStorage_free(self->rows);
+  self->rows = rows;
+  self->format = TH_SPARSE_COO;
+}
+
+void THSparseTensor_(coalesce)(THSparseTensor *self)
+{
+  if(self->format == TH_SPARSE_COO && !self->coalesced)
+  {
+    THSparseTensor_(compress)(self);
+    THSparseTensor_(expand)(self);
+  }
+}
+
+void THSparseTensor_(toCSR)(THSparseTensor *self)
+{
+  if(self->format == TH_SPARSE_COO)
+    THSparseTensor_(compress)(self);
+}
+
+void THSparseTensor_(toCOO)(THSparseTensor *self)
+{
+  if(self->format == TH_SPARSE_CSR)
+    THSparseTensor_(expand)(self);
+}
+
+void THSparseTensor_(fromDense)(THSparseTensor *self, THTensor *dense)
+{
+  long nRow, nCol, i, j, nnz = 0;
+
+  THArgCheck(dense->nDimension == 2, 2, "2D tensor expected");
+  nRow = dense->size[0];
+  nCol = dense->size[1];
+
+  THLongStorage_resize(self->rows, nRow+1);
+  self->rows->data[0] = 0;
+  for(i = 0; i < nRow; i++)
+  {
+    for(j = 0; j < nCol; j++)
+      nnz += (THTensor_fastGet2d(dense, i, j) != 0);
+    self->rows->data[i+1] = nnz;
+  }
+
+  THLongStorage_resize(self->cols, nnz);
+  THStorage_(resize)(self->values, nnz);
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < nRow; i++)
+  {
+    long k = self->rows->data[i], c;
+    for(c = 0; c < nCol; c++)
+    {
+      real v = THTensor_fastGet2d(dense, i, c);
+      if(v != 0)
+      {
+        self->cols->data[k] = c;
+        self->values->data[k++] = v;
+      }
+    }
+  }
+
+  self->nRow = nRow;
+  self->nCol = nCol;
+  self->nnz = nnz;
+  self->format = TH_SPARSE_CSR;
+  self->coalesced = 1;
+}
+
+void THSparseTensor_(toDense)(THSparseTensor *self, THTensor *dense)
+{
+  long *cols = self->cols->data;
+  real *values = self->values->data;
+  long e;
+
+  THTensor_(resize2d)(dense, self->nRow, self->nCol);
+  THTensor_(zero)(dense);
+
+  if(self->format == TH_SPARSE_CSR)
+  {
+    long i;
+    for(i = 0; i < self->nRow; i++)
+      for(e = self->rows->data[i]; e < self->rows->data[i+1]; e++)
+        THTensor_fastSet2d(dense, i, cols[e], values[e]);
+  }
+  else
+  {
+    /* duplicates add up */
+    for(e = 0; e < self->nnz; e++)
+    {
+      real *x = THTensor_(data)(dense) + self->rows->data[e]*dense->stride[0] + cols[e]*dense->stride[1];
+      *x += values[e];
+    }
+  }
+}
+
+/**** products ****/
+
+/* columns of the result handled at once: one tile of a row of r_ stays in
+   L1 while the rows of dense selected by its nonzeros stream through */
+#define TH_SPARSE_TILE 512
+
+void THSparseTensor_(addmm)(THTensor *r_, real beta, THTensor *t, real alpha, THSparseTensor *sparse, THTensor *dense)
+{
+  real *r_data, *d_data;
+  long *rows, *cols;
+  real *values;
+  long n, rs0, rs1, ds0, ds1, i;
+
+  THArgCheck(dense->nDimension == 2, 6, "2D tensor expected");
+  THArgCheck(dense->size[0] == sparse->nCol, 6, "size mismatch");
+  THArgCheck(t->nDimension == 2 && t->size[0] == sparse->nRow && t->size[1] == dense->size[1], 3, "size mismatch");
+
+  if(t != r_)
+  {
+    THTensor_(resizeAs)(r_, t);
+    THTensor_(copy)(r_, t);
+  }
+  if(beta == 0)
+    THTensor_(zero)(r_);
+  else if(beta != 1)
+    THTensor_(mul)(r_, r_, beta);
+
+  THSparseTensor_(toCSR)(sparse);
+  rows = sparse->rows->data;
+  cols = sparse->cols->data;
+  values = sparse->values->data;
+
+  n = dense->size[1];
+  r_data = THTensor_(data)(r_);
+  d_data = THTensor_(data)(dense);
+  rs0 = r_->stride[0];
+  rs1 = r_->stride[1];
+  ds0 = dense->stride[0];
+  ds1 = dense->stride[1];
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < sparse->nRow; i++)
+  {
+    real *r = r_data + i*rs0;
+    long e, j, j0;
+
+    if(rs1 == 1 && ds1 == 1)
+    {
+      for(j0 = 0; j0 < n; j0 += TH_SPARSE_TILE)
+      {
+        long len = THMin(TH_SPARSE_TILE, n-j0);
+        for(e = rows[i]; e < rows[i+1]; e++)
+          THVector_(add)(r + j0, d_data + cols[e]*ds0 + j0, alpha*values[e], len);
+      }
+    }
+    else
+    {
+      /* e.g. dense is a transposed matrix: gather along its rows */
+      for(j = 0; j < n; j++)
+      {
+        real *d = d_data + j*ds1;
+        real sum = 0;
+        for(e = rows[i]; e < rows[i+1]; e++)
+          sum += values[e] * d[cols[e]*ds0];
+        r[j*rs1] += alpha*sum;
+      }
+    }
+  }
+}
+
+void THSparseTensor_(addmv)(THTensor *r_, real beta, THTensor *t, real alpha, THSparseTensor *sparse, THTensor *vec)
+{
+  real *r_data, *v_data;
+  long *rows, *cols;
+  real *values;
+  long rs, vs, i;
+
+  THArgCheck(vec->nDimension == 1 && vec->size[0] == sparse->nCol, 6, "size mismatch");
+  THArgCheck(t->nDimension == 1 && t->size[0] == sparse->nRow, 3, "size mismatch");
+
+  if(t != r_)
+  {
+    THTensor_(resizeAs)(r_, t);
+    THTensor_(copy)(r_, t);
+  }
+  if(beta == 0)
+    THTensor_(zero)(r_);
+  else if(beta != 1)
+    THTensor_(mul)(r_, r_, beta);
+
+  THSparseTensor_(toCSR)(sparse);
+  rows = sparse->rows->data;
+  cols = sparse->cols->data;
+  values = sparse->values->data;
+  r_data = THTensor_(data)(r_);
+  v_data = THTensor_(data)(vec);
+  rs = r_->stride[0];
+  vs = vec->stride[0];
+
+#pragma omp parallel for private(i)
+  for(i = 0; i < sparse->nRow; i++)
+  {
+    real sum = 0;
+    long e;
+    for(e = rows[i]; e < rows[i+1]; e++)
+      sum += values[e] * v_data[cols[e]*vs];
+    r_data[i*rs] += alpha*sum;
+  }
+}
+
+void THSparseTensor_(addDenseMM)(THTensor *r_, real alpha, THTensor *dense, THSparseTensor *sparse)
+{
+  THSparseEntry *entries;
+  long *start, *rowOf;
+  real *r_data, *d_data, *values;
+  long m, rs0, rs1, ds0, ds1, nnz, i, e, g, ngroup = 0;
+
+  THArgCheck(dense->nDimension == 2 && dense->size[1] == sparse->nRow, 3, "size mismatch");
+  THArgCheck(r_->nDimension == 2 && r_->size[0] == dense->size[0] && r_->size[1] == sparse->nCol, 1, "size mismatch");
+
+  THSparseTensor_(toCSR)(sparse);
+  nnz = sparse->nnz;
+  values = sparse->values->data;
+
+  /* group the entries by column, so that each column of r_ is written by
+     a single thread */
+  entries = THAlloc(sizeof(THSparseEntry)*THMax(nnz, 1));
+  rowOf = THAlloc(sizeof(long)*THMax(nnz, 1));
+  start = THAlloc(sizeof(long)*(nnz+1));
+  for(i = 0; i < sparse->nRow; i++)
+  {
+    for(e = sparse->rows->data[i]; e < sparse->rows->data[i+1]; e++)
+    {
+      entries[e].key = sparse->cols->data[e];
+      entries[e].pos = e;
+      rowOf[e] = i;
+    }
+  }
+  qsort(entries, nnz, sizeof(THSparseEntry), THSparseEntry_compare);
+  for(e = 0; e < nnz; e++)
+  {
+    if(e == 0 || entries[e].key != entries[e-1].key)
+      start[ngroup++] = e;
+  }
+  start[ngroup] = nnz;
+
+  m = dense->size[0];
+  r_data = THTensor_(data)(r_);
+  d_data = THTensor_(data)(dense);
+  rs0 = r_->stride[0];
+  rs1 = r_->stride[1];
+  ds0 = dense->stride[0];
+  ds1 = dense->stride[1];
+
+#pragma omp parallel for private(g)
+  for(g = 0; g < ngroup; g++)
+  {
+    real *r = r_data + entries[start[g]].key*rs1;
+    long k, j;
+    for(k = start[g]; k < start[g+1]; k++)
+    {
+      real *d = d_data + rowOf[entries[k].pos]*ds1;
+      real v = alpha*values[entries[k].pos];
+      if(rs0 == 1 && ds0 == 1)
+        THVector_(add)(r, d, v, m);
+      else
+      {
+        for(j = 0; j < m; j++)
+          r[j*rs0] += v*d[j*ds0];
+      }
+    }
+  }
+
+  THFree(entries);
+  THFree(rowOf);
+  THFree(start);
+}
+
+#undef TH_SPARSE_TILE
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TH_GENERIC_FILE
+#define TH_GENERIC_FILE "generic/THSparseTensor.h"
+#else
+
+/* A 2D sparse matrix. Indices are 0-based.
+   COO: rows holds the row of each entry, in any order (duplicates allowed).
+   CSR: rows holds nRow+1 offsets into cols/values; entries of a row are
+        sorted by column and unique. */
+typedef struct THSparseTensor
+{
+    long nRow;
+    long nCol;
+    long nnz;
+    int format;
+    int coalesced; /* entries sorted by (row, col) without duplicates */
+
+    THLongStorage *rows;
+    THLongStorage *cols;
+    THStorage *values;
+    int refcount;
+
+} THSparseTensor;
+
+/**** creation methods ****/
+TH_API THSparseTensor *THSparseTensor_(new)(void);
+TH_API THSparseTensor *THSparseTensor_(newWithSize)(long nRow, long nCol);
+TH_API void THSparseTensor_(retain)(THSparseTensor *self);
+TH_API void THSparseTensor_(free)(THSparseTensor *self);
+
+/* COO with nnz (uninitialized) entries */
+TH_API void THSparseTensor_(resize)(THSparseTensor *self, long nRow, long nCol, long nnz);
+
+/**** conversions ****/
+TH_API void THSparseTensor_(coalesce)(THSparseTensor *self);
+TH_API void THSparseTensor_(toCSR)(THSparseTensor *self);
+TH_API void THSparseTensor_(toCOO)(THSparseTensor *self);
+TH_API void THSparseTensor_(fromDense)(THSparseTensor *self, THTensor *dense);
+TH_API void THSparseTensor_(toDense)(THSparseTensor *self, THTensor *dense);
+
+/**** products; the sparse operand is converted to CSR ****/
+/* r_ = beta*t + alpha*sparse*dense */
+TH_API void THSparseTensor_(addmm)(THTensor *r_, real beta, THTensor *t, real alpha, THSparseTensor *sparse, THTensor *dense);
+/* r_ = beta*t + alpha*sparse*vec */
+TH_API void THSparseTensor_(addmv)(THTensor *r_, real beta, THTensor *t, real alpha, THSparseTensor *sparse, THTensor *vec);
+/* r_ += alpha*dense*sparse; only the columns of r_ holding a nonzero of
+   sparse are read or written */
+TH_API void THSparseTensor_(addDenseMM)(THTensor *r_, real alpha, THTensor *dense, THSparseTensor *sparse);
+
+#endif
@@ -458,6 +458,30 @@ void THTensor_(unfold)(THTensor *self, THTensor *src, int dimension, long size,
   self->nDimension++;
 }
 
+/* a view of src with the given size: dimensions are matched from the last
+   one, and dimensions of size 1 (or missing in src) get a stride of 0 */
+void THTensor_(expand)(THTensor *self, THTensor *src, THLongStorage *size)
+{
+  THLongStorage *stride;
+  int offset, d;
+
+  if(!src)
+    src = self;
+
+  THArgCheck(size->size >= src->nDimension, 3, "cannot expand to fewer dimensions");
+  offset = size->size - src->nDimension;
+  for(d = 0; d < src->nDimension; d++)
+    THArgCheck(src->size[d] == 1 || src->size[d] == size->data[d+offset], 3,
+               "incorrect size: only singleton dimensions can be expanded");
+
+  stride = THLongStorage_newWithSize(size->size);
+  for(d = 0; d < size->size; d++)
+    stride->data[d] = (d < offset || src->size[d-offset] == 1) ? 0 : src->stride[d-offset];
+
+  THTensor_(setStorage)(self, src->storage, src->storageOffset, size, stride);
+  THLongStorage_free(stride);
+}
+
 /* we have to handle the case where the result is a number */
 void THTensor_(squeeze)(THTensor *self, THTensor *src)
 {
@@ -98,6 +98,7 @@ TH_API void THTensor_(narrow)(THTensor *self, THTensor *src, int dimension_, lon
 TH_API void THTensor_(select)(THTensor *self, THTensor *src, int dimension_, long sliceIndex_);
 TH_API void THTensor_(transpose)(THTensor *self, THTensor *src, int dimension1_, int dimension2_);
 TH_API void THTensor_(unfold)(THTensor *self, THTensor *src, int dimension_, long size_, long step_);
+TH_API void THTensor_(expand)(THTensor *self, THTensor *src, THLongStorage *size_);
 
 TH_API void THTensor_(squeeze)(THTensor *self, THTensor *src);
 TH_API void THTensor_(squeeze1d)(THTensor *self, THTensor *src, int dimension_);
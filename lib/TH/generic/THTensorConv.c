@@ -937,6 +937,7 @@ void THTensor_(conv2Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
   long nKernelRows, nKernelCols;
   long nOutputPlane, nOutputRows, nOutputCols;
   long istride0, kstride0, kstride1;
+  TH_STATS_BEGIN(__func__);
 
   THArgCheck(t_->nDimension == 3 , 3, "input: 3D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1056,6 +1057,8 @@ void THTensor_(conv2Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
     /* Next output plane */
     /* output_data += nOutputCols*nOutputRows;*/
   }
+  TH_STATS_END((THTensor_(nElement)(input)+THTensor_(nElement)(kernel)+2*THTensor_(nElement)(r_))*(long long)sizeof(real),
+               6, ((long[]){nInputPlane, nOutputPlane, nInputRows, nInputCols, nKernelRows, nKernelCols}));
   THTensor_(free)(input);
   THTensor_(free)(kernel);
 }
@@ -1072,6 +1075,7 @@ void THTensor_(conv2Dmm)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
   long nKernelRows, nKernelCols;
   long nOutputPlane, nOutputRows, nOutputCols;
   long kstride0, kstride1;
+  TH_STATS_BEGIN(__func__);
 
   THArgCheck(t_->nDimension == 4 , 3, "input: 4D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1202,6 +1206,8 @@ void THTensor_(conv2Dmm)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
       /* output_data += nOutputCols*nOutputRows;*/
     }
   }
+  TH_STATS_END((THTensor_(nElement)(input)+THTensor_(nElement)(kernel)+2*THTensor_(nElement)(r_))*(long long)sizeof(real),
+               7, ((long[]){nbatch, nInputPlane, nOutputPlane, nInputRows, nInputCols, nKernelRows, nKernelCols}));
   THTensor_(free)(input);
   THTensor_(free)(kernel);
 }
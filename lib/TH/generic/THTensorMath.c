@@ -76,10 +76,351 @@ accreal THTensor_(dot)(THTensor *tensor, THTensor *src)
   return sum; 
 }
 
+/* Reductions. A reduction along a dimension runs in one of two orders:
+   - inner: each slice along the dimension is reduced on its own (the
+     dimension has stride 1, or the tensor is not contiguous); slices are
+     spread over threads;
+   - outer: when the reduced dimension is an outer one of a contiguous
+     tensor, whole rows of the inner dimensions are combined at once, so
+     that memory is read in order; blocks of (outer index, inner columns)
+     are spread over threads.
+   Sums use four partial accumulators over blocks of TH_REDUCE_BLOCK
+   values, combined pairwise. Full reductions of contiguous tensors are cut
+   into chunks whose partial results are combined in a fixed order, so
+   that the result does not depend on the number of threads. */
+
+static accreal THTensor_(sumPairwise)(real *x, long n, long stride)
+{
+  if(n <= TH_REDUCE_BLOCK)
+  {
+    accreal s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    long i = 0;
+    if(stride == 1)
+    {
+      for(; i+4 <= n; i += 4)
+      {
+        s0 += x[i];
+        s1 += x[i+1];
+        s2 += x[i+2];
+        s3 += x[i+3];
+      }
+    }
+    for(; i < n; i++)
+      s0 += x[i*stride];
+    return (s0+s1)+(s2+s3);
+  }
+  else
+  {
+    long half = (n/2 + TH_REDUCE_BLOCK-1)/TH_REDUCE_BLOCK*TH_REDUCE_BLOCK;
+    return THTensor_(sumPairwise)(x, half, stride) + THTensor_(sumPairwise)(x+half*stride, n-half, stride);
+  }
+}
+
+static accreal THTensor_(prodSlice)(real *x, long n, long stride)
+{
+  accreal p0 = 1, p1 = 1, p2 = 1, p3 = 1;
+  long i = 0;
+  if(stride == 1)
+  {
+    for(; i+4 <= n; i += 4)
+    {
+      p0 *= x[i];
+      p1 *= x[i+1];
+      p2 *= x[i+2];
+      p3 *= x[i+3];
+    }
+  }
+  for(; i < n; i++)
+    p0 *= x[i*stride];
+  return (p0*p1)*(p2*p3);
+}
+
+static accreal THTensor_(sumPairwiseAcc)(accreal *x, long n)
+{
+  long half;
+  if(n == 1)
+    return x[0];
+  half = n/2;
+  return THTensor_(sumPairwiseAcc)(x, half) + THTensor_(sumPairwiseAcc)(x+half, n-half);
+}
+
+/* whether the reduction along dimension can run in outer order, reading
+   t and writing r (resized to the reduced shape) as contiguous arrays */
+static int THTensor_(reduceOuter)(THTensor *t, int dimension, long *nOuter, long *nInner)
+{
+  int d;
+  if(dimension == t->nDimension-1 || t->stride[dimension] == 1 || !THTensor_(isContiguous)(t))
+    return 0;
+  *nOuter = 1;
+  *nInner = 1;
+  for(d = 0; d < dimension; d++)
+    *nOuter *= t->size[d];
+  for(d = dimension+1; d < t->nDimension; d++)
+    *nInner *= t->size[d];
+  return 1;
+}
+
+/* r = sum (or product) of t along dimension, divided by divisor */
+static void THTensor_(reduceDim)(THTensor *r_, THTensor *t, int dimension, int isProd, long divisor)
+{
+  THLongStorage *dim;
+  real *t_data, *r__data;
+  long n, nOuter, nInner, nslice, s;
+
+  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "dimension out of range");
+
+  dim = THTensor_(newSizeOf)(t);
+  THLongStorage_set(dim, dimension, 1);
+  THTensor_(resize)(r_, dim, NULL);
+  THLongStorage_free(dim);
+
+  n = t->size[dimension];
+  nslice = THTensor_(nElement)(t)/n;
+  t_data = THTensor_(data)(t);
+  r__data = THTensor_(data)(r_);
+
+  if(THTensor_(reduceOuter)(t, dimension, &nOuter, &nInner) && THTensor_(isContiguous)(r_))
+  {
+    long nblock = (nInner + TH_REDUCE_COLUMNS-1)/TH_REDUCE_COLUMNS;
+    long b;
+
+#pragma omp parallel for private(b) if(nslice*n > TH_REDUCE_PARALLEL)
+    for(b = 0; b < nOuter*nblock; b++)
+    {
+      accreal acc[TH_REDUCE_COLUMNS], part[TH_REDUCE_COLUMNS];
+      long o = b / nblock;
+      long j0 = (b % nblock)*TH_REDUCE_COLUMNS;
+      long m = THMin(TH_REDUCE_COLUMNS, nInner-j0);
+      real *src = t_data + o*n*nInner + j0;
+      long i, i0, j;
+
+      if(isProd)
+      {
+        for(j = 0; j < m; j++)
+          acc[j] = 1;
+        for(i = 0; i < n; i++)
+        {
+          for(j = 0; j < m; j++)
+            acc[j] *= src[i*nInner+j];
+        }
+      }
+      else
+      {
+        /* rows are summed by blocks, and blocks into acc */
+        for(j = 0; j < m; j++)
+          acc[j] = 0;
+        for(i0 = 0; i0 < n; i0 += TH_REDUCE_BLOCK)
+        {
+          long i1 = THMin(n, i0+TH_REDUCE_BLOCK);
+          for(j = 0; j < m; j++)
+            part[j] = 0;
+          for(i = i0; i < i1; i++)
+          {
+            for(j = 0; j < m; j++)
+              part[j] += src[i*nInner+j];
+          }
+          for(j = 0; j < m; j++)
+            acc[j] += part[j];
+        }
+      }
+      for(j = 0; j < m; j++)
+        r__data[o*nInner+j0+j] = (real)(acc[j]/divisor);
+    }
+  }
+  else
+  {
+#pragma omp parallel for private(s) if(nslice*n > TH_REDUCE_PARALLEL)
+    for(s = 0; s < nslice; s++)
+    {
+      real *src = t_data + THTensor_sliceOffset(s, t->nDimension, t->size, t->stride, dimension);
+      real *dst = r__data + THTensor_sliceOffset(s, r_->nDimension, r_->size, r_->stride, dimension);
+      accreal acc = (isProd ? THTensor_(prodSlice)(src, n, t->stride[dimension])
+                     : THTensor_(sumPairwise)(src, n, t->stride[dimension]));
+      *dst = (real)(acc/divisor);
+    }
+  }
+}
+
+/* maximum or minimum of n contiguous values, with four partial results.
+   As in a sequential scan, a NaN is only returned when it comes first. */
+static real THTensor_(bestContiguous)(real *x, long n, int isMax)
+{
+  real b0 = x[0], b1 = x[0], b2 = x[0], b3 = x[0];
+  long i = 0;
+  if(isMax)
+  {
+    for(; i+4 <= n; i += 4)
+    {
+      b0 = (x[i] > b0 ? x[i] : b0);
+      b1 = (x[i+1] > b1 ? x[i+1] : b1);
+      b2 = (x[i+2] > b2 ? x[i+2] : b2);
+      b3 = (x[i+3] > b3 ? x[i+3] : b3);
+    }
+    for(; i < n; i++)
+      b0 = (x[i] > b0 ? x[i] : b0);
+    b0 = (b1 > b0 ? b1 : b0);
+    b0 = (b2 > b0 ? b2 : b0);
+    b0 = (b3 > b0 ? b3 : b0);
+  }
+  else
+  {
+    for(; i+4 <= n; i += 4)
+    {
+      b0 = (x[i] < b0 ? x[i] : b0);
+      b1 = (x[i+1] < b1 ? x[i+1] : b1);
+      b2 = (x[i+2] < b2 ? x[i+2] : b2);
+      b3 = (x[i+3] < b3 ? x[i+3] : b3);
+    }
+    for(; i < n; i++)
+      b0 = (x[i] < b0 ? x[i] : b0);
+    b0 = (b1 < b0 ? b1 : b0);
+    b0 = (b2 < b0 ? b2 : b0);
+    b0 = (b3 < b0 ? b3 : b0);
+  }
+  return b0;
+}
+
+/* values and (0-based) indices of the first maximum or minimum along
+   dimension */
+static void THTensor_(reduceDimArg)(THTensor *values_, THLongTensor *indices_, THTensor *t, int dimension, int isMax)
+{
+  THLongStorage *dim;
+  real *t_data, *values__data;
+  long *indices__data;
+  long n, nOuter, nInner, nslice, s;
+
+  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "dimension out of range");
+
+  dim = THTensor_(newSizeOf)(t);
+  THLongStorage_set(dim, dimension, 1);
+  THTensor_(resize)(values_, dim, NULL);
+  THLongTensor_resize(indices_, dim, NULL);
+  THLongStorage_free(dim);
+
+  n = t->size[dimension];
+  nslice = THTensor_(nElement)(t)/n;
+  t_data = THTensor_(data)(t);
+  values__data = THTensor_(data)(values_);
+  indices__data = THLongTensor_data(indices_);
+
+  if(THTensor_(reduceOuter)(t, dimension, &nOuter, &nInner)
+     && THTensor_(isContiguous)(values_) && THLongTensor_isContiguous(indices_))
+  {
+    long nblock = (nInner + TH_REDUCE_COLUMNS-1)/TH_REDUCE_COLUMNS;
+    long b;
+
+#pragma omp parallel for private(b) if(nslice*n > TH_REDUCE_PARALLEL)
+    for(b = 0; b < nOuter*nblock; b++)
+    {
+      long o = b / nblock;
+      long j0 = (b % nblock)*TH_REDUCE_COLUMNS;
+      long m = THMin(TH_REDUCE_COLUMNS, nInner-j0);
+      real *src = t_data + o*n*nInner + j0;
+      real *best = values__data + o*nInner + j0;
+      long *bestIndex = indices__data + o*nInner + j0;
+      long i, j;
+
+      for(j = 0; j < m; j++)
+      {
+        best[j] = src[j];
+        bestIndex[j] = 0;
+      }
+      /* branch-free, so that the column loops vectorize */
+      for(i = 1; i < n; i++)
+      {
+        real *row = src + i*nInner;
+        if(isMax)
+        {
+          for(j = 0; j < m; j++)
+          {
+            int better = (row[j] > best[j]);
+            best[j] = better ? row[j] : best[j];
+            bestIndex[j] = better ? i : bestIndex[j];
+          }
+        }
+        else
+        {
+          for(j = 0; j < m; j++)
+          {
+            int better = (row[j] < best[j]);
+            best[j] = better ? row[j] : best[j];
+            bestIndex[j] = better ? i : bestIndex[j];
+          }
+        }
+      }
+    }
+  }
+  else
+  {
+#pragma omp parallel for private(s) if(nslice*n > TH_REDUCE_PARALLEL)
+    for(s = 0; s < nslice; s++)
+    {
+      real *src = t_data + THTensor_sliceOffset(s, t->nDimension, t->size, t->stride, dimension);
+      long stride = t->stride[dimension];
+      long theIndex = 0, i;
+      real theBest = src[0];
+      if(stride == 1)
+      {
+        /* the value, then its first position (0 for a leading NaN) */
+        theBest = THTensor_(bestContiguous)(src, n, isMax);
+        while(theIndex < n && src[theIndex] != theBest)
+          theIndex++;
+        if(theIndex == n)
+          theIndex = 0;
+      }
+      else if(isMax)
+      {
+        for(i = 1; i < n; i++)
+        {
+          if(src[i*stride] > theBest)
+          {
+            theIndex = i;
+            theBest = src[i*stride];
+          }
+        }
+      }
+      else
+      {
+        for(i = 1; i < n; i++)
+        {
+          if(src[i*stride] < theBest)
+          {
+            theIndex = i;
+            theBest = src[i*stride];
+          }
+        }
+      }
+      values__data[THTensor_sliceOffset(s, values_->nDimension, values_->size, values_->stride, dimension)] = theBest;
+      indices__data[THTensor_sliceOffset(s, indices_->nDimension, indices_->size, indices_->stride, dimension)] = theIndex;
+    }
+  }
+}
+
+/* maximum or minimum of a contiguous tensor, by chunks */
+static real THTensor_(bestall)(THTensor *tensor, int isMax)
+{
+  real *data = THTensor_(data)(tensor);
+  long n = THTensor_(nElement)(tensor);
+  long nchunk = (n + TH_REDUCE_CHUNK-1)/TH_REDUCE_CHUNK;
+  real *part = THAlloc(sizeof(real)*nchunk);
+  real theBest;
+  long c;
+
+#pragma omp parallel for private(c) if(n > TH_REDUCE_PARALLEL)
+  for(c = 0; c < nchunk; c++)
+    part[c] = THTensor_(bestContiguous)(data + c*TH_REDUCE_CHUNK, THMin(TH_REDUCE_CHUNK, n-c*TH_REDUCE_CHUNK), isMax);
+
+  theBest = THTensor_(bestContiguous)(part, nchunk, isMax);
+  THFree(part);
+  return theBest;
+}
+
 real THTensor_(minall)(THTensor *tensor)
 {
   real theMin;
   THArgCheck(tensor->nDimension > 0, 1, "tensor must have one dimension");
+  if(THTensor_(isContiguous)(tensor))
+    return THTensor_(bestall)(tensor, 0);
   theMin = THTensor_(data)(tensor)[0];
   TH_TENSOR_APPLY(real, tensor, if(*tensor_data < theMin) theMin = *tensor_data;);
   return theMin; 
@@ -89,6 +430,8 @@ real THTensor_(maxall)(THTensor *tensor)
 {
   real theMax;
   THArgCheck(tensor->nDimension > 0, 1, "tensor must have one dimension");
+  if(THTensor_(isContiguous)(tensor))
+    return THTensor_(bestall)(tensor, 1);
   theMax = THTensor_(data)(tensor)[0];
   TH_TENSOR_APPLY(real, tensor, if(*tensor_data > theMax) theMax = *tensor_data;);
   return theMax; 
@@ -97,7 +440,28 @@ real THTensor_(maxall)(THTensor *tensor)
 accreal THTensor_(sumall)(THTensor *tensor)
 {
   accreal sum = 0;
-  TH_TENSOR_APPLY(real, tensor, sum += *tensor_data;);
+  if(tensor->nDimension > 0 && THTensor_(isContiguous)(tensor))
+  {
+    real *data = THTensor_(data)(tensor);
+    long n = THTensor_(nElement)(tensor);
+    long nchunk = (n + TH_REDUCE_CHUNK-1)/TH_REDUCE_CHUNK;
+    accreal *part = THAlloc(sizeof(accreal)*nchunk);
+    long c;
+
+#pragma omp parallel for private(c) if(n > TH_REDUCE_PARALLEL)
+    for(c = 0; c < nchunk; c++)
+      part[c] = THTensor_(sumPairwise)(data + c*TH_REDUCE_CHUNK, THMin(TH_REDUCE_CHUNK, n-c*TH_REDUCE_CHUNK), 1);
+
+    sum = THTensor_(sumPairwiseAcc)(part, nchunk);
+    THFree(part);
+    return sum;
+  }
+  /* rows of the innermost dimension are summed pairwise */
+  TH_TENSOR_APPLY(real, tensor,
+                  sum += THTensor_(sumPairwise)(tensor_data, tensor_size-tensor_i, tensor_stride);
+                  tensor_data += (tensor_size-tensor_i)*tensor_stride;
+                  tensor_i = tensor_size;
+                  break;);
   return sum;
 }
 
@@ -119,45 +483,266 @@ void THTensor_(div)(THTensor *r_, THTensor *t, real value)
   TH_TENSOR_APPLY2(real, r_, real, t, *r__data = *t_data / value;);
 }
 
+/* Broadcasting of element-wise operations. Operands with the same number of
+   elements are combined element by element, whatever their shapes. Otherwise
+   their shapes are matched from the last dimension, NumPy style: each
+   dimension must have the same size in all operands or size 1 (missing
+   leading dimensions count as 1), and operands are replaced by views where
+   dimensions of size 1 get a stride of 0, so nothing is copied. The result
+   takes the broadcast shape; it may be one of the operands only if that one
+   already has that shape. Returns whether the operands were replaced. */
+static int THTensor_(broadcast)(THTensor *r_, THTensor **a, THTensor **b, THTensor **c)
+{
+  THTensor **args[3];
+  int nargs = (c ? 3 : 2);
+  THLongStorage *size;
+  int i, d, ndim = 0, same = 1;
+
+  args[0] = a;
+  args[1] = b;
+  args[2] = c;
+  for(i = 0; i < nargs; i++)
+  {
+    if((*args[i])->nDimension == 0)
+      return 0;
+    if(THTensor_(nElement)(*args[i]) != THTensor_(nElement)(*a))
+      same = 0;
+    ndim = THMax(ndim, (*args[i])->nDimension);
+  }
+  if(same)
+    return 0;
+
+  size = THLongStorage_newWithSize(ndim);
+  THLongStorage_fill(size, 1);
+  for(i = 0; i < nargs; i++)
+  {
+    THTensor *t = *args[i];
+    int offset = ndim - t->nDimension;
+    for(d = 0; d < t->nDimension; d++)
+    {
+      if(t->size[d] == 1)
+        continue;
+      if(size->data[d+offset] != 1 && size->data[d+offset] != t->size[d])
+      {
+        THLongStorage_free(size);
+        THError("inconsistent tensor size: operands cannot be broadcast together");
+      }
+      size->data[d+offset] = t->size[d];
+    }
+  }
+
+  same = (r_->nDimension == ndim);
+  for(d = 0; same && d < ndim; d++)
+    same = (r_->size[d] == size->data[d]);
+  if(!same)
+  {
+    for(i = 0; i < nargs; i++)
+    {
+      if(r_ == *args[i])
+      {
+        THLongStorage_free(size);
+        THError("inconsistent tensor size: the result of the broadcast is larger than the tensor updated in place");
+      }
+    }
+    THTensor_(resize)(r_, size, NULL);
+  }
+
+  for(i = 0; i < nargs; i++)
+  {
+    THTensor *view = THTensor_(new)();
+    THTensor_(expand)(view, *args[i], size);
+    *args[i] = view;
+  }
+  THLongStorage_free(size);
+  return 1;
+}
+
+static void THTensor_(broadcastFree)(THTensor *a, THTensor *b, THTensor *c)
+{
+  THTensor_(free)(a);
+  THTensor_(free)(b);
+  if(c)
+    THTensor_(free)(c);
+}
+
 void THTensor_(cadd)(THTensor *r_, THTensor *t, real value, THTensor *src)
 {
-  THTensor_(resizeAs)(r_, t);
+  int expanded = THTensor_(broadcast)(r_, &t, &src, NULL);
+  if(!expanded)
+    THTensor_(resizeAs)(r_, t);
   TH_TENSOR_APPLY3(real, r_, real, t, real, src, *r__data = *t_data + value * *src_data;);
+  if(expanded)
+    THTensor_(broadcastFree)(t, src, NULL);
 }
 
 void THTensor_(cmul)(THTensor *r_, THTensor *t, THTensor *src)
 {
-  THTensor_(resizeAs)(r_, t);
+  int expanded = THTensor_(broadcast)(r_, &t, &src, NULL);
+  if(!expanded)
+    THTensor_(resizeAs)(r_, t);
   TH_TENSOR_APPLY3(real, r_, real, t, real, src, *r__data = *t_data * *src_data;);
+  if(expanded)
+    THTensor_(broadcastFree)(t, src, NULL);
 }
 
 void THTensor_(cdiv)(THTensor *r_, THTensor *t, THTensor *src)
 {
-  THTensor_(resizeAs)(r_, t);
+  int expanded = THTensor_(broadcast)(r_, &t, &src, NULL);
+  if(!expanded)
+    THTensor_(resizeAs)(r_, t);
   TH_TENSOR_APPLY3(real, r_, real, t, real, src, *r__data = *t_data / *src_data;);
+  if(expanded)
+    THTensor_(broadcastFree)(t, src, NULL);
 }
 
 void THTensor_(addcmul)(THTensor *r_, THTensor *t, real value, THTensor *src1, THTensor *src2)
 {
-  if(r_ != t)
+  int inplace = (r_ == t);
+  int expanded = THTensor_(broadcast)(r_, &t, &src1, &src2);
+  if(!inplace)
   {
-    THTensor_(resizeAs)(r_, t);
+    if(!expanded)
+      THTensor_(resizeAs)(r_, t);
     THTensor_(copy)(r_, t);
   }
 
   TH_TENSOR_APPLY3(real, r_, real, src1, real, src2, *r__data += value * *src1_data * *src2_data;);
+  if(expanded)
+    THTensor_(broadcastFree)(t, src1, src2);
 }
 
 
 void THTensor_(addcdiv)(THTensor *r_, THTensor *t, real value, THTensor *src1, THTensor *src2)
 {
-  if(r_ != t)
+  int inplace = (r_ == t);
+  int expanded = THTensor_(broadcast)(r_, &t, &src1, &src2);
+  if(!inplace)
   {
-    THTensor_(resizeAs)(r_, t);
+    if(!expanded)
+      THTensor_(resizeAs)(r_, t);
     THTensor_(copy)(r_, t);
   }
 
   TH_TENSOR_APPLY3(real, r_, real, src1, real, src2, *r__data += value * *src1_data / *src2_data;);
+  if(expanded)
+    THTensor_(broadcastFree)(t, src1, src2);
+}
+
+/* Fused evaluation of an element-wise expression. The program runs over
+   blocks of TH_FUSE_BLOCK elements: registers 0 to ninputs-1 point into the
+   inputs, the ntemps next ones into per-thread buffers, so that the whole
+   expression costs a single pass over memory. The last instruction writes
+   straight into the result, or the result is a copy of register 0 when
+   there are no instructions. */
+void THTensor_(fuse)(THTensor *r_, THTensor **inputs, int ninputs, int ntemps, const int *code, int ninstr, const real *scalars, int nscalars)
+{
+  int nreg = ninputs + ntemps;
+  THTensor **src, *out;
+  long n, nblock, b;
+  int i;
+
+  THArgCheck(ninputs > 0, 3, "at least one input expected");
+  n = THTensor_(nElement)(inputs[0]);
+  for(i = 1; i < ninputs; i++)
+    THArgCheck(THTensor_(nElement)(inputs[i]) == n, 2, "inputs must have the same number of elements");
+  for(i = 0; i < ninstr; i++)
+  {
+    const int *ins = code + 5*i;
+    THArgCheck(ins[0] >= 0 && ins[0] < TH_FUSE_NOPS, 5, "invalid instruction");
+    THArgCheck(ins[1] >= ninputs && ins[1] < nreg && ins[2] >= 0 && ins[2] < nreg && ins[3] >= 0 && ins[3] < nreg,
+               5, "invalid register");
+    THArgCheck(ins[4] < nscalars, 5, "invalid scalar");
+  }
+
+  src = THAlloc(sizeof(THTensor*)*ninputs);
+  for(i = 0; i < ninputs; i++)
+    src[i] = THTensor_(newContiguous)(inputs[i]);
+  THTensor_(resizeAs)(r_, inputs[0]);
+  out = THTensor_(newContiguous)(r_);
+
+  nblock = (n + TH_FUSE_BLOCK-1)/TH_FUSE_BLOCK;
+
+#pragma omp parallel private(b) if(n > TH_REDUCE_PARALLEL)
+  {
+    real *buffer = THAlloc(sizeof(real)*TH_FUSE_BLOCK*THMax(ntemps, 1));
+    real **reg = THAlloc(sizeof(real*)*nreg);
+    int k;
+
+    for(k = 0; k < ntemps; k++)
+      reg[ninputs+k] = buffer + k*TH_FUSE_BLOCK;
+
+#pragma omp for
+    for(b = 0; b < nblock; b++)
+    {
+      long start = b*TH_FUSE_BLOCK;
+      long m = THMin(TH_FUSE_BLOCK, n-start);
+      real *res = THTensor_(data)(out) + start;
+      long j;
+
+      for(k = 0; k < ninputs; k++)
+        reg[k] = THTensor_(data)(src[k]) + start;
+
+      if(ninstr == 0)
+        memcpy(res, reg[0], sizeof(real)*m);
+
+      for(k = 0; k < ninstr; k++)
+      {
+        const int *ins = code + 5*k;
+        real *d = (k == ninstr-1 ? res : reg[ins[1]]);
+        real *x = reg[ins[2]];
+        real *y = reg[ins[3]];
+        real s = (ins[4] >= 0 ? scalars[ins[4]] : 0);
+
+        switch(ins[0])
+        {
+          case TH_FUSE_ADD:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] + y[j];
+            break;
+          case TH_FUSE_SUB:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] - y[j];
+            break;
+          case TH_FUSE_MUL:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] * y[j];
+            break;
+          case TH_FUSE_DIV:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] / y[j];
+            break;
+          case TH_FUSE_AXPY:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] + s * y[j];
+            break;
+          case TH_FUSE_ADDS:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] + s;
+            break;
+          case TH_FUSE_MULS:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] * s;
+            break;
+          case TH_FUSE_DIVS:
+            for(j = 0; j < m; j++)
+              d[j] = x[j] / s;
+            break;
+          case TH_FUSE_RDIVS:
+            for(j = 0; j < m; j++)
+              d[j] = s / x[j];
+            break;
+        }
+      }
+    }
+
+    THFree(buffer);
+    THFree(reg);
+  }
+
+  for(i = 0; i < ninputs; i++)
+    THTensor_(free)(src[i]);
+  THFree(src);
+  THTensor_(freeCopyTo)(out, r_);
 }
 
 void THTensor_(addmv)(THTensor *r_, real beta, THTensor *t, real alpha, THTensor *mat, THTensor *vec)
@@ -366,100 +951,22 @@ long THTensor_(numel)(THTensor *t)
 
 void THTensor_(max)(THTensor *values_, THLongTensor *indices_, THTensor *t, int dimension)
 {
-  THLongStorage *dim;
-  long i;
-
-  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "dimension out of range");
-
-  dim = THTensor_(newSizeOf)(t);
-  THLongStorage_set(dim, dimension, 1);
-  THTensor_(resize)(values_, dim, NULL);
-  THLongTensor_resize(indices_, dim, NULL);
-  THLongStorage_free(dim);
-
-  TH_TENSOR_DIM_APPLY3(real, t, real, values_, long, indices_, dimension,
-                       long theIndex = 0;
-                       real theMax = t_data[0];
-                       for(i = 1; i < t_size; i++)
-                       {
-                         if(t_data[i*t_stride] > theMax)
-                         {
-                           theIndex = i;
-                           theMax = t_data[i*t_stride];
-                         }
-                       }
-                       *indices__data = theIndex;
-                       *values__data = theMax;);  
-
+  THTensor_(reduceDimArg)(values_, indices_, t, dimension, 1);
 }
 
 void THTensor_(min)(THTensor *values_, THLongTensor *indices_, THTensor *t, int dimension)
 {
-  THLongStorage *dim;
-  long i;
-
-  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "dimension out of range");
-
-  dim = THTensor_(newSizeOf)(t);
-  THLongStorage_set(dim, dimension, 1);
-  THTensor_(resize)(values_, dim, NULL);
-  THLongTensor_resize(indices_, dim, NULL);
-  THLongStorage_free(dim);
-
-  TH_TENSOR_DIM_APPLY3(real, t, real, values_, long, indices_, dimension,
-                       long theIndex = 0;
-                       real theMin = t_data[0];
-                       for(i = 1; i < t_size; i++)
-                       {
-                         if(t_data[i*t_stride] < theMin)
-                         {
-                           theIndex = i;
-                           theMin = t_data[i*t_stride];
-                         }
-                       }
-                       *indices__data = theIndex;
-                       *values__data = theMin;);  
-
+  THTensor_(reduceDimArg)(values_, indices_, t, dimension, 0);
 }
 
-
 void THTensor_(sum)(THTensor *r_, THTensor *t, int dimension)
 {
-  THLongStorage *dim;
-
-  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "dimension out of range");
-  
-  dim = THTensor_(newSizeOf)(t);
-  THLongStorage_set(dim, dimension, 1);
-  THTensor_(resize)(r_, dim, NULL);
-  THLongStorage_free(dim);
-
-  TH_TENSOR_DIM_APPLY2(real, t, real, r_, dimension,
-                       accreal sum = 0;
-                       long i;
-                       for(i = 0; i < t_size; i++)
-                         sum += t_data[i*t_stride];
-                       *r__data = (real)sum;);
+  THTensor_(reduceDim)(r_, t, dimension, 0, 1);
 }
 
 void THTensor_(prod)(THTensor *r_, THTensor *t, int dimension)
 {
-  THLongStorage *dim;
-
-  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "dimension out of range");
-
-  dim = THTensor_(newSizeOf)(t);
-  THLongStorage_set(dim, dimension, 1);
-  THTensor_(resize)(r_, dim, NULL);
-  THLongStorage_free(dim);
-  
-  TH_TENSOR_DIM_APPLY2(real, t, real, r_, dimension,
-                       accreal prod = 1;
-                       long i;
-                       for(i = 0; i < t_size; i++)
-                         prod *= t_data[i*t_stride];
-                       *r__data = (real)prod;);
-
+  THTensor_(reduceDim)(r_, t, dimension, 1, 1);
 }
 
 void THTensor_(cumsum)(THTensor *r_, THTensor *t, int dimension)
@@ -698,85 +1205,452 @@ void THTensor_(reshape)(THTensor *r_, THTensor *t, THLongStorage *size)
   THTensor_(copy)(r_, t);
 }
 
-/* I cut and pasted (slightly adapted) the quicksort code from
-   http://www.alienryderflex.com/quicksort/
-   This public-domain C implementation by Darel Rex Finley.
-   Thanks man :)
-*/
-#define  MAX_LEVELS  300
-static void THTensor_(quicksortascend)(real *arr, long *idx, long elements, long stride)
+/* Sorting engine. Each slice is gathered into contiguous scratch, sorted
+   there and scattered back; independent slices run in parallel. Slices are
+   sorted with an introsort (median-of-3 quicksort, heapsort past a depth
+   limit, insertion sort for small ranges), long float slices with a radix
+   sort. Equal values keep increasing indices. */
+
+#define TH_SORT_INSERTION 16
+#define TH_SORT_RADIX 1024
+
+static void THTensor_(sortSwap)(real *v, long *ix, long i, long j)
+{
+  real tv = v[i];
+  long ti = ix[i];
+  v[i] = v[j];
+  ix[i] = ix[j];
+  v[j] = tv;
+  ix[j] = ti;
+}
+
+static void THTensor_(insertionSort)(real *v, long *ix, long n, int desc)
 {
-  long beg[MAX_LEVELS], end[MAX_LEVELS], i=0, L, R, swap, pid;
-  real piv;
-  
-  beg[0]=0; end[0]=elements;
-  while (i>=0) {
-    L=beg[i]; R=end[i]-1;
-    if (L<R) {
-      piv=arr[L*stride];
-      pid=idx[L*stride];
-      while (L<R) {
-        while (arr[R*stride]>=piv && L<R) R--; if (L<R) {idx[L*stride]=idx[R*stride]; arr[L*stride]=arr[R*stride]; L++;}
-        while (arr[L*stride]<=piv && L<R) L++; if (L<R) {idx[R*stride]=idx[L*stride]; arr[R*stride]=arr[L*stride]; R--;} }
-      idx[L*stride]=pid; arr[L*stride]=piv; beg[i+1]=L+1; end[i+1]=end[i]; end[i++]=L;
-      if (end[i]-beg[i]>end[i-1]-beg[i-1]) {
-        swap=beg[i]; beg[i]=beg[i-1]; beg[i-1]=swap;
-        swap=end[i]; end[i]=end[i-1]; end[i-1]=swap; }}
-    else {
-      i--; }}}
-
-static void THTensor_(quicksortdescend)(real *arr, long *idx, long elements, long stride)
-{
-  long beg[MAX_LEVELS], end[MAX_LEVELS], i=0, L, R, swap, pid;
-  real piv;
-  
-  beg[0]=0; end[0]=elements;
-  while (i>=0) {
-    L=beg[i]; R=end[i]-1;
-    if (L<R) {
-      piv=arr[L*stride];
-      pid=idx[L*stride];
-      while (L<R) {
-        while (arr[R*stride]<=piv && L<R) R--; if (L<R) {idx[L*stride]=idx[R*stride]; arr[L*stride]=arr[R*stride]; L++;}
-        while (arr[L*stride]>=piv && L<R) L++; if (L<R) {idx[R*stride]=idx[L*stride]; arr[R*stride]=arr[L*stride]; R--;} }
-      idx[L*stride]=pid; arr[L*stride]=piv; beg[i+1]=L+1; end[i+1]=end[i]; end[i++]=L;
-      if (end[i]-beg[i]>end[i-1]-beg[i-1]) {
-        swap=beg[i]; beg[i]=beg[i-1]; beg[i-1]=swap;
-        swap=end[i]; end[i]=end[i-1]; end[i-1]=swap; }}
-    else {
-      i--; }}}
+  long i, j;
+  for(i = 1; i < n; i++)
+  {
+    real tv = v[i];
+    long ti = ix[i];
+    for(j = i; j > 0 && (tv < v[j-1] || (tv == v[j-1] && (desc ? ti > ix[j-1] : ti < ix[j-1]))); j--)
+    {
+      v[j] = v[j-1];
+      ix[j] = ix[j-1];
+    }
+    v[j] = tv;
+    ix[j] = ti;
+  }
+}
+
+static void THTensor_(siftDown)(real *v, long *ix, long root, long n, int desc)
+{
+  long child;
+  while((child = 2*root+1) < n)
+  {
+    if(child+1 < n && THTensor_sortBefore(v, ix, child, child+1, desc))
+      child++;
+    if(!THTensor_sortBefore(v, ix, root, child, desc))
+      return;
+    THTensor_(sortSwap)(v, ix, root, child);
+    root = child;
+  }
+}
+
+static void THTensor_(heapSort)(real *v, long *ix, long n, int desc)
+{
+  long i;
+  for(i = n/2-1; i >= 0; i--)
+    THTensor_(siftDown)(v, ix, i, n, desc);
+  for(i = n-1; i > 0; i--)
+  {
+    THTensor_(sortSwap)(v, ix, 0, i);
+    THTensor_(siftDown)(v, ix, 0, i, desc);
+  }
+}
+
+/* Hoare partition around the median of the first, middle and last
+   elements; returns p such that [0, p) comes before [p, n), 0 < p < n */
+static long THTensor_(partition)(real *v, long *ix, long n, int desc)
+{
+  long mid = n/2, i = 0, j = n-1;
+  real pv;
+  long pi;
+
+  if(THTensor_sortBefore(v, ix, mid, 0, desc))
+    THTensor_(sortSwap)(v, ix, mid, 0);
+  if(THTensor_sortBefore(v, ix, n-1, mid, desc))
+  {
+    THTensor_(sortSwap)(v, ix, n-1, mid);
+    if(THTensor_sortBefore(v, ix, mid, 0, desc))
+      THTensor_(sortSwap)(v, ix, mid, 0);
+  }
+  pv = v[mid];
+  pi = ix[mid];
+
+  /* the first and last elements are sentinels for both scans */
+  for(;;)
+  {
+    do i++; while(v[i] < pv || (v[i] == pv && (desc ? ix[i] > pi : ix[i] < pi)));
+    do j--; while(pv < v[j] || (pv == v[j] && (desc ? pi > ix[j] : pi < ix[j])));
+    if(i >= j)
+      return j+1;
+    THTensor_(sortSwap)(v, ix, i, j);
+  }
+}
+
+static void THTensor_(introSort)(real *v, long *ix, long n, int depth, int desc)
+{
+  while(n > TH_SORT_INSERTION)
+  {
+    long p;
+    if(depth-- == 0)
+    {
+      THTensor_(heapSort)(v, ix, n, desc);
+      return;
+    }
+    p = THTensor_(partition)(v, ix, n, desc);
+    /* recurse into the smaller side */
+    if(p < n-p)
+    {
+      THTensor_(introSort)(v, ix, p, depth, desc);
+      v += p;
+      ix += p;
+      n -= p;
+    }
+    else
+    {
+      THTensor_(introSort)(v+p, ix+p, n-p, depth, desc);
+      n = p;
+    }
+  }
+  THTensor_(insertionSort)(v, ix, n, desc);
+}
+
+static int THTensor_(sortDepth)(long n)
+{
+  int depth = 0;
+  while(n > 1)
+  {
+    n >>= 1;
+    depth += 2;
+  }
+  return depth;
+}
+
+/* reorders v so that [0, m) comes before [m, n) */
+static void THTensor_(quickSelect)(real *v, long *ix, long n, long m, int desc)
+{
+  int depth = THTensor_(sortDepth)(n);
+  while(n > TH_SORT_INSERTION)
+  {
+    long p;
+    if(depth-- == 0)
+    {
+      THTensor_(heapSort)(v, ix, n, desc);
+      return;
+    }
+    p = THTensor_(partition)(v, ix, n, desc);
+    if(m < p)
+      n = p;
+    else if(m > p)
+    {
+      v += p;
+      ix += p;
+      n -= p;
+      m -= p;
+    }
+    else
+      return;
+  }
+  THTensor_(insertionSort)(v, ix, n, desc);
+}
+
+static void THTensor_(reverse)(real *v, long *ix, long n)
+{
+  long i;
+  for(i = 0; i < n/2; i++)
+    THTensor_(sortSwap)(v, ix, i, n-1-i);
+}
+
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+
+#if defined(TH_REAL_IS_FLOAT)
+#define THSortKey unsigned int
+#else
+#define THSortKey unsigned long long
+#endif
+
+/* LSD radix sort on 8-bit digits of the IEEE bits, mapped to unsigned
+   integers in the same order (negative numbers flipped, positive ones with
+   the sign bit set). Each pass is stable, so equal values keep their
+   order; descending sorts complement the keys. */
+static void THTensor_(radixSort)(real *v, long *ix, long n, int desc, THSortKey *key, THSortKey *key2, long *ix2)
+{
+  const THSortKey sign = (THSortKey)1 << (sizeof(THSortKey)*8-1);
+  long *ix1 = ix;
+  long count[256];
+  unsigned int shift;
+  long e;
+
+  for(e = 0; e < n; e++)
+  {
+    THSortKey u;
+    memcpy(&u, v+e, sizeof(THSortKey));
+    u = (u & sign) ? ~u : (u | sign);
+    key[e] = desc ? ~u : u;
+  }
+
+  for(shift = 0; shift < sizeof(THSortKey)*8; shift += 8)
+  {
+    long sum = 0;
+    int d;
+    THSortKey *tk;
+    long *ti;
+
+    memset(count, 0, sizeof(count));
+    for(e = 0; e < n; e++)
+      count[(key[e] >> shift) & 255]++;
+    if(count[(key[0] >> shift) & 255] == n) /* same digit everywhere */
+      continue;
+    for(d = 0; d < 256; d++)
+    {
+      long c = count[d];
+      count[d] = sum;
+      sum += c;
+    }
+    for(e = 0; e < n; e++)
+    {
+      long pos = count[(key[e] >> shift) & 255]++;
+      key2[pos] = key[e];
+      ix2[pos] = ix1[e];
+    }
+    tk = key; key = key2; key2 = tk;
+    ti = ix1; ix1 = ix2; ix2 = ti;
+  }
+
+  for(e = 0; e < n; e++)
+  {
+    THSortKey u = desc ? ~key[e] : key[e];
+    u = (u & sign) ? (u & ~sign) : ~u;
+    memcpy(v+e, &u, sizeof(THSortKey));
+  }
+  if(ix1 != ix)
+    memcpy(ix, ix1, sizeof(long)*n);
+}
+
+#endif
+
+/* sorts n values with their indices. The radix sort needs scratch of
+   THTensor_(sortScratchSize) bytes and relies on the indices coming in
+   increasing order: without scratch, a comparison sort is used. */
+static long THTensor_(sortScratchSize)(long n)
+{
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if(n >= TH_SORT_RADIX)
+    return n*(2*sizeof(THSortKey) + sizeof(long));
+#endif
+  return 0;
+}
+
+static void THTensor_(sortValues)(real *v, long *ix, long n, int desc, void *scratch)
+{
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if(scratch && n >= TH_SORT_RADIX)
+  {
+    THSortKey *key = scratch;
+    THTensor_(radixSort)(v, ix, n, desc, key, key+n, (long*)(key+2*n));
+    return;
+  }
+#endif
+  THTensor_(introSort)(v, ix, n, THTensor_(sortDepth)(n), desc);
+  if(desc)
+    THTensor_(reverse)(v, ix, n);
+}
 
 void THTensor_(sort)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension, int descendingOrder)
 {
+  real *t_data, *rt__data;
+  long *ri__data;
+  long n, nslice, s;
+
   THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "invalid dimension");
 
   THTensor_(resizeAs)(rt_, t);
-  THTensor_(copy)(rt_, t);
-
   {
     THLongStorage *size = THTensor_(newSizeOf)(t);
     THLongTensor_resize(ri_, size, NULL);
     THLongStorage_free(size);
   }
 
-  if(descendingOrder)
+  n = t->size[dimension];
+  nslice = THTensor_(nElement)(t)/n;
+  t_data = THTensor_(data)(t);
+  rt__data = THTensor_(data)(rt_);
+  ri__data = THLongTensor_data(ri_);
+
+#pragma omp parallel private(s)
   {
-    TH_TENSOR_DIM_APPLY2(real, rt_, long, ri_, dimension, 
-                         long i;
-                         for(i = 0; i < ri__size; i++)
-                           ri__data[i*ri__stride] = i;
-                         THTensor_(quicksortdescend)(rt__data, ri__data, rt__size, rt__stride);)
+    real *v = THAlloc(sizeof(real)*n);
+    long *ix = THAlloc(sizeof(long)*n);
+    void *scratch = THAlloc(THTensor_(sortScratchSize)(n));
+
+#pragma omp for
+    for(s = 0; s < nslice; s++)
+    {
+      /* rt_ may be t: the slice is read before it gets written */
+      real *ts = t_data + THTensor_sliceOffset(s, t->nDimension, t->size, t->stride, dimension);
+      real *rs = rt__data + THTensor_sliceOffset(s, rt_->nDimension, rt_->size, rt_->stride, dimension);
+      long *is = ri__data + THTensor_sliceOffset(s, ri_->nDimension, ri_->size, ri_->stride, dimension);
+      long i;
+
+      for(i = 0; i < n; i++)
+      {
+        v[i] = ts[i*t->stride[dimension]];
+        ix[i] = i;
       }
-  else
+      THTensor_(sortValues)(v, ix, n, descendingOrder, scratch);
+      for(i = 0; i < n; i++)
+      {
+        rs[i*rt_->stride[dimension]] = v[i];
+        is[i*ri_->stride[dimension]] = ix[i];
+      }
+    }
+
+    THFree(v);
+    THFree(ix);
+    THFree(scratch);
+  }
+}
+
+/* selection of the k largest (dir) or smallest values along dimension.
+   When k is small compared to the slice, a heap of the k best values seen
+   so far is kept while streaming through the slice; otherwise the slice is
+   partitioned in scratch. */
+#define TH_TOPK_HEAP 16
+
+static void THTensor_(topkSiftDown)(real *v, long *ix, long root, long n, int dir)
+{
+  long child;
+  while((child = 2*root+1) < n)
+  {
+    if(child+1 < n && THTensor_topkWorse(v, ix, child+1, child, dir))
+      child++;
+    if(!THTensor_topkWorse(v, ix, child, root, dir))
+      return;
+    THTensor_(sortSwap)(v, ix, root, child);
+    root = child;
+  }
+}
+
+void THTensor_(topk)(THTensor *rt_, THLongTensor *ri_, THTensor *t, long k, int dimension, int dir, int sorted)
+{
+  real *t_data, *rt__data;
+  long *ri__data;
+  long n, nslice, s;
+  int useHeap;
+
+  THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 3, "invalid dimension");
+  n = t->size[dimension];
+  THArgCheck(k > 0 && k <= n, 2, "k out of range");
+
+  {
+    THLongStorage *size = THTensor_(newSizeOf)(t);
+    size->data[dimension] = k;
+    THTensor_(resize)(rt_, size, NULL);
+    THLongTensor_resize(ri_, size, NULL);
+    THLongStorage_free(size);
+  }
+
+  nslice = THTensor_(nElement)(t)/n;
+  t_data = THTensor_(data)(t);
+  rt__data = THTensor_(data)(rt_);
+  ri__data = THLongTensor_data(ri_);
+  useHeap = (k*TH_TOPK_HEAP <= n);
+
+#pragma omp parallel private(s)
   {
-    TH_TENSOR_DIM_APPLY2(real, rt_, long, ri_, dimension,
-                         long i;
-                         for(i = 0; i < ri__size; i++)
-                           ri__data[i*ri__stride] = i;
-                         THTensor_(quicksortascend)(rt__data, ri__data, rt__size, rt__stride);)
+    long m = useHeap ? k : n;
+    real *v = THAlloc(sizeof(real)*m);
+    long *ix = THAlloc(sizeof(long)*m);
+
+#pragma omp for
+    for(s = 0; s < nslice; s++)
+    {
+      real *ts = t_data + THTensor_sliceOffset(s, t->nDimension, t->size, t->stride, dimension);
+      real *rs = rt__data + THTensor_sliceOffset(s, rt_->nDimension, rt_->size, rt_->stride, dimension);
+      long *is = ri__data + THTensor_sliceOffset(s, ri_->nDimension, ri_->size, ri_->stride, dimension);
+      long tstride = t->stride[dimension];
+      real *best;
+      long *bestIx;
+      long i;
+
+      if(useHeap)
+      {
+        /* the root is the worst of the kept values */
+        for(i = 0; i < k; i++)
+        {
+          v[i] = ts[i*tstride];
+          ix[i] = i;
+        }
+        for(i = k/2-1; i >= 0; i--)
+          THTensor_(topkSiftDown)(v, ix, i, k, dir);
+        for(i = k; i < n; i++)
+        {
+          real x = ts[i*tstride];
+          /* i is larger than any kept index: ties never get in */
+          if(dir ? (x > v[0]) : (x < v[0]))
+          {
+            v[0] = x;
+            ix[0] = i;
+            THTensor_(topkSiftDown)(v, ix, 0, k, dir);
+          }
+        }
+        best = v;
+        bestIx = ix;
+      }
+      else
+      {
+        for(i = 0; i < n; i++)
+        {
+          v[i] = ts[i*tstride];
+          ix[i] = i;
+        }
+        if(dir)
+        {
+          THTensor_(quickSelect)(v, ix, n, n-k, 1);
+          best = v+n-k;
+          bestIx = ix+n-k;
+        }
+        else
+        {
+          THTensor_(quickSelect)(v, ix, n, k, 0);
+          best = v;
+          bestIx = ix;
+        }
+      }
+
+      /* the selection shuffled the indices: no radix sort */
+      if(sorted)
+        THTensor_(sortValues)(best, bestIx, k, dir, NULL);
+
+      for(i = 0; i < k; i++)
+      {
+        rs[i*rt_->stride[dimension]] = best[i];
+        is[i*ri_->stride[dimension]] = bestIx[i];
       }
+    }
+
+    THFree(v);
+    THFree(ix);
+  }
 }
 
+#undef TH_TOPK_HEAP
+#undef TH_SORT_INSERTION
+#undef TH_SORT_RADIX
+#ifdef THSortKey
+#undef THSortKey
+#endif
+
 void THTensor_(tril)(THTensor *r_, THTensor *t, long k)
 {
   long t_size_0, t_size_1;
@@ -946,27 +1820,18 @@ LAB_IMPLEMENT_BASIC_FUNCTION(abs,fabs)
 
 void THTensor_(atan2)(THTensor *r_, THTensor *tx, THTensor *ty)
 {
-  THTensor_(resizeAs)(r_, tx);
+  int expanded = THTensor_(broadcast)(r_, &tx, &ty, NULL);
+  if(!expanded)
+    THTensor_(resizeAs)(r_, tx);
   TH_TENSOR_APPLY3(real, r_, real, tx, real, ty, *r__data = atan2(*tx_data,*ty_data););
+  if(expanded)
+    THTensor_(broadcastFree)(tx, ty, NULL);
 }
 
 void THTensor_(mean)(THTensor *r_, THTensor *t, int dimension)
 {
-  THLongStorage *dim;
-
   THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "invalid dimension");
-
-  dim = THTensor_(newSizeOf)(t);
-  THLongStorage_set(dim, dimension, 1);
-  THTensor_(resize)(r_, dim, NULL);
-  THLongStorage_free(dim);
-
-  TH_TENSOR_DIM_APPLY2(real, t, real, r_, dimension,
-                       accreal sum = 0;
-                       long i;
-                       for(i = 0; i < t_size; i++)
-                         sum += t_data[i*t_stride];
-                       *r__data = (real)sum/t_size;);
+  THTensor_(reduceDim)(r_, t, dimension, 0, t->size[dimension]);
 }
 
 void THTensor_(std)(THTensor *r_, THTensor *t, int dimension, int flag)
@@ -94,6 +94,15 @@ void luaT_stackdump(lua_State *L)
   printf("---------------------------------------------\n");
 }
 
+/* replaces the table on the top of the stack by its metatable, if any */
+static int luaT_replacemetatable(lua_State *L)
+{
+  if(!lua_getmetatable(L, -1))
+    return 0;
+  lua_replace(L, -2);
+  return 1;
+}
+
 /* metatable operator methods */
 static int luaT_mt__index(lua_State *L);
 static int luaT_mt__newindex(lua_State *L);
@@ -116,6 +125,51 @@ static int luaT_mt__call(lua_State *L);
 static int luaT_cmt__call(lua_State *L);
 static int luaT_cmt__newindex(lua_State *L);
 
+/* Type records. Each metatable created by luaT carries a record (a full
+   userdata, at the address of luaT_typekey) with the class name and a
+   pointer to the record of its parent class. Userdata pushed by
+   luaT_pushudata point to the record of their class, so type checks do
+   not have to look up the metatable by name in the registry. A class
+   whose parent has no record (a metatable not created by luaT) is marked
+   slow: beyond its record, checks walk the metatables. */
+typedef struct luaT_Type
+{
+  struct luaT_Type *parent;
+  int slow;
+  char name[1];
+} luaT_Type;
+
+typedef struct luaT_Udata
+{
+  void *ptr; /* must be first: Torch objects are used as void** */
+  luaT_Type *type;
+  long magic;
+} luaT_Udata;
+
+#define LUAT_UDATA_MAGIC 0x7ea5c0deL
+
+static char luaT_typekey;
+
+/* the record of the metatable at the top of the stack, or NULL */
+static luaT_Type* luaT_totype(lua_State *L)
+{
+  luaT_Type *type;
+  lua_pushlightuserdata(L, &luaT_typekey);
+  lua_rawget(L, -2);
+  type = lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  return type;
+}
+
+/* the header of a userdata pushed by luaT_pushudata, or NULL */
+static luaT_Udata* luaT_toheader(lua_State *L, int ud)
+{
+  luaT_Udata *p = lua_touserdata(L, ud);
+  if(p && lua_objlen(L, ud) == sizeof(luaT_Udata) && p->magic == LUAT_UDATA_MAGIC)
+    return p;
+  return NULL;
+}
+
 const char* luaT_newmetatable(lua_State *L, const char *tname, const char *parenttname,
                               lua_CFunction constructor, lua_CFunction destructor, lua_CFunction factory)
 {
@@ -156,6 +210,9 @@ const char *luaT_typenameid(lua_State *L, const char *tname)
 
 const char* luaT_typename(lua_State *L, int ud)
 {
+  luaT_Udata *h = luaT_toheader(L, ud);
+  if(h)
+    return h->type->name;
   if(lua_getmetatable(L, ud))
   {
     const char *tname = NULL;
@@ -172,10 +229,24 @@ void luaT_pushudata(lua_State *L, void *udata, const char *tname)
 {
   if(udata)
   {
-    void **udata_p = lua_newuserdata(L, sizeof(void*));
-    *udata_p = udata;
+    luaT_Udata *h;
+    luaT_Type *type;
     if(!luaT_pushmetatable(L, tname))
       luaL_error(L, "Torch internal problem: cannot find metatable for type <%s>", tname);
+    type = luaT_totype(L);
+    if(type)
+    {
+      h = lua_newuserdata(L, sizeof(luaT_Udata));
+      h->ptr = udata;
+      h->type = type;
+      h->magic = LUAT_UDATA_MAGIC;
+    }
+    else /* metatable not created by luaT */
+    {
+      void **udata_p = lua_newuserdata(L, sizeof(void*));
+      *udata_p = udata;
+    }
+    lua_insert(L, -2);
     lua_setmetatable(L, -2);
   }
   else
@@ -185,6 +256,26 @@ void luaT_pushudata(lua_State *L, void *udata, const char *tname)
 void *luaT_toudata(lua_State *L, int ud, const char *tname)
 {
   void **p = lua_touserdata(L, ud);
+  luaT_Udata *h = luaT_toheader(L, ud);
+  if(h)
+  {
+    luaT_Type *type = h->type;
+    for(;;)
+    {
+      if(!strcmp(type->name, tname))
+        return h->ptr;
+      if(!type->parent)
+        break;
+      type = type->parent;
+    }
+    if(!type->slow)
+    {
+      if(!luaT_pushmetatable(L, tname))
+        luaL_error(L, "Torch internal problem: cannot find metatable for type <%s>", tname);
+      lua_pop(L, 1);
+      return NULL;
+    }
+  }
   if(p != NULL) /* value is a userdata? */
   {
     if(!luaT_pushmetatable(L, tname))
@@ -391,6 +482,7 @@ const char *luaT_classmodulename(const char *tname)
 int luaT_lua_newmetatable(lua_State *L)
 {
   const char* tname = luaL_checkstring(L, 1);
+  luaT_Type *type, *parenttype;
 
   lua_settop(L, 5);
   luaL_argcheck(L, lua_isnoneornil(L, 2) || lua_isstring(L, 2), 2, "parent class name or nil expected");
@@ -482,6 +574,14 @@ int luaT_lua_newmetatable(lua_State *L)
 
     lua_pushcfunction(L, luaT_mt__call);
     lua_setfield(L, -2, "__call");
+
+    /* type record */
+    lua_pushlightuserdata(L, &luaT_typekey);
+    type = lua_newuserdata(L, sizeof(luaT_Type)+strlen(tname));
+    type->parent = NULL;
+    type->slow = 0;
+    strcpy(type->name, tname);
+    lua_rawset(L, -3);
   }
 
   /* we assign the parent class if necessary */
@@ -492,10 +592,16 @@ int luaT_lua_newmetatable(lua_State *L)
     else
     {
       const char* parenttname = luaL_checkstring(L, 2);
-      luaT_pushmetatable(L, parenttname);
-      if(lua_isnil(L, -1))
+      if(!luaT_pushmetatable(L, parenttname))
         luaL_error(L, "bad argument #2 (invalid parent class name %s)", parenttname);
+      parenttype = luaT_totype(L);
       lua_setmetatable(L, -2);
+      type = luaT_totype(L);
+      /* the record stays: userdata of this class may already point to it */
+      if(type && parenttype)
+        type->parent = parenttype;
+      else if(type) /* parent without record: checks beyond this class are slow */
+        type->slow = 1;
     }
   }
 
@@ -744,6 +850,22 @@ static int luaT_mt__index(lua_State *L)
   if(!lua_istable(L, -1))
     luaL_error(L, "critical internal indexing error: not a metatable");
 
+  /* methods: string keys are first looked up (raw) in the class and its
+     parents, which avoids a call to __index__ and the __index chain */
+  if(lua_type(L, 2) == LUA_TSTRING)
+  {
+    lua_pushvalue(L, -1);
+    do
+    {
+      lua_pushvalue(L, 2);
+      lua_rawget(L, -2);
+      if(!lua_isnil(L, -1))
+        return 1;
+      lua_pop(L, 1);
+    } while(luaT_replacemetatable(L));
+    lua_pop(L, 1);
+  }
+
   /* test for __index__ method first */
   lua_getfield(L, -1, "__index__");
   if(!lua_isnil(L, -1))
@@ -820,10 +942,12 @@ static int luaT_mt__newindex(lua_State *L)
 }
 
 /* note: check dans metatable pour ca, donc necessaire */
+/* binary operators may have a number as first operand: then the method is
+   looked up in the metatable of the second one */
 #define MT_DECLARE_OPERATOR(NAME, NIL_BEHAVIOR)                     \
   int luaT_mt__##NAME(lua_State *L)                                 \
   {                                                                 \
-    if(!lua_getmetatable(L, 1))                                     \
+    if(!lua_getmetatable(L, 1) && !(lua_gettop(L) > 1 && lua_getmetatable(L, 2))) \
       luaL_error(L, "internal error in __" #NAME ": no metatable"); \
                                                                     \
     lua_getfield(L, -1, "__" #NAME "__");                           \
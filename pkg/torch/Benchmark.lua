@@ -0,0 +1,182 @@
+local Benchmark = torch.class('torch.Benchmark')
+
+function Benchmark:__init()
+   self.benchmarks = {}
+   self.results = {}
+   self.warmup = 0.05   -- seconds of calls discarded before measuring
+   self.mintime = 0.02  -- seconds of calls per sample
+   self.samples = 9
+   self.timer = torch.Timer()
+end
+
+-- f() runs one iteration; flops and bytes (per iteration) are optional
+function Benchmark:add(name, f, flops, bytes)
+   if type(f) ~= 'function' then
+      error('Benchmark:add(name, f, [flops], [bytes]) expects a function')
+   end
+   table.insert(self.benchmarks, {name=name, f=f, flops=flops or 0, bytes=bytes or 0})
+end
+
+function Benchmark:time(f, n)
+   local timer = self.timer
+   local start = timer:time().real
+   for i=1,n do
+      f()
+   end
+   return timer:time().real - start
+end
+
+-- of sorted values
+local function median(x)
+   local n = #x
+   if n % 2 == 1 then
+      return x[(n+1)/2]
+   end
+   return (x[n/2] + x[n/2+1])/2
+end
+
+-- time of one iteration: the warm up calls (first touch of the buffers,
+-- allocation of the outputs...) are not measured, each sample runs enough
+-- calls to last mintime, and the cost of the timing loop itself is
+-- subtracted.
+function Benchmark:measure(f)
+   if not self.overhead then
+      local function empty() end
+      self.overhead = self:time(empty, 1e6)/1e6
+   end
+
+   local n, elapsed = 0, 0
+   repeat
+      elapsed = elapsed + self:time(f, 1)
+      n = n + 1
+   until n >= 2 and elapsed >= self.warmup
+   local reps = math.max(1, math.ceil(self.mintime*n/elapsed))
+
+   local times = {}
+   for i=1,self.samples do
+      times[i] = math.max(self:time(f, reps)/reps - self.overhead, 1e-12)
+   end
+   table.sort(times)
+   return median(times), times[1], times[#times]
+end
+
+-- runs the benchmarks whose name matches one of the given Lua patterns (all
+-- of them by default), and returns the results
+function Benchmark:run(patterns)
+   if type(patterns) == 'string' then
+      patterns = {patterns}
+   end
+   self.results = {}
+   for _,benchmark in ipairs(self.benchmarks) do
+      local selected = not patterns or #patterns == 0
+      for _,pattern in ipairs(patterns or {}) do
+         selected = selected or benchmark.name:match(pattern)
+      end
+      if selected then
+         collectgarbage()
+         local time, min, max = self:measure(benchmark.f)
+         local result = {name=benchmark.name, time=time, min=min, max=max,
+                         gflops=benchmark.flops/time*1e-9, gbs=benchmark.bytes/time*1e-9}
+         table.insert(self.results, result)
+         self:print(result)
+      end
+   end
+   return self.results
+end
+
+function Benchmark:print(result)
+   if not self.header then
+      print(string.format('%-56s %10s %10s %9s %9s %8s',
+                          'benchmark', 'median(ms)', 'min(ms)', 'GFLOP/s', 'GB/s', 'baseline'))
+      self.header = true
+   end
+   local baseline = ''
+   local ref = self.baseline and self.baseline[result.name]
+   if ref then
+      result.ratio = result.time/ref.time
+      baseline = string.format('x%.2f%s', result.ratio,
+                               result.ratio > 1 + self.tolerance and ' SLOWER' or '')
+   end
+   print(string.format('%-56s %10.4f %10.4f %9.3f %9.3f %8s',
+                       result.name, result.time*1e3, result.min*1e3,
+                       result.gflops, result.gbs, baseline))
+   io.stdout:flush()
+end
+
+-- tab separated results: one line per benchmark, times in seconds
+function Benchmark:write(filename)
+   local f = assert(io.open(filename, 'w'))
+   f:write(string.format('# torch.Benchmark threads=%d samples=%d\n', torch.getnumthreads(), self.samples))
+   f:write('name\ttime\tmin\tmax\tgflops\tgbs\n')
+   for _,result in ipairs(self.results) do
+      f:write(string.format('%s\t%.6e\t%.6e\t%.6e\t%.6e\t%.6e\n', result.name, result.time,
+                            result.min, result.max, result.gflops, result.gbs))
+   end
+   f:close()
+end
+
+function Benchmark:read(filename)
+   local results = {}
+   for line in io.lines(filename) do
+      local name, time, min, max, gflops, gbs = line:match('^([^\t#]+)\t([^\t]+)\t([^\t]+)\t([^\t]+)\t([^\t]+)\t([^\t]+)$')
+      if name and tonumber(time) then
+         results[name] = {name=name, time=tonumber(time), min=tonumber(min), max=tonumber(max),
+                          gflops=tonumber(gflops), gbs=tonumber(gbs)}
+      end
+   end
+   return results
+end
+
+-- results are then compared to the given baseline file (written by
+-- Benchmark:write()): a benchmark more than tolerance slower is a regression
+function Benchmark:setBaseline(filename, tolerance)
+   self.baseline = self:read(filename)
+   self.tolerance = tolerance or 0.1
+end
+
+function Benchmark:regressions()
+   local regressions = {}
+   for _,result in ipairs(self.results) do
+      if result.ratio and result.ratio > 1 + self.tolerance then
+         table.insert(regressions, result)
+      end
+   end
+   return regressions
+end
+
+-- command line driver of a benchmark script; exits with 1 on regressions
+function Benchmark:main(arg)
+   local cmd = torch.CmdLine()
+   cmd:text()
+   cmd:text('Options:')
+   cmd:option('-run', '', 'only the benchmarks matching this Lua pattern')
+   cmd:option('-save', '', 'write the results to this file')
+   cmd:option('-baseline', '', 'compare the results to this file (written with -save)')
+   cmd:option('-tolerance', 0.1, 'relative slow down counted as a regression')
+   cmd:option('-samples', self.samples, 'timed samples per benchmark')
+   cmd:option('-mintime', self.mintime, 'minimal time of a sample (seconds)')
+   cmd:option('-threads', 1, 'number of threads')
+   cmd:text()
+   local opt = cmd:parse(arg or {})
+
+   torch.setnumthreads(opt.threads)
+   self.samples = opt.samples
+   self.mintime = opt.mintime
+   if opt.baseline ~= '' then
+      self:setBaseline(opt.baseline, opt.tolerance)
+   end
+   self:run(opt.run ~= '' and opt.run or nil)
+   if opt.save ~= '' then
+      self:write(opt.save)
+   end
+   if self.baseline then
+      local regressions = self:regressions()
+      print(string.format('%d regressions (tolerance %d%%)', #regressions, self.tolerance*100))
+      for _,result in ipairs(regressions) do
+         print(string.format('  %s: x%.2f', result.name, result.ratio))
+      end
+      if #regressions > 0 then
+         os.exit(1)
+      end
+   end
+end
@@ -0,0 +1,190 @@
+-- Lazy element-wise expressions.
+--
+-- torch.lazy(x) wraps a tensor. Arithmetic on the result builds an
+-- expression instead of computing anything, and expr:eval([res]) runs the
+-- whole expression at once: the inputs are read in a single pass, block by
+-- block, with intermediate results kept in small buffers (see
+-- THTensor_(fuse)). Tensors are read when the expression is evaluated, so
+-- an expression can be built once and evaluated many times.
+--
+--   torch.lazy(r):mul(0.299):add(0.587, g):add(0.114, b):eval(y)
+
+local LazyTensor = torch.class('torch.LazyTensor')
+
+-- instructions of THTensor_(fuse)
+local ADD, SUB, MUL, DIV, AXPY, ADDS, MULS, DIVS, RDIVS = 0, 1, 2, 3, 4, 5, 6, 7, 8
+
+function LazyTensor:__init(op, a, b, s)
+   if torch.typename(op) and torch.typename(op):match('Tensor$') then
+      self.tensor = op
+   else
+      self.op = op
+      self.a = a
+      self.b = b
+      self.s = s
+   end
+end
+
+function torch.lazy(tensor)
+   if torch.typename(tensor) == 'torch.LazyTensor' then
+      return tensor
+   end
+   if not (torch.typename(tensor) and torch.typename(tensor):match('Tensor$')) then
+      error('tensor or lazy expression expected')
+   end
+   return torch.LazyTensor(tensor)
+end
+
+local function node(x)
+   return torch.lazy(x)
+end
+
+function LazyTensor:add(a, b)
+   if b then
+      return torch.LazyTensor(AXPY, self, node(b), a)
+   elseif type(a) == 'number' then
+      return torch.LazyTensor(ADDS, self, nil, a)
+   else
+      return torch.LazyTensor(ADD, self, node(a))
+   end
+end
+
+function LazyTensor:mul(value)
+   return torch.LazyTensor(MULS, self, nil, value)
+end
+
+function LazyTensor:div(value)
+   return torch.LazyTensor(DIVS, self, nil, value)
+end
+
+function LazyTensor:cmul(x)
+   return torch.LazyTensor(MUL, self, node(x))
+end
+
+function LazyTensor:cdiv(x)
+   return torch.LazyTensor(DIV, self, node(x))
+end
+
+function LazyTensor:addcmul(value, x, y)
+   if not y then
+      value, x, y = 1, value, x
+   end
+   return torch.LazyTensor(AXPY, self, node(x):cmul(y), value)
+end
+
+function LazyTensor:addcdiv(value, x, y)
+   if not y then
+      value, x, y = 1, value, x
+   end
+   return torch.LazyTensor(AXPY, self, node(x):cdiv(y), value)
+end
+
+function LazyTensor.__add__(x, y)
+   if type(x) == 'number' then
+      return node(y):add(x)
+   end
+   return node(x):add(y)
+end
+
+function LazyTensor.__sub__(x, y)
+   if type(x) == 'number' then
+      return node(y):mul(-1):add(x)
+   elseif type(y) == 'number' then
+      return node(x):add(-y)
+   end
+   return torch.LazyTensor(SUB, node(x), node(y))
+end
+
+function LazyTensor.__mul__(x, y)
+   if type(x) == 'number' then
+      return node(y):mul(x)
+   elseif type(y) == 'number' then
+      return node(x):mul(y)
+   end
+   error('use cmul() for the element-wise product of lazy expressions')
+end
+
+function LazyTensor.__div__(x, y)
+   if type(x) == 'number' then
+      return torch.LazyTensor(RDIVS, node(y), nil, x)
+   elseif type(y) == 'number' then
+      return node(x):div(y)
+   end
+   error('use cdiv() for the element-wise division of lazy expressions')
+end
+
+function LazyTensor.__unm__(x)
+   return x:mul(-1)
+end
+
+-- registers: the distinct input tensors first, then temporaries, each
+-- temporary being reused once all the nodes reading it are emitted
+local function compile(root)
+   local inputs, inputReg = {}, {}
+   local uses = {}
+   local function visit(n)
+      if uses[n] then
+         uses[n] = uses[n] + 1
+         return
+      end
+      uses[n] = 1
+      if n.tensor then
+         if not inputReg[n.tensor] then
+            table.insert(inputs, n.tensor)
+            inputReg[n.tensor] = #inputs-1
+         end
+      else
+         visit(n.a)
+         if n.b then visit(n.b) end
+      end
+   end
+   visit(root)
+
+   local code, scalars = {}, {}
+   local reg, free = {}, {}
+   local ntemps = 0
+   local function release(n)
+      uses[n] = uses[n] - 1
+      if uses[n] == 0 and not n.tensor then
+         table.insert(free, reg[n])
+      end
+   end
+   local function emit(n)
+      if reg[n] then
+         return reg[n]
+      end
+      if n.tensor then
+         reg[n] = inputReg[n.tensor]
+         return reg[n]
+      end
+      local a = emit(n.a)
+      local b = n.b and emit(n.b) or a
+      release(n.a)
+      if n.b then release(n.b) end
+      local dst = table.remove(free)
+      if not dst then
+         dst = #inputs + ntemps
+         ntemps = ntemps + 1
+      end
+      local s = -1
+      if n.s then
+         table.insert(scalars, n.s)
+         s = #scalars-1
+      end
+      for _,v in ipairs({n.op, dst, a, b, s}) do
+         table.insert(code, v)
+      end
+      reg[n] = dst
+      return dst
+   end
+   emit(root)
+
+   return {inputs=inputs, ntemps=ntemps, code=code, scalars=scalars}
+end
+
+function LazyTensor:eval(res)
+   self.program = self.program or compile(self)
+   local p = self.program
+   res = res or p.inputs[1].new()
+   return res:fuse(p.inputs, p.ntemps, p.code, p.scalars)
+end
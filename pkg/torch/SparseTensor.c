@@ -0,0 +1,10 @@
+#include "general.h"
+
+#define torch_Tensor TH_CONCAT_STRING_3(torch.,Real,Tensor)
+#define torch_SparseTensor_(NAME) TH_CONCAT_4(torch_,Real,SparseTensor_,NAME)
+#define torch_SparseTensor TH_CONCAT_STRING_3(torch.,Real,SparseTensor)
+#define THFile_readRealRaw TH_CONCAT_3(THFile_read, Real, Raw)
+#define THFile_writeRealRaw TH_CONCAT_3(THFile_write, Real, Raw)
+
+#include "generic/SparseTensor.c"
+#include "THGenerateFloatTypes.h"
@@ -360,6 +360,33 @@ function Tensor.repeatTensor(tensor,...)
 end
 torch.repeatTensor = Tensor.repeatTensor
 
+-- splits a 2D tensor of rank one into a column and a row, so that
+-- tensor = torch.ger(column, row); returns nil for any other tensor
+function Tensor.separate(tensor, precision)
+   if tensor:dim() ~= 2 then
+      return
+   end
+   local r, c, pivot = 1, 1, 0
+   for i=1,tensor:size(1) do
+      for j=1,tensor:size(2) do
+         if math.abs(tensor[i][j]) > pivot then
+            r, c, pivot = i, j, math.abs(tensor[i][j])
+         end
+      end
+   end
+   if pivot == 0 then
+      return
+   end
+   local column = torch.DoubleTensor(tensor:size(1)):copy(tensor:select(2,c))
+   local row = torch.DoubleTensor(tensor:size(2)):copy(tensor[r]):div(tensor[r][c])
+   local residual = torch.ger(column, row):add(-1, torch.DoubleTensor(tensor:size()):copy(tensor))
+   if residual:abs():max() > (precision or 1e-6)*pivot then
+      return
+   end
+   return tensor.new(column:size()):copy(column), tensor.new(row:size()):copy(row)
+end
+torch.separate = Tensor.separate
+
 for _,type in ipairs(types) do
    local metatable = torch.getmetatable('torch.' .. type .. 'Tensor')
    for funcname, func in pairs(Tensor) do
@@ -98,6 +98,8 @@ argtypes.charoption = {
               return table.concat(txt, '')
          end,
 
+   luatypes = {'string', 'number'},
+
    read = function(arg, idx)
           end,
    
@@ -145,6 +147,34 @@ static const void* torch_istensortype(lua_State *L, const char *tname)
 
   return NULL;
 }
+
+/* same, for the object at index idx: its metatable is used directly,
+   instead of being looked up in the registry from its type name */
+static int torch_istensorarg(lua_State *L, int idx)
+{
+  if(!lua_getmetatable(L, idx))
+    return 0;
+
+  lua_pushvalue(L, lua_upvalueindex(1)); /* "torch" */
+  lua_rawget(L, -2);
+  if(lua_istable(L, -1))
+    return 1;
+
+  lua_pop(L, 2);
+  return 0;
+}
+
+/* dispatch functions are registered with "torch" and their name as upvalues */
+static void torch_registerdispatch(lua_State *L, const struct luaL_Reg *reg)
+{
+  for(; reg->name; reg++)
+  {
+    lua_pushstring(L, "torch");
+    lua_pushstring(L, reg->name);
+    lua_pushcclosure(L, reg->func, 2);
+    lua_setfield(L, -2, reg->name);
+  }
+}
 ]])
 
 interface.dispatchregistry = {}
@@ -161,11 +191,11 @@ function interface:wrap(name, ...)
 static int torch_NAME(lua_State *L)
 {
   int narg = lua_gettop(L);
-  const void *tname;
-  if(narg >= 1 && (tname = torch_istensortype(L, luaT_typename(L, 1)))) /* first argument is tensor? */
+  const void *tname = NULL; /* only resolved for a type string or the default type */
+  if(narg >= 1 && torch_istensorarg(L, 1)) /* first argument is tensor? */
   {
   }
-  else if(narg >= 2 && (tname = torch_istensortype(L, luaT_typename(L, 2)))) /* second? */
+  else if(narg >= 2 && torch_istensorarg(L, 2)) /* second? */
   {
   }
   else if(narg >= 1 && lua_isstring(L, narg)
@@ -176,7 +206,7 @@ static int torch_NAME(lua_State *L)
   else if(!(tname = torch_istensortype(L, torch_getdefaulttensortype(L))))
     luaL_error(L, "internal error: the default tensor type does not seem to be an actual tensor");
   
-  lua_pushstring(L, "NAME");
+  lua_pushvalue(L, lua_upvalueindex(2)); /* "NAME" */
   lua_rawget(L, -2);
   if(lua_isfunction(L, -1))
   {
@@ -185,7 +215,15 @@ static int torch_NAME(lua_State *L)
     lua_call(L, lua_gettop(L)-1, LUA_MULTRET);
   }
   else
-    return luaL_error(L, "%s does not implement the torch.NAME() function", tname);
+  {
+    if(!tname)
+    {
+      lua_pushvalue(L, -3);
+      lua_rawget(L, LUA_REGISTRYINDEX); /* the type name of the metatable */
+      tname = lua_tostring(L, -1);
+    }
+    return luaL_error(L, "%s does not implement the torch.NAME() function", (const char*)tname);
+  }
 
   return lua_gettop(L);
 }
@@ -549,6 +587,16 @@ for _,Tensor in ipairs({"ByteTensor", "CharTensor",
          {name=Tensor},
          {name="index", default=lastdim(3)},
          {name="boolean", default=0}})
+
+   wrap("topk",
+        cname("topk"),
+        {{name=Tensor, default=true, returned=true},
+         {name="IndexTensor", default=true, returned=true, noreadadd=true},
+         {name=Tensor},
+         {name="long"},
+         {name="index", default=lastdim(3)},
+         {name="boolean", default=0},
+         {name="boolean", default=1}})
    
    wrap("tril",
         cname("tril"),
@@ -1058,7 +1106,7 @@ void torch_TensorMath_init(lua_State *L)
   torch_LongTensorMath_init(L);
   torch_FloatTensorMath_init(L);
   torch_DoubleTensorMath_init(L);
-  luaL_register(L, NULL, torch_TensorMath__);
+  torch_registerdispatch(L, torch_TensorMath__);
 }
 ]])
 
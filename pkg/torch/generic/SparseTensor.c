@@ -0,0 +1,309 @@
+#ifndef TH_GENERIC_FILE
+#define TH_GENERIC_FILE "generic/SparseTensor.c"
+#else
+
+/* torch.SparseTensor()
+   torch.SparseTensor(nRow, nCol)
+   torch.SparseTensor(indices, values, nRow, nCol)  -- COO, indices is 2 x nnz
+   torch.SparseTensor(dense)                        -- CSR */
+static int torch_SparseTensor_(new)(lua_State *L)
+{
+  THSparseTensor *sparse;
+
+  if(lua_isnumber(L, 1))
+  {
+    long nRow = luaL_checklong(L, 1);
+    long nCol = luaL_checklong(L, 2);
+    luaL_argcheck(L, nRow >= 0 && nCol >= 0, 1, "invalid size");
+    sparse = THSparseTensor_(newWithSize)(nRow, nCol);
+  }
+  else if(luaT_toudata(L, 1, "torch.LongTensor"))
+  {
+    THLongTensor *indices = luaT_checkudata(L, 1, "torch.LongTensor");
+    THTensor *values = luaT_checkudata(L, 2, torch_Tensor);
+    long nRow = luaL_checklong(L, 3);
+    long nCol = luaL_checklong(L, 4);
+    long nnz, e;
+
+    luaL_argcheck(L, indices->nDimension == 2 && indices->size[0] == 2, 1, "2 x nnz tensor expected");
+    nnz = indices->size[1];
+    luaL_argcheck(L, values->nDimension == 1 && values->size[0] == nnz, 2, "one value per index expected");
+    luaL_argcheck(L, nRow >= 0 && nCol >= 0, 3, "invalid size");
+
+    for(e = 0; e < nnz; e++)
+    {
+      long row = THLongTensor_get2d(indices, 0, e);
+      long col = THLongTensor_get2d(indices, 1, e);
+      if(row < 1 || row > nRow || col < 1 || col > nCol)
+        luaL_error(L, "index (%d, %d) out of range", (int)row, (int)col);
+    }
+
+    sparse = THSparseTensor_(new)();
+    THSparseTensor_(resize)(sparse, nRow, nCol, nnz);
+    for(e = 0; e < nnz; e++)
+    {
+      sparse->rows->data[e] = THLongTensor_get2d(indices, 0, e)-1;
+      sparse->cols->data[e] = THLongTensor_get2d(indices, 1, e)-1;
+      sparse->values->data[e] = THTensor_(get1d)(values, e);
+    }
+  }
+  else if(luaT_toudata(L, 1, torch_Tensor))
+  {
+    THTensor *dense = luaT_checkudata(L, 1, torch_Tensor);
+    luaL_argcheck(L, dense->nDimension == 2, 1, "2D tensor expected");
+    sparse = THSparseTensor_(new)();
+    THSparseTensor_(fromDense)(sparse, dense);
+  }
+  else
+  {
+    luaL_argcheck(L, lua_isnoneornil(L, 1), 1, "size, indices or dense tensor expected");
+    sparse = THSparseTensor_(new)();
+  }
+
+  luaT_pushudata(L, sparse, torch_SparseTensor);
+  return 1;
+}
+
+static int torch_SparseTensor_(factory)(lua_State *L)
+{
+  luaT_pushudata(L, THSparseTensor_(new)(), torch_SparseTensor);
+  return 1;
+}
+
+static int torch_SparseTensor_(free)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THSparseTensor_(free)(sparse);
+  return 0;
+}
+
+static int torch_SparseTensor_(size)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  if(lua_isnumber(L, 2))
+  {
+    int dim = luaL_checkint(L, 2);
+    luaL_argcheck(L, dim == 1 || dim == 2, 2, "out of range");
+    lua_pushnumber(L, (dim == 1) ? sparse->nRow : sparse->nCol);
+  }
+  else
+  {
+    THLongStorage *size = THLongStorage_newWithSize(2);
+    size->data[0] = sparse->nRow;
+    size->data[1] = sparse->nCol;
+    luaT_pushudata(L, size, "torch.LongStorage");
+  }
+  return 1;
+}
+
+static int torch_SparseTensor_(nnz)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  lua_pushnumber(L, sparse->nnz);
+  return 1;
+}
+
+static int torch_SparseTensor_(format)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  lua_pushstring(L, (sparse->format == TH_SPARSE_CSR) ? "csr" : "coo");
+  return 1;
+}
+
+static int torch_SparseTensor_(isCoalesced)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  lua_pushboolean(L, sparse->coalesced);
+  return 1;
+}
+
+static int torch_SparseTensor_(coalesce)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THSparseTensor_(coalesce)(sparse);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_SparseTensor_(csr)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THSparseTensor_(toCSR)(sparse);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_SparseTensor_(coo)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THSparseTensor_(toCOO)(sparse);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_SparseTensor_(toDense)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THTensor *dense = THTensor_(new)();
+  THSparseTensor_(toDense)(sparse, dense);
+  luaT_pushudata(L, dense, torch_Tensor);
+  return 1;
+}
+
+/* 2 x nnz (row, column) pairs, 1-based */
+static int torch_SparseTensor_(indices)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THLongTensor *indices = THLongTensor_new();
+  long *data;
+  long e;
+
+  if(sparse->nnz > 0)
+  {
+    THLongTensor_resize2d(indices, 2, sparse->nnz);
+    data = THLongTensor_data(indices);
+    if(sparse->format == TH_SPARSE_CSR)
+    {
+      long i;
+      for(i = 0; i < sparse->nRow; i++)
+        for(e = sparse->rows->data[i]; e < sparse->rows->data[i+1]; e++)
+          data[e] = i+1;
+    }
+    else
+    {
+      for(e = 0; e < sparse->nnz; e++)
+        data[e] = sparse->rows->data[e]+1;
+    }
+    for(e = 0; e < sparse->nnz; e++)
+      data[sparse->nnz+e] = sparse->cols->data[e]+1;
+  }
+  luaT_pushudata(L, indices, "torch.LongTensor");
+  return 1;
+}
+
+/* shares the values until the next format change */
+static int torch_SparseTensor_(values)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THTensor *values = THTensor_(new)();
+  if(sparse->nnz > 0)
+    THTensor_(setStorage1d)(values, sparse->values, 0, sparse->nnz, 1);
+  luaT_pushudata(L, values, torch_Tensor);
+  return 1;
+}
+
+/* sparse:mm(dense, [result]) */
+static int torch_SparseTensor_(mm)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THTensor *dense = luaT_checkudata(L, 2, torch_Tensor);
+  THTensor *result = luaT_toudata(L, 3, torch_Tensor);
+
+  luaL_argcheck(L, dense->nDimension == 2 && dense->size[0] == sparse->nCol, 2, "size mismatch");
+  if(result)
+    lua_pushvalue(L, 3);
+  else
+  {
+    result = THTensor_(new)();
+    luaT_pushudata(L, result, torch_Tensor);
+  }
+  THTensor_(resize2d)(result, sparse->nRow, dense->size[1]);
+  THSparseTensor_(addmm)(result, 0, result, 1, sparse, dense);
+  return 1;
+}
+
+/* sparse:mv(vec, [result]) */
+static int torch_SparseTensor_(mv)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THTensor *vec = luaT_checkudata(L, 2, torch_Tensor);
+  THTensor *result = luaT_toudata(L, 3, torch_Tensor);
+
+  luaL_argcheck(L, vec->nDimension == 1 && vec->size[0] == sparse->nCol, 2, "size mismatch");
+  if(result)
+    lua_pushvalue(L, 3);
+  else
+  {
+    result = THTensor_(new)();
+    luaT_pushudata(L, result, torch_Tensor);
+  }
+  THTensor_(resize1d)(result, sparse->nRow);
+  THSparseTensor_(addmv)(result, 0, result, 1, sparse, vec);
+  return 1;
+}
+
+static int torch_SparseTensor_(__tostring__)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  lua_pushfstring(L, "[%s of size %dx%d with %d nonzeros (%s)]", torch_SparseTensor,
+                  (int)sparse->nRow, (int)sparse->nCol, (int)sparse->nnz,
+                  (sparse->format == TH_SPARSE_CSR) ? "csr" : "coo");
+  return 1;
+}
+
+static int torch_SparseTensor_(write)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THFile *file = luaT_checkudata(L, 2, "torch.File");
+
+  THFile_writeIntScalar(file, sparse->format);
+  THFile_writeIntScalar(file, sparse->coalesced);
+  THFile_writeLongScalar(file, sparse->nRow);
+  THFile_writeLongScalar(file, sparse->nCol);
+  THFile_writeLongScalar(file, sparse->nnz);
+  THFile_writeLongScalar(file, sparse->rows->size);
+  THFile_writeLongRaw(file, sparse->rows->data, sparse->rows->size);
+  THFile_writeLongRaw(file, sparse->cols->data, sparse->nnz);
+  THFile_writeRealRaw(file, sparse->values->data, sparse->nnz);
+  return 0;
+}
+
+static int torch_SparseTensor_(read)(lua_State *L)
+{
+  THSparseTensor *sparse = luaT_checkudata(L, 1, torch_SparseTensor);
+  THFile *file = luaT_checkudata(L, 2, "torch.File");
+  long nrows;
+
+  sparse->format = THFile_readIntScalar(file);
+  sparse->coalesced = THFile_readIntScalar(file);
+  sparse->nRow = THFile_readLongScalar(file);
+  sparse->nCol = THFile_readLongScalar(file);
+  sparse->nnz = THFile_readLongScalar(file);
+  nrows = THFile_readLongScalar(file);
+  THLongStorage_resize(sparse->rows, nrows);
+  THLongStorage_resize(sparse->cols, sparse->nnz);
+  THStorage_(resize)(sparse->values, sparse->nnz);
+  THFile_readLongRaw(file, sparse->rows->data, nrows);
+  THFile_readLongRaw(file, sparse->cols->data, sparse->nnz);
+  THFile_readRealRaw(file, sparse->values->data, sparse->nnz);
+  return 0;
+}
+
+static const struct luaL_Reg torch_SparseTensor_(_) [] = {
+  {"size", torch_SparseTensor_(size)},
+  {"nnz", torch_SparseTensor_(nnz)},
+  {"format", torch_SparseTensor_(format)},
+  {"isCoalesced", torch_SparseTensor_(isCoalesced)},
+  {"coalesce", torch_SparseTensor_(coalesce)},
+  {"csr", torch_SparseTensor_(csr)},
+  {"coo", torch_SparseTensor_(coo)},
+  {"toDense", torch_SparseTensor_(toDense)},
+  {"indices", torch_SparseTensor_(indices)},
+  {"values", torch_SparseTensor_(values)},
+  {"mm", torch_SparseTensor_(mm)},
+  {"mv", torch_SparseTensor_(mv)},
+  {"__tostring__", torch_SparseTensor_(__tostring__)},
+  {"read", torch_SparseTensor_(read)},
+  {"write", torch_SparseTensor_(write)},
+  {NULL, NULL}
+};
+
+void torch_SparseTensor_(init)(lua_State *L)
+{
+  luaT_newmetatable(L, torch_SparseTensor, NULL,
+                    torch_SparseTensor_(new), torch_SparseTensor_(free), torch_SparseTensor_(factory));
+  luaL_register(L, NULL, torch_SparseTensor_(_));
+  lua_pop(L, 1);
+}
+
+#endif
@@ -976,6 +976,56 @@ static int torch_Tensor_(map2)(lua_State *L)
   return 1;
 }
 
+/* res:fuse(inputs, ntemps, code, scalars): runs the element-wise program
+   built by torch.lazy (see Lazy.lua), with code a flat table of 5-tuples */
+static int torch_Tensor_(fuse)(lua_State *L)
+{
+  THTensor *tensor = luaT_checkudata(L, 1, torch_Tensor);
+  int ntemps = luaL_checkint(L, 3);
+  THTensor **inputs;
+  int *code;
+  real *scalars;
+  int ninputs, ncode, nscalars, i;
+
+  luaL_checktype(L, 2, LUA_TTABLE);
+  luaL_checktype(L, 4, LUA_TTABLE);
+  luaL_checktype(L, 5, LUA_TTABLE);
+  ninputs = lua_objlen(L, 2);
+  ncode = lua_objlen(L, 4);
+  nscalars = lua_objlen(L, 5);
+  luaL_argcheck(L, ninputs > 0, 2, "at least one input expected");
+  luaL_argcheck(L, ntemps >= 0, 3, "invalid number of temporaries");
+  luaL_argcheck(L, ncode % 5 == 0, 4, "instructions have 5 fields");
+
+  inputs = lua_newuserdata(L, sizeof(THTensor*)*ninputs);
+  code = lua_newuserdata(L, sizeof(int)*(ncode+1));
+  scalars = lua_newuserdata(L, sizeof(real)*(nscalars+1));
+  for(i = 0; i < ninputs; i++)
+  {
+    lua_rawgeti(L, 2, i+1);
+    inputs[i] = luaT_toudata(L, -1, torch_Tensor);
+    luaL_argcheck(L, inputs[i], 2, "inputs must be tensors of the result type");
+    lua_pop(L, 1);
+  }
+  for(i = 0; i < ncode; i++)
+  {
+    lua_rawgeti(L, 4, i+1);
+    code[i] = (int)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+  }
+  for(i = 0; i < nscalars; i++)
+  {
+    lua_rawgeti(L, 5, i+1);
+    scalars[i] = (real)luaL_checknumber(L, -1);
+    lua_pop(L, 1);
+  }
+
+  THTensor_(fuse)(tensor, inputs, ninputs, ntemps, code, ncode/5, scalars, nscalars);
+
+  lua_settop(L, 1);
+  return 1;
+}
+
 static int torch_Tensor_(factory)(lua_State *L)
 {
   THTensor *tensor = THTensor_(new)();
@@ -1059,6 +1109,7 @@ static const struct luaL_Reg torch_Tensor_(_) [] = {
   {"apply", torch_Tensor_(apply)},
   {"map", torch_Tensor_(map)},
   {"map2", torch_Tensor_(map2)},
+  {"fuse", torch_Tensor_(fuse)},
   {"read", torch_Tensor_(read)},
   {"write", torch_Tensor_(write)},
   {"__index__", torch_Tensor_(__index__)},
@@ -28,11 +28,7 @@ static int torch_TensorOperator_(__add__)(lua_State *L)
       THTensor_(add)(r, r, luaL_checknumber(L, 2));
     }
     else
-    {
-      THTensor_(resizeAs)(r, tensor1);
-      THTensor_(copy)(r, tensor1);
-      THTensor_(cadd)(r, r, 1, tensor2);
-    }
+      THTensor_(cadd)(r, tensor1, 1, tensor2);
   }
   return 1;
 }
@@ -63,11 +59,7 @@ static int torch_TensorOperator_(__sub__)(lua_State *L)
       THTensor_(add)(r, r, -luaL_checknumber(L, 2));
     }
     else
-    {
-      THTensor_(resizeAs)(r, tensor1);
-      THTensor_(copy)(r, tensor1);
-      THTensor_(cadd)(r, r, -1, tensor2);
-    }
+      THTensor_(cadd)(r, tensor1, -1, tensor2);
   }
   return 1;
 }
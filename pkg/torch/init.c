@@ -25,6 +25,9 @@ extern void torch_LongTensor_init(lua_State *L);
 extern void torch_FloatTensor_init(lua_State *L);
 extern void torch_DoubleTensor_init(lua_State *L);
 
+extern void torch_FloatSparseTensor_init(lua_State *L);
+extern void torch_DoubleSparseTensor_init(lua_State *L);
+
 extern void torch_ByteTensorOperator_init(lua_State *L);
 extern void torch_CharTensorOperator_init(lua_State *L);
 extern void torch_ShortTensorOperator_init(lua_State *L);
@@ -74,6 +77,9 @@ DLL_EXPORT int luaopen_libtorch(lua_State *L)
   torch_FloatTensor_init(L);
   torch_DoubleTensor_init(L);
 
+  torch_FloatSparseTensor_init(L);
+  torch_DoubleSparseTensor_init(L);
+
   torch_ByteTensorOperator_init(L);
   torch_CharTensorOperator_init(L);
   torch_ShortTensorOperator_init(L);
@@ -27,8 +27,76 @@ function torch.packageLuaPath(name)
    end
 end
 
+--- classes loaded on demand
+-- torch.autoload(req, tname, parenttname) declares that the Lua module req
+-- (as given to require()) only defines the class tname. torch.include() of
+-- this module then does not load it: it is loaded on the first access to
+-- the class, either through its module table (e.g. nn.SpatialFovea), or
+-- by name (torch.getmetatable(), torch.factory(), deserialization, ...).
+-- Package bundles (see cmake/lua2exe/lua2bundle.lua) declare their class
+-- files this way.
+local autoloads = {}
+local autoloadreqs = {}
+
+local function autoload(tname)
+   local entry = autoloads[tname]
+   if entry then
+      autoloads[tname] = nil
+      if entry.parent then
+         autoload(entry.parent)
+      end
+      require(entry.req)
+   end
+end
+
+local function autoloadmodule(modname)
+   local module = modname and rawget(_G, modname)
+   if type(module) ~= 'table' then
+      return false
+   end
+   local mt = getmetatable(module)
+   if mt then
+      return mt.__autoload
+   end
+   setmetatable(module, {
+      __autoload = true,
+      __index = function(self, key)
+                   if type(key) == 'string' and autoloads[modname .. '.' .. key] then
+                      autoload(modname .. '.' .. key)
+                      return rawget(self, key)
+                   end
+                end
+   })
+   return true
+end
+
+local function autoloadhook(func, argidx)
+   return function(...)
+             local tname = select(argidx, ...)
+             if autoloads[tname] then
+                autoload(tname)
+             end
+             return func(...)
+          end
+end
+
+function torch.autoload(req, tname, parenttname)
+   if not next(autoloadreqs) then
+      torch.getmetatable = autoloadhook(torch.getmetatable, 1)
+      torch.getconstructortable = autoloadhook(torch.getconstructortable, 1)
+      torch.factory = autoloadhook(torch.factory, 1)
+      torch.newmetatable = autoloadhook(torch.newmetatable, 2)
+   end
+   autoloads[tname] = {req=req, parent=parenttname}
+   autoloadreqs[req] = tname
+end
+
 function torch.include(package, file)
    local req = package .. '.' .. file:gsub('.lua$','')
+   local tname = autoloadreqs[req]
+   if tname and autoloads[tname] and autoloadmodule(tname:match('^(.*)%.')) then
+      return
+   end
    require(req)
 end
 
@@ -62,6 +130,7 @@ function torch.setdefaulttensortype(typename)
    if torch.getconstructortable(typename) then
       torch.Tensor = torch.getconstructortable(typename)
       torch.Storage = torch.getconstructortable(torch.typename(torch.Tensor(1):storage()))
+      torch.SparseTensor = torch.getconstructortable((typename:gsub('Tensor$', 'SparseTensor')))
    else
       error(string.format("<%s> is not a string describing a torch object", typename))
    end
@@ -70,8 +139,10 @@ end
 torch.setdefaulttensortype('torch.FloatTensor')
 
 torch.include('torch','Tensor.lua')
+torch.include('torch','Lazy.lua')
 torch.include('torch','File.lua')
 torch.include('torch','CmdLine.lua')
 torch.include('torch','Tester.lua')
+torch.include('torch','Benchmark.lua')
 
 return torch
@@ -0,0 +1,87 @@
+-- TH benchmarks: BLAS, element-wise math, reductions and serialization
+-- typical usage: lua benchmark.lua [-run pattern] [-save file] [-baseline file]
+
+require 'torch'
+
+local bench = torch.Benchmark()
+local elementsize = ({['torch.FloatTensor']=4, ['torch.DoubleTensor']=8})[torch.getdefaulttensortype()]
+
+torch.manualSeed(1234)
+
+-- BLAS
+for _,n in ipairs{64, 256, 1024} do
+   local a, b, c = torch.rand(n,n), torch.rand(n,n), torch.zeros(n,n)
+   bench:add(string.format('gemm %dx%dx%d', n, n, n), function() c:addmm(0, 1, a, b) end,
+             2*n*n*n, 4*n*n*elementsize)
+end
+
+-- as in the convolution layers: 96 5x5x3 filters on 60x60 outputs
+do
+   local m, n, k = 96, 3600, 75
+   local a, b, c = torch.rand(m,k), torch.rand(k,n), torch.zeros(m,n)
+   bench:add(string.format('gemm %dx%dx%d', m, n, k), function() c:addmm(0, 1, a, b) end,
+             2*m*n*k, (m*k+k*n+2*m*n)*elementsize)
+end
+
+for _,size in ipairs{{256, 256}, {4096, 1024}} do
+   local m, n = size[1], size[2]
+   local a, x, y = torch.rand(m,n), torch.rand(n), torch.zeros(m)
+   bench:add(string.format('gemv %dx%d', m, n), function() y:addmv(0, 1, a, x) end,
+             2*m*n, (m*n+n+2*m)*elementsize)
+   local aT = a:t()
+   local xT, yT = torch.rand(m), torch.zeros(n)
+   bench:add(string.format('gemv %dx%d (transposed)', m, n), function() yT:addmv(0, 1, aT, xT) end,
+             2*m*n, (m*n+m+2*n)*elementsize)
+end
+
+-- element-wise math, on contiguous tensors small and large
+for _,n in ipairs{1e3, 1e6} do
+   local x, y, z = torch.rand(n), torch.rand(n), torch.zeros(n)
+   bench:add(string.format('fill %d', n), function() z:fill(1) end, 0, n*elementsize)
+   bench:add(string.format('copy %d', n), function() z:copy(x) end, 0, 2*n*elementsize)
+   bench:add(string.format('add %d', n), function() z:add(x, y) end, n, 3*n*elementsize)
+   bench:add(string.format('mul %d', n), function() z:mul(x, 2) end, n, 2*n*elementsize)
+   bench:add(string.format('cmul %d', n), function() z:cmul(x, y) end, n, 3*n*elementsize)
+   bench:add(string.format('addcmul %d', n), function() z:addcmul(0.5, x, y) end, 3*n, 3*n*elementsize)
+   bench:add(string.format('exp %d', n), function() z:exp(x) end, n, 2*n*elementsize)
+   bench:add(string.format('tanh %d', n), function() z:tanh(x) end, n, 2*n*elementsize)
+end
+
+-- non contiguous
+do
+   local x, z = torch.rand(1000, 1000), torch.zeros(1000, 1000)
+   bench:add('copy 1000x1000 (transposed)', function() z:copy(x:t()) end, 0, 2*1e6*elementsize)
+   bench:add('add 1000x1000 (transposed)', function() z:add(x:t()) end, 1e6, 3*1e6*elementsize)
+end
+
+-- reductions
+do
+   local x = torch.rand(1000, 1000)
+   local r = torch.Tensor()
+   bench:add('sum 1000x1000', function() x:sum() end, 1e6, 1e6*elementsize)
+   bench:add('sum 1000x1000 (dim 1)', function() r:sum(x, 1) end, 1e6, 1e6*elementsize)
+   bench:add('sum 1000x1000 (dim 2)', function() r:sum(x, 2) end, 1e6, 1e6*elementsize)
+   local values, indices = torch.Tensor(), torch.LongTensor()
+   bench:add('max 1000x1000 (dim 2)', function() values:max(indices, x, 2) end, 1e6, 1e6*elementsize)
+   bench:add('mean 1000x1000 (dim 1)', function() r:mean(x, 1) end, 1e6, 1e6*elementsize)
+   bench:add('norm 1000x1000', function() x:norm() end, 2e6, 1e6*elementsize)
+end
+
+-- serialization
+do
+   local x = torch.rand(1000, 1000)
+   local filename = os.tmpname()
+   local bytes = x:nElement()*elementsize
+   torch.save(filename, x)
+   bench:add('save 1000x1000', function() torch.save(filename, x) end, 0, bytes)
+   bench:add('load 1000x1000', function() torch.load(filename) end, 0, bytes)
+   local s = torch.serialize(x)
+   bench:add('serialize 1000x1000', function() torch.serialize(x) end, 0, bytes)
+   bench:add('deserialize 1000x1000', function() torch.deserialize(s) end, 0, bytes)
+   -- objects with many small tensors, as networks
+   local t = {}
+   for i=1,1000 do t[i] = {weight=torch.rand(10), bias=torch.rand(1), name='module' .. i} end
+   bench:add('serialize 1000 tables', function() torch.serialize(t) end)
+   bench:main(arg)
+   os.remove(filename)
+end
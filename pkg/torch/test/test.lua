@@ -46,6 +46,130 @@ function torchtest.prod()
    torch.prod(mxx,x,2)
    mytester:asserteq(maxdiff(mx,mxx),0,'torch.prod value')
 end
+function torchtest.reductiondims()
+   -- reductions along each dimension, of contiguous and transposed tensors,
+   -- against a reference computed element by element
+   local x = torch.rand(5,7,300)
+   for _,t in ipairs({x, x:transpose(1,3)}) do
+      local c = t:clone()
+      local s, st = c:storage(), c:stride()
+      local p = torch.mul(t,0.02):add(0.99)
+      local ps = p:clone():storage()
+      for d=1,3 do
+         local size = c:size()
+         size[d] = 1
+         local rsum, rprod = torch.DoubleTensor():resize(size):zero(), torch.DoubleTensor():resize(size):fill(1)
+         local rmax, rmin = torch.Tensor(size):fill(-math.huge), torch.Tensor(size):fill(math.huge)
+         local imax, imin = torch.LongTensor():resize(size):zero(), torch.LongTensor():resize(size):zero()
+         local rst = rsum:stride()
+         local pos = {}
+         for a=1,c:size(1) do
+            for b=1,c:size(2) do
+               for e=1,c:size(3) do
+                  pos[1], pos[2], pos[3] = a, b, e
+                  local k = 1 + (a-1)*st[1] + (b-1)*st[2] + (e-1)*st[3]
+                  local v = s[k]
+                  local i = pos[d]
+                  pos[d] = 1
+                  local r = 1 + (pos[1]-1)*rst[1] + (pos[2]-1)*rst[2] + (pos[3]-1)*rst[3]
+                  rsum:storage()[r] = rsum:storage()[r] + v
+                  rprod:storage()[r] = rprod:storage()[r] * ps[k]
+                  if v > rmax:storage()[r] then rmax:storage()[r] = v; imax:storage()[r] = i end
+                  if v < rmin:storage()[r] then rmin:storage()[r] = v; imin:storage()[r] = i end
+               end
+            end
+         end
+         mytester:assertlt(maxdiff(torch.sum(t,d):double(),rsum),1e-4,'torch.sum dimension ' .. d)
+         mytester:assertlt(maxdiff(torch.mean(t,d):double(),rsum:clone():div(t:size(d))),1e-6,'torch.mean dimension ' .. d)
+         mytester:assertlt(maxdiff(torch.prod(p,d):double(),rprod),1e-5,'torch.prod dimension ' .. d)
+         local mx,ix = torch.max(t,d)
+         mytester:asserteq(maxdiff(mx,rmax),0,'torch.max value dimension ' .. d)
+         mytester:asserteq(maxdiff(ix,imax),0,'torch.max index dimension ' .. d)
+         local mn,ixn = torch.min(t,d)
+         mytester:asserteq(maxdiff(mn,rmin),0,'torch.min value dimension ' .. d)
+         mytester:asserteq(maxdiff(ixn,imin),0,'torch.min index dimension ' .. d)
+      end
+      local total = 0
+      for k=1,s:size() do total = total + s[k] end
+      mytester:assertlt(math.abs(t:sum()-total),1e-6,'torch.sumall')
+      mytester:asserteq(t:max(),x:max(),'torch.maxall')
+      mytester:asserteq(t:min(),x:min(),'torch.minall')
+   end
+end
+function torchtest.sumprecision()
+   local x = torch.DoubleTensor(1000000):fill(0.1)
+   mytester:assertlt(math.abs(x:sum()-100000),1e-8,'torch.sumall precision')
+   local y = torch.DoubleTensor(2,500000):fill(0.1)
+   mytester:assertlt(math.abs(y:sum(2)[1][1]-50000),1e-8,'torch.sum precision')
+   mytester:assertlt(math.abs(y:t():sum(1)[1][1]-50000),1e-8,'torch.sum precision (strided)')
+end
+function torchtest.broadcast()
+   local x = torch.rand(4,5,6)
+   local row = torch.rand(6)
+   local col = torch.rand(5,1)
+   local one = torch.rand(4,1,1)
+   -- reference: explicit copies of the operands to the full size
+   local frow = row:clone():resize(1,1,6):expandAs(x):clone()
+   local fcol = col:clone():resize(1,5,1):expandAs(x):clone()
+   local fone = one:expandAs(x):clone()
+
+   mytester:asserteq(maxdiff(torch.add(x,row),torch.add(x,frow)),0,'torch.add broadcast')
+   mytester:asserteq(maxdiff(torch.add(row,2,x),torch.add(frow,2,x)),0,'torch.add broadcast (first operand)')
+   mytester:asserteq(maxdiff(torch.cmul(x,col),torch.cmul(x,fcol)),0,'torch.cmul broadcast')
+   mytester:asserteq(maxdiff(torch.cdiv(x,one),torch.cdiv(x,fone)),0,'torch.cdiv broadcast')
+   mytester:asserteq(maxdiff(x+row,x+frow),0,'operator + broadcast')
+   mytester:asserteq(maxdiff(row-x,frow-x),0,'operator - broadcast')
+   -- broadcast between the operands only: (5,1) with (6) gives (5,6)
+   local outer = torch.cmul(col,row)
+   mytester:asserteq(outer:dim(),2,'torch.cmul broadcast dimensions')
+   mytester:asserteq(maxdiff(outer,torch.ger(col:select(2,1),row)),0,'torch.cmul outer broadcast')
+   mytester:asserteq(maxdiff(torch.addcmul(x,0.5,col,row),torch.addcmul(x,0.5,fcol,frow)),0,'torch.addcmul broadcast')
+   mytester:asserteq(maxdiff(torch.addcdiv(row,0.5,x,one),torch.addcdiv(frow,0.5,x,fone)),0,'torch.addcdiv broadcast')
+   -- in place, into the larger operand
+   local y = x:clone()
+   y:add(-1,row)
+   mytester:asserteq(maxdiff(y,torch.add(x,-1,frow)),0,'in-place broadcast')
+   -- same number of elements: element by element, as before
+   local a = torch.rand(6)
+   local b = torch.rand(2,3)
+   mytester:asserteq(maxdiff(torch.add(a,b),torch.add(a,b:clone():resize(6))),0,'same number of elements')
+   mytester:assertError(function() row:add(x) end,'in-place broadcast into the smaller operand')
+   mytester:assertError(function() torch.add(torch.rand(3),torch.rand(4)) end,'incompatible sizes')
+end
+function torchtest.lazy()
+   local x = torch.rand(msize,msize)
+   local y = torch.rand(msize,msize)
+   local z = torch.rand(msize,msize):add(1)
+   local L = torch.lazy
+   local precision = 1e-5
+   local mx = L(x):mul(2):add(3,y):cmul(z):add(1):div(4):eval()
+   local ref = torch.mul(x,2):add(3,y):cmul(z):add(1):div(4)
+   mytester:assertlt(maxdiff(mx,ref),precision,'torch.lazy chain')
+   mx = ((L(x) - y) * 0.5 + 2 / L(z) - 1):eval()
+   ref = torch.add(x,-1,y):mul(0.5):add(torch.Tensor(msize,msize):fill(2):cdiv(z)):add(-1)
+   mytester:assertlt(maxdiff(mx,ref),precision,'torch.lazy operators')
+   mx = L(x):addcmul(0.5,y,z):addcdiv(y,z):eval()
+   ref = torch.addcmul(x,0.5,y,z):addcdiv(y,z)
+   mytester:assertlt(maxdiff(mx,ref),precision,'torch.lazy addcmul/addcdiv')
+   -- a shared subexpression is computed once
+   local w = L(x):cmul(y)
+   local e = w:add(w)
+   mx = e:eval()
+   mytester:assertlt(maxdiff(mx,torch.cmul(x,y):mul(2)),precision,'torch.lazy shared subexpression')
+   mytester:asserteq(e.program.ntemps,1,'torch.lazy shared subexpression temporaries')
+   -- in place, and on non-contiguous inputs
+   local xx = x:clone()
+   L(xx):mul(2):add(y):eval(xx)
+   mytester:assertlt(maxdiff(xx,torch.mul(x,2):add(y)),precision,'torch.lazy in place')
+   local xt = x:t()
+   mx = L(xt):add(1):eval()
+   mytester:assertlt(maxdiff(mx,torch.add(xt,1)),precision,'torch.lazy non-contiguous')
+   mytester:assertError(function() L(x):add(torch.rand(3)):eval() end,'torch.lazy incompatible sizes')
+   -- programs are checked: a scalar index out of the scalars table is an error
+   mx = torch.Tensor():fuse({x}, 1, {5, 1, 0, 0, 0}, {2})
+   mytester:assertlt(maxdiff(mx,torch.add(x,2)),precision,'torch.fuse scalar')
+   mytester:assertError(function() torch.Tensor():fuse({x}, 1, {5, 1, 0, 0, 1}, {2}) end,'torch.fuse invalid scalar')
+end
 function torchtest.cumsum()
    local x = torch.rand(msize,msize)
    local mx = torch.cumsum(x,2)
@@ -138,6 +262,52 @@ function torchtest.sort()
    mytester:asserteq(maxdiff(mx,mxx),0,'torch.sort value')
    mytester:asserteq(maxdiff(ix,ixx),0,'torch.sort index')
 end
+function torchtest.sortorder()
+   -- long slices go through the radix sort, short ones through introsort
+   for _,n in ipairs({msize, 2000}) do
+      local x = torch.rand(7,n):mul(10):floor() -- with ties
+      for _,d in ipairs({1,2}) do
+         for _,desc in ipairs({false,true}) do
+            local mx,ix = torch.sort(x,d,desc)
+            local ok = true
+            for i=1,x:size(3-d) do
+               local v = mx:select(3-d,i)
+               local k = ix:select(3-d,i)
+               local xs = x:select(3-d,i)
+               for j=1,v:size(1) do
+                  if v[j] ~= xs[k[j]] then ok = false end
+                  if j > 1 then
+                     local before = desc and v[j-1] > v[j] or not desc and v[j-1] < v[j]
+                     if not (before or v[j-1] == v[j] and k[j-1] < k[j]) then ok = false end
+                  end
+               end
+            end
+            mytester:assert(ok,'torch.sort order')
+         end
+      end
+   end
+end
+function torchtest.topk()
+   for _,n in ipairs({msize, 2000}) do
+      local x = torch.rand(5,n):mul(20):floor()
+      for _,k in ipairs({1,3,n}) do
+         for _,dir in ipairs({false,true}) do
+            local mx,ix = torch.sort(x,2,dir)
+            local tx,tix = torch.topk(x,k,2,dir)
+            mytester:asserteq(maxdiff(tx,mx:narrow(2,1,k)),0,'torch.topk value')
+            mytester:asserteq(maxdiff(tix,ix:narrow(2,1,k)),0,'torch.topk index')
+            local ux,uix = torch.topk(x:t(),k,1,dir,false)
+            local sux = torch.sort(ux,1,dir)
+            mytester:asserteq(maxdiff(sux,tx:t()),0,'torch.topk unsorted value')
+            for i=1,k do
+               for j=1,x:size(1) do
+                  mytester:asserteq(ux[i][j],x[j][uix[i][j]],'torch.topk unsorted index')
+               end
+            end
+         end
+      end
+   end
+end
 function torchtest.tril()
    local x = torch.rand(msize,msize)
    local mx = torch.tril(x)
@@ -378,6 +548,69 @@ function torchtest.logical()
    mytester:asserteq(x:nElement(),all:double():sum() , 'torch.logical')
 end
 
+function torchtest.asciiFile()
+   for _,t in ipairs{'torch.FloatTensor', 'torch.DoubleTensor', 'torch.LongTensor'} do
+      local x = torch.randn(msize,msize):mul(1e3):type(t)
+      local f = torch.MemoryFile()
+      f:ascii()
+      f:writeObject(x)
+      f:seek(1)
+      local xx = f:readObject()
+      f:close()
+      mytester:asserteq(maxdiff(x,xx),0,'ascii file round trip (' .. t .. ')')
+   end
+end
+
+function torchtest.sparse()
+   for _,t in ipairs{'torch.FloatTensor', 'torch.DoubleTensor'} do
+      local x = torch.rand(msize, msize):type(t)
+      x:apply(function(v) return v > 0.9 and v or 0 end)
+      local s = torch.getconstructortable((t:gsub('Tensor$', 'SparseTensor')))(x)
+      mytester:asserteq(s:format(), 'csr', 'sparse from dense format (' .. t .. ')')
+      mytester:asserteq(s:nnz(), x:ne(0):sum(), 'sparse nnz (' .. t .. ')')
+      mytester:asserteq(maxdiff(s:toDense(), x), 0, 'sparse to dense (' .. t .. ')')
+
+      local y = torch.rand(msize, 7):type(t)
+      mytester:assertlt(maxdiff(s:mm(y), x*y), 1e-4, 'sparse mm (' .. t .. ')')
+      mytester:assertlt(maxdiff(s:mm(y:t():t()), x*y), 1e-4, 'sparse mm transposed (' .. t .. ')')
+      local z = torch.rand(7, msize):type(t)
+      mytester:assertlt(maxdiff(s:mm(z:t()), x*z:t()), 1e-4, 'sparse mm transposed (' .. t .. ')')
+      local v = torch.rand(msize):type(t)
+      mytester:assertlt(maxdiff(s:mv(v), x*v), 1e-4, 'sparse mv (' .. t .. ')')
+
+      -- coo with duplicates, coalesced into csr
+      local indices = s:coo():indices()
+      local values = s:values()
+      local n = values:size(1)
+      local coo = torch.getconstructortable((t:gsub('Tensor$', 'SparseTensor')))(
+         torch.cat(indices, indices, 2), torch.cat(values, values), msize, msize)
+      mytester:assert(not coo:isCoalesced(), 'sparse coo not coalesced (' .. t .. ')')
+      mytester:asserteq(maxdiff(coo:toDense(), x*2), 0, 'sparse coo to dense (' .. t .. ')')
+      coo:csr()
+      mytester:asserteq(coo:nnz(), n, 'sparse coalesce nnz (' .. t .. ')')
+      mytester:asserteq(maxdiff(coo:toDense(), x*2), 0, 'sparse coalesce (' .. t .. ')')
+
+      local f = torch.MemoryFile()
+      f:writeObject(coo)
+      f:seek(1)
+      local cc = f:readObject()
+      f:close()
+      mytester:asserteq(maxdiff(cc:toDense(), x*2), 0, 'sparse file round trip (' .. t .. ')')
+   end
+end
+
+function torchtest.separate()
+   local v, h = torch.rand(5), torch.rand(7):add(-0.5)
+   local k = torch.ger(v, h)
+   local sv, sh = torch.separate(k)
+   mytester:assertlt((torch.ger(sv, sh) - k):abs():max(), 1e-5, 'rank one')
+   local fv, fh = torch.separate(k:float())
+   mytester:asserteq(torch.typename(fv), 'torch.FloatTensor', 'type of the factors')
+   k[2][3] = k[2][3] + 1
+   mytester:asserteq(torch.separate(k), nil, 'rank two')
+   mytester:asserteq(torch.separate(torch.zeros(3, 3)), nil, 'zero')
+end
+
 function torchtest.TestAsserts()
    mytester:assertError(function() error('hello') end, 'assertError: Error not caught')
 
@@ -388,6 +621,26 @@ function torchtest.TestAsserts()
 end
 
 
+function torchtest.kernelStats()
+   local a = torch.DoubleTensor(20,30):uniform()
+   local b = torch.DoubleTensor(30,10):uniform()
+   torch.kernelStats(true)
+   for i=1,3 do
+      torch.mm(a, b)
+   end
+   local stats = torch.kernelStats(true)
+   mytester:asserteq(next(torch.kernelStats()), nil, 'torch.kernelStats reset')
+   -- empty when TH is built without WITH_TH_STATS
+   if next(stats) then
+      local gemm = stats.THDoubleBlas_gemm
+      mytester:asserteq(gemm.calls, 3, 'torch.kernelStats calls')
+      mytester:asserteq(gemm.bytes, 3*(20*30+30*10+2*20*10)*8, 'torch.kernelStats bytes')
+      -- m x n x k of the (column major) BLAS call
+      mytester:asserteq(gemm.shapes['10x20x30'].calls, 3, 'torch.kernelStats shapes')
+      mytester:assertgt(gemm.time, 0, 'torch.kernelStats time')
+   end
+end
+
 function torchtest.BugInAssertTableEq()
    local t = {1,2,3}
    local tt = {1,2,3}
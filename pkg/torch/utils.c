@@ -165,6 +165,73 @@ static int torch_setnumthreads(lua_State *L)
   return 0;
 }
 
+static void torch_kernelstats_shape(const THStatsShape *shape, void *data)
+{
+  lua_State *L = data;
+  char key[256];
+  int i, n = 0;
+
+  for(i = 0; i < shape->ndim; i++)
+    n += snprintf(key+n, sizeof(key)-n, (i ? "x%ld" : "%ld"), shape->shape[i]);
+
+  lua_getfield(L, -1, THStats_name(shape->kernel));
+  if(lua_isnil(L, -1)) /* counted while reading */
+  {
+    lua_pop(L, 1);
+    return;
+  }
+  lua_getfield(L, -1, "shapes");
+  lua_getfield(L, -1, key);
+  if(lua_isnil(L, -1))
+  {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushnumber(L, 0);
+    lua_setfield(L, -2, "calls");
+    lua_pushnumber(L, 0);
+    lua_setfield(L, -2, "time");
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -3, key);
+  }
+  lua_getfield(L, -1, "calls");
+  lua_pushnumber(L, lua_tonumber(L, -1) + shape->calls);
+  lua_setfield(L, -3, "calls");
+  lua_pop(L, 1);
+  lua_getfield(L, -1, "time");
+  lua_pushnumber(L, lua_tonumber(L, -1) + shape->ns*1e-9);
+  lua_setfield(L, -3, "time");
+  lua_pop(L, 4);
+}
+
+static int torch_kernelstats(lua_State *L)
+{
+  int reset = lua_toboolean(L, 1);
+  int kernel;
+
+  lua_newtable(L);
+  for(kernel = 0; kernel < THStats_nKernel(); kernel++)
+  {
+    long long calls, ns, bytes;
+    THStats_get(kernel, &calls, &ns, &bytes);
+    if(calls == 0)
+      continue;
+    lua_newtable(L);
+    lua_pushnumber(L, calls);
+    lua_setfield(L, -2, "calls");
+    lua_pushnumber(L, ns*1e-9);
+    lua_setfield(L, -2, "time");
+    lua_pushnumber(L, bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_newtable(L);
+    lua_setfield(L, -2, "shapes");
+    lua_setfield(L, -2, THStats_name(kernel));
+  }
+  THStats_shapes(torch_kernelstats_shape, L);
+  if(reset)
+    THStats_reset();
+  return 1;
+}
+
 static const struct luaL_Reg torch_utils__ [] = {
   {"getdefaulttensortype", torch_lua_getdefaulttensortype},
   {"isatty", torch_isatty},
@@ -172,6 +239,7 @@ static const struct luaL_Reg torch_utils__ [] = {
   {"toc", torch_lua_toc},
   {"setnumthreads", torch_setnumthreads},
   {"getnumthreads", torch_getnumthreads},
+  {"kernelStats", torch_kernelstats},
   {"factory", luaT_lua_factory},
   {"getconstructortable", luaT_lua_getconstructortable},
   {"typename", luaT_lua_typename},
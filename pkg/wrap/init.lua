@@ -35,11 +35,20 @@ function CInterface:wrap(luaname, ...)
    table.insert(txt, "{")
    table.insert(txt, "int narg = lua_gettop(L);")
 
+   local hassig = self:__hassignature(varargs)
+   if hassig then
+      table.insert(txt, "unsigned long argsig = 0;")
+      table.insert(txt, "int argsigidx;")
+   end
+
    if #varargs == 2 then
       local cfuncname = varargs[1]
       local args = varargs[2]
       
       local helpargs, cargs, argcreturned = self:__writeheaders(txt, args)
+      if hassig then
+         self:__writesignature(txt)
+      end
       self:__writechecks(txt, args)
       
       table.insert(txt, 'else')
@@ -66,6 +75,9 @@ function CInterface:wrap(luaname, ...)
          argoffset = argoffset + #allargs[k]
       end
 
+      if hassig then
+         self:__writesignature(txt)
+      end
       for k=1,#varargs/2 do
          self:__writechecks(txt, allargs[k], k)
       end
@@ -130,6 +142,72 @@ local function hasbit(x, p)
    return x % (p + p) >= p
 end
 
+-- Argument signature: the Lua types of the first SIGNARGS stack values,
+-- packed in argsig, 4 bits per value (value k at bits 4(k-1)), each one
+-- holding lua_type()+1 (codes of the Lua 5.1 API below).  Argument types
+-- listing the Lua types their check() can accept in a "luatypes" field get
+-- a (mask, value) test on argsig, tried before the check() itself: a call
+-- only runs the checks of the variants whose argument types can match.
+local SIGNARGS = 8
+local sigcodes = {none=0, ['nil']=1, boolean=2, lightuserdata=3, number=4,
+                  string=5, table=6, ['function']=7, userdata=8, thread=9}
+
+local function band4(x, y)
+   local r = 0
+   for b=1,4 do
+      if hasbit(x, bit(b)) and hasbit(y, bit(b)) then
+         r = r + bit(b)
+      end
+   end
+   return r
+end
+
+-- the widest mask selecting exactly the codes of the given Lua types
+local function sigfilter(luatypes)
+   local accepted = {}
+   for _,luatype in ipairs(luatypes) do
+      accepted[assert(sigcodes[luatype], 'unknown Lua type ' .. luatype)] = true
+   end
+   for mask=15,1,-1 do
+      local value
+      for code in pairs(accepted) do
+         value = value or band4(mask, code)
+         if band4(mask, code) ~= value then
+            value = nil
+            break
+         end
+      end
+      if value then
+         local exact = true
+         for code=0,9 do
+            if band4(mask, code) == value and not accepted[code] then
+               exact = false
+            end
+         end
+         if exact then
+            return {mask=mask, value=value}
+         end
+      end
+   end
+end
+
+function CInterface:__hassignature(varargs)
+   for k=1,#varargs/2 do
+      for _,arg in ipairs(varargs[k*2]) do
+         local argtype = self.argtypes[arg.name]
+         if argtype and argtype.luatypes and not arg.invisible then
+            return true
+         end
+      end
+   end
+   return false
+end
+
+function CInterface:__writesignature(txt)
+   table.insert(txt, string.format("for(argsigidx = (narg < %d ? narg : %d); argsigidx > 0; argsigidx--)", SIGNARGS, SIGNARGS))
+   table.insert(txt, "argsig = (argsig << 4) | (unsigned long)(lua_type(L, argsigidx)+1);")
+end
+
 local function beautify(txt)
    local indent = 0
    for i=1,#txt do
@@ -257,6 +335,18 @@ function CInterface:__writechecks(txt, args, argset)
          table.insert(txt, string.format('else if(narg %s %d', compop, #currentargs))
       end
 
+      local sigmask, sigvalue = 0, 0
+      for stackidx, arg in ipairs(currentargs) do
+         local filter = stackidx <= SIGNARGS and arg.luatypes and sigfilter(arg.luatypes)
+         if filter then
+            sigmask = sigmask + filter.mask * 16^(stackidx-1)
+            sigvalue = sigvalue + filter.value * 16^(stackidx-1)
+         end
+      end
+      if sigmask > 0 then
+         table.insert(txt, string.format("&& (argsig & 0x%xUL) == 0x%xUL", sigmask, sigvalue))
+      end
+
       for stackidx, arg in ipairs(currentargs) do
          table.insert(txt, string.format("&& %s", arg:check(stackidx)))
       end
@@ -27,6 +27,8 @@ wrap.argtypes.Tensor = {
               end
          end,
 
+   luatypes = {'userdata'},
+
    read = function(arg, idx)
              if arg.returned then
                 return string.format("arg%d_idx = %d;", arg.i, idx)
@@ -107,6 +109,8 @@ wrap.argtypes.IndexTensor = {
               return string.format('(arg%d = luaT_toudata(L, %d, "torch.LongTensor"))', arg.i, idx)
            end,
 
+   luatypes = {'userdata'},
+
    read = function(arg, idx)
              local txt = {}
              if not arg.noreadadd then
@@ -189,6 +193,8 @@ for _,typename in ipairs({"ByteTensor", "CharTensor", "ShortTensor", "IntTensor"
                  end
               end,
 
+      luatypes = {'userdata'},
+
       read = function(arg, idx)
                 if arg.returned then
                    return string.format("arg%d_idx = %d;", arg.i, idx)
@@ -290,6 +296,8 @@ wrap.argtypes.index = {
               return string.format("lua_isnumber(L, %d)", idx)
            end,
 
+   luatypes = {'number', 'string'},
+
    read = function(arg, idx)
              return string.format("arg%d = (long)lua_tonumber(L, %d)-1;", arg.i, idx)
           end,
@@ -342,6 +350,8 @@ for _,typename in ipairs({"real", "unsigned char", "char", "short", "int", "long
                  return string.format("lua_isnumber(L, %d)", idx)
               end,
 
+      luatypes = {'number', 'string'},
+
       read = function(arg, idx)
                 return string.format("arg%d = (%s)lua_tonumber(L, %d);", arg.i, typename, idx)
              end,
@@ -396,6 +406,8 @@ wrap.argtypes.boolean = {
               return string.format("lua_isboolean(L, %d)", idx)
            end,
 
+   luatypes = {'boolean'},
+
    read = function(arg, idx)
              return string.format("arg%d = lua_toboolean(L, %d);", arg.i, idx)
           end,